@@ -159,6 +159,10 @@ function(
     set(PATHS_PARAMS ${PATHS_PARAMS} --suppress_catch_stub_exceptions)
   endif()
 
+  if(BUILD_COROUTINE)
+    set(PATHS_PARAMS ${PATHS_PARAMS} --coroutines)
+  endif()
+
   if(${DEBUG_RPC_GEN})
     message(
       "
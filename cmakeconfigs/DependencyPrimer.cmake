@@ -34,6 +34,7 @@ if(NOT DEPENDENCIES_LOADED)
   option(USE_RPC_TELEMETRY "turn on rpc telemetry" OFF)
   option(USE_RPC_TELEMETRY_RAII_LOGGING
          "turn on the logging of the addref release and try cast activity of the services, proxies and stubs" OFF)
+  option(BUILD_COROUTINE "build coroutine support, requires C++20" OFF)
 
   if(NOT DEFINED RPC_OUT_BUFFER_SIZE)
     # setting RPC_OUT_BUFFER_SIZE to 4kb which is the default page size for windows and linux
@@ -60,7 +61,11 @@ if(NOT DEPENDENCIES_LOADED)
   message("ENABLE_CLANG_TIDY  ${ENABLE_CLANG_TIDY}")
   message("ENABLE_CLANG_TIDY_FIX  ${ENABLE_CLANG_TIDY_FIX}")
 
-  set(CMAKE_CXX_STANDARD 17)
+  if(BUILD_COROUTINE)
+    set(CMAKE_CXX_STANDARD 20)
+  else()
+    set(CMAKE_CXX_STANDARD 17)
+  endif()
   set(CMAKE_CXX_STANDARD_REQUIRED ON)
   set(CMAKE_CXX_EXTENSIONS OFF)
   set(CMAKE_POSITION_INDEPENDENT_CODE ON)
@@ -152,6 +157,11 @@ if(NOT DEPENDENCIES_LOADED)
   else()
     set(USE_RPC_TELEMETRY_RAII_LOGGING_FLAG)
   endif()
+  if(BUILD_COROUTINE)
+    set(BUILD_COROUTINE_FLAG BUILD_COROUTINE)
+  else()
+    set(BUILD_COROUTINE_FLAG)
+  endif()
 
   if(${ENCLAVE_TARGET} STREQUAL "SGX")
     if(${SGX_HW}) # not simulation
@@ -170,6 +180,7 @@ if(NOT DEPENDENCIES_LOADED)
         ${RPC_HANG_ON_FAILED_ASSERT_FLAG}
         ${USE_RPC_TELEMETRY_FLAG}
         ${USE_RPC_TELEMETRY_RAII_LOGGING_FLAG}
+        ${BUILD_COROUTINE_FLAG}
         ${BUILD_TEST_FLAG}
         ${ENCLAVE_MEMLEAK_DEFINES}
         ${ENABLE_EXTERNAL_VERIFICATION_FLAG}
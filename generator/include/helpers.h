@@ -21,6 +21,10 @@ std::string get_encapsulated_shared_ptr_type(const std::string& type_name);
 
 bool is_interface_param(const class_entity& lib, const std::string& type);
 
+// a std::vector or std::array of plain numbers, parameters of these types are marshalled as one block by
+// rpc::pod_block, byte_elements is set when each element is a single byte
+bool is_pod_block(std::string type_name, bool& byte_elements);
+
 bool is_type_and_parameter_the_same(std::string type, std::string name);
 
 void render_parameter(writer& header, const class_entity& m_ob, const parameter_entity& parameter);
@@ -36,11 +36,8 @@ namespace rpc_generator
         std::string additional_params,
         bool include_variadics);
 
-    void write_method(const class_entity& m_ob,
-        writer& header,
-        const std::string& interface_name,
-        const std::shared_ptr<function_entity>& function,
-        int& function_count);
+    void write_method(
+        const class_entity& m_ob, writer& header, const std::shared_ptr<function_entity>& function, bool coroutines);
 
-    void write_interface(const class_entity& m_ob, writer& header);
+    void write_interface(const class_entity& m_ob, writer& header, bool coroutines);
 }
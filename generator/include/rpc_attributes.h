@@ -12,6 +12,13 @@ namespace rpc_attribute_types
     // the last ')'
     constexpr const char* inline_namespace = "inline";
 
+    ///////////////////////////////
+    // interface modifiers
+    ///////////////////////////////
+
+    // calls to an object that implements this interface are run one at a time so the implementation needs no locks
+    constexpr const char* strand_interface = "strand";
+
     ///////////////////////////////
     // function modifiers
     ///////////////////////////////
@@ -20,6 +27,10 @@ namespace rpc_attribute_types
     // the last ')'
     constexpr const char* deprecated_function = "deprecated";
 
+    // the proxy sends the call without waiting for or allocating a reply and the stub serialises none, it cannot have
+    // out parameters and its return value only says whether the call could be sent
+    constexpr const char* oneway_function = "oneway";
+
     // this is to provide backward compatability with various bugs that break fingerprints, dont use these with new idl
     // declarations!
 
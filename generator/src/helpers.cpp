@@ -1,4 +1,5 @@
 #include <iostream>
+#include <set>
 
 #include <fmt/format.h>
 
@@ -49,6 +50,67 @@ bool is_interface_param(const class_entity& lib, const std::string& type)
     return false;
 }
 
+bool is_pod_block(std::string type_name, bool& byte_elements)
+{
+    static const std::set<std::string> byte_types = {"uint8_t", "int8_t", "char", "unsigned char", "signed char"};
+    static const std::set<std::string> number_types = {"uint16_t",
+        "int16_t",
+        "uint32_t",
+        "int32_t",
+        "uint64_t",
+        "int64_t",
+        "short",
+        "unsigned short",
+        "int",
+        "unsigned int",
+        "long",
+        "unsigned long",
+        "long long",
+        "unsigned long long",
+        "float",
+        "double"};
+
+    auto trim = [](std::string& value)
+    {
+        auto begin = value.find_first_not_of(" \t\r\n");
+        auto end = value.find_last_not_of(" \t\r\n");
+        value = begin == std::string::npos ? std::string() : value.substr(begin, end - begin + 1);
+    };
+
+    std::string reference_modifiers;
+    strip_reference_modifiers(type_name, reference_modifiers);
+    if (reference_modifiers.find('*') != std::string::npos)
+        return false;
+    trim(type_name);
+    if (type_name.rfind("const ", 0) == 0)
+        type_name = type_name.substr(6);
+    trim(type_name);
+
+    std::string element;
+    for (std::string container : {"std::vector<", "std::array<"})
+    {
+        if (type_name.rfind(container, 0) != 0 || type_name.back() != '>')
+            continue;
+        element = type_name.substr(container.size(), type_name.size() - container.size() - 1);
+        // the size of a std::array, a std::vector with its own allocator is left to yas
+        auto comma = element.find(',');
+        if (comma != std::string::npos)
+        {
+            if (container == "std::vector<")
+                return false;
+            element = element.substr(0, comma);
+        }
+    }
+    if (element.find('<') != std::string::npos)
+        return false;
+    trim(element);
+    if (element.rfind("std::", 0) == 0)
+        element = element.substr(5);
+
+    byte_elements = byte_types.count(element) != 0;
+    return byte_elements || number_types.count(element) != 0;
+}
+
 bool is_in_param(const std::list<std::string>& attributes)
 {
     return std::find(attributes.begin(), attributes.end(), attribute_types::in_param) != attributes.end();
@@ -744,7 +744,8 @@ namespace rpc_generator
         return stream.str();
     }
 
-    void write_method(const class_entity& m_ob, writer& header, const std::shared_ptr<function_entity>& function)
+    void write_method(
+        const class_entity& m_ob, writer& header, const std::shared_ptr<function_entity>& function, bool coroutines)
     {
         if (function->get_entity_type() == entity_type::FUNCTION_METHOD)
         {
@@ -783,6 +784,34 @@ namespace rpc_generator
             {
                 header.raw(") = 0;\n");
             }
+
+            if (coroutines)
+            {
+                // the awaitable flavour defaults to the blocking call so hand written implementations still compile
+                header("#ifdef BUILD_COROUTINE");
+                header.print_tabs();
+                header.raw("virtual rpc::task<{}> {}_async(", function->get_return_type(), function->get_name());
+                std::string args;
+                has_parameter = false;
+                for (auto& parameter : function->get_parameters())
+                {
+                    if (has_parameter)
+                    {
+                        header.raw(", ");
+                        args += ", ";
+                    }
+                    has_parameter = true;
+                    render_parameter(header, m_ob, parameter);
+                    auto type = parameter.get_type();
+                    if (type.size() > 2 && type.substr(type.size() - 2) == "&&")
+                        args += "std::move(" + parameter.get_name() + ")";
+                    else
+                        args += parameter.get_name();
+                }
+                header.raw(function_is_const ? ") const" : ")");
+                header.raw(" {{ co_return {}({}); }}\n", function->get_name(), args);
+                header("#endif");
+            }
         }
         else if (function->get_entity_type() == entity_type::FUNCTION_PRIVATE)
         {
@@ -794,7 +823,7 @@ namespace rpc_generator
         }
     }
 
-    void write_interface(const class_entity& m_ob, writer& header)
+    void write_interface(const class_entity& m_ob, writer& header, bool coroutines)
     {
         if (m_ob.is_in_import())
             return;
@@ -884,7 +913,7 @@ namespace rpc_generator
                     continue;
                 }
                 if (function->get_entity_type() == entity_type::FUNCTION_METHOD)
-                    write_method(m_ob, header, function);
+                    write_method(m_ob, header, function, coroutines);
             }
         }
 
@@ -2,6 +2,7 @@
 #include "cpp_parser.h"  // Your parser API header
 #include "json_schema/generator.h"
 #include "json_schema/writer.h"
+#include "helpers.h"
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -498,6 +499,19 @@ namespace json_schema_generator
             for (const auto& pair : properties)
             {
                 writer.write_key(pair.first);
+                // byte block parameters are carried as base64 by rpc::pod_block
+                bool byte_elements = false;
+                if (is_pod_block(pair.second.first, byte_elements) && byte_elements)
+                {
+                    writer.open_object();
+                    writer.write_string_property("type", "string");
+                    writer.write_string_property("contentEncoding", "base64");
+                    std::string description = find_attribute_value(pair.second.second, "description");
+                    if (!description.empty())
+                        writer.write_string_property("description", description);
+                    writer.close_object();
+                    continue;
+                }
                 map_idl_type_to_json_schema(root,
                     info.interface_entity,
                     pair.second.first,
@@ -98,6 +98,8 @@ int main(const int argc, char* argv[])
             args_parser, "exception", "exceptions that should be rethrown", {'r', "rethrow_stub_exception"});
         args::ValueFlagList<std::string> additional_stub_headers_arg(
             args_parser, "header", "additional stub headers", {'A', "additional_stub_header"});
+        args::Flag coroutines_arg(
+            args_parser, "coroutines", "generate awaitable proxies and coroutine stubs", {'C', "coroutines"});
 
         try
         {
@@ -131,6 +133,7 @@ int main(const int argc, char* argv[])
         std::vector<std::string> additional_headers = args::get(additional_headers_arg);
         std::vector<std::string> additional_stub_headers = args::get(additional_stub_headers_arg);
         bool dump_preprocessor_output_and_die = args::get(dump_preprocessor_output_and_die_arg);
+        bool coroutines = args::get(coroutines_arg);
         std::replace(header_path.begin(), header_path.end(), '\\', '/');
         std::replace(proxy_path.begin(), proxy_path.end(), '\\', '/');
         std::replace(stub_path.begin(), stub_path.end(), '\\', '/');
@@ -280,7 +283,8 @@ int main(const int argc, char* argv[])
                 additional_headers,
                 !suppress_catch_stub_exceptions,
                 rethrow_exceptions,
-                additional_stub_headers);
+                additional_stub_headers,
+                coroutines);
 
             header_stream << ends;
             proxy_stream << ends;
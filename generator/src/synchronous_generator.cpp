@@ -46,7 +46,16 @@ namespace rpc_generator
             STUB_PARAM_CAST,
             STUB_ADD_REF_OUT_PREDECLARE,
             STUB_ADD_REF_OUT,
-            STUB_MARSHALL_OUT
+            STUB_MARSHALL_OUT,
+
+            // the direct encoding passes a tuple of references to the proxy's arguments instead of a serialised
+            // buffer, $arg in the stub renderings is replaced by the tuple element
+            DIRECT_IN_TYPE,
+            DIRECT_OUT_TYPE,
+            PROXY_DIRECT_IN,
+            PROXY_DIRECT_OUT,
+            STUB_DIRECT_IN,
+            STUB_DIRECT_OUT
         };
 
         struct renderer
@@ -122,6 +131,17 @@ namespace rpc_generator
                 return fmt::format("{}_", name);
             case STUB_MARSHALL_OUT:
                 return fmt::format("{0}_, ", name);
+            case DIRECT_IN_TYPE:
+                return fmt::format("const {}&", object_type);
+            case DIRECT_OUT_TYPE:
+                return fmt::format("{}&", object_type);
+            case PROXY_DIRECT_IN:
+            case PROXY_DIRECT_OUT:
+                return name;
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = $arg;", name);
+            case STUB_DIRECT_OUT:
+                return fmt::format("$arg = std::move({}_);", name);
             default:
                 return "";
             }
@@ -162,6 +182,12 @@ namespace rpc_generator
                 return fmt::format("{}_, ", name);
             case STUB_PARAM_CAST:
                 return fmt::format("{}_", name);
+            case DIRECT_IN_TYPE:
+                return fmt::format("const {}&", object_type);
+            case PROXY_DIRECT_IN:
+                return name;
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = $arg;", name);
             default:
                 return "";
             }
@@ -210,6 +236,12 @@ namespace rpc_generator
                 return fmt::format("std::move({}_)", name);
             case STUB_MARSHALL_OUT:
                 return fmt::format("{0}_, ", name);
+            case DIRECT_IN_TYPE:
+                return fmt::format("{}&", object_type);
+            case PROXY_DIRECT_IN:
+                return name;
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = std::move($arg);", name);
             default:
                 return "";
             }
@@ -249,6 +281,12 @@ namespace rpc_generator
                 return fmt::format("{}_, ", name);
             case STUB_PARAM_CAST:
                 return fmt::format("({}*){}_", object_type, name);
+            case DIRECT_IN_TYPE:
+                return "uint64_t";
+            case PROXY_DIRECT_IN:
+                return fmt::format("(uint64_t){}", name);
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = $arg;", name);
             default:
                 return "";
             }
@@ -293,6 +331,18 @@ namespace rpc_generator
             case PROXY_VALUE_RETURN:
                 return fmt::format("{} = ({}*){}_;", name, object_type, name);
 
+            case DIRECT_IN_TYPE:
+                return "uint64_t";
+            case DIRECT_OUT_TYPE:
+                return "uint64_t&";
+            case PROXY_DIRECT_IN:
+                return fmt::format("(uint64_t){}", name);
+            case PROXY_DIRECT_OUT:
+                return fmt::format("{}_", name);
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = ({}*)$arg;", name, object_type);
+            case STUB_DIRECT_OUT:
+                return fmt::format("$arg = (uint64_t){}_;", name);
             default:
                 return "";
             }
@@ -333,6 +383,18 @@ namespace rpc_generator
                 return fmt::format("uint64_t {}_ = 0;", name);
             case STUB_MARSHALL_OUT:
                 return fmt::format("(uint64_t){}_, ", name);
+            case DIRECT_IN_TYPE:
+                return "uint64_t";
+            case DIRECT_OUT_TYPE:
+                return "uint64_t&";
+            case PROXY_DIRECT_IN:
+                return fmt::format("(uint64_t)({0} ? *{0} : nullptr)", name);
+            case PROXY_DIRECT_OUT:
+                return fmt::format("{}_", name);
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_ = ({}*)$arg;", name, object_type);
+            case STUB_DIRECT_OUT:
+                return fmt::format("$arg = (uint64_t){}_;", name);
             default:
                 return "";
             }
@@ -368,7 +430,9 @@ namespace rpc_generator
             case PROXY_PREPARE_IN_INTERFACE_ID:
                 return fmt::format("RPC_ASSERT(rpc::are_in_same_zone(this, {0}.get()));\n"
                                    "\t\t\tauto {0}_stub_id_ = proxy_bind_in_param(__rpc_sp->get_remote_rpc_version(), "
-                                   "{0}, {0}_stub_);",
+                                   "{0}, {0}_stub_);\n"
+                                   "\t\t\tif({0} && !{0}_stub_id_.object_id.is_set())\n"
+                                   "\t\t\t  __rpc_ret = rpc::error::OUT_OF_MEMORY();",
                     name);
             case PROXY_MARSHALL_IN:
             {
@@ -419,6 +483,12 @@ namespace rpc_generator
             case PROXY_VALUE_RETURN:
             case PROXY_OUT_DECLARATION:
                 return fmt::format("  rpc::interface_descriptor {}_;", name);
+            case DIRECT_IN_TYPE:
+                return "const rpc::interface_descriptor&";
+            case PROXY_DIRECT_IN:
+                return fmt::format("{}_stub_id_", name);
+            case STUB_DIRECT_IN:
+                return fmt::format("{}_object_ = $arg;", name);
             default:
                 return "";
             }
@@ -450,7 +520,9 @@ namespace rpc_generator
             case PROXY_PREPARE_IN_INTERFACE_ID:
                 return fmt::format("RPC_ASSERT(rpc::are_in_same_zone(this, {0}.get()));\n"
                                    "\t\t\tauto {0}_stub_id_ = proxy_bind_in_param(__rpc_sp->get_remote_rpc_version(), "
-                                   "{0}, {0}_stub_);",
+                                   "{0}, {0}_stub_);\n"
+                                   "\t\t\tif({0} && !{0}_stub_id_.object_id.is_set())\n"
+                                   "\t\t\t  __rpc_ret = rpc::error::OUT_OF_MEMORY();",
                     name);
             case PROXY_MARSHALL_IN:
             {
@@ -477,10 +549,22 @@ namespace rpc_generator
                 return fmt::format("rpc::interface_descriptor {0}_;", name);
             case STUB_ADD_REF_OUT:
                 return fmt::format(
-                    "{0}_ = stub_bind_out_param(zone_, protocol_version, caller_channel_zone_id, caller_zone_id, {0});",
+                    "{0}_ = stub_bind_out_param(zone_, protocol_version, caller_channel_zone_id, caller_zone_id, {0});\n"
+                    "\t\t\tif({0} && !{0}_.object_id.is_set())\n"
+                    "\t\t\t  __rpc_ret = rpc::error::OUT_OF_MEMORY();",
                     name);
             case STUB_MARSHALL_OUT:
                 return fmt::format("{}_, ", name);
+            case DIRECT_IN_TYPE:
+                return "const rpc::interface_descriptor&";
+            case DIRECT_OUT_TYPE:
+                return "rpc::interface_descriptor&";
+            case PROXY_DIRECT_IN:
+                return fmt::format("{}_stub_id_", name);
+            case PROXY_DIRECT_OUT:
+                return fmt::format("{}_", name);
+            case STUB_DIRECT_OUT:
+                return fmt::format("$arg = {}_;", name);
             default:
                 return "";
             }
@@ -679,18 +763,46 @@ namespace rpc_generator
             const std::shared_ptr<function_entity>& function,
             int& function_count,
             bool catch_stub_exceptions,
-            const std::vector<std::string>& rethrow_exceptions)
+            const std::vector<std::string>& rethrow_exceptions,
+            bool coroutine)
         {
             if (function->get_entity_type() == entity_type::FUNCTION_METHOD)
             {
                 std::string scoped_namespace;
                 ::rpc_generator::build_scoped_name(&m_ob, scoped_namespace);
 
+                bool is_oneway = false;
+                for (auto& item : function->get_attributes())
+                {
+                    if (item == rpc_attribute_types::oneway_function)
+                        is_oneway = true;
+                }
+                if (is_oneway)
+                {
+                    for (auto& parameter : function->get_parameters())
+                    {
+                        if (is_out_param(parameter.get_attributes()))
+                            throw std::runtime_error(std::string("oneway method ") + interface_name
+                                                     + "::" + function->get_name() + " cannot have out parameters");
+                    }
+                }
+
+                // the coroutine flavour awaits the transport in the proxy and the implementation in the stub, a oneway
+                // call has no reply so it is posted and the proxy does not wait for it either way
+                std::string return_keyword = coroutine ? "co_return" : "return";
+                std::string send_call = is_oneway ? "__rpc_op->post"
+                                        : coroutine ? "co_await __rpc_op->async_send"
+                                                    : "__rpc_op->send";
+                std::string out_buf_arg = is_oneway ? "" : ", __rpc_out_buf";
+
                 stub("case {}:", function_count);
                 stub("{{");
 
                 proxy.print_tabs();
-                proxy.raw("virtual {} {}(", function->get_return_type(), function->get_name());
+                if (coroutine)
+                    proxy.raw("virtual rpc::task<{}> {}_async(", function->get_return_type(), function->get_name());
+                else
+                    proxy.raw("virtual {} {}(", function->get_return_type(), function->get_name());
                 bool has_parameter = false;
                 for (auto& parameter : function->get_parameters())
                 {
@@ -760,10 +872,112 @@ namespace rpc_generator
                     }
                 }
 
-                proxy("std::vector<char> __rpc_in_buf;");
+                // the direct argument pack holds the in parameters followed by the out parameters
+                std::string direct_types;
+                std::string direct_args;
+                std::vector<std::string> stub_direct_in;
+                std::vector<std::string> stub_direct_out;
+                {
+                    size_t index = 0;
+                    auto add_direct_param = [&](const std::string& type_output, const std::string& arg_output)
+                    {
+                        if (index)
+                        {
+                            direct_types += ", ";
+                            direct_args += ", ";
+                        }
+                        direct_types += type_output;
+                        direct_args += arg_output;
+                        return fmt::format("std::get<{}>(__rpc_direct_args)", index++);
+                    };
+                    auto bind_direct_param = [](std::string output, const std::string& element)
+                    {
+                        auto pos = output.find("$arg");
+                        if (pos != std::string::npos)
+                            output.replace(pos, 4, element);
+                        return output;
+                    };
+
+                    uint64_t count = 1;
+                    for (auto& parameter : function->get_parameters())
+                    {
+                        std::string type_output;
+                        std::string arg_output;
+                        std::string stub_output;
+                        if (!do_in_param(DIRECT_IN_TYPE,
+                                from_host,
+                                m_ob,
+                                parameter.get_name(),
+                                parameter.get_type(),
+                                parameter.get_attributes(),
+                                count,
+                                type_output))
+                            continue;
+                        do_in_param(PROXY_DIRECT_IN,
+                            from_host,
+                            m_ob,
+                            parameter.get_name(),
+                            parameter.get_type(),
+                            parameter.get_attributes(),
+                            count,
+                            arg_output);
+                        do_in_param(STUB_DIRECT_IN,
+                            from_host,
+                            m_ob,
+                            parameter.get_name(),
+                            parameter.get_type(),
+                            parameter.get_attributes(),
+                            count,
+                            stub_output);
+                        auto element = add_direct_param(type_output, arg_output);
+                        if (!stub_output.empty())
+                            stub_direct_in.push_back(bind_direct_param(stub_output, element));
+                    }
+                    for (auto& parameter : function->get_parameters())
+                    {
+                        std::string type_output;
+                        std::string arg_output;
+                        std::string stub_output;
+                        if (!do_out_param(DIRECT_OUT_TYPE,
+                                from_host,
+                                m_ob,
+                                parameter.get_name(),
+                                parameter.get_type(),
+                                parameter.get_attributes(),
+                                count,
+                                type_output))
+                            continue;
+                        do_out_param(PROXY_DIRECT_OUT,
+                            from_host,
+                            m_ob,
+                            parameter.get_name(),
+                            parameter.get_type(),
+                            parameter.get_attributes(),
+                            count,
+                            arg_output);
+                        do_out_param(STUB_DIRECT_OUT,
+                            from_host,
+                            m_ob,
+                            parameter.get_name(),
+                            parameter.get_type(),
+                            parameter.get_attributes(),
+                            count,
+                            stub_output);
+                        auto element = add_direct_param(type_output, arg_output);
+                        if (!stub_output.empty())
+                            stub_direct_out.push_back(bind_direct_param(stub_output, element));
+                    }
+                }
+
+                // marshalling buffers come from the thread's buffer pool so that steady state calls do not allocate
+                proxy("rpc::pooled_buffer __rpc_in_pooled_buf;");
+                proxy("auto& __rpc_in_buf = __rpc_in_pooled_buf.get();");
                 proxy("auto __rpc_ret = rpc::error::OK();");
-                proxy(
-                    "std::vector<char> __rpc_out_buf(RPC_OUT_BUFFER_SIZE); //max size using short string optimisation");
+                if (!is_oneway)
+                {
+                    proxy("rpc::pooled_buffer __rpc_out_pooled_buf(RPC_OUT_BUFFER_SIZE);");
+                    proxy("auto& __rpc_out_buf = __rpc_out_pooled_buf.get();");
+                }
 
                 proxy("//PROXY_PREPARE_IN");
                 uint64_t count = 1;
@@ -796,13 +1010,85 @@ namespace rpc_generator
                     }
                     count++;
                 }
+                {
+                    uint64_t count = 1;
+                    proxy("//PROXY_OUT_DECLARATION");
+                    for (auto& parameter : function->get_parameters())
+                    {
+                        count++;
+                        std::string output;
+                        if (do_in_param(PROXY_OUT_DECLARATION,
+                                from_host,
+                                m_ob,
+                                parameter.get_name(),
+                                parameter.get_type(),
+                                parameter.get_attributes(),
+                                count,
+                                output))
+                            continue;
+                        if (!do_out_param(PROXY_OUT_DECLARATION,
+                                from_host,
+                                m_ob,
+                                parameter.get_name(),
+                                parameter.get_type(),
+                                parameter.get_attributes(),
+                                count,
+                                output))
+                            continue;
+
+                        proxy(output);
+                    }
+                }
+
+                std::string tag = function->get_attribute_value("tag");
+                if (tag.empty())
+                    tag = "0";
+
+                // in process transports take a tuple of references to the arguments rather than a serialised buffer
+                proxy("auto __rpc_enc = __rpc_sp->get_encoding();");
+                proxy("if(__rpc_ret == rpc::error::OK() && __rpc_enc == rpc::encoding::direct)");
+                proxy("{{");
+                proxy("std::tuple<{}> __rpc_direct_args{{{}}};", direct_types, direct_args);
+                proxy("__rpc_ret = {}(rpc::encoding::direct, (uint64_t){}, {}::get_id, {{{}}}, "
+                      "sizeof(__rpc_direct_args), (const char*)&__rpc_direct_args{});",
+                    send_call,
+                    tag,
+                    interface_name,
+                    function_count,
+                    out_buf_arg);
+                proxy("//a zone further along the route is not in this process so fall back to serialising");
+                proxy("if(__rpc_ret == rpc::error::INCOMPATIBLE_SERIALISATION())");
+                proxy("{{");
+                proxy("__rpc_enc = rpc::encoding::yas_binary;");
+                proxy("__rpc_ret = rpc::error::OK();");
+                proxy("}}");
+                proxy("}}");
+                proxy("//an input interface that could not be bound skips the call");
+                proxy("if(__rpc_ret == rpc::error::OK() && __rpc_enc != rpc::encoding::direct)");
+                proxy("{{");
+
+                stub("using __rpc_direct_args_t = std::tuple<{}>;", direct_types);
+                stub("int __rpc_ret = rpc::error::OK();");
+                stub("if(enc == rpc::encoding::direct)");
+                stub("{{");
+                stub("if(in_size_ != sizeof(__rpc_direct_args_t))");
+                stub("  {} rpc::error::STUB_DESERIALISATION_ERROR();", return_keyword);
+                if (!stub_direct_in.empty())
+                {
+                    stub("auto& __rpc_direct_args = *reinterpret_cast<const __rpc_direct_args_t*>(in_buf_);");
+                    for (auto& output : stub_direct_in)
+                        stub(output);
+                }
+                stub("}}");
+                stub("else");
+                stub("{{");
                 {
                     proxy.print_tabs();
                     proxy.raw("{}proxy_serialiser<rpc::serialiser::yas, rpc::encoding>::{}(",
                         scoped_namespace,
                         function->get_name());
                     stub.print_tabs();
-                    stub.raw("auto __rpc_ret = {}stub_deserialiser<rpc::serialiser::yas, rpc::encoding>::{}(",
+                    stub.raw("__rpc_ret = {}stub_deserialiser<rpc::serialiser::yas, rpc::encoding>::{}(",
                         scoped_namespace,
                         function->get_name());
                     count = 1;
@@ -844,22 +1130,22 @@ namespace rpc_generator
                         }
                         count++;
                     }
-                    proxy.raw("__rpc_in_buf, __rpc_sp->get_encoding());\n");
+                    proxy.raw("__rpc_in_buf, __rpc_enc);\n");
 
                     stub.raw("in_buf_, in_size_, enc);\n");
+                    stub("}}");
                     stub("if(__rpc_ret != rpc::error::OK())");
-                    stub("  return __rpc_ret;");
+                    stub("  {} __rpc_ret;", return_keyword);
                 }
 
-                std::string tag = function->get_attribute_value("tag");
-                if (tag.empty())
-                    tag = "0";
-
-                proxy("__rpc_ret = __rpc_op->send((uint64_t){}, {}::get_id, {{{}}}, __rpc_in_buf.size(), "
-                      "__rpc_in_buf.data(), __rpc_out_buf);",
+                proxy("__rpc_ret = {}(__rpc_enc, (uint64_t){}, {}::get_id, {{{}}}, __rpc_in_buf.size(), "
+                      "__rpc_in_buf.data(){});",
+                    send_call,
                     tag,
                     interface_name,
-                    function_count);
+                    function_count,
+                    out_buf_arg);
+                proxy("}}");
 
                 proxy("if(__rpc_ret >= rpc::error::MIN() && __rpc_ret <= rpc::error::MAX())");
                 proxy("{{");
@@ -888,7 +1174,7 @@ namespace rpc_generator
                         count++;
                     }
                 }
-                proxy("return __rpc_ret;");
+                proxy("{} __rpc_ret;", return_keyword);
                 proxy("}}");
 
                 stub("//STUB_PARAM_WRAP");
@@ -928,7 +1214,10 @@ namespace rpc_generator
                 }
 
                 stub.print_tabs();
-                stub.raw("__rpc_ret = __rpc_target_->{}(", function->get_name());
+                if (coroutine)
+                    stub.raw("__rpc_ret = co_await __rpc_target_->{}_async(", function->get_name());
+                else
+                    stub.raw("__rpc_ret = __rpc_target_->{}(", function->get_name());
 
                 {
                     bool has_param = false;
@@ -1001,35 +1290,6 @@ namespace rpc_generator
 
                 stub("}}");
 
-                {
-                    uint64_t count = 1;
-                    proxy("//PROXY_OUT_DECLARATION");
-                    for (auto& parameter : function->get_parameters())
-                    {
-                        count++;
-                        std::string output;
-                        if (do_in_param(PROXY_OUT_DECLARATION,
-                                from_host,
-                                m_ob,
-                                parameter.get_name(),
-                                parameter.get_type(),
-                                parameter.get_attributes(),
-                                count,
-                                output))
-                            continue;
-                        if (!do_out_param(PROXY_OUT_DECLARATION,
-                                from_host,
-                                m_ob,
-                                parameter.get_name(),
-                                parameter.get_type(),
-                                parameter.get_attributes(),
-                                count,
-                                output))
-                            continue;
-
-                        proxy(output);
-                    }
-                }
                 {
                     stub("//STUB_ADD_REF_OUT_PREDECLARE");
                     uint64_t count = 1;
@@ -1091,13 +1351,32 @@ namespace rpc_generator
                         stub("}}");
                     }
                 }
+                // a oneway call has no out parameters and nobody reads its reply so nothing is serialised back
+                if (!is_oneway)
                 {
                     uint64_t count = 1;
+                    // with the direct encoding the stub has already written the out parameters through the tuple
+                    proxy("if(__rpc_enc != rpc::encoding::direct)");
+                    proxy("{{");
                     proxy.print_tabs();
                     proxy.raw("auto __receiver_result = {}proxy_deserialiser<rpc::serialiser::yas, rpc::encoding>::{}(",
                         scoped_namespace,
                         function->get_name());
 
+                    if (stub_direct_out.empty())
+                    {
+                        stub("if(enc != rpc::encoding::direct)");
+                    }
+                    else
+                    {
+                        stub("if(enc == rpc::encoding::direct)");
+                        stub("{{");
+                        stub("auto& __rpc_direct_args = *reinterpret_cast<const __rpc_direct_args_t*>(in_buf_);");
+                        for (auto& output : stub_direct_out)
+                            stub(output);
+                        stub("}}");
+                        stub("else");
+                    }
                     stub.print_tabs();
                     stub.raw("{}stub_serialiser<rpc::serialiser::yas, rpc::encoding>::{}(",
                         scoped_namespace,
@@ -1130,13 +1409,14 @@ namespace rpc_generator
 
                         stub.raw(output);
                     }
-                    proxy.raw("__rpc_out_buf.data(), __rpc_out_buf.size(), __rpc_sp->get_encoding());\n");
+                    proxy.raw("__rpc_out_buf.data(), __rpc_out_buf.size(), __rpc_enc);\n");
                     proxy("if(__receiver_result != rpc::error::OK())");
                     proxy("  __rpc_ret = __receiver_result;");
+                    proxy("}}");
 
                     stub.raw("__rpc_out_buf, enc);\n");
                 }
-                stub("return __rpc_ret;");
+                stub("{} __rpc_ret;", return_keyword);
 
                 proxy("//PROXY_VALUE_RETURN");
                 {
@@ -1190,7 +1470,7 @@ namespace rpc_generator
                     }
                 }
 
-                proxy("return __rpc_ret;");
+                proxy("{} __rpc_ret;", return_keyword);
                 proxy("}}");
                 proxy("");
 
@@ -1205,7 +1485,8 @@ namespace rpc_generator
             writer& proxy,
             writer& stub,
             bool catch_stub_exceptions,
-            const std::vector<std::string>& rethrow_exceptions)
+            const std::vector<std::string>& rethrow_exceptions,
+            bool coroutines)
         {
             if (m_ob.is_in_import())
                 return;
@@ -1354,19 +1635,63 @@ namespace rpc_generator
                             function,
                             function_count,
                             catch_stub_exceptions,
-                            rethrow_exceptions);
+                            rethrow_exceptions,
+                            false);
                 }
 
                 stub("default:");
                 stub("return rpc::error::INVALID_METHOD_ID();");
                 stub("}};");
             }
-            proxy("}};");
-            proxy("");
 
             stub("return rpc::error::INVALID_METHOD_ID();");
             stub("}}");
             stub("");
+
+            if (coroutines)
+            {
+                // awaitable proxy methods and a stub dispatcher that awaits the implementation
+                proxy("#ifdef BUILD_COROUTINE");
+                stub("#ifdef BUILD_COROUTINE");
+                stub("rpc::task<int> {0}_stub::async_call(uint64_t protocol_version, rpc::encoding enc, "
+                     "rpc::caller_channel_zone caller_channel_zone_id, rpc::caller_zone caller_zone_id, rpc::method "
+                     "method_id, size_t in_size_, const char* in_buf_, std::vector<char>& __rpc_out_buf)",
+                    interface_name);
+                stub("{{");
+                if (has_methods)
+                {
+                    stub("switch(method_id.get_val())");
+                    stub("{{");
+
+                    int function_count = 1;
+                    for (auto& function : m_ob.get_functions())
+                    {
+                        if (function->get_entity_type() == entity_type::FUNCTION_METHOD)
+                            write_method(from_host,
+                                m_ob,
+                                proxy,
+                                stub,
+                                interface_name,
+                                function,
+                                function_count,
+                                catch_stub_exceptions,
+                                rethrow_exceptions,
+                                true);
+                    }
+
+                    stub("default:");
+                    stub("co_return rpc::error::INVALID_METHOD_ID();");
+                    stub("}};");
+                }
+                stub("co_return rpc::error::INVALID_METHOD_ID();");
+                stub("}}");
+                stub("#endif");
+                stub("");
+                proxy("#endif");
+            }
+
+            proxy("}};");
+            proxy("");
         };
 
         void write_stub_factory(const class_entity& m_ob, writer& stub, std::set<std::string>& done)
@@ -1406,7 +1731,17 @@ namespace rpc_generator
             stub("}}");
             stub("#endif");
             stub("return nullptr;");
-            stub("}}));");
+            bool strand = false;
+            for (auto& item : m_ob.get_attributes())
+            {
+                if (item == rpc_attribute_types::strand_interface)
+                    strand = true;
+            }
+            // the service needs to know which interfaces want a strand before any object that implements one is bound
+            if (strand)
+                stub("}}), true);");
+            else
+                stub("}}));");
         }
 
         void write_stub_cast_factory(const class_entity& m_ob, writer& stub)
@@ -1425,7 +1760,8 @@ namespace rpc_generator
             stub("}}");
         }
 
-        void write_interface_forward_declaration(const class_entity& m_ob, writer& header, writer& proxy, writer& stub)
+        void write_interface_forward_declaration(
+            const class_entity& m_ob, writer& header, writer& proxy, writer& stub, bool coroutines)
         {
             header("class {};", m_ob.get_name());
             proxy("class {}_proxy;", m_ob.get_name());
@@ -1474,8 +1810,21 @@ namespace rpc_generator
                  "caller_channel_zone_id, rpc::caller_zone caller_zone_id, rpc::method method_id, size_t in_size_, "
                  "const char* in_buf_, std::vector<char>& "
                  "__rpc_out_buf) override;");
+            if (coroutines)
+            {
+                stub("#ifdef BUILD_COROUTINE");
+                stub("rpc::task<int> async_call(uint64_t protocol_version, rpc::encoding enc, rpc::caller_channel_zone "
+                     "caller_channel_zone_id, rpc::caller_zone caller_zone_id, rpc::method method_id, size_t in_size_, "
+                     "const char* in_buf_, std::vector<char>& __rpc_out_buf) override;");
+                stub("#endif");
+            }
             stub("int cast(rpc::interface_ordinal interface_id, rpc::shared_ptr<rpc::i_interface_stub>& new_stub) "
                  "override;");
+            for (auto& item : m_ob.get_attributes())
+            {
+                if (item == rpc_attribute_types::strand_interface)
+                    stub("bool requires_strand() const override {{ return true; }}");
+            }
             stub("}};");
             stub("");
         }
@@ -1703,13 +2052,8 @@ namespace rpc_generator
                 }
             }
 
-            header("");
-            header("// one member-function for save/load");
-            header("template<typename Ar>");
-            header("void serialize(Ar &ar)");
-            header("{{");
-            header("std::ignore = ar;");
-            bool has_fields = false;
+            // the non static members in declaration order
+            std::vector<std::string> fields;
             for (auto& field : m_ob.get_functions())
             {
                 auto type = field->get_entity_type();
@@ -1724,35 +2068,60 @@ namespace rpc_generator
                             continue;
                         }
                     }
-
-                    has_fields = true;
-                    break;
+                    fields.push_back(field->get_name());
                 }
             }
-            if (has_fields)
+
+            header("");
+            header("// one member-function for save/load");
+            header("template<typename Ar>");
+            header("void serialize(Ar &ar)");
+            header("{{");
+            header("std::ignore = ar;");
+            if (!fields.empty())
             {
                 header("ar & YAS_OBJECT_NVP(\"{}\"", m_ob.get_name());
-
-                for (auto& field : m_ob.get_functions())
-                {
-                    auto type = field->get_entity_type();
-                    if (type != entity_type::CPPQUOTE && type != entity_type::FUNCTION_PUBLIC
-                        && type != entity_type::FUNCTION_PRIVATE && type != entity_type::CONSTEXPR)
-                    {
-                        if (field->get_entity_type() == entity_type::FUNCTION_VARIABLE)
-                        {
-                            auto* function_variable = static_cast<const function_entity*>(field.get());
-                            if (function_variable->is_static())
-                            {
-                                continue;
-                            }
-                        }
-                        header("  ,(\"{0}\", {0})", field->get_name());
-                    }
-                }
+                for (auto& field : fields)
+                    header("  ,(\"{0}\", {0})", field);
                 header(");");
             }
+            header("}}");
+
+            // the flat encoding lays the members out in this order and reads them back in place through flat_view
+            std::string members;
+            for (auto& field : fields)
+            {
+                if (!members.empty())
+                    members += ", ";
+                members += field;
+            }
+            header("");
+            header("auto flat_members() {{ return std::tie({}); }}", members);
+            header("auto flat_members() const {{ return std::tie({}); }}", members);
+            header("struct flat_view");
+            header("{{");
+            for (auto& field : fields)
+                header("rpc::flat::view_t<decltype({0}::{1})> {1};", m_ob.get_name(), field);
+            header("auto flat_members() const {{ return std::tie({}); }}", members);
+            header("}};");
 
+            // the json encoding writes the same text as yas json
+            header("");
+            header("void to_json(rpc::json::writer& __w) const");
+            header("{{");
+            header("__w.begin_object();");
+            for (auto& field : fields)
+                header("__w.member(\"{0}\", {0});", field);
+            header("__w.end_object();");
+            header("}}");
+            header("bool from_json(rpc::json::reader& __r)");
+            header("{{");
+            header("return __r.read_object([&](std::string_view {})", fields.empty() ? "" : "__key");
+            header("{{");
+            for (auto& field : fields)
+                header("if(__key == \"{0}\") return __r.read({0});", field);
+            header("return __r.skip();");
+            header("}});");
             header("}}");
 
             header("}};");
@@ -1978,14 +2347,15 @@ namespace rpc_generator
         }
 
         // entry point
-        void write_namespace_predeclaration(const class_entity& lib, writer& header, writer& proxy, writer& stub)
+        void write_namespace_predeclaration(
+            const class_entity& lib, writer& header, writer& proxy, writer& stub, bool coroutines)
         {
             for (auto cls : lib.get_classes())
             {
                 if (!cls->get_import_lib().empty())
                     continue;
                 if (cls->get_entity_type() == entity_type::INTERFACE || cls->get_entity_type() == entity_type::LIBRARY)
-                    write_interface_forward_declaration(*cls, header, proxy, stub);
+                    write_interface_forward_declaration(*cls, header, proxy, stub, coroutines);
             }
 
             for (auto cls : lib.get_classes())
@@ -2012,7 +2382,7 @@ namespace rpc_generator
                     proxy("{{");
                     stub("{{");
 
-                    write_namespace_predeclaration(*cls, header, proxy, stub);
+                    write_namespace_predeclaration(*cls, header, proxy, stub, coroutines);
 
                     header("}}");
                     proxy("}}");
@@ -2029,7 +2399,8 @@ namespace rpc_generator
             writer& proxy,
             writer& stub,
             bool catch_stub_exceptions,
-            const std::vector<std::string>& rethrow_exceptions)
+            const std::vector<std::string>& rethrow_exceptions,
+            bool coroutines)
         {
             for (auto& elem : lib.get_elements(entity_type::NAMESPACE_MEMBERS))
             {
@@ -2059,8 +2430,15 @@ namespace rpc_generator
                     proxy("{{");
                     stub("{{");
                     auto& ent = static_cast<const class_entity&>(*elem);
-                    write_namespace(
-                        from_host, ent, prefix + elem->get_name() + "::", header, proxy, stub, catch_stub_exceptions, rethrow_exceptions);
+                    write_namespace(from_host,
+                        ent,
+                        prefix + elem->get_name() + "::",
+                        header,
+                        proxy,
+                        stub,
+                        catch_stub_exceptions,
+                        rethrow_exceptions,
+                        coroutines);
                     header("}}");
                     proxy("}}");
                     stub("}}");
@@ -2074,8 +2452,8 @@ namespace rpc_generator
                 else if (elem->get_entity_type() == entity_type::INTERFACE || elem->get_entity_type() == entity_type::LIBRARY)
                 {
                     auto& ent = static_cast<const class_entity&>(*elem);
-                    ::rpc_generator::write_interface(ent, header);
-                    write_interface(from_host, ent, proxy, stub, catch_stub_exceptions, rethrow_exceptions);
+                    ::rpc_generator::write_interface(ent, header, coroutines);
+                    write_interface(from_host, ent, proxy, stub, catch_stub_exceptions, rethrow_exceptions, coroutines);
                 }
                 else if (elem->get_entity_type() == entity_type::CONSTEXPR)
                 {
@@ -2186,7 +2564,8 @@ namespace rpc_generator
             const std::vector<std::string>& additional_headers,
             bool catch_stub_exceptions,
             const std::vector<std::string>& rethrow_exceptions,
-            const std::vector<std::string>& additional_stub_headers)
+            const std::vector<std::string>& additional_stub_headers,
+            bool coroutines)
         {
             writer header(hos);
             writer proxy(pos);
@@ -2213,10 +2592,13 @@ namespace rpc_generator
             header("#include <unordered_set>");
             header("#include <string>");
             header("#include <array>");
+            header("#include <tuple>");
 
             header("#include <rpc/version.h>");
             header("#include <rpc/marshaller.h>");
             header("#include <rpc/serialiser.h>");
+            header("#include <rpc/flat.h>");
+            header("#include <rpc/json.h>");
             header("#include <rpc/service.h>");
             header("#include <rpc/error_codes.h>");
             header("#include <rpc/types.h>");
@@ -2245,6 +2627,7 @@ namespace rpc_generator
             proxy("#include <rpc/proxy.h>");
             proxy("#include <rpc/stub.h>");
             proxy("#include <rpc/service.h>");
+            proxy("#include <rpc/buffer_pool.h>");
             proxy("#include \"{}\"", header_filename);
 
             proxy("");
@@ -2280,9 +2663,10 @@ namespace rpc_generator
                 prefix += ns + "::";
             }
 
-            write_namespace_predeclaration(lib, header, proxy, stub);
+            write_namespace_predeclaration(lib, header, proxy, stub, coroutines);
 
-            write_namespace(from_host, lib, prefix, header, proxy, stub, catch_stub_exceptions, rethrow_exceptions);
+            write_namespace(
+                from_host, lib, prefix, header, proxy, stub, catch_stub_exceptions, rethrow_exceptions, coroutines);
 
             for (auto& ns : namespaces)
             {
@@ -635,6 +635,113 @@ namespace rpc_generator
             return ret + template_modifier + reference_modifiers;
         }
 
+        // the arguments as a tuple of references for the flat encoding
+        std::string flat_tie(const std::vector<std::string>& names)
+        {
+            std::string args;
+            for (auto& name : names)
+            {
+                if (!args.empty())
+                    args += ", ";
+                args += name;
+            }
+            return fmt::format("std::tie({})", args);
+        }
+
+        // sizes __buffer for a yas save with flags before it is written so that it is allocated once
+        std::string yas_reserve(const std::string& flags, const std::vector<std::string>& names)
+        {
+            std::string types;
+            for (auto& name : names)
+                types += fmt::format(", decltype({})", name);
+            return fmt::format("rpc::reserve_yas<{}{}>(__buffer, __yas_mapping);", flags, types);
+        }
+
+        // a parameter that is a contiguous block of plain numbers is marshalled through an rpc::pod_block declared
+        // ahead of the mapping rather than value by value by yas
+        void use_pod_block(const parameter_entity& parameter, std::string& output, std::vector<std::string>& blocks)
+        {
+            bool byte_elements = false;
+            if (!is_pod_block(parameter.get_type(), byte_elements))
+                return;
+            output = fmt::format("  ,(\"{0}\", __rpc_block_{0})", parameter.get_name());
+            blocks.push_back(
+                fmt::format("auto __rpc_block_{0} = rpc::make_pod_block({0}, __rpc_enc);", parameter.get_name()));
+        }
+
+        // yas binary in an rpc::lz frame
+        void write_lz_save(writer& wrtr, const std::vector<std::string>& names)
+        {
+            wrtr("case rpc::encoding::yas_lz:");
+            wrtr(yas_reserve("::yas::mem|::yas::binary|::yas::no_header", names));
+            wrtr("::yas::save<::yas::mem|::yas::binary|::yas::no_header>(::yas::vector_ostream(__buffer), "
+                 "__yas_mapping);");
+            wrtr("rpc::lz::pack(__buffer);");
+            wrtr("break;");
+        }
+
+        void write_lz_load(writer& wrtr, const char* error)
+        {
+            wrtr("case rpc::encoding::yas_lz:");
+            wrtr("{{");
+            // the scratch comes from the pool already sized for the payload so unpacking does not allocate
+            wrtr("rpc::pooled_buffer __unpacked(rpc::lz::unpacked_size(__rpc_buf, __rpc_buf_size));");
+            wrtr("const char* __payload = nullptr;");
+            wrtr("size_t __payload_size = 0;");
+            wrtr("if(!rpc::lz::unpack(__rpc_buf, __rpc_buf_size, __unpacked.get(), __payload, __payload_size))");
+            wrtr("  return rpc::error::{}();", error);
+            wrtr("::yas::load<::yas::mem|::yas::binary|::yas::no_header>(::yas::intrusive_buffer(__payload, "
+                 "__payload_size), __yas_mapping);");
+            wrtr("break;");
+            wrtr("}}");
+        }
+
+        // the json encoding writes the parameters as yas json would, byte blocks as the base64 rpc::pod_block gives.
+        // params are name and type pairs
+        void write_json_save(writer& wrtr, const std::vector<std::pair<std::string, std::string>>& params)
+        {
+            wrtr("case rpc::encoding::json:");
+            wrtr("{{");
+            wrtr("rpc::json::writer __w(__buffer);");
+            wrtr("__w.begin_object();");
+            for (auto& [name, type] : params)
+            {
+                bool byte_elements = false;
+                if (is_pod_block(type, byte_elements) && byte_elements)
+                    wrtr("__w.member_base64(\"{0}\", {0});", name);
+                else
+                    wrtr("__w.member(\"{0}\", {0});", name);
+            }
+            wrtr("__w.end_object();");
+            wrtr("if(!__w.ok())");
+            wrtr("  return rpc::error::INCOMPATIBLE_SERIALISATION();");
+            wrtr("break;");
+            wrtr("}}");
+        }
+
+        void write_json_load(
+            writer& wrtr, const std::vector<std::pair<std::string, std::string>>& params, const char* error)
+        {
+            wrtr("case rpc::encoding::json:");
+            wrtr("{{");
+            wrtr("rpc::json::reader __r(__rpc_buf, __rpc_buf_size);");
+            wrtr("if(!__r.read_object([&](std::string_view __key)");
+            wrtr("{{");
+            for (auto& [name, type] : params)
+            {
+                bool byte_elements = false;
+                if (is_pod_block(type, byte_elements) && byte_elements)
+                    wrtr("if(__key == \"{0}\") return __r.read_base64({0});", name);
+                else
+                    wrtr("if(__key == \"{0}\") return __r.read({0});", name);
+            }
+            wrtr("return __r.skip();");
+            wrtr("}}) || !__r.at_end())");
+            wrtr("  return rpc::error::{}();", error);
+            wrtr("break;");
+            wrtr("}}");
+        }
+
         void write_proxy_send_method(bool from_host,
             const class_entity& m_ob,
             writer& proxy,
@@ -655,10 +762,11 @@ namespace rpc_generator
 
             if (has_inparams)
             {
-                proxy("auto __yas_mapping = YAS_OBJECT_NVP(");
-                proxy("  \"in\"");
-
                 uint64_t count = 1;
+                std::vector<std::string> flat_names;
+                std::vector<std::string> entries;
+                std::vector<std::string> blocks;
+                std::vector<std::pair<std::string, std::string>> json_params;
                 for (auto& parameter : function->get_parameters())
                 {
                     std::string output;
@@ -673,11 +781,20 @@ namespace rpc_generator
                                 output))
                             continue;
 
-                        proxy(output);
+                        use_pod_block(parameter, output, blocks);
+                        entries.push_back(output);
+                        flat_names.push_back(parameter.get_name());
+                        json_params.emplace_back(parameter.get_name(), parameter.get_type());
                     }
                     count++;
                 }
 
+                for (auto& block : blocks)
+                    proxy(block);
+                proxy("auto __yas_mapping = YAS_OBJECT_NVP(");
+                proxy("  \"in\"");
+                for (auto& entry : entries)
+                    proxy(entry);
                 proxy("  );");
 
                 proxy("__buffer.clear(); // this does not change the capacity of the vector so this is a low cost "
@@ -685,6 +802,8 @@ namespace rpc_generator
                 proxy("switch(__rpc_enc)");
                 proxy("{{");
                 proxy("case rpc::encoding::yas_compressed_binary:");
+                proxy("case rpc::encoding::yas_compressed_blocks:");
+                proxy(yas_reserve("::yas::mem|::yas::binary|::yas::compacted|::yas::no_header", flat_names));
                 proxy("::yas::save<::yas::mem|::yas::binary|::yas::compacted|::yas::no_header>(::yas::vector_"
                       "ostream(__buffer), "
                       "__yas_mapping);");
@@ -694,19 +813,31 @@ namespace rpc_generator
                 //       "__yas_mapping);");
                 // proxy("break;");
                 proxy("case rpc::encoding::yas_json:");
+                proxy("case rpc::encoding::yas_json_blocks:");
+                proxy(yas_reserve("::yas::mem|::yas::json|::yas::no_header", flat_names));
                 proxy("::yas::save<::yas::mem|::yas::json|::yas::no_header>(::yas::vector_ostream(__buffer), "
                       "__yas_mapping);");
                 proxy("break;");
                 proxy("case rpc::encoding::enc_default:");
                 proxy("case rpc::encoding::yas_binary:");
+                proxy(yas_reserve("::yas::mem|::yas::binary|::yas::no_header", flat_names));
                 proxy("::yas::save<::yas::mem|::yas::binary|::yas::no_header>(::yas::vector_ostream(__buffer), "
                       "__yas_mapping);");
                 proxy("break;");
+                write_json_save(proxy, json_params);
+                write_lz_save(proxy, flat_names);
+                proxy("case rpc::encoding::flat:");
+                proxy("if(!rpc::flat::save(__buffer, {}))", flat_tie(flat_names));
+                proxy("  return rpc::error::INCOMPATIBLE_SERIALISATION();");
+                proxy("break;");
+                proxy("default:");
+                proxy("return rpc::error::INCOMPATIBLE_SERIALISATION();");
                 proxy("}}");
             }
             else
             {
-                proxy("if(__rpc_enc == rpc::encoding::yas_json)");
+                proxy("if(__rpc_enc == rpc::encoding::yas_json || __rpc_enc == rpc::encoding::yas_json_blocks");
+                proxy("   || __rpc_enc == rpc::encoding::json)");
                 proxy("  __buffer = {{'{{','}}'}};");
             }
             proxy("return rpc::error::OK();");
@@ -741,10 +872,11 @@ namespace rpc_generator
                 proxy("    return rpc::error::PROXY_DESERIALISATION_ERROR();");
                 proxy("try");
                 proxy("{{");
-                proxy("auto __yas_mapping = YAS_OBJECT_NVP(");
-                proxy("  \"out\"");
-
                 uint64_t count = 1;
+                std::vector<std::string> flat_names;
+                std::vector<std::string> entries;
+                std::vector<std::string> blocks;
+                std::vector<std::pair<std::string, std::string>> json_params;
                 for (auto& parameter : function->get_parameters())
                 {
                     count++;
@@ -758,12 +890,22 @@ namespace rpc_generator
                             count,
                             output))
                         continue;
-                    proxy(output);
+                    use_pod_block(parameter, output, blocks);
+                    entries.push_back(output);
+                    flat_names.push_back(parameter.get_name());
+                    json_params.emplace_back(parameter.get_name(), parameter.get_type());
                 }
+                for (auto& block : blocks)
+                    proxy(block);
+                proxy("auto __yas_mapping = YAS_OBJECT_NVP(");
+                proxy("  \"out\"");
+                for (auto& entry : entries)
+                    proxy(entry);
                 proxy("  );");
                 proxy("switch(__rpc_enc)");
                 proxy("{{");
                 proxy("case rpc::encoding::yas_compressed_binary:");
+                proxy("case rpc::encoding::yas_compressed_blocks:");
                 proxy("::yas::load<::yas::mem|::yas::binary|::yas::compacted|::yas::no_header>(::yas::intrusive_"
                       "buffer(__rpc_buf,__rpc_buf_size), "
                       "__yas_mapping);");
@@ -773,6 +915,7 @@ namespace rpc_generator
                 //       "rpc_buf_size), __yas_mapping);");
                 // proxy("break;");
                 proxy("case rpc::encoding::yas_json:");
+                proxy("case rpc::encoding::yas_json_blocks:");
                 proxy("::yas::load<::yas::mem|::yas::json|::yas::no_header>(::yas::intrusive_buffer(__rpc_buf,__"
                       "rpc_buf_size), __yas_mapping);");
                 proxy("break;");
@@ -781,6 +924,12 @@ namespace rpc_generator
                 proxy("::yas::load<::yas::mem|::yas::binary|::yas::no_header>(::yas::intrusive_buffer(__rpc_buf,__"
                       "rpc_buf_size), __yas_mapping);");
                 proxy("break;");
+                write_json_load(proxy, json_params, "PROXY_DESERIALISATION_ERROR");
+                write_lz_load(proxy, "PROXY_DESERIALISATION_ERROR");
+                proxy("case rpc::encoding::flat:");
+                proxy("if(!rpc::flat::load(__rpc_buf, __rpc_buf_size, {}))", flat_tie(flat_names));
+                proxy("  return rpc::error::PROXY_DESERIALISATION_ERROR();");
+                proxy("break;");
                 proxy("default:");
                 proxy("return rpc::error::PROXY_DESERIALISATION_ERROR();");
                 proxy("}}");
@@ -840,10 +989,11 @@ namespace rpc_generator
                 stub("    return rpc::error::STUB_DESERIALISATION_ERROR();");
                 stub("try");
                 stub("{{");
-                stub("auto __yas_mapping = YAS_OBJECT_NVP(");
-                stub("  \"out\"");
-
                 uint64_t count = 1;
+                std::vector<std::string> flat_names;
+                std::vector<std::string> entries;
+                std::vector<std::string> blocks;
+                std::vector<std::pair<std::string, std::string>> json_params;
                 for (auto& parameter : function->get_parameters())
                 {
                     count++;
@@ -857,13 +1007,23 @@ namespace rpc_generator
                             count,
                             output))
                         continue;
-                    stub(output);
+                    use_pod_block(parameter, output, blocks);
+                    entries.push_back(output);
+                    flat_names.push_back(parameter.get_name());
+                    json_params.emplace_back(parameter.get_name(), parameter.get_type());
                 }
+                for (auto& block : blocks)
+                    stub(block);
+                stub("auto __yas_mapping = YAS_OBJECT_NVP(");
+                stub("  \"out\"");
+                for (auto& entry : entries)
+                    stub(entry);
                 stub("  );");
 
                 stub("switch(__rpc_enc)");
                 stub("{{");
                 stub("case rpc::encoding::yas_compressed_binary:");
+                stub("case rpc::encoding::yas_compressed_blocks:");
                 stub("::yas::load<::yas::mem|::yas::binary|::yas::compacted|::yas::no_header>(::yas::intrusive_"
                      "buffer(__rpc_buf,__rpc_buf_size), "
                      "__yas_mapping);");
@@ -873,6 +1033,7 @@ namespace rpc_generator
                 //       "rpc_buf_size), __yas_mapping);");
                 // stub("break;");
                 stub("case rpc::encoding::yas_json:");
+                stub("case rpc::encoding::yas_json_blocks:");
                 stub("::yas::load<::yas::mem|::yas::json|::yas::no_header>(::yas::intrusive_buffer(__rpc_buf,__"
                      "rpc_buf_size), __yas_mapping);");
                 stub("break;");
@@ -881,6 +1042,12 @@ namespace rpc_generator
                 stub("::yas::load<::yas::mem|::yas::binary|::yas::no_header>(::yas::intrusive_buffer(__rpc_buf,__"
                      "rpc_buf_size), __yas_mapping);");
                 stub("break;");
+                write_json_load(stub, json_params, "STUB_DESERIALISATION_ERROR");
+                write_lz_load(stub, "STUB_DESERIALISATION_ERROR");
+                stub("case rpc::encoding::flat:");
+                stub("if(!rpc::flat::load(__rpc_buf, __rpc_buf_size, {}))", flat_tie(flat_names));
+                stub("  return rpc::error::STUB_DESERIALISATION_ERROR();");
+                stub("break;");
                 stub("default:");
                 stub("return rpc::error::STUB_DESERIALISATION_ERROR();");
                 stub("}}");
@@ -935,10 +1102,11 @@ namespace rpc_generator
 
             if (has_outparams)
             {
-                stub("auto __yas_mapping = YAS_OBJECT_NVP(");
-                stub("  \"out\"");
-
                 uint64_t count = 1;
+                std::vector<std::string> flat_names;
+                std::vector<std::string> entries;
+                std::vector<std::string> blocks;
+                std::vector<std::pair<std::string, std::string>> json_params;
                 for (auto& parameter : function->get_parameters())
                 {
                     std::string output;
@@ -953,11 +1121,20 @@ namespace rpc_generator
                                 output))
                             continue;
 
-                        stub(output);
+                        use_pod_block(parameter, output, blocks);
+                        entries.push_back(output);
+                        flat_names.push_back(parameter.get_name());
+                        json_params.emplace_back(parameter.get_name(), parameter.get_type());
                     }
                     count++;
                 }
 
+                for (auto& block : blocks)
+                    stub(block);
+                stub("auto __yas_mapping = YAS_OBJECT_NVP(");
+                stub("  \"out\"");
+                for (auto& entry : entries)
+                    stub(entry);
                 stub("  );");
 
                 stub("__buffer.clear(); // this does not change the capacity of the vector so this is a low cost reset "
@@ -965,6 +1142,8 @@ namespace rpc_generator
                 stub("switch(__rpc_enc)");
                 stub("{{");
                 stub("case rpc::encoding::yas_compressed_binary:");
+                stub("case rpc::encoding::yas_compressed_blocks:");
+                stub(yas_reserve("::yas::mem|::yas::binary|::yas::compacted|::yas::no_header", flat_names));
                 stub("::yas::save<::yas::mem|::yas::binary|::yas::compacted|::yas::no_header>(::yas::vector_"
                      "ostream(__buffer), "
                      "__yas_mapping);");
@@ -974,19 +1153,31 @@ namespace rpc_generator
                 //       "__yas_mapping);");
                 // stub("break;");
                 stub("case rpc::encoding::yas_json:");
+                stub("case rpc::encoding::yas_json_blocks:");
+                stub(yas_reserve("::yas::mem|::yas::json|::yas::no_header", flat_names));
                 stub("::yas::save<::yas::mem|::yas::json|::yas::no_header>(::yas::vector_ostream(__buffer), "
                      "__yas_mapping);");
                 stub("break;");
                 stub("case rpc::encoding::enc_default:");
                 stub("case rpc::encoding::yas_binary:");
+                stub(yas_reserve("::yas::mem|::yas::binary|::yas::no_header", flat_names));
                 stub("::yas::save<::yas::mem|::yas::binary|::yas::no_header>(::yas::vector_ostream(__buffer), "
                      "__yas_mapping);");
                 stub("break;");
+                write_json_save(stub, json_params);
+                write_lz_save(stub, flat_names);
+                stub("case rpc::encoding::flat:");
+                stub("if(!rpc::flat::save(__buffer, {}))", flat_tie(flat_names));
+                stub("  return rpc::error::INCOMPATIBLE_SERIALISATION();");
+                stub("break;");
+                stub("default:");
+                stub("return rpc::error::INCOMPATIBLE_SERIALISATION();");
                 stub("}}");
             }
             else
             {
-                stub("if(__rpc_enc == rpc::encoding::yas_json)");
+                stub("if(__rpc_enc == rpc::encoding::yas_json || __rpc_enc == rpc::encoding::yas_json_blocks");
+                stub("   || __rpc_enc == rpc::encoding::json)");
                 stub("  __buffer = {{'{{','}}'}};");
             }
             stub("return rpc::error::OK();");
@@ -1213,6 +1404,10 @@ namespace rpc_generator
             header("#include <rpc/error_codes.h>");
             header("#include <rpc/marshaller.h>");
             header("#include <rpc/serialiser.h>");
+            header("#include <rpc/flat.h>");
+            header("#include <rpc/json.h>");
+            header("#include <rpc/lz.h>");
+            header("#include <rpc/buffer_pool.h>");
             header("#include <rpc/service.h>");
             header("#include \"{}\"", header_filename);
             header("");
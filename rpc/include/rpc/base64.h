@@ -0,0 +1,129 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// base64 for blocks of bytes carried in json.  The loops take whole groups at a time with no branches inside them so
+// the compiler can vectorise them, there are no intrinsics so the same code builds in an enclave
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rpc
+{
+    namespace base64
+    {
+        namespace detail
+        {
+            inline constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            // 0x80 marks a character that is not in the alphabet
+            struct decode_table
+            {
+                uint8_t values[256] = {};
+                constexpr decode_table()
+                {
+                    for (auto& v : values)
+                        v = 0x80;
+                    for (int i = 0; i < 64; i++)
+                        values[(uint8_t)alphabet[i]] = (uint8_t)i;
+                }
+            };
+            inline constexpr decode_table decoder{};
+        }
+
+        inline constexpr size_t encoded_size(size_t size)
+        {
+            return (size + 2) / 3 * 4;
+        }
+
+        inline void encode(const void* data, size_t size, std::string& out)
+        {
+            auto* in = (const uint8_t*)data;
+            out.resize(encoded_size(size));
+            auto* dest = out.data();
+            size_t whole = size / 3;
+            for (size_t i = 0; i < whole; i++)
+            {
+                uint32_t v = (uint32_t(in[i * 3]) << 16) | (uint32_t(in[i * 3 + 1]) << 8) | in[i * 3 + 2];
+                dest[i * 4] = detail::alphabet[(v >> 18) & 63];
+                dest[i * 4 + 1] = detail::alphabet[(v >> 12) & 63];
+                dest[i * 4 + 2] = detail::alphabet[(v >> 6) & 63];
+                dest[i * 4 + 3] = detail::alphabet[v & 63];
+            }
+            auto rest = size - whole * 3;
+            if (rest)
+            {
+                in += whole * 3;
+                dest += whole * 4;
+                uint32_t v = (uint32_t(in[0]) << 16) | (rest == 2 ? uint32_t(in[1]) << 8 : 0);
+                dest[0] = detail::alphabet[(v >> 18) & 63];
+                dest[1] = detail::alphabet[(v >> 12) & 63];
+                dest[2] = rest == 2 ? detail::alphabet[(v >> 6) & 63] : '=';
+                dest[3] = '=';
+            }
+        }
+
+        // the number of bytes text decodes to, false if it cannot be base64
+        inline bool decoded_size(const char* text, size_t length, size_t& size)
+        {
+            if (length % 4)
+                return false;
+            size_t padding = 0;
+            if (length && text[length - 1] == '=')
+                padding = text[length - 2] == '=' ? 2 : 1;
+            size = length / 4 * 3 - padding;
+            return true;
+        }
+
+        // writes decoded_size bytes to out, false if text is not canonical base64
+        inline bool decode(const char* text, size_t length, void* out)
+        {
+            size_t size = 0;
+            if (!decoded_size(text, length, size))
+                return false;
+            if (!length)
+                return true;
+            auto* in = (const uint8_t*)text;
+            auto* dest = (uint8_t*)out;
+            // every group but the last, which may be padded
+            size_t whole = length / 4 - 1;
+            uint8_t invalid = 0;
+            for (size_t i = 0; i < whole; i++)
+            {
+                uint8_t a = detail::decoder.values[in[i * 4]];
+                uint8_t b = detail::decoder.values[in[i * 4 + 1]];
+                uint8_t c = detail::decoder.values[in[i * 4 + 2]];
+                uint8_t d = detail::decoder.values[in[i * 4 + 3]];
+                invalid |= a | b | c | d;
+                uint32_t v = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | d;
+                dest[i * 3] = (uint8_t)(v >> 16);
+                dest[i * 3 + 1] = (uint8_t)(v >> 8);
+                dest[i * 3 + 2] = (uint8_t)v;
+            }
+            if (invalid & 0x80)
+                return false;
+
+            in += whole * 4;
+            dest += whole * 3;
+            auto rest = size - whole * 3;
+            uint8_t a = detail::decoder.values[in[0]];
+            uint8_t b = detail::decoder.values[in[1]];
+            uint8_t c = rest > 1 ? detail::decoder.values[in[2]] : 0;
+            uint8_t d = rest > 2 ? detail::decoder.values[in[3]] : 0;
+            if ((a | b | c | d) & 0x80)
+                return false;
+            uint32_t v = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | d;
+            // bits under the padding must be clear or two texts would decode to the same bytes
+            if (rest < 3 && (v & (rest == 1 ? 0xffff : 0xff)))
+                return false;
+            dest[0] = (uint8_t)(v >> 16);
+            if (rest > 1)
+                dest[1] = (uint8_t)(v >> 8);
+            if (rest > 2)
+                dest[2] = (uint8_t)v;
+            return true;
+        }
+    }
+}
@@ -27,6 +27,9 @@ namespace rpc
             : service_proxy(name, parent_svc->get_zone_id().as_destination(), child_svc)
             , parent_service_(parent_svc)
         {
+            // both zones share this address space so calls do not need to be serialised
+            set_shares_address_space();
+            set_encoding(encoding::direct);
         }
         local_service_proxy(const local_service_proxy& other) = default;
 
@@ -80,6 +83,41 @@ namespace rpc
         {
             return parent_service_.lock()->try_cast(protocol_version, destination_zone_id, object_id, interface_id);
         }
+#ifdef BUILD_COROUTINE
+        task<int> async_send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override
+        {
+            co_return co_await parent_service_.lock()->async_send(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+        }
+        task<int> async_try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override
+        {
+            co_return co_await parent_service_.lock()->async_try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+        }
+#endif
         uint64_t add_ref(uint64_t protocol_version,
             destination_channel_zone destination_channel_zone_id,
             destination_zone destination_zone_id,
@@ -109,6 +147,15 @@ namespace rpc
             auto ret = parent_service_.lock()->release(protocol_version, destination_zone_id, object_id, caller_zone_id);
             return ret;
         }
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override
+        {
+            auto ret = parent_service_.lock()->release_batch(
+                protocol_version, destination_zone_id, caller_zone_id, releases);
+            return ret;
+        }
 
         friend rpc::child_service;
 
@@ -133,6 +180,8 @@ namespace rpc
             : service_proxy(name, destination_zone_id, parent_svc)
             , fn_(fn)
         {
+            set_shares_address_space();
+            set_encoding(encoding::direct);
         }
         local_child_service_proxy(const local_child_service_proxy& other) = default;
 
@@ -194,6 +243,41 @@ namespace rpc
         {
             return child_service_->try_cast(protocol_version, destination_zone_id, object_id, interface_id);
         }
+#ifdef BUILD_COROUTINE
+        task<int> async_send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override
+        {
+            co_return co_await child_service_->async_send(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+        }
+        task<int> async_try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override
+        {
+            co_return co_await child_service_->async_try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+        }
+#endif
         uint64_t add_ref(uint64_t protocol_version,
             destination_channel_zone destination_channel_zone_id,
             destination_zone destination_zone_id,
@@ -217,6 +301,13 @@ namespace rpc
             auto ret = child_service_->release(protocol_version, destination_zone_id, object_id, caller_zone_id);
             return ret;
         }
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override
+        {
+            return child_service_->release_batch(protocol_version, destination_zone_id, caller_zone_id, releases);
+        }
 
     public:
         virtual ~local_child_service_proxy() = default;
@@ -0,0 +1,81 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rpc
+{
+    // size classes are powers of two starting at min_class_size, buffers are binned by capacity so that a buffer taken
+    // from a class is always large enough for any request routed to that class
+    struct buffer_pool_config
+    {
+        static constexpr size_t max_class_count = 16;
+
+        size_t min_class_size = 0x100;
+        size_t class_count = 12; // 256 bytes to 512kb, larger buffers are freed on release
+        size_t max_buffers_per_class = 8;
+        size_t high_water_bytes = 0x400000; // anything pooled beyond this is freed on release
+    };
+
+    // a per thread cache of marshalling buffers, generated proxies and stubs draw from it and return to it so that
+    // steady state calls do not touch the heap.  It is thread local rather than per service_proxy so that no locking
+    // is needed and buffers are shared between all the proxies used by a thread
+    class buffer_pool
+    {
+        buffer_pool_config config_;
+        std::array<std::vector<std::vector<char>>, buffer_pool_config::max_class_count> classes_;
+        size_t pooled_bytes_ = 0;
+
+        size_t class_index_for_capacity(size_t capacity) const;
+        size_t class_index_for_request(size_t size) const;
+
+    public:
+        buffer_pool();
+        buffer_pool(const buffer_pool&) = delete;
+        buffer_pool& operator=(const buffer_pool&) = delete;
+
+        // the pool of the calling thread
+        static buffer_pool& get();
+
+        // sets the configuration used by pools created after this call, existing pools keep their own
+        static void set_default_config(const buffer_pool_config& config);
+        static buffer_pool_config get_default_config();
+
+        // reconfigures this pool, buffers that no longer fit are freed
+        void configure(const buffer_pool_config& config);
+        const buffer_pool_config& get_config() const { return config_; }
+
+        // returns a buffer whose size is exactly size, bytes that were already within range are not zeroed
+        std::vector<char> acquire(size_t size);
+        void release(std::vector<char>&& buf);
+
+        // frees every pooled buffer
+        void trim();
+        size_t get_pooled_bytes() const { return pooled_bytes_; }
+        size_t get_pooled_count() const;
+    };
+
+    // raii holder that returns its buffer to the pool of the thread that destroys it
+    class pooled_buffer
+    {
+        std::vector<char> buf_;
+
+    public:
+        explicit pooled_buffer(size_t size = 0)
+            : buf_(buffer_pool::get().acquire(size))
+        {
+        }
+        pooled_buffer(const pooled_buffer&) = delete;
+        pooled_buffer& operator=(const pooled_buffer&) = delete;
+        ~pooled_buffer() { buffer_pool::get().release(std::move(buf_)); }
+
+        std::vector<char>& get() { return buf_; }
+        const std::vector<char>& get() const { return buf_; }
+    };
+}
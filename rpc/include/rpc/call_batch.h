@@ -0,0 +1,135 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <rpc/error_codes.h>
+#include <rpc/proxy.h>
+#include <rpc/serialiser.h>
+#include <rpc/types.h>
+
+namespace rpc
+{
+    // one call in a batch, in is serialised with the encoding of the batch
+    struct batched_call
+    {
+        uint64_t tag = 0;
+        object object_id;
+        interface_ordinal interface_id;
+        method method_id;
+        std::vector<char> in;
+
+        template<typename Ar> void serialize(Ar& ar)
+        {
+            ar& YAS_OBJECT_NVP("batched_call",
+                ("tag", tag),
+                ("object_id", object_id.id),
+                ("interface_id", interface_id.id),
+                ("method_id", method_id.id),
+                ("in", in));
+        }
+    };
+
+    struct batched_reply
+    {
+        int result = 0;
+        std::vector<char> out;
+
+        template<typename Ar> void serialize(Ar& ar) { ar& YAS_OBJECT_NVP("batched_reply", ("result", result), ("out", out)); }
+    };
+
+    // a batch is sent to ids that are never handed out, object ids start at one and interface ids are fingerprints
+    inline bool is_batch_call(object object_id, interface_ordinal interface_id, method method_id)
+    {
+        return !object_id.is_set() && !interface_id.is_set() && !method_id.is_set();
+    }
+
+    // a batch is serialised as a whole with yas so only the yas encodings can carry one
+    inline bool is_batch_encoding(encoding enc)
+    {
+        return enc == encoding::enc_default || enc == encoding::yas_binary || enc == encoding::yas_compressed_binary
+               || enc == encoding::yas_json;
+    }
+
+    // collects calls to objects in one destination zone and sends them as a single message, which the destination
+    // runs in order and answers with the result and reply of each call.  Calls are queued with on(iface) through the
+    // generated buffered_proxy_serialiser of the interface.  Methods with out or interface parameters are not offered
+    // there, they can still be queued with add using the generated proxy_serialiser and their replies read back with
+    // the proxy_deserialiser
+    class call_batch
+    {
+        rpc::shared_ptr<service_proxy> service_proxy_;
+        encoding enc_ = encoding::yas_binary;
+        std::vector<batched_call> calls_;
+        // the result slot of each queued call
+        std::vector<size_t> slots_;
+        std::vector<int> results_;
+        std::vector<std::vector<char>> replies_;
+
+    public:
+        template<class T> class target : public T::template buffered_proxy_serialiser<target<T>, size_t>
+        {
+            call_batch& batch_;
+            rpc::shared_ptr<object_proxy> object_proxy_;
+
+        public:
+            target(call_batch& batch, rpc::shared_ptr<object_proxy> object_proxy)
+                : batch_(batch)
+                , object_proxy_(std::move(object_proxy))
+            {
+            }
+            encoding get_encoding() const { return batch_.get_encoding(); }
+            size_t register_call(
+                int err, const char* name, method method_id, uint64_t tag, const std::vector<char>& buffer)
+            {
+                std::ignore = name;
+                return batch_.add(err, object_proxy_, T::get_id, method_id, tag, buffer);
+            }
+        };
+
+        // the batch is serialised as a whole with yas, even for transports that could take argument packs.  With
+        // an encoding that is not one of is_batch_encoding every call is refused with INCOMPATIBLE_SERIALISATION
+        explicit call_batch(encoding enc = encoding::yas_binary)
+            : enc_(enc)
+        {
+        }
+        call_batch(const call_batch&) = delete;
+        call_batch& operator=(const call_batch&) = delete;
+
+        // queues calls on iface, which must be a proxy to an object in the same zone as every other call in the batch
+        template<class T> target<T> on(const rpc::shared_ptr<T>& iface)
+        {
+            rpc::shared_ptr<object_proxy> op;
+            if (iface)
+            {
+                if (auto* base = iface->query_proxy_base())
+                    op = base->get_object_proxy();
+            }
+            return target<T>(*this, op);
+        }
+
+        // queues a call whose in parameters are already serialised with get_encoding() and returns the index of its
+        // result, a call that cannot join the batch is not sent and gets err or INVALID_DATA as its result instead
+        size_t add(int err,
+            const rpc::shared_ptr<object_proxy>& op,
+            const std::function<interface_ordinal(uint64_t)>& id_getter,
+            method method_id,
+            uint64_t tag,
+            const std::vector<char>& in);
+
+        // sends the queued calls in one message, the result is that of the crossing and each call has its own result
+        int flush();
+
+        encoding get_encoding() const { return enc_; }
+        size_t size() const { return results_.size(); }
+        // valid once the call has been flushed
+        int get_result(size_t index) const { return results_[index]; }
+        const std::vector<char>& get_reply(size_t index) const { return replies_[index]; }
+    };
+}
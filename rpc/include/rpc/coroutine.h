@@ -0,0 +1,169 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// coroutine support is only available when the library is built with BUILD_COROUTINE which requires C++20
+#ifdef BUILD_COROUTINE
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace rpc
+{
+    // a lazily started awaitable that resumes its awaiter when it completes, awaiting a task that has already finished
+    // does not suspend.  The task owns its coroutine frame and must be awaited or passed to sync_wait to run at all
+    template<class T> class [[nodiscard]] task
+    {
+        static_assert(!std::is_void_v<T>, "rpc calls always produce an error code");
+
+    public:
+        struct promise_type
+        {
+            std::optional<T> value;
+            std::exception_ptr exception;
+            std::coroutine_handle<> continuation;
+
+            task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+                // resume the awaiter directly from the final suspend point
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    if (h.promise().continuation)
+                        return h.promise().continuation;
+                    return std::noop_coroutine();
+                }
+                void await_resume() noexcept { }
+            };
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            template<class U> void return_value(U&& val) { value.emplace(std::forward<U>(val)); }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+
+        explicit task(std::coroutine_handle<promise_type> handle)
+            : handle_(handle)
+        {
+        }
+
+    public:
+        task(task&& other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr))
+        {
+        }
+        task& operator=(task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                    handle_.destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        ~task()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        bool is_ready() const { return !handle_ || handle_.done(); }
+
+        auto operator co_await() && noexcept
+        {
+            struct awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() noexcept { return !handle || handle.done(); }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+                T await_resume()
+                {
+                    auto& promise = handle.promise();
+                    if (promise.exception)
+                        std::rethrow_exception(promise.exception);
+                    return std::move(*promise.value);
+                }
+            };
+            return awaiter{handle_};
+        }
+    };
+
+    namespace detail
+    {
+        // fire and forget coroutine used to drive a task from non coroutine code
+        struct detached_task
+        {
+            struct promise_type
+            {
+                detached_task get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() { }
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        template<class T> struct sync_wait_state
+        {
+            std::mutex control;
+            std::condition_variable completed;
+            bool done = false;
+            std::optional<T> value;
+            std::exception_ptr exception;
+        };
+
+        template<class T> detached_task run_and_signal(task<T>& t, sync_wait_state<T>& state)
+        {
+            std::optional<T> value;
+            std::exception_ptr exception;
+            try
+            {
+                value.emplace(co_await std::move(t));
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+            std::lock_guard g(state.control);
+            state.value = std::move(value);
+            state.exception = exception;
+            state.done = true;
+            state.completed.notify_one();
+        }
+    }
+
+    // blocks the calling thread until the task completes, this is the bridge from blocking code into coroutines and
+    // must not be called from a thread that is needed to resume the task
+    template<class T> T sync_wait(task<T> t)
+    {
+        detail::sync_wait_state<T> state;
+        detail::run_and_signal(t, state);
+        std::unique_lock g(state.control);
+        state.completed.wait(g, [&]() { return state.done; });
+        if (state.exception)
+            std::rethrow_exception(state.exception);
+        return std::move(*state.value);
+    }
+}
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#ifndef _IN_ENCLAVE
+#include <thread>
+#endif
+#include <type_traits>
+#include <vector>
+
+namespace rpc
+{
+    // work queued on an executor, it is intrusive so that a caller blocked on the result can keep it on its stack and
+    // posting never allocates
+    struct executor_task
+    {
+        std::atomic<executor_task*> next = nullptr;
+        void (*run)(executor_task* task) = nullptr;
+    };
+
+    // an intrusive lock free queue that any number of threads may push to and one thread at a time may pop from
+    class mpsc_mailbox
+    {
+        alignas(64) std::atomic<executor_task*> head_;
+        alignas(64) executor_task* tail_;
+        executor_task stub_;
+
+    public:
+        mpsc_mailbox();
+        mpsc_mailbox(const mpsc_mailbox&) = delete;
+        mpsc_mailbox& operator=(const mpsc_mailbox&) = delete;
+
+        void push(executor_task* task);
+        // may return null while a push is still being linked in, callers that track a count retry
+        executor_task* pop();
+    };
+
+    class executor
+    {
+    public:
+        virtual ~executor() = default;
+        virtual void post(executor_task* task) = 0;
+        // true when called from one of the threads of this executor
+        virtual bool is_current() const = 0;
+    };
+
+    // marks the calling thread as a worker of a pool, such as a transport's, while it is in scope.  The threads of a
+    // threaded_executor count as workers too.  A zone with a dispatcher runs calls made on a worker inline, the call
+    // already has a thread of its own and queued behind the dispatcher it could wait on calls that are waiting on it
+    class worker_scope
+    {
+    public:
+        worker_scope();
+        ~worker_scope();
+        worker_scope(const worker_scope&) = delete;
+        worker_scope& operator=(const worker_scope&) = delete;
+
+        static bool is_worker();
+    };
+
+#ifndef _IN_ENCLAVE
+    // an executor that owns threads, one of its threads that blocks on other work keeps running its own tasks meanwhile
+    // so that calls which come back into its zone do not deadlock
+    class threaded_executor : public executor
+    {
+    protected:
+        // marks the calling thread as belonging to this executor for the life of the thread
+        void enter();
+        void leave();
+
+    public:
+        bool is_current() const override;
+
+        // the executor owning the calling thread if any
+        static threaded_executor* current();
+
+        // called on one of this executors threads, keeps running its queued work until done is set and wake is called
+        virtual void wait_for(const std::atomic<bool>& done) = 0;
+        virtual void wake_all() = 0;
+    };
+
+    struct thread_pool_config
+    {
+        // one thread makes the zone an actor, its state needs no locks
+        size_t thread_count = 1;
+        // thread i is pinned to cpus[i % cpus.size()] when set, linux only
+        std::vector<int> cpus;
+    };
+
+    // a set of threads draining a single mailbox
+    class thread_pool_executor : public threaded_executor
+    {
+        mpsc_mailbox mailbox_;
+        // only one thread may pop at a time, it is uncontended when there is one thread
+        std::mutex pop_control_;
+        std::atomic<size_t> pending_ = 0;
+
+        std::mutex sleep_control_;
+        std::condition_variable wake_;
+        std::atomic<uint32_t> sleepers_ = 0;
+        std::atomic<bool> stopping_ = false;
+        std::vector<std::thread> threads_;
+
+        bool run_one();
+        void run(size_t index, const thread_pool_config& config);
+
+    public:
+        explicit thread_pool_executor(const thread_pool_config& config = {});
+        thread_pool_executor(const thread_pool_executor&) = delete;
+        thread_pool_executor& operator=(const thread_pool_executor&) = delete;
+        // runs whatever is still queued and then joins the threads, it must not be destroyed from one of them
+        ~thread_pool_executor() override;
+
+        void post(executor_task* task) override;
+        // the threads leave once the queue is empty, it does not wait for them so it may be called from one of them
+        void stop();
+        size_t get_thread_count() const { return threads_.size(); }
+        size_t get_pending() const { return pending_.load(std::memory_order_relaxed); }
+
+        void wait_for(const std::atomic<bool>& done) override;
+        void wake_all() override;
+    };
+
+    struct work_stealing_stats
+    {
+        uint64_t posted = 0;
+        uint64_t executed = 0;
+        // tasks a thread took from another threads deque
+        uint64_t steals = 0;
+        // tasks waiting in each threads deque
+        std::vector<size_t> queue_depths;
+    };
+
+    // one deque per thread, typically one thread per core.  Work posted from one of the threads stays on its own deque,
+    // work from outside is spread round robin.  A thread runs the newest task on its own deque so nested work stays
+    // cache hot, and when that is empty it steals the oldest task from another thread, so a burst from one caller is
+    // spread over every idle core
+    class work_stealing_executor : public threaded_executor
+    {
+        struct alignas(64) worker
+        {
+            std::mutex control;
+            std::deque<executor_task*> tasks;
+            std::atomic<uint64_t> executed = 0;
+            std::atomic<uint64_t> steals = 0;
+        };
+        std::vector<std::unique_ptr<worker>> workers_;
+        std::atomic<size_t> next_worker_ = 0;
+        std::atomic<uint64_t> posted_ = 0;
+        std::atomic<size_t> pending_ = 0;
+
+        std::mutex sleep_control_;
+        std::condition_variable wake_;
+        std::atomic<uint32_t> sleepers_ = 0;
+        std::atomic<bool> stopping_ = false;
+        std::vector<std::thread> threads_;
+
+        bool run_one(size_t index);
+        void run(size_t index, const thread_pool_config& config);
+
+    public:
+        explicit work_stealing_executor(const thread_pool_config& config = {});
+        work_stealing_executor(const work_stealing_executor&) = delete;
+        work_stealing_executor& operator=(const work_stealing_executor&) = delete;
+        // runs whatever is still queued and then joins the threads, it must not be destroyed from one of them
+        ~work_stealing_executor() override;
+
+        void post(executor_task* task) override;
+        size_t get_thread_count() const { return threads_.size(); }
+        // tasks posted but not yet started across all deques
+        size_t get_pending() const { return pending_.load(std::memory_order_relaxed); }
+        work_stealing_stats get_stats() const;
+
+        void wait_for(const std::atomic<bool>& done) override;
+        void wake_all() override;
+    };
+#endif
+
+    // runs the tasks posted to it one at a time in the order they arrive without owning a thread.  Queued tasks are
+    // drained on ex, or when there is no ex by whichever poster finds the strand idle, so an uncontended post runs
+    // straight away on the posting thread.  A task that blocks on work which comes back to the same strand from
+    // another thread deadlocks, as with any strand, reentry on the same thread runs inline
+    class strand : public executor
+    {
+        mpsc_mailbox mailbox_;
+        std::atomic<size_t> pending_ = 0;
+        std::shared_ptr<executor> executor_;
+        struct drain_task : executor_task
+        {
+            strand* owner = nullptr;
+        } drain_task_;
+
+        void drain();
+
+    public:
+        // tasks drained on an executor in one go before the strand yields it to other work
+        static constexpr size_t max_batch = 64;
+
+        explicit strand(std::shared_ptr<executor> ex = nullptr);
+        strand(const strand&) = delete;
+        strand& operator=(const strand&) = delete;
+
+        void post(executor_task* task) override;
+        bool is_current() const override;
+        size_t get_pending() const { return pending_.load(std::memory_order_relaxed); }
+    };
+
+    // signalled once by whichever thread finishes a task, a waiter that is itself an executor thread keeps serving its
+    // own executor meanwhile so that calls which come back into its zone do not deadlock
+    class completion
+    {
+        std::atomic<bool> done_ = false;
+#ifndef _IN_ENCLAVE
+        threaded_executor* waiter_executor_ = threaded_executor::current();
+#endif
+        std::mutex control_;
+        std::condition_variable cv_;
+
+    public:
+        void set();
+        void wait();
+    };
+
+    // runs fn on ex and returns its result, inline if the caller is already on one of the threads of ex
+    template<class FN> auto run_on(executor& ex, FN&& fn) -> decltype(fn())
+    {
+        using result_type = decltype(fn());
+        static_assert(!std::is_void<result_type>::value, "run_on returns the result of fn");
+        if (ex.is_current())
+            return fn();
+
+        struct task : executor_task
+        {
+            std::remove_reference_t<FN>* fn;
+            result_type result{};
+            rpc::completion completion;
+        } t;
+        t.fn = &fn;
+        t.run = [](executor_task* base)
+        {
+            auto* self = static_cast<task*>(base);
+            self->result = (*self->fn)();
+            self->completion.set();
+        };
+        ex.post(&t);
+        t.completion.wait();
+        return t.result;
+    }
+}
@@ -0,0 +1,645 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// the flat encoding lays values out in a buffer much as they sit in memory so that the receiver reads them in place
+// through views instead of parsing them.  Fixed size values sit inline in their parent, strings, vectors and maps are
+// an {offset, count} reference to a block further along the buffer.  Offsets are from the start of the buffer so it
+// can be copied or moved as a whole.  Generated structs are laid out member by member, any other type that is not plain
+// data is embedded as a yas binary blob.  Like the direct encoding the layout is native endian.
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <rpc/serialiser.h>
+
+namespace rpc
+{
+    namespace flat
+    {
+        // where an out of line block starts and how many elements it holds
+        struct ref
+        {
+            uint32_t offset = 0;
+            uint32_t count = 0;
+        };
+
+        constexpr size_t round_up(size_t size, size_t align)
+        {
+            return (size + align - 1) / align * align;
+        }
+
+        inline ref get_ref(const char* base, size_t at)
+        {
+            ref r;
+            memcpy(&r, base + at, sizeof(r));
+            return r;
+        }
+
+        class writer
+        {
+            std::vector<char>& buf_;
+            bool overflow_ = false;
+
+        public:
+            explicit writer(std::vector<char>& buf)
+                : buf_(buf)
+            {
+            }
+
+            // zero fills size bytes at the end of the buffer aligned to align and returns their offset
+            size_t append(size_t size, size_t align)
+            {
+                auto offset = round_up(buf_.size(), align);
+                buf_.resize(offset + size);
+                return offset;
+            }
+            char* at(size_t offset) { return buf_.data() + offset; }
+            void set_ref(size_t at, size_t offset, size_t count)
+            {
+                if (offset > std::numeric_limits<uint32_t>::max() || count > std::numeric_limits<uint32_t>::max())
+                {
+                    overflow_ = true;
+                    return;
+                }
+                ref r{static_cast<uint32_t>(offset), static_cast<uint32_t>(count)};
+                memcpy(buf_.data() + at, &r, sizeof(r));
+            }
+            // false if the buffer grew past what a reference can address
+            bool ok() const { return !overflow_; }
+        };
+
+        // checks a buffer before any view is taken of it
+        class reader
+        {
+            const char* data_;
+            size_t size_;
+            // every block a reference points to is charged to this, a writer never refers to the same block twice so
+            // however the references in a hostile buffer are arranged they cannot describe more than the buffer holds
+            size_t budget_;
+            size_t depth_ = 0;
+
+        public:
+            static constexpr size_t max_depth = 64;
+
+            reader(const char* data, size_t size)
+                : data_(data)
+                , size_(size)
+                , budget_(size)
+            {
+            }
+
+            const char* data() const { return data_; }
+            size_t size() const { return size_; }
+            ref get(size_t at) const { return get_ref(data_, at); }
+
+            // true if count elements of stride bytes at r.offset lie in the buffer
+            bool claim(const ref& r, size_t stride)
+            {
+                auto bytes = static_cast<uint64_t>(r.count) * stride;
+                if (r.offset > size_ || bytes > size_ - r.offset || bytes > budget_)
+                    return false;
+                budget_ -= bytes;
+                return true;
+            }
+            bool enter() { return ++depth_ <= max_depth; }
+            void leave() { --depth_; }
+        };
+
+        template<class T> struct is_vector : std::false_type
+        {
+        };
+        template<class T, class A> struct is_vector<std::vector<T, A>> : std::true_type
+        {
+        };
+        template<class T> struct is_map : std::false_type
+        {
+        };
+        template<class K, class V, class A> struct is_map<std::map<K, V, std::less<K>, A>> : std::true_type
+        {
+        };
+        // generated structs list their members with flat_members() and have a nested flat_view
+        template<class T, class = void> struct has_members : std::false_type
+        {
+        };
+        template<class T>
+        struct has_members<T, std::void_t<decltype(std::declval<const T&>().flat_members())>> : std::true_type
+        {
+        };
+
+        enum class kind
+        {
+            scalar,
+            string,
+            vector,
+            map,
+            record,
+            opaque
+        };
+
+        template<class T> constexpr kind kind_of()
+        {
+            if constexpr (std::is_same<T, std::string>::value)
+                return kind::string;
+            else if constexpr (is_vector<T>::value)
+                return kind::vector;
+            else if constexpr (is_map<T>::value)
+                return kind::map;
+            else if constexpr (has_members<T>::value)
+                return kind::record;
+            // classes with padding would carry whatever was in it across
+            else if constexpr (std::is_arithmetic<T>::value || std::is_enum<T>::value
+                               || (std::is_class<T>::value && std::is_trivially_copyable<T>::value
+                                   && std::has_unique_object_representations<T>::value))
+                return kind::scalar;
+            else
+                return kind::opaque;
+        }
+
+        template<class T, kind K = kind_of<T>()> struct traits;
+        template<class T> using view_t = typename traits<T>::view;
+
+        // plain data whose elements can be copied in and out of a block in one go
+        template<class T> constexpr bool is_plain()
+        {
+            return kind_of<T>() == kind::scalar && !std::is_same<T, bool>::value;
+        }
+
+        template<class View> class index_iterator
+        {
+            const View* view_;
+            size_t index_;
+
+        public:
+            index_iterator(const View* view, size_t index)
+                : view_(view)
+                , index_(index)
+            {
+            }
+            auto operator*() const { return (*view_)[index_]; }
+            index_iterator& operator++()
+            {
+                ++index_;
+                return *this;
+            }
+            bool operator==(const index_iterator& other) const { return index_ == other.index_; }
+            bool operator!=(const index_iterator& other) const { return index_ != other.index_; }
+        };
+
+        // the views point into the buffer, which must outlive them
+        template<class T> class vector_view
+        {
+            const char* base_ = nullptr;
+            size_t at_ = 0;
+            size_t count_ = 0;
+
+        public:
+            vector_view() = default;
+            vector_view(const char* base, size_t at, size_t count)
+                : base_(base)
+                , at_(at)
+                , count_(count)
+            {
+            }
+
+            size_t size() const { return count_; }
+            bool empty() const { return count_ == 0; }
+            // deduced so that a struct may hold a vector of itself
+            auto operator[](size_t index) const { return traits<T>::read(base_, at_ + index * traits<T>::size); }
+            index_iterator<vector_view> begin() const { return {this, 0}; }
+            index_iterator<vector_view> end() const { return {this, count_}; }
+
+            // plain data is stored as an array of T so it comes out with one copy
+            void copy_to(T* out) const
+            {
+                static_assert(is_plain<T>(), "only vectors of plain data can be copied in one go");
+                if (count_)
+                    memcpy(out, base_ + at_, count_ * sizeof(T));
+            }
+        };
+
+        template<class... Ts> struct layout;
+
+        // an ordered map is written in key order so it can be searched in place
+        template<class K, class V> class map_view
+        {
+            const char* base_ = nullptr;
+            size_t at_ = 0;
+            size_t count_ = 0;
+
+            size_t entry(size_t index) const { return at_ + index * layout<K, V>::size; }
+
+        public:
+            map_view() = default;
+            map_view(const char* base, size_t at, size_t count)
+                : base_(base)
+                , at_(at)
+                , count_(count)
+            {
+            }
+
+            size_t size() const { return count_; }
+            bool empty() const { return count_ == 0; }
+            auto key(size_t index) const
+            {
+                return traits<K>::read(base_, entry(index) + layout<K, V>::offsets[0]);
+            }
+            auto value(size_t index) const
+            {
+                return traits<V>::read(base_, entry(index) + layout<K, V>::offsets[1]);
+            }
+            auto operator[](size_t index) const { return std::make_pair(key(index), value(index)); }
+            index_iterator<map_view> begin() const { return {this, 0}; }
+            index_iterator<map_view> end() const { return {this, count_}; }
+
+            // the index of key or size() if it is not there
+            template<class Key> size_t find(const Key& k) const
+            {
+                size_t first = 0;
+                size_t last = count_;
+                while (first < last)
+                {
+                    auto middle = first + (last - first) / 2;
+                    if (key(middle) < k)
+                        first = middle + 1;
+                    else
+                        last = middle;
+                }
+                return first < count_ && !(k < key(first)) ? first : count_;
+            }
+        };
+
+        // a type with no flat layout, read back through yas
+        template<class T> class opaque_view
+        {
+            std::string_view bytes_;
+
+        public:
+            opaque_view() = default;
+            explicit opaque_view(std::string_view bytes)
+                : bytes_(bytes)
+            {
+            }
+
+            bool load(T& value) const
+            {
+                return from_yas_binary(span(bytes_.data(), bytes_.data() + bytes_.size()), value).empty();
+            }
+        };
+
+        // members laid out one after another each at its own alignment, never empty so that arrays of it advance
+        template<class... Ts> struct layout
+        {
+            static constexpr size_t count = sizeof...(Ts);
+            static constexpr size_t align = std::max({size_t(1), traits<Ts>::align...});
+
+            static constexpr std::array<size_t, sizeof...(Ts) + 1> compute_offsets()
+            {
+                constexpr size_t sizes[] = {traits<Ts>::size..., 0};
+                constexpr size_t aligns[] = {traits<Ts>::align..., 1};
+                std::array<size_t, sizeof...(Ts) + 1> offsets{};
+                size_t at = 0;
+                for (size_t i = 0; i < sizeof...(Ts); i++)
+                {
+                    at = round_up(at, aligns[i]);
+                    offsets[i] = at;
+                    at += sizes[i];
+                }
+                offsets[sizeof...(Ts)] = at;
+                return offsets;
+            }
+            static constexpr std::array<size_t, sizeof...(Ts) + 1> offsets = compute_offsets();
+            static constexpr size_t size = round_up(std::max(offsets[sizeof...(Ts)], size_t(1)), align);
+
+            template<class Tuple, size_t... Is>
+            static void write(
+                [[maybe_unused]] writer& w, [[maybe_unused]] size_t at, const Tuple& values, std::index_sequence<Is...>)
+            {
+                (traits<Ts>::write(w, at + offsets[Is], std::get<Is>(values)), ...);
+            }
+            template<class Tuple> static void write(writer& w, size_t at, const Tuple& values)
+            {
+                write(w, at, values, std::index_sequence_for<Ts...>{});
+            }
+
+            template<size_t... Is>
+            static bool verify([[maybe_unused]] reader& r, [[maybe_unused]] size_t at, std::index_sequence<Is...>)
+            {
+                return (traits<Ts>::verify(r, at + offsets[Is]) && ...);
+            }
+            static bool verify(reader& r, size_t at) { return verify(r, at, std::index_sequence_for<Ts...>{}); }
+
+            template<size_t... Is>
+            static std::tuple<view_t<Ts>...> read(
+                [[maybe_unused]] const char* base, [[maybe_unused]] size_t at, std::index_sequence<Is...>)
+            {
+                return std::tuple<view_t<Ts>...>(traits<Ts>::read(base, at + offsets[Is])...);
+            }
+            static std::tuple<view_t<Ts>...> read(const char* base, size_t at)
+            {
+                return read(base, at, std::index_sequence_for<Ts...>{});
+            }
+
+            template<class Dst, class Src, size_t... Is>
+            static bool assign([[maybe_unused]] const Dst& dst, [[maybe_unused]] const Src& src, std::index_sequence<Is...>)
+            {
+                return (traits<Ts>::assign(std::get<Is>(dst), std::get<Is>(src)) && ...);
+            }
+            // dst is a tuple of references to the values and src a tuple of their views
+            template<class Dst, class Src> static bool assign(const Dst& dst, const Src& src)
+            {
+                return assign(dst, src, std::index_sequence_for<Ts...>{});
+            }
+        };
+
+        template<class Tuple> struct tuple_layout;
+        template<class... Ms> struct tuple_layout<std::tuple<Ms...>>
+        {
+            using type = layout<std::decay_t<Ms>...>;
+        };
+
+        template<class T> struct traits<T, kind::scalar>
+        {
+            using view = T;
+            static constexpr size_t size = sizeof(T);
+            static constexpr size_t align = alignof(T);
+
+            static void write(writer& w, size_t at, const T& value) { memcpy(w.at(at), &value, sizeof(T)); }
+            static bool verify(reader& r, size_t at)
+            {
+                // any other byte would be undefined to read back as a bool
+                if constexpr (std::is_same<T, bool>::value)
+                    return static_cast<unsigned char>(r.data()[at]) <= 1;
+                else
+                {
+                    std::ignore = r;
+                    std::ignore = at;
+                    return true;
+                }
+            }
+            static view read(const char* base, size_t at)
+            {
+                T value{};
+                memcpy(&value, base + at, sizeof(T));
+                return value;
+            }
+            static bool assign(T& dst, const view& v)
+            {
+                dst = v;
+                return true;
+            }
+        };
+
+        template<> struct traits<std::string, kind::string>
+        {
+            using view = std::string_view;
+            static constexpr size_t size = sizeof(ref);
+            static constexpr size_t align = alignof(ref);
+
+            static void write(writer& w, size_t at, const std::string& value)
+            {
+                auto offset = w.append(value.size(), 1);
+                if (!value.empty())
+                    memcpy(w.at(offset), value.data(), value.size());
+                w.set_ref(at, offset, value.size());
+            }
+            static bool verify(reader& r, size_t at) { return r.claim(r.get(at), 1); }
+            static view read(const char* base, size_t at)
+            {
+                auto r = get_ref(base, at);
+                return view(base + r.offset, r.count);
+            }
+            static bool assign(std::string& dst, const view& v)
+            {
+                dst.assign(v.data(), v.size());
+                return true;
+            }
+        };
+
+        template<class T, class A> struct traits<std::vector<T, A>, kind::vector>
+        {
+            using view = vector_view<T>;
+            static constexpr size_t size = sizeof(ref);
+            static constexpr size_t align = alignof(ref);
+
+            static void write(writer& w, size_t at, const std::vector<T, A>& value)
+            {
+                auto offset = w.append(value.size() * traits<T>::size, traits<T>::align);
+                if constexpr (is_plain<T>())
+                {
+                    if (!value.empty())
+                        memcpy(w.at(offset), value.data(), value.size() * sizeof(T));
+                }
+                else
+                {
+                    for (size_t i = 0; i < value.size(); i++)
+                        traits<T>::write(w, offset + i * traits<T>::size, value[i]);
+                }
+                w.set_ref(at, offset, value.size());
+            }
+            static bool verify(reader& r, size_t at)
+            {
+                auto block = r.get(at);
+                if (!r.claim(block, traits<T>::size))
+                    return false;
+                if constexpr (is_plain<T>())
+                    return true;
+                else
+                {
+                    if (!r.enter())
+                        return false;
+                    bool ok = true;
+                    for (size_t i = 0; ok && i < block.count; i++)
+                        ok = traits<T>::verify(r, block.offset + i * traits<T>::size);
+                    r.leave();
+                    return ok;
+                }
+            }
+            static view read(const char* base, size_t at)
+            {
+                auto r = get_ref(base, at);
+                return view(base, r.offset, r.count);
+            }
+            static bool assign(std::vector<T, A>& dst, const view& v)
+            {
+                if constexpr (is_plain<T>())
+                {
+                    dst.resize(v.size());
+                    v.copy_to(dst.data());
+                    return true;
+                }
+                else
+                {
+                    dst.clear();
+                    dst.reserve(v.size());
+                    for (size_t i = 0; i < v.size(); i++)
+                    {
+                        T item{};
+                        if (!traits<T>::assign(item, v[i]))
+                            return false;
+                        dst.push_back(std::move(item));
+                    }
+                    return true;
+                }
+            }
+        };
+
+        template<class K, class V, class A> struct traits<std::map<K, V, std::less<K>, A>, kind::map>
+        {
+            using view = map_view<K, V>;
+            static constexpr size_t size = sizeof(ref);
+            static constexpr size_t align = alignof(ref);
+
+            static void write(writer& w, size_t at, const std::map<K, V, std::less<K>, A>& value)
+            {
+                using entry = layout<K, V>;
+                auto offset = w.append(value.size() * entry::size, entry::align);
+                auto next = offset;
+                for (auto& item : value)
+                {
+                    traits<K>::write(w, next + entry::offsets[0], item.first);
+                    traits<V>::write(w, next + entry::offsets[1], item.second);
+                    next += entry::size;
+                }
+                w.set_ref(at, offset, value.size());
+            }
+            static bool verify(reader& r, size_t at)
+            {
+                using entry = layout<K, V>;
+                auto block = r.get(at);
+                if (!r.claim(block, entry::size) || !r.enter())
+                    return false;
+                bool ok = true;
+                for (size_t i = 0; ok && i < block.count; i++)
+                    ok = entry::verify(r, block.offset + i * entry::size);
+                r.leave();
+                return ok;
+            }
+            static view read(const char* base, size_t at)
+            {
+                auto r = get_ref(base, at);
+                return view(base, r.offset, r.count);
+            }
+            static bool assign(std::map<K, V, std::less<K>, A>& dst, const view& v)
+            {
+                dst.clear();
+                for (size_t i = 0; i < v.size(); i++)
+                {
+                    K key{};
+                    V value{};
+                    if (!traits<K>::assign(key, v.key(i)) || !traits<V>::assign(value, v.value(i)))
+                        return false;
+                    dst.emplace_hint(dst.end(), std::move(key), std::move(value));
+                }
+                return true;
+            }
+        };
+
+        template<class T> struct traits<T, kind::record>
+        {
+            using layout_type = typename tuple_layout<decltype(std::declval<const T&>().flat_members())>::type;
+            using view = typename T::flat_view;
+            static constexpr size_t size = layout_type::size;
+            static constexpr size_t align = layout_type::align;
+
+            static void write(writer& w, size_t at, const T& value) { layout_type::write(w, at, value.flat_members()); }
+            static bool verify(reader& r, size_t at) { return layout_type::verify(r, at); }
+            static view read(const char* base, size_t at)
+            {
+                return std::apply([](auto&&... members) { return view{std::move(members)...}; },
+                    layout_type::read(base, at));
+            }
+            static bool assign(T& dst, const view& v) { return layout_type::assign(dst.flat_members(), v.flat_members()); }
+        };
+
+        template<class T> struct traits<T, kind::opaque>
+        {
+            using view = opaque_view<T>;
+            static constexpr size_t size = sizeof(ref);
+            static constexpr size_t align = alignof(ref);
+
+            static void write(writer& w, size_t at, const T& value)
+            {
+                auto bytes = to_yas_binary<T, std::vector<char>>(value);
+                auto offset = w.append(bytes.size(), 1);
+                if (!bytes.empty())
+                    memcpy(w.at(offset), bytes.data(), bytes.size());
+                w.set_ref(at, offset, bytes.size());
+            }
+            static bool verify(reader& r, size_t at) { return r.claim(r.get(at), 1); }
+            static view read(const char* base, size_t at)
+            {
+                auto r = get_ref(base, at);
+                return view(std::string_view(base + r.offset, r.count));
+            }
+            static bool assign(T& dst, const view& v) { return v.load(dst); }
+        };
+
+        template<class Layout> bool verify(const char* data, size_t size)
+        {
+            if (size < Layout::size)
+                return false;
+            reader r(data, size);
+            return Layout::verify(r, 0);
+        }
+
+        // lays out a tuple of references to values as one record at the start of buffer, false if the buffer would
+        // be too big to address
+        template<class... Ts> bool save(std::vector<char>& buffer, const std::tuple<Ts&...>& values)
+        {
+            using layout_type = layout<std::decay_t<Ts>...>;
+            buffer.clear();
+            writer w(buffer);
+            auto at = w.append(layout_type::size, layout_type::align);
+            layout_type::write(w, at, values);
+            return w.ok();
+        }
+
+        // checks a buffer written by save with the same types and then copies it out into values, nothing is read
+        // from a buffer that fails the check
+        template<class... Ts> bool load(const char* data, size_t size, const std::tuple<Ts&...>& values)
+        {
+            using layout_type = layout<std::decay_t<Ts>...>;
+            if (!verify<layout_type>(data, size))
+                return false;
+            return layout_type::assign(values, layout_type::read(data, 0));
+        }
+
+        // checks a buffer written by to_flat and gives a view of its value that reads it in place
+        template<class T> bool get_view(const span& data, view_t<T>& value)
+        {
+            auto* begin = reinterpret_cast<const char*>(data.begin);
+            if (!verify<layout<T>>(begin, data.end - data.begin))
+                return false;
+            value = traits<T>::read(begin, 0);
+            return true;
+        }
+    }
+
+    template<typename T, class OutputBlob = std::vector<char>> OutputBlob to_flat(const T& obj)
+    {
+        std::vector<char> buffer;
+        if (!flat::save(buffer, std::tie(obj)))
+            throw std::runtime_error("value is too large for the flat encoding");
+        return OutputBlob(buffer.begin(), buffer.end());
+    }
+
+    template<typename T> std::string from_flat(const span& data, T& obj)
+    {
+        if (!flat::load(reinterpret_cast<const char*>(data.begin), data.end - data.begin, std::tie(obj)))
+            return "a flat buffer was incompatible with the type that is deserialising to";
+        return "";
+    }
+}
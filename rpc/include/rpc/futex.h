@@ -0,0 +1,77 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// linux only wait and wake primitives shared by the cross process transports
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace rpc
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32 bit integers");
+
+    // a parked thread wakes up this often to recheck state that can change without a wake, such as a dead peer
+    constexpr long futex_timeout_ns = 50 * 1000 * 1000;
+
+    // shared words may live in memory mapped by several processes, private words are only waited on in this one
+    inline void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, bool shared)
+    {
+        timespec timeout{0, futex_timeout_ns};
+        syscall(SYS_futex,
+            reinterpret_cast<uint32_t*>(word),
+            shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+            expected,
+            &timeout,
+            nullptr,
+            0);
+    }
+
+    inline void futex_wake(std::atomic<uint32_t>* word, bool shared)
+    {
+        syscall(SYS_futex,
+            reinterpret_cast<uint32_t*>(word),
+            shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+            INT_MAX,
+            nullptr,
+            nullptr,
+            0);
+    }
+
+    inline void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // spins for up to limit iterations before the caller falls back to a futex, the limit doubles when spinning paid
+    // off and halves when it did not so waits that are usually long quickly stop burning cpu
+    template<class FN> bool adaptive_spin(std::atomic<uint32_t>& limit, FN&& ready)
+    {
+        constexpr uint32_t min_spin = 16;
+        constexpr uint32_t max_spin = 0x4000;
+        auto spins = limit.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < spins; i++)
+        {
+            if (ready())
+            {
+                limit.store(std::min(spins * 2, max_spin), std::memory_order_relaxed);
+                return true;
+            }
+            cpu_relax();
+        }
+        limit.store(std::max(spins / 2, min_spin), std::memory_order_relaxed);
+        return false;
+    }
+}
@@ -0,0 +1,811 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// a json codec that writes and reads the same text as yas json without going through an archive.  Generated structs
+// and parameter blocks have their own to_json and from_json, containers and numbers are handled here and any other
+// type goes through yas json.  Strings are scanned eight bytes at a time for the characters that need attention, and
+// numbers, bools and strings are read straight into their destination so values of a known size never allocate
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <rpc/base64.h>
+#include <rpc/serialiser.h>
+
+namespace rpc
+{
+    namespace json
+    {
+        namespace detail
+        {
+            constexpr uint64_t ones = 0x0101010101010101ull;
+            constexpr uint64_t highs = 0x8080808080808080ull;
+
+            inline uint64_t load8(const char* p)
+            {
+                uint64_t v;
+                memcpy(&v, p, sizeof(v));
+                return v;
+            }
+            // non zero if a byte of v may be c, false positives are possible after a real match
+            inline uint64_t may_have(uint64_t v, char c)
+            {
+                auto x = v ^ (ones * (uint8_t)c);
+                return (x - ones) & ~x & highs;
+            }
+            // non zero if a byte of v may be a quote, a backslash or a control character
+            inline uint64_t may_need_escape(uint64_t v)
+            {
+                return may_have(v, '"') | may_have(v, '\\') | ((v - ones * 0x20) & ~v & highs);
+            }
+
+            template<class T> struct is_sequence : std::false_type
+            {
+            };
+            template<class T, class A> struct is_sequence<std::vector<T, A>> : std::true_type
+            {
+            };
+            template<class T, class A> struct is_sequence<std::list<T, A>> : std::true_type
+            {
+            };
+            template<class T> struct is_array : std::false_type
+            {
+            };
+            template<class T, size_t N> struct is_array<std::array<T, N>> : std::true_type
+            {
+            };
+            template<class T> struct is_map : std::false_type
+            {
+            };
+            template<class K, class V, class C, class A> struct is_map<std::map<K, V, C, A>> : std::true_type
+            {
+            };
+            template<class K, class V, class H, class E, class A>
+            struct is_map<std::unordered_map<K, V, H, E, A>> : std::true_type
+            {
+            };
+        }
+
+        class writer;
+        class reader;
+
+        template<class T, class = void> struct has_codec : std::false_type
+        {
+        };
+        template<class T>
+        struct has_codec<T,
+            std::void_t<decltype(std::declval<const T&>().to_json(std::declval<writer&>())),
+                decltype(std::declval<T&>().from_json(std::declval<reader&>()))>> : std::true_type
+        {
+        };
+
+        class writer
+        {
+            std::vector<char>& out_;
+            // a value has been written at this level so the next one needs a comma
+            bool need_comma_ = false;
+            bool ok_ = true;
+
+            void put(char c) { out_.push_back(c); }
+            void put(const char* text, size_t size) { out_.insert(out_.end(), text, text + size); }
+
+            void write_escaped(const char* text, size_t size)
+            {
+                put('"');
+                size_t i = 0;
+                while (i < size)
+                {
+                    // runs of characters that need no escaping are copied eight at a time
+                    size_t run = i;
+                    while (run + 8 <= size && !detail::may_need_escape(detail::load8(text + run)))
+                        run += 8;
+                    while (run < size)
+                    {
+                        auto c = (uint8_t)text[run];
+                        if (c == '"' || c == '\\' || c < 0x20)
+                            break;
+                        run++;
+                    }
+                    put(text + i, run - i);
+                    if (run == size)
+                        break;
+                    auto c = (uint8_t)text[run];
+                    put('\\');
+                    switch (c)
+                    {
+                    case '"':
+                        put('"');
+                        break;
+                    case '\\':
+                        put('\\');
+                        break;
+                    case '\n':
+                        put('n');
+                        break;
+                    case '\r':
+                        put('r');
+                        break;
+                    case '\t':
+                        put('t');
+                        break;
+                    case '\b':
+                        put('b');
+                        break;
+                    case '\f':
+                        put('f');
+                        break;
+                    default:
+                    {
+                        constexpr char hex[] = "0123456789abcdef";
+                        char code[5] = {'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                        put(code, sizeof(code));
+                    }
+                    }
+                    i = run + 1;
+                }
+                put('"');
+            }
+
+            template<class T> void write_integer(T value)
+            {
+                char digits[24];
+                char* end = digits + sizeof(digits);
+                char* p = end;
+                using unsigned_type = std::make_unsigned_t<T>;
+                unsigned_type magnitude = static_cast<unsigned_type>(value);
+                bool negative = false;
+                if constexpr (std::is_signed<T>::value)
+                {
+                    if (value < 0)
+                    {
+                        negative = true;
+                        magnitude = unsigned_type(0) - magnitude;
+                    }
+                }
+                do
+                {
+                    *--p = char('0' + magnitude % 10);
+                    magnitude /= 10;
+                } while (magnitude);
+                if (negative)
+                    *--p = '-';
+                put(p, end - p);
+            }
+
+        public:
+            explicit writer(std::vector<char>& out)
+                : out_(out)
+            {
+            }
+
+            // false if a value could not be written as json
+            bool ok() const { return ok_; }
+
+            void begin_object()
+            {
+                put('{');
+                need_comma_ = false;
+            }
+            void end_object()
+            {
+                put('}');
+                need_comma_ = true;
+            }
+            void key(std::string_view name)
+            {
+                if (need_comma_)
+                    put(',');
+                write_escaped(name.data(), name.size());
+                put(':');
+            }
+            template<class T> void member(std::string_view name, const T& value)
+            {
+                key(name);
+                write(value);
+                need_comma_ = true;
+            }
+            // a parameter that rpc::pod_block carries as base64
+            template<class C> void member_base64(std::string_view name, const C& value)
+            {
+                key(name);
+                std::string text;
+                base64::encode(value.data(), value.size(), text);
+                write_escaped(text.data(), text.size());
+                need_comma_ = true;
+            }
+
+            void write(bool value)
+            {
+                if (value)
+                    put("true", 4);
+                else
+                    put("false", 5);
+            }
+            void write(const std::string& value) { write_escaped(value.data(), value.size()); }
+            void write(std::string_view value) { write_escaped(value.data(), value.size()); }
+
+            template<class T> void write(const T& value)
+            {
+                if constexpr (std::is_enum<T>::value)
+                    write_integer(static_cast<std::underlying_type_t<T>>(value));
+                else if constexpr (std::is_integral<T>::value)
+                    write_integer(value);
+                else if constexpr (std::is_floating_point<T>::value)
+                {
+                    // json has no text for these
+                    if (!std::isfinite(value))
+                    {
+                        ok_ = false;
+                        return;
+                    }
+                    char text[32];
+                    auto size = snprintf(
+                        text, sizeof(text), "%.*g", std::numeric_limits<T>::max_digits10, static_cast<double>(value));
+                    put(text, size);
+                }
+                else if constexpr (detail::is_sequence<T>::value || detail::is_array<T>::value)
+                {
+                    put('[');
+                    bool first = true;
+                    for (const auto& item : value)
+                    {
+                        if (!first)
+                            put(',');
+                        first = false;
+                        write(item);
+                    }
+                    put(']');
+                }
+                else if constexpr (detail::is_map<T>::value)
+                {
+                    put('[');
+                    bool first = true;
+                    for (const auto& item : value)
+                    {
+                        if (!first)
+                            put(',');
+                        first = false;
+                        begin_object();
+                        member("k", item.first);
+                        member("v", item.second);
+                        end_object();
+                    }
+                    put(']');
+                }
+                else if constexpr (has_codec<T>::value)
+                    value.to_json(*this);
+                else
+                {
+                    auto text = to_yas_json<T, std::vector<char>>(value);
+                    put(text.data(), text.size());
+                }
+            }
+        };
+
+        class reader
+        {
+            const char* pos_;
+            const char* end_;
+            size_t depth_ = 0;
+            // keys that had escapes in them are unescaped into this
+            std::string key_;
+
+            void skip_space()
+            {
+                while (pos_ != end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t'))
+                    pos_++;
+            }
+            bool expect(char c)
+            {
+                skip_space();
+                if (pos_ == end_ || *pos_ != c)
+                    return false;
+                pos_++;
+                return true;
+            }
+            bool peek(char c)
+            {
+                skip_space();
+                return pos_ != end_ && *pos_ == c;
+            }
+            bool enter() { return ++depth_ <= max_depth; }
+            void leave() { --depth_; }
+
+            // the end of the run of characters up to the next quote or backslash
+            const char* scan_plain(const char* p) const
+            {
+                while (end_ - p >= 8)
+                {
+                    auto v = detail::load8(p);
+                    if (detail::may_have(v, '"') | detail::may_have(v, '\\'))
+                        break;
+                    p += 8;
+                }
+                while (p != end_ && *p != '"' && *p != '\\')
+                    p++;
+                return p;
+            }
+
+            bool read_hex4(uint32_t& code)
+            {
+                if (end_ - pos_ < 4)
+                    return false;
+                code = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    char c = *pos_++;
+                    code <<= 4;
+                    if (c >= '0' && c <= '9')
+                        code |= c - '0';
+                    else if (c >= 'a' && c <= 'f')
+                        code |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F')
+                        code |= c - 'A' + 10;
+                    else
+                        return false;
+                }
+                return true;
+            }
+
+            static void append_utf8(std::string& out, uint32_t code)
+            {
+                if (code < 0x80)
+                    out += char(code);
+                else if (code < 0x800)
+                {
+                    out += char(0xc0 | (code >> 6));
+                    out += char(0x80 | (code & 0x3f));
+                }
+                else if (code < 0x10000)
+                {
+                    out += char(0xe0 | (code >> 12));
+                    out += char(0x80 | ((code >> 6) & 0x3f));
+                    out += char(0x80 | (code & 0x3f));
+                }
+                else
+                {
+                    out += char(0xf0 | (code >> 18));
+                    out += char(0x80 | ((code >> 12) & 0x3f));
+                    out += char(0x80 | ((code >> 6) & 0x3f));
+                    out += char(0x80 | (code & 0x3f));
+                }
+            }
+
+            // the rest of a string after its opening quote, appended to out
+            bool read_escaped(std::string& out)
+            {
+                while (true)
+                {
+                    auto plain = scan_plain(pos_);
+                    out.append(pos_, plain);
+                    pos_ = plain;
+                    if (pos_ == end_)
+                        return false;
+                    if (*pos_++ == '"')
+                        return true;
+                    if (pos_ == end_)
+                        return false;
+                    switch (*pos_++)
+                    {
+                    case '"':
+                        out += '"';
+                        break;
+                    case '\\':
+                        out += '\\';
+                        break;
+                    case '/':
+                        out += '/';
+                        break;
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 'r':
+                        out += '\r';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'b':
+                        out += '\b';
+                        break;
+                    case 'f':
+                        out += '\f';
+                        break;
+                    case 'u':
+                    {
+                        uint32_t code = 0;
+                        if (!read_hex4(code))
+                            return false;
+                        if (code >= 0xd800 && code < 0xdc00)
+                        {
+                            uint32_t low = 0;
+                            if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u')
+                                return false;
+                            pos_ += 2;
+                            if (!read_hex4(low) || low < 0xdc00 || low >= 0xe000)
+                                return false;
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        }
+                        else if (code >= 0xdc00 && code < 0xe000)
+                            return false;
+                        append_utf8(out, code);
+                        break;
+                    }
+                    default:
+                        return false;
+                    }
+                }
+            }
+
+            bool read_string(std::string& value)
+            {
+                if (!expect('"'))
+                    return false;
+                // most strings have no escapes and are assigned in one go, reusing the capacity already there
+                auto plain = scan_plain(pos_);
+                if (plain != end_ && *plain == '"')
+                {
+                    value.assign(pos_, plain);
+                    pos_ = plain + 1;
+                    return true;
+                }
+                value.clear();
+                return read_escaped(value);
+            }
+
+            // the text of a number, which is checked by whoever parses it
+            std::string_view number_text()
+            {
+                skip_space();
+                auto begin = pos_;
+                while (pos_ != end_
+                       && ((*pos_ >= '0' && *pos_ <= '9') || *pos_ == '-' || *pos_ == '+' || *pos_ == '.'
+                           || *pos_ == 'e' || *pos_ == 'E'))
+                    pos_++;
+                return std::string_view(begin, pos_ - begin);
+            }
+
+            template<class T> bool read_integer(T& value)
+            {
+                auto text = number_text();
+                size_t i = 0;
+                bool negative = false;
+                if (i < text.size() && text[i] == '-')
+                {
+                    if (!std::is_signed<T>::value)
+                        return false;
+                    negative = true;
+                    i++;
+                }
+                if (i == text.size())
+                    return false;
+                using unsigned_type = std::make_unsigned_t<T>;
+                unsigned_type limit = negative ? unsigned_type(std::numeric_limits<T>::max()) + 1
+                                               : unsigned_type(std::numeric_limits<T>::max());
+                unsigned_type magnitude = 0;
+                for (; i < text.size(); i++)
+                {
+                    auto c = text[i];
+                    if (c < '0' || c > '9')
+                        return false;
+                    unsigned_type digit = c - '0';
+                    if (magnitude > (limit - digit) / 10)
+                        return false;
+                    magnitude = magnitude * 10 + digit;
+                }
+                value = negative ? T(unsigned_type(0) - magnitude) : T(magnitude);
+                return true;
+            }
+
+            template<class T> bool read_floating(T& value)
+            {
+                auto text = number_text();
+                char copy[64];
+                if (text.empty() || text.size() >= sizeof(copy))
+                    return false;
+                memcpy(copy, text.data(), text.size());
+                copy[text.size()] = 0;
+                char* parsed = nullptr;
+                auto result = strtod(copy, &parsed);
+                if (parsed != copy + text.size())
+                    return false;
+                value = static_cast<T>(result);
+                return true;
+            }
+
+            template<class T> bool read_array(T& value)
+            {
+                if (!expect('[') || !enter())
+                    return false;
+                size_t count = 0;
+                auto it = value.begin();
+                if (!peek(']'))
+                {
+                    do
+                    {
+                        if constexpr (detail::is_array<T>::value)
+                        {
+                            if (count == value.size() || !read(value[count]))
+                                return false;
+                        }
+                        else if constexpr (std::is_same<typename T::value_type, bool>::value)
+                        {
+                            bool item = false;
+                            if (!read(item))
+                                return false;
+                            if (count < value.size())
+                                value[count] = item;
+                            else
+                                value.push_back(item);
+                        }
+                        else
+                        {
+                            // elements already there are read over so their storage is reused
+                            if (it == value.end())
+                            {
+                                value.emplace_back();
+                                it = std::prev(value.end());
+                            }
+                            if (!read(*it++))
+                                return false;
+                        }
+                        count++;
+                    } while (expect(','));
+                }
+                if constexpr (detail::is_array<T>::value)
+                {
+                    if (count != value.size())
+                        return false;
+                }
+                else
+                    value.resize(count);
+                leave();
+                return expect(']');
+            }
+
+            template<class T> bool read_map(T& value)
+            {
+                if (!expect('[') || !enter())
+                    return false;
+                value.clear();
+                if (!peek(']'))
+                {
+                    do
+                    {
+                        typename T::key_type k{};
+                        typename T::mapped_type v{};
+                        bool has_k = false;
+                        bool has_v = false;
+                        if (!read_object(
+                                [&](std::string_view name)
+                                {
+                                    if (name == "k")
+                                        return has_k = read(k);
+                                    if (name == "v")
+                                        return has_v = read(v);
+                                    return skip();
+                                }))
+                            return false;
+                        if (!has_k || !has_v)
+                            return false;
+                        value.insert_or_assign(std::move(k), std::move(v));
+                    } while (expect(','));
+                }
+                leave();
+                return expect(']');
+            }
+
+        public:
+            static constexpr size_t max_depth = 64;
+
+            reader(const char* data, size_t size)
+                : pos_(data)
+                , end_(data + size)
+            {
+            }
+
+            // true once only white space is left
+            bool at_end()
+            {
+                skip_space();
+                return pos_ == end_;
+            }
+
+            // calls member with each key of an object, member reads or skips the value that follows it.  The key is
+            // only valid during the call
+            template<class F> bool read_object(F&& member)
+            {
+                if (!expect('{') || !enter())
+                    return false;
+                if (!peek('}'))
+                {
+                    do
+                    {
+                        if (!expect('"'))
+                            return false;
+                        std::string_view name;
+                        auto plain = scan_plain(pos_);
+                        if (plain != end_ && *plain == '"')
+                        {
+                            name = std::string_view(pos_, plain - pos_);
+                            pos_ = plain + 1;
+                        }
+                        else
+                        {
+                            key_.clear();
+                            if (!read_escaped(key_))
+                                return false;
+                            name = key_;
+                        }
+                        if (!expect(':') || !member(name))
+                            return false;
+                    } while (expect(','));
+                }
+                leave();
+                return expect('}');
+            }
+
+            // steps over a value of any type
+            bool skip()
+            {
+                skip_space();
+                if (pos_ == end_)
+                    return false;
+                switch (*pos_)
+                {
+                case '"':
+                {
+                    pos_++;
+                    while (true)
+                    {
+                        pos_ = scan_plain(pos_);
+                        if (pos_ == end_)
+                            return false;
+                        if (*pos_++ == '"')
+                            return true;
+                        if (pos_ == end_)
+                            return false;
+                        pos_++;
+                    }
+                }
+                case '{':
+                    return read_object([this](std::string_view) { return skip(); });
+                case '[':
+                {
+                    if (!expect('[') || !enter())
+                        return false;
+                    if (!peek(']'))
+                    {
+                        do
+                        {
+                            if (!skip())
+                                return false;
+                        } while (expect(','));
+                    }
+                    leave();
+                    return expect(']');
+                }
+                default:
+                {
+                    for (auto word : {std::string_view("true"), std::string_view("false"), std::string_view("null")})
+                    {
+                        if ((size_t)(end_ - pos_) >= word.size() && std::string_view(pos_, word.size()) == word)
+                        {
+                            pos_ += word.size();
+                            return true;
+                        }
+                    }
+                    return !number_text().empty();
+                }
+                }
+            }
+
+            bool read(bool& value)
+            {
+                skip_space();
+                if (end_ - pos_ >= 4 && std::string_view(pos_, 4) == "true")
+                {
+                    pos_ += 4;
+                    value = true;
+                    return true;
+                }
+                if (end_ - pos_ >= 5 && std::string_view(pos_, 5) == "false")
+                {
+                    pos_ += 5;
+                    value = false;
+                    return true;
+                }
+                return false;
+            }
+            bool read(std::string& value) { return read_string(value); }
+
+            template<class T> bool read(T& value)
+            {
+                if constexpr (std::is_enum<T>::value)
+                {
+                    std::underlying_type_t<T> underlying{};
+                    if (!read_integer(underlying))
+                        return false;
+                    value = static_cast<T>(underlying);
+                    return true;
+                }
+                else if constexpr (std::is_integral<T>::value)
+                    return read_integer(value);
+                else if constexpr (std::is_floating_point<T>::value)
+                    return read_floating(value);
+                else if constexpr (detail::is_sequence<T>::value || detail::is_array<T>::value)
+                    return read_array(value);
+                else if constexpr (detail::is_map<T>::value)
+                    return read_map(value);
+                else if constexpr (has_codec<T>::value)
+                {
+                    if (!enter())
+                        return false;
+                    auto ret = value.from_json(*this);
+                    leave();
+                    return ret;
+                }
+                else
+                {
+                    skip_space();
+                    auto begin = pos_;
+                    if (!skip())
+                        return false;
+                    return from_yas_json(span(begin, pos_), value).empty();
+                }
+            }
+
+            // a parameter that rpc::pod_block carries as base64
+            template<class C> bool read_base64(C& value)
+            {
+                if (!read_string(key_))
+                    return false;
+                size_t size = 0;
+                if (!base64::decoded_size(key_.data(), key_.size(), size))
+                    return false;
+                if constexpr (detail::is_array<C>::value)
+                {
+                    if (size != value.size())
+                        return false;
+                }
+                else
+                    value.resize(size);
+                return !size || base64::decode(key_.data(), key_.size(), value.data());
+            }
+        };
+    }
+
+    template<typename T, class OutputBlob = std::vector<char>> OutputBlob to_json(const T& obj)
+    {
+        std::vector<char> buffer;
+        json::writer writer(buffer);
+        writer.write(obj);
+        if (!writer.ok())
+            throw std::runtime_error("value cannot be written as json");
+        return OutputBlob(buffer.begin(), buffer.end());
+    }
+
+    template<typename T> std::string from_json(const span& data, T& obj)
+    {
+        json::reader reader(reinterpret_cast<const char*>(data.begin), data.end - data.begin);
+        if (!reader.read(obj) || !reader.at_end())
+            return "a json blob was incompatible with the type that is deserialising to";
+        return "";
+    }
+}
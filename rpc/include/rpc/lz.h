@@ -0,0 +1,46 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// the block compressor behind encoding::yas_lz.  It is a byte oriented LZ77 in the style of LZ4, a hash of the next
+// four bytes finds an earlier match within 64k and each sequence is a token, its literals and a two byte offset.  It
+// is written here rather than pulled in so that it builds in an enclave, it has no intrinsics and never allocates
+// beyond its output.
+//
+// A frame is one header byte followed by the payload.  Payloads under the threshold are stored as they are so a small
+// message costs that one byte, larger ones are compressed when that makes them smaller and then carry their original
+// size as a varint after the header
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rpc
+{
+    namespace lz
+    {
+        enum class frame : uint8_t
+        {
+            stored = 0,
+            compressed = 1
+        };
+
+        // payloads at least this large are compressed, 1024 bytes unless set
+        void set_threshold(size_t threshold);
+        size_t get_threshold();
+
+        // appends a block holding size bytes of data to out
+        void compress(const char* data, size_t size, std::vector<char>& out);
+        // decompresses a block into exactly size bytes at out, false if the block is malformed or does not fill them
+        bool decompress(const char* block, size_t block_size, char* out, size_t size);
+
+        // the size of the payload of a compressed frame, zero for a stored or malformed one as those need no scratch
+        size_t unpacked_size(const char* frame_data, size_t frame_size);
+        // turns the payload in buffer into a frame
+        void pack(std::vector<char>& buffer);
+        // the payload of a frame, data points into the frame when it was stored and into scratch when it was not
+        bool unpack(
+            const char* frame_data, size_t frame_size, std::vector<char>& scratch, const char*& data, size_t& size);
+    }
+}
@@ -4,14 +4,19 @@
  */
 #pragma once
 
+#include <cstring>
 #include <string>
+#include <limits>
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 #include <rpc/types.h>
 #include <rpc/serialiser.h>
 #include <rpc/error_codes.h>
+#include <rpc/coroutine.h>
 
 namespace rpc
 {
@@ -82,8 +87,155 @@ namespace rpc
         virtual uint64_t release(
             uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id)
             = 0;
+
+        // releases each object the given number of times in one message, marshallers that cannot batch fall back to a
+        // release per reference.  Returns the sum of the counts that the objects were left with, as release would for
+        // each, or std::numeric_limits<uint64_t>::max() if the protocol version is not supported, in which case
+        // nothing has been released
+        virtual uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases)
+        {
+            bool first = true;
+            uint64_t remaining = 0;
+            for (auto& item : releases)
+            {
+                uint64_t ret = 0;
+                for (uint64_t i = 0; i < item.second; i++)
+                {
+                    ret = release(protocol_version, destination_zone_id, item.first, caller_zone_id);
+                    if (first && ret == std::numeric_limits<uint64_t>::max())
+                        return ret;
+                    first = false;
+                }
+                // an object that could not be released has nothing left to count
+                if (ret != std::numeric_limits<uint64_t>::max())
+                    remaining += ret;
+            }
+            return remaining;
+        }
+
+        // sends a call to a [oneway] method, nothing is read back so the caller need not wait for the call to run.
+        // Marshallers that can queue may return as soon as the message is on its way, in which case the result only
+        // reports whether it could be sent.  in_buf_ is the callers so a marshaller that queues it must copy it and
+        // refuse encoding::direct with INCOMPATIBLE_SERIALISATION.  The default sends the call and drops the reply, so
+        // it still waits for the call to run on a marshaller that does not override it
+        virtual int post(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_)
+        {
+            // a oneway stub writes no reply so this never allocates
+            std::vector<char> out_buf;
+            return send(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf);
+        }
+#ifdef BUILD_COROUTINE
+        // awaitable variants of the calls above, the defaults complete synchronously by calling the blocking versions
+        // so only marshallers that can genuinely suspend need to override them
+        virtual task<int> async_send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_)
+        {
+            co_return send(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+        }
+        virtual task<int> async_try_cast(
+            uint64_t protocol_version, destination_zone destination_zone_id, object object_id, interface_ordinal interface_id)
+        {
+            co_return try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+        }
+        virtual task<uint64_t> async_add_ref(uint64_t protocol_version,
+            destination_channel_zone destination_channel_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            add_ref_options build_out_param_channel)
+        {
+            co_return add_ref(protocol_version,
+                destination_channel_zone_id,
+                destination_zone_id,
+                object_id,
+                caller_channel_zone_id,
+                caller_zone_id,
+                build_out_param_channel);
+        }
+        virtual task<uint64_t> async_release(
+            uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id)
+        {
+            co_return release(protocol_version, destination_zone_id, object_id, caller_zone_id);
+        }
+#endif
     };
 
+    // the wire form of a release batch for transports that carry it as a block of bytes, each object id is followed
+    // by the number of references released on it
+    inline void pack_release_batch(const std::vector<std::pair<object, uint64_t>>& releases, std::vector<uint64_t>& out)
+    {
+        out.clear();
+        out.reserve(releases.size() * 2);
+        for (auto& item : releases)
+        {
+            out.push_back(item.first.get_val());
+            out.push_back(item.second);
+        }
+    }
+
+    // false if size bytes at data are not a packed release batch
+    inline bool unpack_release_batch(
+        const char* data, size_t size, std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        constexpr size_t item_size = sizeof(uint64_t) * 2;
+        if (size % item_size)
+            return false;
+        releases.resize(size / item_size);
+        for (size_t i = 0; i < releases.size(); i++)
+        {
+            uint64_t values[2];
+            memcpy(values, data + i * item_size, item_size);
+            releases[i] = {{values[0]}, values[1]};
+        }
+        return true;
+    }
+
     // this class is responsible for (de)coding and logging of data streams
     /*class method_data_processor
     {
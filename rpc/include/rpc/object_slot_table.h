@@ -0,0 +1,96 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <rpc/types.h>
+#include <rpc/remote_pointer.h>
+
+namespace rpc
+{
+    class object_stub;
+
+    // a dense table of object stubs where an object id is a (generation, slot index) pair, the high 32 bits of the id
+    // are the generation and the low 32 bits the slot.  A lookup is a single indexed load followed by a generation
+    // check, a slot's generation is bumped when it is freed so stale ids never resolve to a newer object
+    class object_slot_table
+    {
+    public:
+        static constexpr uint32_t segment_size = 1024;
+        static constexpr uint32_t max_segments = 4096;
+
+    private:
+        struct slot
+        {
+            std::atomic<uint32_t> generation = 1;
+            // guards stub and occupied, held only for the duration of a weak_ptr copy
+            mutable std::atomic_flag busy = ATOMIC_FLAG_INIT;
+            bool occupied = false;
+            rpc::weak_ptr<object_stub> stub;
+
+            void lock() const
+            {
+                while (busy.test_and_set(std::memory_order_acquire))
+                    ;
+            }
+            void unlock() const { busy.clear(std::memory_order_release); }
+        };
+
+        struct segment
+        {
+            std::array<slot, segment_size> slots;
+        };
+
+        // segments are allocated on demand and never moved so readers do not need a lock to reach a slot
+        std::array<std::atomic<segment*>, max_segments> segments_ = {};
+
+        mutable std::mutex allocation_control;
+        std::vector<uint32_t> free_slots_;
+        uint32_t next_slot_ = 0;
+
+        slot* get_slot(uint32_t index) const;
+
+    public:
+        object_slot_table() = default;
+        object_slot_table(const object_slot_table&) = delete;
+        object_slot_table& operator=(const object_slot_table&) = delete;
+        ~object_slot_table();
+
+        // claims a slot and returns its id, returns a zero id if the table is full
+        object reserve();
+        // makes the stub visible to find, id must have come from reserve
+        void publish(object id, const rpc::weak_ptr<object_stub>& stub);
+        rpc::weak_ptr<object_stub> find(object id) const;
+        // retires the id, returns false if it was already stale
+        bool free(object id);
+
+        template<class FN> void for_each(FN&& fn) const
+        {
+            uint32_t count = 0;
+            {
+                std::lock_guard g(allocation_control);
+                count = next_slot_;
+            }
+            for (uint32_t index = 0; index < count; index++)
+            {
+                auto* s = get_slot(index);
+                if (!s)
+                    continue;
+                s->lock();
+                bool occupied = s->occupied;
+                object id = {((uint64_t)s->generation.load(std::memory_order_relaxed) << 32) | index};
+                auto stub = s->stub;
+                s->unlock();
+                if (occupied)
+                    fn(id, stub);
+            }
+        }
+    };
+}
@@ -4,6 +4,8 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <unordered_map>
@@ -87,10 +89,43 @@ namespace rpc
 
     class object_proxy : public rpc::enable_shared_from_this<object_proxy>
     {
+    public:
+        // how many refused interfaces are remembered before the oldest is forgotten
+        static constexpr size_t refused_interface_count = 4;
+
+    private:
+        // an object is rarely used through more than a few interfaces so their proxies are cached in inline slots that
+        // are read without taking insert_control_, a slot's interface id never changes once it is published
+        struct interface_slot
+        {
+            std::atomic<uint64_t> interface_id = 0;
+            // guards proxy, held only for the duration of a weak_ptr copy
+            mutable std::atomic_flag busy = ATOMIC_FLAG_INIT;
+            rpc::weak_ptr<proxy_base> proxy;
+
+            void lock() const
+            {
+                while (busy.test_and_set(std::memory_order_acquire))
+                    ;
+            }
+            void unlock() const { busy.clear(std::memory_order_release); }
+        };
+        static constexpr size_t interface_slot_count = 4;
+
         object object_id_;
         rpc::shared_ptr<service_proxy> service_proxy_;
+        std::array<interface_slot, interface_slot_count> interface_slots_;
+        // interfaces that did not fit in the inline slots
         std::unordered_map<interface_ordinal, rpc::weak_ptr<proxy_base>> proxy_map;
+        // interfaces the remote object has refused in try_cast, an object's interfaces never change so a refusal is
+        // final and repeating the cast does not need to cross the zone boundary again
+        std::array<std::atomic<uint64_t>, refused_interface_count> refused_interfaces_ = {};
+        std::atomic<uint32_t> next_refused_interface_ = 0;
         std::mutex insert_control_;
+        // with indirect reference counting these are references on the remote object that this zone has absorbed from
+        // zones it passed the object on to, they are lent out again instead of add_reffing the owner and handed back
+        // to the owner when this proxy dies
+        std::atomic<uint64_t> reference_credit_ = 0;
 
         object_proxy(object object_id, rpc::shared_ptr<service_proxy> service_proxy);
 
@@ -99,6 +134,16 @@ namespace rpc
 
         int try_cast(std::function<interface_ordinal(uint64_t)> id_getter);
 
+        // lock free lookup of a live proxy in the inline slots
+        rpc::shared_ptr<proxy_base> find_cached_proxy(interface_ordinal interface_id) const;
+        // these require insert_control_, lookup_proxy returns true if the interface has been proxied before even if
+        // the proxy has since expired
+        bool lookup_proxy(interface_ordinal interface_id, rpc::shared_ptr<proxy_base>& proxy);
+        void store_proxy(interface_ordinal interface_id, const rpc::shared_ptr<proxy_base>& proxy);
+
+        bool is_refused_interface(interface_ordinal interface_id) const;
+        void add_refused_interface(interface_ordinal interface_id);
+
         friend service_proxy;
 
     public:
@@ -106,6 +151,20 @@ namespace rpc
 
         rpc::shared_ptr<service_proxy> get_service_proxy() const { return service_proxy_; }
         object get_object_id() const { return {object_id_}; }
+
+        // returns the credit now held
+        uint64_t add_reference_credit() { return ++reference_credit_; }
+        bool try_take_reference_credit()
+        {
+            auto credit = reference_credit_.load();
+            while (credit)
+            {
+                if (reference_credit_.compare_exchange_weak(credit, credit - 1))
+                    return true;
+            }
+            return false;
+        }
+        uint64_t get_reference_credit() const { return reference_credit_.load(); }
         destination_zone get_destination_zone_id() const;
 
         [[nodiscard]] int send(uint64_t protocol_version,
@@ -124,81 +183,118 @@ namespace rpc
             const char* in_buf_,
             std::vector<char>& out_buf_);
 
+        [[nodiscard]] int send(rpc::encoding encoding,
+            uint64_t tag,
+            std::function<interface_ordinal(uint64_t)> id_getter,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_);
+
+        // for [oneway] methods, there is no reply to wait for
+        [[nodiscard]] int post(rpc::encoding encoding,
+            uint64_t tag,
+            std::function<interface_ordinal(uint64_t)> id_getter,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_);
+
+#ifdef BUILD_COROUTINE
+        task<int> async_send(rpc::encoding encoding,
+            uint64_t tag,
+            std::function<interface_ordinal(uint64_t)> id_getter,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_);
+#endif
+
         size_t get_proxy_count()
         {
             std::lock_guard guard(insert_control_);
-            return proxy_map.size();
+            size_t count = proxy_map.size();
+            for (auto& slot : interface_slots_)
+            {
+                if (slot.interface_id.load(std::memory_order_relaxed))
+                    count++;
+            }
+            return count;
         }
 
         template<class T> void create_interface_proxy(rpc::shared_ptr<T>& inface);
 
         template<class T> int query_interface(rpc::shared_ptr<T>& iface, bool do_remote_check = true)
         {
-            auto create = [&](std::unordered_map<interface_ordinal, rpc::weak_ptr<proxy_base>>::iterator item) -> int
+#ifdef RPC_V2
+            auto interface_id = T::get_id(rpc::VERSION_2);
+            if (interface_id == 0)
+            {
+                return rpc::error::OK();
+            }
+            if (auto proxy = find_cached_proxy(interface_id))
             {
-                rpc::shared_ptr<proxy_base> proxy = item->second.lock();
-                if (!proxy)
-                {
-                    // weak pointer needs refreshing
-                    create_interface_proxy<T>(iface);
-                    item->second = rpc::reinterpret_pointer_cast<proxy_base>(iface);
-                    return rpc::error::OK();
-                }
                 iface = rpc::reinterpret_pointer_cast<T>(proxy);
                 return rpc::error::OK();
-            };
+            }
+#endif
 
             { // scope for the lock
                 std::lock_guard guard(insert_control_);
+                bool known = false;
 #ifdef RPC_V2
-                if (T::get_id(rpc::VERSION_2) == 0)
+                rpc::shared_ptr<proxy_base> proxy;
+                known = lookup_proxy(interface_id, proxy);
+                if (proxy)
                 {
+                    iface = rpc::reinterpret_pointer_cast<T>(proxy);
                     return rpc::error::OK();
                 }
-                {
-                    auto item = proxy_map.find(T::get_id(rpc::VERSION_2));
-                    if (item != proxy_map.end())
-                    {
-                        return create(item);
-                    }
-                }
 #endif
-                if (!do_remote_check)
+                // an expired proxy just needs refreshing as the remote check has already been done
+                if (known || !do_remote_check)
                 {
                     create_interface_proxy<T>(iface);
 #ifdef RPC_V2
-                    proxy_map[T::get_id(rpc::VERSION_2)] = rpc::reinterpret_pointer_cast<proxy_base>(iface);
+                    store_proxy(interface_id, rpc::reinterpret_pointer_cast<proxy_base>(iface));
 #endif
                     return rpc::error::OK();
                 }
             }
 
             // release the lock and then check for casting
-            if (do_remote_check)
+#ifdef RPC_V2
+            if (is_refused_interface(interface_id))
             {
-                // see if object_id can implement interface
-                int ret = try_cast(T::get_id);
-                if (ret != rpc::error::OK())
-                {
-                    return ret;
-                }
+                return rpc::error::INVALID_CAST();
             }
+#endif
+            // see if object_id can implement interface
+            int ret = try_cast(T::get_id);
+            if (ret != rpc::error::OK())
+            {
+#ifdef RPC_V2
+                if (ret == rpc::error::INVALID_CAST())
+                    add_refused_interface(interface_id);
+#endif
+                return ret;
+            }
+
             { // another scope for the lock
                 std::lock_guard guard(insert_control_);
 
                 // check again...
 #ifdef RPC_V2
+                rpc::shared_ptr<proxy_base> proxy;
+                lookup_proxy(interface_id, proxy);
+                if (proxy)
                 {
-                    auto item = proxy_map.find(T::get_id(rpc::VERSION_2));
-                    if (item != proxy_map.end())
-                    {
-                        return create(item);
-                    }
+                    iface = rpc::reinterpret_pointer_cast<T>(proxy);
+                    return rpc::error::OK();
                 }
 #endif
                 create_interface_proxy<T>(iface);
 #ifdef RPC_V2
-                proxy_map[T::get_id(rpc::VERSION_2)] = rpc::reinterpret_pointer_cast<proxy_base>(iface);
+                store_proxy(interface_id, rpc::reinterpret_pointer_cast<proxy_base>(iface));
 #endif
                 return rpc::error::OK();
             }
@@ -223,11 +319,20 @@ namespace rpc
         std::atomic<int> lifetime_lock_count_ = 0;
         std::atomic<uint64_t> version_ = rpc::get_version();
         encoding enc_ = encoding::enc_default;
+        bool shares_address_space_ = false;
         // if a service proxy is pointing to the zones parent zone then it needs to stay alive even if there are no
         // active references going through it
         bool is_parent_channel_ = false;
         std::string name_;
 
+        // releases are held back and sent in batches when release_batch_size_ is non zero, add_refs are never
+        // delayed so the remote count can only ever be higher than the true count and nothing is torn down early
+        std::mutex release_batch_control_;
+        std::unordered_map<object, uint64_t> pending_releases_;
+        uint64_t pending_release_count_ = 0;
+        std::atomic<uint64_t> release_batch_size_ = 0;
+        std::atomic<bool> has_pending_releases_ = false;
+
     protected:
         service_proxy(const char* name, destination_zone destination_zone_id, const rpc::shared_ptr<service>& svc)
             : zone_id_(svc->get_zone_id())
@@ -255,11 +360,16 @@ namespace rpc
             , service_(other.service_)
             , lifetime_lock_count_(0)
             , enc_(other.enc_)
+            , shares_address_space_(other.shares_address_space_)
             , name_(other.name_)
+            , release_batch_size_(other.release_batch_size_.load())
         {
             RPC_ASSERT(service_.lock() != nullptr);
         }
 
+        // for transports whose zones share this address space, only they can be set to encoding::direct
+        void set_shares_address_space() { shares_address_space_ = true; }
+
         // not thread safe
         void set_remote_rpc_version(uint64_t version) { version_ = version; }
         bool is_parent_channel() const { return is_parent_channel_; }
@@ -278,6 +388,8 @@ namespace rpc
         virtual ~service_proxy()
         {
             RPC_ASSERT(proxies_.empty());
+            // each pending release holds an external ref so none can be outstanding once the proxy dies
+            RPC_ASSERT(pending_releases_.empty());
             auto svc = service_.lock();
             if (svc)
             {
@@ -299,12 +411,65 @@ namespace rpc
 
         encoding get_encoding() const { return enc_; }
 
+        // an encoding the transport cannot carry is refused with INCOMPATIBLE_SERIALISATION and the current one kept
         uint64_t set_encoding(encoding enc)
         {
+            if (!is_supported_encoding(enc) || (enc == encoding::direct && !shares_address_space_))
+                return error::INCOMPATIBLE_SERIALISATION();
             enc_ = enc;
             return error::OK();
         }
 
+        // batch up to size object proxy releases before sending them, zero sends each release immediately
+        void set_release_batch_size(uint64_t size)
+        {
+            release_batch_size_ = size;
+            if (!size)
+                flush_pending_releases();
+        }
+        uint64_t get_release_batch_size() const { return release_batch_size_.load(); }
+
+        // sends any held back releases as a single batch, call this from a timer to bound how long they are held
+        void flush_pending_releases()
+        {
+            std::vector<std::pair<object, uint64_t>> releases;
+            uint64_t reference_count = 0;
+            {
+                std::lock_guard g(release_batch_control_);
+                if (pending_releases_.empty())
+                    return;
+                releases.assign(pending_releases_.begin(), pending_releases_.end());
+                reference_count = pending_release_count_;
+                pending_releases_.clear();
+                pending_release_count_ = 0;
+                has_pending_releases_ = false;
+            }
+
+            auto original_version = version_.load();
+            auto version = original_version;
+            while (version)
+            {
+                auto ret = release_batch(version, destination_zone_id_, caller_zone_id_, releases);
+                if (ret != std::numeric_limits<uint64_t>::max())
+                {
+                    if (original_version != version)
+                    {
+                        version_.compare_exchange_strong(original_version, version);
+                    }
+                    // this may drop the lifetime lock so it must be the last thing done
+                    for (uint64_t i = 0; i < reference_count; i++)
+                        inner_release_external_ref();
+                    return;
+                }
+                version--;
+            }
+            {
+                std::string message("unable to release batch on service");
+                LOG_STR(message.c_str(), message.size());
+                RPC_ASSERT(false);
+            }
+        }
+
         virtual int connect(rpc::interface_descriptor input_descr, rpc::interface_descriptor& output_descr)
         {
             std::ignore = input_descr;
@@ -367,6 +532,9 @@ namespace rpc
             const char* in_buf_,
             std::vector<char>& out_buf_)
         {
+            // piggyback any held back releases on the next outbound call
+            if (has_pending_releases_.load(std::memory_order_relaxed))
+                flush_pending_releases();
             return send(protocol_version,
                 encoding,
                 tag,
@@ -391,15 +559,57 @@ namespace rpc
             std::vector<char>& out_buf_)
         {
             // force a lowest common denominator
-            if (enc != encoding::enc_default && enc != encoding::yas_binary && enc != encoding::yas_compressed_binary
-                && enc != encoding::yas_json)
+            if (!is_supported_encoding(enc))
             {
                 return error::INCOMPATIBLE_SERIALISATION();
             }
+            if (enc == encoding::enc_default)
+                enc = enc_;
+            // argument packs can only be handed to a transport that stays in this address space
+            if (enc == encoding::direct && enc_ != encoding::direct)
+                return error::INCOMPATIBLE_SERIALISATION();
 
             auto version = version_.load();
             auto ret = send_from_this_zone(
-                version, enc_, tag, object_id, id_getter(version), method_id, in_size_, in_buf_, out_buf_);
+                version, enc, tag, object_id, id_getter(version), method_id, in_size_, in_buf_, out_buf_);
+            if (ret == rpc::error::INVALID_VERSION())
+            {
+                version_.compare_exchange_strong(version, version - 1);
+            }
+            return ret;
+        }
+
+        [[nodiscard]] int post_from_this_zone(encoding enc,
+            uint64_t tag,
+            object object_id,
+            std::function<interface_ordinal(uint64_t)> id_getter,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_)
+        {
+            if (!is_supported_encoding(enc))
+            {
+                return error::INCOMPATIBLE_SERIALISATION();
+            }
+            if (enc == encoding::enc_default)
+                enc = enc_;
+            if (enc == encoding::direct && enc_ != encoding::direct)
+                return error::INCOMPATIBLE_SERIALISATION();
+
+            if (has_pending_releases_.load(std::memory_order_relaxed))
+                flush_pending_releases();
+            auto version = version_.load();
+            auto ret = post(version,
+                enc,
+                tag,
+                caller_channel_zone{},
+                caller_zone_id_,
+                destination_zone_id_,
+                object_id,
+                id_getter(version),
+                method_id,
+                in_size_,
+                in_buf_);
             if (ret == rpc::error::INVALID_VERSION())
             {
                 version_.compare_exchange_strong(version, version - 1);
@@ -407,9 +617,53 @@ namespace rpc
             return ret;
         }
 
+#ifdef BUILD_COROUTINE
+        task<int> async_send_from_this_zone(encoding enc,
+            uint64_t tag,
+            object object_id,
+            std::function<interface_ordinal(uint64_t)> id_getter,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_)
+        {
+            if (!is_supported_encoding(enc))
+            {
+                co_return error::INCOMPATIBLE_SERIALISATION();
+            }
+            if (enc == encoding::enc_default)
+                enc = enc_;
+            if (enc == encoding::direct && enc_ != encoding::direct)
+                co_return error::INCOMPATIBLE_SERIALISATION();
+
+            if (has_pending_releases_.load(std::memory_order_relaxed))
+                flush_pending_releases();
+            auto version = version_.load();
+            auto ret = co_await async_send(version,
+                enc,
+                tag,
+                caller_channel_zone{},
+                caller_zone_id_,
+                destination_zone_id_,
+                object_id,
+                id_getter(version),
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+            if (ret == rpc::error::INVALID_VERSION())
+            {
+                version_.compare_exchange_strong(version, version - 1);
+            }
+            co_return ret;
+        }
+#endif
+
         [[nodiscard]] int sp_try_cast(
             destination_zone destination_zone_id, object object_id, std::function<interface_ordinal(uint64_t)> id_getter)
         {
+            if (has_pending_releases_.load(std::memory_order_relaxed))
+                flush_pending_releases();
             auto original_version = version_.load();
             auto version = original_version;
             while (version)
@@ -503,7 +757,40 @@ namespace rpc
             return rpc::error::INCOMPATIBLE_SERVICE();
         }
 
-        void on_object_proxy_released(object object_id)
+        uint64_t sp_release_batch(const std::vector<std::pair<object, uint64_t>>& releases)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                for (auto& item : releases)
+                    telemetry_service->on_service_proxy_release(get_zone_id(),
+                        destination_zone_id_,
+                        destination_channel_zone_,
+                        get_caller_zone_id(),
+                        item.first);
+            }
+#endif
+
+            auto original_version = version_.load();
+            auto version = original_version;
+            while (version)
+            {
+                auto ret = release_batch(version, destination_zone_id_, caller_zone_id_, releases);
+                if (ret != std::numeric_limits<uint64_t>::max())
+                {
+                    if (original_version != version)
+                    {
+                        version_.compare_exchange_strong(original_version, version);
+                    }
+                    return ret;
+                }
+                version--;
+            }
+            return rpc::error::INCOMPATIBLE_SERVICE();
+        }
+
+        // extra_references are references the object proxy was holding on behalf of other zones
+        void on_object_proxy_released(object object_id, uint64_t extra_references = 0)
         {
             auto caller_zone_id = get_zone_id().as_caller();
             RPC_ASSERT(caller_zone_id == get_caller_zone_id());
@@ -528,11 +815,32 @@ namespace rpc
             }
 #endif
 
+            if (auto batch_size = release_batch_size_.load(); batch_size)
+            {
+                // the external ref is kept until the release is actually sent so the channel stays open
+                uint64_t pending = 0;
+                {
+                    std::lock_guard g(release_batch_control_);
+                    pending_releases_[object_id] += 1 + extra_references;
+                    pending = ++pending_release_count_;
+                    has_pending_releases_ = true;
+                }
+                // flush a full batch, or straight away if the held back releases are all that is keeping this channel
+                // alive as otherwise the zone would never be torn down
+                if (pending >= batch_size || pending >= (uint64_t)lifetime_lock_count_.load())
+                    flush_pending_releases();
+                return;
+            }
+
             auto original_version = version_.load();
             auto version = original_version;
             while (version)
             {
-                auto ret = release(version, destination_zone_id_, object_id, caller_zone_id);
+                auto ret = extra_references ? release_batch(version,
+                                                  destination_zone_id_,
+                                                  caller_zone_id,
+                                                  {{object_id, 1 + extra_references}})
+                                            : release(version, destination_zone_id_, object_id, caller_zone_id);
                 if (ret != std::numeric_limits<uint64_t>::max())
                 {
                     inner_release_external_ref();
@@ -554,6 +862,16 @@ namespace rpc
 
         std::unordered_map<object, rpc::weak_ptr<object_proxy>> get_proxies() { return proxies_; }
 
+        // returns the live object proxy for this object if there is one, it never creates one
+        rpc::shared_ptr<object_proxy> find_object_proxy(object object_id)
+        {
+            std::lock_guard l(insert_control_);
+            auto item = proxies_.find(object_id);
+            if (item == proxies_.end())
+                return nullptr;
+            return item->second.lock();
+        }
+
         virtual rpc::shared_ptr<service_proxy> clone() = 0;
         virtual void clone_completed()
         {
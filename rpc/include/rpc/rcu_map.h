@@ -0,0 +1,161 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <type_traits>
+
+namespace rpc
+{
+    // the grace period tracking shared by every rcu_map in the process.  Each thread claims a reader slot the first
+    // time it reads and publishes the epoch it entered at in it, so a read is a pair of stores to a cache line that
+    // no other reader writes.  A writer bumps the epoch and waits until every slot is either idle or has moved past
+    // it.  Threads that find every slot taken fall back to a pair of shared counters
+    class rcu_domain
+    {
+    public:
+        static constexpr size_t slot_count = 256;
+        static constexpr uint64_t idle = ~uint64_t(0);
+
+    private:
+        struct alignas(64) reader_slot
+        {
+            std::atomic<uint64_t> epoch = idle;
+            std::atomic<bool> owned = false;
+        };
+
+        struct alignas(64) reader_count
+        {
+            std::atomic<uint64_t> count = 0;
+        };
+
+        std::atomic<uint64_t> epoch_ = 0;
+        std::array<reader_slot, slot_count> slots_;
+        std::array<reader_count, 2> overflow_readers_;
+        std::mutex writer_control_;
+
+        struct thread_reader;
+        static thread_reader& this_reader();
+
+        rcu_domain() = default;
+
+    public:
+        rcu_domain(const rcu_domain&) = delete;
+        rcu_domain& operator=(const rcu_domain&) = delete;
+
+        // never destroyed so that threads still reading during static destruction are safe
+        static rcu_domain& get();
+
+        class read_section
+        {
+            reader_slot* slot_ = nullptr;
+            reader_count* overflow_ = nullptr;
+
+        public:
+            read_section();
+            ~read_section();
+            read_section(const read_section&) = delete;
+            read_section& operator=(const read_section&) = delete;
+        };
+
+        // returns once every read section that started before the call has finished
+        void synchronize();
+    };
+
+    // a read mostly ordered map, readers work on an immutable snapshot and never block, each mutation copies the
+    // current snapshot, publishes the modified copy and frees the old one once every reader that could have seen it
+    // has left.  Mutations are serialised internally but callers that need a find then insert to be atomic must
+    // still hold their own lock around the pair.
+    // Do not mutate any rcu_map from inside a read callback as the writer would wait forever for its own read to
+    // finish
+    template<class KEY, class VALUE, class COMPARE = std::less<KEY>> class rcu_map
+    {
+    public:
+        using map_type = std::map<KEY, VALUE, COMPARE>;
+
+    private:
+        std::atomic<const map_type*> current_;
+        std::atomic<uint64_t> version_ = 0;
+        std::mutex writer_control_;
+
+    public:
+        rcu_map()
+            : current_(new map_type())
+        {
+        }
+        rcu_map(const rcu_map&) = delete;
+        rcu_map& operator=(const rcu_map&) = delete;
+        ~rcu_map() { delete current_.load(); }
+
+        // runs fn against the current snapshot, fn must not keep references into the map once it returns
+        template<class FN> auto read(FN&& fn) const
+        {
+            rcu_domain::read_section section;
+            return fn(*current_.load());
+        }
+
+        bool find(const KEY& key, VALUE& value) const
+        {
+            return read(
+                [&](const map_type& map)
+                {
+                    auto it = map.find(key);
+                    if (it == map.end())
+                        return false;
+                    value = it->second;
+                    return true;
+                });
+        }
+
+        // copies the current snapshot, lets fn modify the copy then publishes it
+        template<class FN> auto update(FN&& fn)
+        {
+            std::lock_guard g(writer_control_);
+            auto* old_map = current_.load();
+            auto* new_map = new map_type(*old_map);
+            auto finish = [&]()
+            {
+                current_.store(new_map);
+                ++version_;
+                rcu_domain::get().synchronize();
+                delete old_map;
+            };
+            if constexpr (std::is_void_v<decltype(fn(*new_map))>)
+            {
+                fn(*new_map);
+                finish();
+            }
+            else
+            {
+                auto ret = fn(*new_map);
+                finish();
+                return ret;
+            }
+        }
+
+        void insert_or_assign(const KEY& key, const VALUE& value)
+        {
+            update([&](map_type& map) { map.insert_or_assign(key, value); });
+        }
+
+        bool erase(const KEY& key)
+        {
+            return update([&](map_type& map) { return map.erase(key) != 0; });
+        }
+
+        void clear()
+        {
+            update([&](map_type& map) { map.clear(); });
+        }
+
+        // increments every time a new snapshot is published
+        uint64_t get_version() const { return version_.load(); }
+    };
+}
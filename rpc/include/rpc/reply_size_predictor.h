@@ -0,0 +1,125 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <rpc/error_codes.h>
+#include <rpc/types.h>
+
+namespace rpc
+{
+    // some transports copy a reply into a buffer supplied by the caller and answer NEED_MORE_MEMORY with the size they
+    // need when it is too small, the caller then grows the buffer and crosses the boundary a second time.  This keeps a
+    // short history of reply sizes for each method so that the buffer can be sized before the first crossing
+    class reply_size_predictor
+    {
+    public:
+        struct stats
+        {
+            uint64_t calls = 0;
+            uint64_t retries = 0;
+
+            double get_retry_rate() const { return calls ? double(retries) / double(calls) : 0.0; }
+        };
+
+        // replies are tracked over windows of this many calls, the prediction covers the current and the previous
+        // window so a single large reply stops inflating buffers after at most two windows
+        static constexpr uint32_t window_size = 64;
+
+    private:
+        struct key
+        {
+            interface_ordinal interface_id;
+            method method_id;
+
+            bool operator==(const key& other) const
+            {
+                return interface_id == other.interface_id && method_id == other.method_id;
+            }
+        };
+
+        struct key_hash
+        {
+            size_t operator()(const key& k) const
+            {
+                return std::hash<interface_ordinal>()(k.interface_id) ^ (std::hash<method>()(k.method_id) << 1);
+            }
+        };
+
+        struct history
+        {
+            size_t window_max = 0;
+            size_t previous_window_max = 0;
+            uint32_t window_calls = 0;
+            stats totals;
+        };
+
+        mutable std::mutex control_;
+        std::unordered_map<key, history, key_hash> histories_;
+        std::atomic<uint64_t> calls_ = 0;
+        std::atomic<uint64_t> retries_ = 0;
+        std::atomic<bool> enabled_ = true;
+
+    public:
+        // the out buffer size expected to hold the next reply of this method, zero if nothing is known yet
+        size_t predict(interface_ordinal interface_id, method method_id) const;
+
+        // reply_size is the size the transport reported, retried is true if the first attempt was too small
+        void record(interface_ordinal interface_id, method method_id, size_t reply_size, bool retried);
+
+        stats get_stats() const
+        {
+            return {calls_.load(std::memory_order_relaxed), retries_.load(std::memory_order_relaxed)};
+        }
+        stats get_stats(interface_ordinal interface_id, method method_id) const;
+        double get_retry_rate() const { return get_stats().get_retry_rate(); }
+
+        void reset();
+
+        // a disabled predictor keeps its statistics but never grows the buffer, useful to measure what it saves
+        void set_enabled(bool enabled) { enabled_ = enabled; }
+        bool is_enabled() const { return enabled_; }
+
+        // runs the two phase protocol for any transport that speaks it, call is int(std::vector<char>& out_buf,
+        // size_t& data_out_sz) and makes one crossing.  It returns TRANSPORT_ERROR if the crossing itself failed, else
+        // the error code of the call with data_out_sz set to the size of the reply.  The buffer is grown to the
+        // prediction first and is trimmed to the reply on the way out
+        template<class CALL>
+        int send(interface_ordinal interface_id, method method_id, std::vector<char>& out_buf, CALL&& call)
+        {
+            auto predicted = predict(interface_id, method_id);
+            if (predicted > out_buf.size())
+                out_buf.resize(predicted);
+
+            size_t data_out_sz = 0;
+            int err_code = call(out_buf, data_out_sz);
+            if (err_code == rpc::error::TRANSPORT_ERROR())
+                return err_code;
+
+            bool retried = false;
+            if (err_code == rpc::error::NEED_MORE_MEMORY())
+            {
+                // data too small reallocate memory and try again
+                retried = true;
+                out_buf.resize(data_out_sz);
+                err_code = call(out_buf, data_out_sz);
+                if (err_code == rpc::error::TRANSPORT_ERROR())
+                    return err_code;
+            }
+            record(interface_id, method_id, data_out_sz, retried);
+
+            // out buffers may come from a pool so they can carry stale bytes past the reply, trim them off
+            if (data_out_sz <= out_buf.size())
+                out_buf.resize(data_out_sz);
+            return err_code;
+        }
+    };
+}
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstring>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <type_traits>
+#include <vector>
 #include <unordered_map>
 #include <mutex>
 #include <assert.h>
@@ -11,6 +17,7 @@
 
 #include <rpc/types.h>
 #include <rpc/error_codes.h>
+#include <rpc/base64.h>
 
 namespace rpc
 {
@@ -20,12 +27,47 @@ namespace rpc
         yas_binary = 1,
         yas_compressed_binary = 2,
         // yas_text = 4,     //not really needed
-        yas_json = 8 // we may have different json parsers that have a better implementation e.g. glaze
+        yas_json = 8, // we may have different json parsers that have a better implementation e.g. glaze
         // protocol_buffers = 16,
         // flat_buffers = 32,
         // mpi = 64
+        // only valid between zones that share an address space, the in buffer is a tuple of references to the
+        // callers arguments and out parameters are written straight back through it
+        direct = 128,
+        // the native layout in rpc/flat.h that the receiver reads in place, both ends must share endianness
+        flat = 256,
+        // the same text as yas_json_blocks written and read by the generated codec in rpc/json.h rather than a yas
+        // archive
+        json = 512,
+        // yas binary in a frame from rpc/lz.h, compressed when it is at least lz::get_threshold() bytes
+        yas_lz = 1024,
+        // yas_compressed_binary with the vectors and arrays of plain numbers that rpc::pod_block handles written as one
+        // raw block rather than value by value
+        yas_compressed_blocks = 2048,
+        // yas_json with the byte vectors and arrays that rpc::pod_block handles written as base64 strings
+        yas_json_blocks = 4096
     };
 
+    // the encodings a service proxy can send, direct is further limited to transports that share an address space
+    inline bool is_supported_encoding(encoding enc)
+    {
+        switch (enc)
+        {
+        case encoding::enc_default:
+        case encoding::yas_binary:
+        case encoding::yas_compressed_binary:
+        case encoding::yas_json:
+        case encoding::direct:
+        case encoding::flat:
+        case encoding::json:
+        case encoding::yas_lz:
+        case encoding::yas_compressed_blocks:
+        case encoding::yas_json_blocks:
+            return true;
+        }
+        return false;
+    }
+
     // note a serialiser may support more than one encoding
     namespace serialiser
     {
@@ -127,14 +169,129 @@ namespace rpc
         return OutputBlob(yas_buffer.data.get(), yas_buffer.data.get() + yas_buffer.size);
     }
 
+    // yas binary writes a fixed size value as its bytes, so a parameter set made only of them has a size known at
+    // compile time
+    template<typename... Ts> struct yas_fixed_size
+    {
+        static constexpr bool known
+            = ((std::is_arithmetic<std::decay_t<Ts>>::value || std::is_enum<std::decay_t<Ts>>::value) && ...);
+        static constexpr size_t value = (sizeof(std::decay_t<Ts>) + ... + 0);
+    };
+
+    // grows buffer once to fit what a yas save of mapping with these flags will append to it, Ts are the types of the
+    // values in mapping.  Compacted and json output depends on the values so those are measured with a count stream
+    template<std::size_t Flags, typename... Ts, typename Mapping>
+    void reserve_yas(std::vector<char>& buffer, const Mapping& mapping)
+    {
+        if constexpr (!(Flags & (::yas::compacted | ::yas::json)) && yas_fixed_size<Ts...>::known)
+        {
+            buffer.reserve(buffer.size() + yas_fixed_size<Ts...>::value);
+        }
+        else
+        {
+            ::yas::count_ostream counter;
+            ::yas::save<Flags>(counter, mapping);
+            buffer.reserve(buffer.size() + counter.total_size);
+        }
+    }
+
+    // a std::vector or std::array of plain numbers passed as a parameter, yas writes these value by value in compacted
+    // and json archives.  The yas_compressed_blocks encoding has the raw bytes written as a string is and
+    // yas_json_blocks has single byte elements written as base64, every other encoding is left to yas so their wire
+    // layout is unchanged
+    template<class Container> class pod_block
+    {
+        using value_type = typename std::remove_const_t<Container>::value_type;
+        static_assert(std::is_arithmetic<value_type>::value && !std::is_same<value_type, bool>::value,
+            "a pod_block holds plain numbers");
+
+        Container& container_;
+        encoding enc_;
+        // reserve_yas saves the mapping once to measure it so the base64 is only built the first time
+        mutable std::string block_;
+        mutable bool built_ = false;
+
+        bool as_block() const
+        {
+            return enc_ == encoding::yas_compressed_blocks
+                   || (enc_ == encoding::yas_json_blocks && sizeof(value_type) == 1);
+        }
+
+        template<class T, class Allocator> static bool fit(std::vector<T, Allocator>& container, size_t count)
+        {
+            container.resize(count);
+            return true;
+        }
+        template<class T, size_t N> static bool fit(std::array<T, N>&, size_t count) { return count == N; }
+
+    public:
+        pod_block(Container& container, encoding enc)
+            : container_(container)
+            , enc_(enc)
+        {
+        }
+
+        template<typename Ar> void save(Ar& ar) const
+        {
+            if (!as_block())
+            {
+                ar& container_;
+                return;
+            }
+            auto size = container_.size() * sizeof(value_type);
+            if (enc_ == encoding::yas_compressed_blocks)
+            {
+                // the same layout as a string, written straight from the container
+                ar& std::string_view((const char*)container_.data(), size);
+                return;
+            }
+            if (!built_)
+            {
+                base64::encode(container_.data(), size, block_);
+                built_ = true;
+            }
+            ar& block_;
+        }
+
+        template<typename Ar> void load(Ar& ar)
+        {
+            if (!as_block())
+            {
+                ar& container_;
+                return;
+            }
+            ar& block_;
+            size_t size = block_.size();
+            if (enc_ == encoding::yas_json_blocks && !base64::decoded_size(block_.data(), block_.size(), size))
+                throw std::runtime_error("pod_block is not base64");
+            if (size % sizeof(value_type) || !fit(container_, size / sizeof(value_type)))
+                throw std::runtime_error("pod_block does not fit its container");
+            if (!size)
+                return;
+            if (enc_ == encoding::yas_json_blocks)
+            {
+                if (!base64::decode(block_.data(), block_.size(), container_.data()))
+                    throw std::runtime_error("pod_block is not base64");
+            }
+            else
+                memcpy(container_.data(), block_.data(), size);
+        }
+    };
+
+    template<class Container> pod_block<Container> make_pod_block(Container& container, encoding enc)
+    {
+        return pod_block<Container>(container, enc);
+    }
+
+    // pod_block only applies to parameters so the block encodings write whole objects as their yas archives do
     template<typename T, class OutputBlob = std::vector<std::uint8_t>> OutputBlob serialise(const T& obj, encoding enc)
     {
-        if (enc == encoding::yas_json)
-            return to_yas_json(obj);
+        if (enc == encoding::yas_json || enc == encoding::yas_json_blocks)
+            return to_yas_json<T, OutputBlob>(obj);
         if (enc == encoding::enc_default || enc == encoding::yas_binary)
-            return to_yas_binary(obj);
-        if (enc == encoding::yas_compressed_binary)
-            return to_compressed_yas_binary(obj);
+            return to_yas_binary<T, OutputBlob>(obj);
+        if (enc == encoding::yas_compressed_binary || enc == encoding::yas_compressed_blocks)
+            return to_compressed_yas_binary<T, OutputBlob>(obj);
         throw std::runtime_error("invalid encoding type");
     }
 
@@ -207,11 +364,11 @@ namespace rpc
 
     template<typename T> std::string deserialise(encoding enc, const span& data, const T& obj)
     {
-        if (enc == encoding::yas_json)
+        if (enc == encoding::yas_json || enc == encoding::yas_json_blocks)
             return from_yas_json(data, obj);
         if (enc == encoding::enc_default || enc == encoding::yas_binary)
             return from_yas_binary(data, obj);
-        if (enc == encoding::yas_compressed_binary)
+        if (enc == encoding::yas_compressed_binary || enc == encoding::yas_compressed_blocks)
             return from_yas_compressed_binary(data, obj);
         return "invalid encoding type";
     }
@@ -21,6 +21,9 @@
 #include <rpc/marshaller.h>
 #include <rpc/remote_pointer.h>
 #include <rpc/casting_interface.h>
+#include <rpc/sharded_map.h>
+#include <rpc/object_slot_table.h>
+#include <rpc/rcu_map.h>
 #ifdef USE_RPC_TELEMETRY
 #include <rpc/telemetry/i_telemetry_service.h>
 #endif
@@ -31,7 +34,9 @@ namespace rpc
     class object_stub;
     class service;
     class child_service;
+    class object_proxy;
     class service_proxy;
+    class executor;
     struct current_service_tracker;
 
     const object dummy_object_id = {std::numeric_limits<uint64_t>::max()};
@@ -73,14 +78,29 @@ namespace rpc
         zone zone_id_ = {0};
         mutable std::atomic<uint64_t> object_id_generator = 0;
 
-        // map object_id's to stubs
-        mutable std::mutex stub_control;
-        std::unordered_map<object, rpc::weak_ptr<object_stub>> stubs;
+        // map object_id's to stubs, sharded so that lookups on the call path only take a shared lock
+        sharded_map<object, rpc::weak_ptr<object_stub>> stubs;
         std::unordered_map<rpc::interface_ordinal,
             std::shared_ptr<std::function<rpc::shared_ptr<rpc::i_interface_stub>(const rpc::shared_ptr<rpc::i_interface_stub>&)>>>
             stub_factories;
-        // map wrapped objects pointers to stubs
-        std::map<void*, rpc::weak_ptr<object_stub>> wrapped_object_to_stub;
+        // the interfaces marked [strand] that have a stub factory, an object implementing any of them gets a strand
+        std::vector<rpc::interface_ordinal> strand_interfaces_;
+        // map wrapped objects pointers to stubs, the shard lock for a pointer also serialises the creation and
+        // destruction of its stub
+        sharded_map<void*, rpc::weak_ptr<object_stub>> wrapped_object_to_stub;
+        // when set object ids are slot table handles and stubs are looked up here instead of in stubs
+        std::unique_ptr<object_slot_table> object_slots_;
+        // when set releases passing through this zone are absorbed as credit by its own proxy to the object
+        bool indirect_reference_counting_ = false;
+        // when set every object gets a strand, otherwise only objects with a [strand] interface
+        bool strand_all_objects_ = false;
+        std::shared_ptr<executor> strand_executor_;
+        // when set inbound calls to objects in this zone run on it rather than on the calling thread
+        std::shared_ptr<executor> dispatcher_;
+        // executors whose last owner let go of them on one of their own threads, they cannot join themselves so this
+        // zone joins them when it goes
+        mutable std::mutex retired_executors_control_;
+        std::vector<std::shared_ptr<executor>> retired_executors_;
         std::string name_;
 
         struct zone_route
@@ -95,12 +115,39 @@ namespace rpc
             }
         };
 
+        // lookups in other_zones are lock free, zone_control only serialises the compound find then add sequences
         mutable std::mutex zone_control;
-        std::map<zone_route, rpc::weak_ptr<service_proxy>> other_zones;
+        rcu_map<zone_route, rpc::weak_ptr<service_proxy>> other_zones;
         std::list<std::shared_ptr<service_logger>> service_loggers;
 
         rpc::shared_ptr<casting_interface> get_castable_interface(object object_id, interface_ordinal interface_id);
 
+        void register_stub(object object_id, const rpc::weak_ptr<object_stub>& stub);
+        void deregister_stub(object object_id);
+        bool find_stub(object object_id, rpc::weak_ptr<object_stub>& stub) const;
+
+        // the route for this exact destination and caller pair
+        rpc::shared_ptr<service_proxy> find_route(destination_zone destination_zone_id, caller_zone caller_zone_id) const;
+        // the first route to the destination for any caller, the fallback when there is no caller specific route
+        rpc::shared_ptr<service_proxy> find_any_route(destination_zone destination_zone_id) const;
+
+        // unpacks a call_batch and sends each of its calls to this zone in turn
+        int send_batch(uint64_t protocol_version,
+            encoding encoding,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_);
+
+        // drops one reference on a stub in this zone, tearing it down when it was the last
+        uint64_t release_object(object object_id);
+        // takes a stub whose count has reached zero out of the registries and then lets go of its object
+        void retire_stub(const rpc::shared_ptr<rpc::object_stub>& stub);
+
+        // true if a reference absorbed by this zone can be lent out in place of an add_ref to the owning zone
+        bool take_reference_credit(const rpc::shared_ptr<object_proxy>& object_proxy) const;
+
         template<class T>
         interface_descriptor proxy_bind_in_param(
             uint64_t protocol_version, const shared_ptr<T>& iface, shared_ptr<object_stub>& stub);
@@ -131,6 +178,31 @@ namespace rpc
         static caller_zone get_current_caller();
 
         object generate_new_object_id() const;
+        // switches object ids to dense (generation, slot) handles for O(1) stub lookup, note this function is not
+        // thread safe!  Use it before any objects are bound to the service
+        void enable_dense_object_ids();
+        bool has_dense_object_ids() const { return object_slots_ != nullptr; }
+        // lets this zone absorb releases for objects in an adjacent zone that it holds a proxy to and lend them out again
+        // when it passes the object on, so forwarding an interface does not need an add_ref round trip to the owner.
+        // The owner is only told when the credit runs out or this zone's proxy dies.  Not thread safe, use it before
+        // the service is connected to other zones
+        void enable_indirect_reference_counting() { indirect_reference_counting_ = true; }
+        bool has_indirect_reference_counting() const { return indirect_reference_counting_; }
+        // calls to an object with a strand run one at a time so its implementation needs no locks, different objects
+        // still run in parallel.  Queued calls are run on ex, or by the thread that finds the object idle when ex is
+        // null.  Not thread safe, use it before any objects are bound to the service
+        void configure_strands(bool all_objects, std::shared_ptr<executor> ex = nullptr);
+        bool has_strands_for_all_objects() const { return strand_all_objects_; }
+        const std::shared_ptr<executor>& get_strand_executor() const { return strand_executor_; }
+        // runs inbound calls to objects in this zone on ex, for instance a work_stealing_executor so that they spread
+        // over idle cores rather than holding up the callers thread.  Calls routed on to other zones, casts and
+        // reference counting still run on the calling thread.  Not thread safe, use it before the zone is connected
+        void set_dispatcher(std::shared_ptr<executor> ex) { dispatcher_ = std::move(ex); }
+        const std::shared_ptr<executor>& get_dispatcher() const { return dispatcher_; }
+        // takes an executor from an owner running on one of its threads, its threads are joined when this service is
+        // destroyed
+        void retire_executor(std::shared_ptr<executor> ex);
+        size_t get_retired_executor_count() const;
         std::string get_name() const { return name_; }
 
         virtual bool check_is_empty() const;
@@ -147,6 +219,8 @@ namespace rpc
             caller_channel_zone caller_channel_zone_id,
             caller_zone caller_zone_id,
             rpc::proxy_base* base);
+        // returns an empty descriptor and a null stub if no object id is left for a new stub, callers report that as
+        // OUT_OF_MEMORY
         interface_descriptor get_proxy_stub_descriptor(uint64_t protocol_version,
             caller_channel_zone caller_channel_zone_id,
             caller_zone caller_zone_id,
@@ -169,6 +243,18 @@ namespace rpc
             size_t in_size_,
             const char* in_buf_,
             std::vector<char>& out_buf_) override;
+        // calls for other zones are posted on so that the transport can queue them
+        int post(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_) override;
         int try_cast(uint64_t protocol_version,
             destination_zone destination_zone_id,
             object object_id,
@@ -184,6 +270,30 @@ namespace rpc
             destination_zone destination_zone_id,
             object object_id,
             caller_zone caller_zone_id) override;
+        // releases for other zones are sent on as one batch, except where this zone absorbs them as credit
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override;
+
+#ifdef BUILD_COROUTINE
+        task<int> async_send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override;
+        task<int> async_try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override;
+#endif
 
         uint64_t release_local_stub(const rpc::shared_ptr<rpc::object_stub>& stub);
 
@@ -246,6 +356,13 @@ namespace rpc
                         factory,
                         false,
                         stub);
+                    if (!stub)
+                    {
+                        new_service_proxy->release_external_ref();
+                        remove_zone_proxy_if_not_used(
+                            new_service_proxy->get_destination_zone_id(), new_service_proxy->get_caller_zone_id());
+                        return rpc::error::OUT_OF_MEMORY();
+                    }
                 }
             }
 
@@ -283,7 +400,10 @@ namespace rpc
         // note this function is not thread safe!  Use it before using the service class for normal operation
         void add_interface_stub_factory(std::function<interface_ordinal(uint8_t)> id_getter,
             std::shared_ptr<std::function<rpc::shared_ptr<rpc::i_interface_stub>(const rpc::shared_ptr<rpc::i_interface_stub>&)>>
-                factory);
+                factory,
+            bool requires_strand = false);
+        // whether a newly bound object gets a strand, decided once as the object is registered
+        bool needs_strand(rpc::casting_interface* iface, const rpc::shared_ptr<rpc::i_interface_stub>& first) const;
 
         // note this is not thread safe and should only be used on setup
         void add_service_logger(const std::shared_ptr<service_logger>& logger) { service_loggers.push_back(logger); }
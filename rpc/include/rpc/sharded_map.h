@@ -0,0 +1,105 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace rpc
+{
+    // a hash map split into independently locked shards, lookups take a shared lock on a single shard so readers
+    // never block each other and writers only block readers of the same shard
+    template<class KEY, class VALUE, size_t SHARD_COUNT = 16> class sharded_map
+    {
+        static_assert(SHARD_COUNT && !(SHARD_COUNT & (SHARD_COUNT - 1)), "SHARD_COUNT must be a power of two");
+
+        struct alignas(64) shard
+        {
+            mutable std::shared_mutex control;
+            std::unordered_map<KEY, VALUE> map;
+        };
+        std::array<shard, SHARD_COUNT> shards_;
+
+        // object ids are sequential and pointers are aligned so mix the hash before picking a shard
+        static size_t shard_index(const KEY& key)
+        {
+            uint64_t h = std::hash<KEY>{}(key);
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return (size_t)(h & (SHARD_COUNT - 1));
+        }
+
+    public:
+        bool find(const KEY& key, VALUE& value) const
+        {
+            auto& s = shards_[shard_index(key)];
+            std::shared_lock g(s.control);
+            auto it = s.map.find(key);
+            if (it == s.map.end())
+                return false;
+            value = it->second;
+            return true;
+        }
+
+        void insert_or_assign(const KEY& key, const VALUE& value)
+        {
+            auto& s = shards_[shard_index(key)];
+            std::unique_lock g(s.control);
+            s.map.insert_or_assign(key, value);
+        }
+
+        bool erase(const KEY& key)
+        {
+            auto& s = shards_[shard_index(key)];
+            std::unique_lock g(s.control);
+            return s.map.erase(key) != 0;
+        }
+
+        // runs fn with exclusive access to the shard that owns key, use this for find or create sequences that must
+        // be atomic, fn must not call back into this map for a key that may live in the same shard
+        template<class FN> auto with_exclusive(const KEY& key, FN&& fn)
+        {
+            auto& s = shards_[shard_index(key)];
+            std::unique_lock g(s.control);
+            return fn(s.map);
+        }
+
+        // visits every entry one shard at a time, this is not a consistent snapshot of the whole map
+        template<class FN> void for_each(FN&& fn) const
+        {
+            for (auto& s : shards_)
+            {
+                std::shared_lock g(s.control);
+                for (const auto& item : s.map)
+                    fn(item.first, item.second);
+            }
+        }
+
+        bool empty() const
+        {
+            for (auto& s : shards_)
+            {
+                std::shared_lock g(s.control);
+                if (!s.map.empty())
+                    return false;
+            }
+            return true;
+        }
+
+        void clear()
+        {
+            for (auto& s : shards_)
+            {
+                std::unique_lock g(s.control);
+                s.map.clear();
+            }
+        }
+    };
+}
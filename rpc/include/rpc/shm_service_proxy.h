@@ -0,0 +1,138 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// a transport between zones living in different processes on the same linux host, both processes map the same posix
+// shared memory region which holds one ring per direction
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rpc/transport_channel.h>
+
+namespace rpc
+{
+    // a single producer single consumer byte ring living in shared memory, the ring data follows the region header
+    struct alignas(64) shm_ring
+    {
+        // total bytes ever published, only the producer advances it
+        alignas(64) std::atomic<uint64_t> write_pos;
+        // total bytes ever consumed, only the consumer advances it
+        alignas(64) std::atomic<uint64_t> read_pos;
+        // futex words, bumped every time data is published or space is freed
+        alignas(64) std::atomic<uint32_t> data_signal;
+        std::atomic<uint32_t> consumer_waiting;
+        alignas(64) std::atomic<uint32_t> space_signal;
+        std::atomic<uint32_t> producer_waiting;
+    };
+
+    struct shm_region_header
+    {
+        std::atomic<uint64_t> magic;
+        uint64_t version;
+        uint64_t ring_capacity;
+        // set by either side when it goes away so the other side stops waiting on it
+        std::atomic<uint32_t> closed;
+        // ring 0 carries parent to child traffic, ring 1 child to parent
+        shm_ring rings[2];
+    };
+
+    // one end of a shared memory connection, messages are framed into the rings and a receiver thread per process
+    // drains the inbound ring
+    class shm_channel : public transport_channel
+    {
+    public:
+        static constexpr size_t default_ring_capacity = 1 << 20;
+
+    private:
+        std::string name_;
+        int fd_ = -1;
+        void* mapping_ = nullptr;
+        size_t mapping_size_ = 0;
+        bool is_owner_ = false;
+
+        shm_region_header* region_ = nullptr;
+        shm_ring* outbound_ = nullptr;
+        char* outbound_data_ = nullptr;
+        shm_ring* inbound_ = nullptr;
+        char* inbound_data_ = nullptr;
+        uint64_t capacity_ = 0;
+
+        // the rings are single producer, this lets any number of local threads take turns at being that producer
+        std::mutex write_control_;
+        std::atomic<uint32_t> write_spin_limit_ = 256;
+        std::atomic<uint32_t> read_spin_limit_ = 256;
+
+        shm_channel() = default;
+
+        bool map_region(const std::string& name, bool create, size_t ring_capacity);
+        // blocks until a message arrives, returns false once the channel is closed
+        bool read_message(transport_message& header, std::vector<char>& payload);
+        void receive_loop();
+
+    protected:
+        // blocks until the ring has room and then publishes the message, fails if either side has closed
+        int write_message(const transport_message& header, const char* payload) override;
+        void start_receiver() override;
+        void on_close() override;
+        bool is_peer_closed() const override;
+
+    public:
+        ~shm_channel() override;
+
+        // creates a new shared memory region for a child process to open, the region is unlinked when this side goes
+        static std::shared_ptr<shm_channel> create(const std::string& name, size_t ring_capacity = default_ring_capacity);
+        // opens a region created by the parent process
+        static std::shared_ptr<shm_channel> open(const std::string& name);
+
+        size_t get_max_payload_size() const override;
+
+        // the child process entry point, opens the region, waits for the parent to connect, builds the child zone
+        // with fn and then services calls until the parent disconnects
+        template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+        static int run_child_zone(const char* name,
+            const std::string& shm_name,
+            std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+                rpc::shared_ptr<CHILD_INTERFACE>&,
+                const rpc::shared_ptr<rpc::child_service>&)> fn)
+        {
+            auto channel = open(shm_name);
+            if (!channel)
+                return rpc::error::TRANSPORT_ERROR();
+
+            // shared with the connect handler which may still be running on a worker when the parent goes away
+            struct zone_holder
+            {
+                std::mutex control;
+                rpc::shared_ptr<rpc::child_service> child_service;
+            };
+            auto holder = std::make_shared<zone_holder>();
+            channel->set_connect_handler(make_child_zone_handler<PARENT_INTERFACE, CHILD_INTERFACE>(name,
+                channel,
+                fn,
+                [holder](const rpc::shared_ptr<rpc::child_service>& child_service)
+                {
+                    std::lock_guard g(holder->control);
+                    holder->child_service = child_service;
+                }));
+            channel->start();
+            channel->wait_for_close();
+
+            rpc::shared_ptr<rpc::child_service> child_service;
+            {
+                std::lock_guard g(holder->control);
+                child_service = std::move(holder->child_service);
+            }
+            return rpc::error::OK();
+        }
+    };
+
+    // the parent passes an shm_channel to service::connect_to_zone, the child zone is built by
+    // shm_channel::run_child_zone
+    using shm_service_proxy = transport_service_proxy;
+}
@@ -0,0 +1,298 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// runs a child zone in process behind the same marshalling contract as an sgx enclave so that enclave style traffic
+// can be profiled without the sdk.  Every crossing copies its [in] buffer to the far side and its [out] buffer back,
+// replies that do not fit the callers buffer are parked on the far side and answered with NEED_MORE_MEMORY, and an
+// optional latency is paid on each crossing in either direction
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <rpc/proxy.h>
+#include <rpc/reply_size_predictor.h>
+#include <rpc/service.h>
+
+namespace rpc
+{
+    struct simulated_boundary_config
+    {
+        // busy waited on every crossing, a real enclave transition costs several microseconds
+        std::chrono::nanoseconds crossing_latency = std::chrono::nanoseconds(0);
+        // turn off to measure what the NEED_MORE_MEMORY retries cost without reply size prediction
+        bool predict_reply_sizes = true;
+    };
+
+    struct simulated_boundary_stats
+    {
+        uint64_t crossings = 0;
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+        // replies currently waiting on the far side for a caller to come back with a larger buffer
+        uint64_t parked_replies = 0;
+    };
+
+    // the edge between a parent zone and its simulated enclave, shared by the proxies on both sides
+    class simulated_boundary
+    {
+        simulated_boundary_config config_;
+        std::atomic<uint64_t> crossings_ = 0;
+        std::atomic<uint64_t> bytes_in_ = 0;
+        std::atomic<uint64_t> bytes_out_ = 0;
+
+        // stands in for sgx_is_within_enclave, the caller only ever holds the address of a parked reply as a token
+        // and a token that this boundary did not hand out is rejected
+        mutable std::mutex parked_control_;
+        std::unordered_map<const retry_buffer*, std::unique_ptr<retry_buffer>> parked_;
+
+        // replies coming back from the child and from the parent
+        reply_size_predictor child_reply_sizes_;
+        reply_size_predictor parent_reply_sizes_;
+
+    public:
+        explicit simulated_boundary(const simulated_boundary_config& config = {});
+        simulated_boundary(const simulated_boundary&) = delete;
+        simulated_boundary& operator=(const simulated_boundary&) = delete;
+
+        const simulated_boundary_config& get_config() const { return config_; }
+        simulated_boundary_stats get_stats() const;
+        reply_size_predictor& get_child_reply_sizes() { return child_reply_sizes_; }
+        reply_size_predictor& get_parent_reply_sizes() { return parent_reply_sizes_; }
+
+        // pays for one crossing
+        void cross();
+
+        // the far side of call_enclave and call_host, retry_token must point at storage owned by the caller that
+        // starts out null and is passed back unchanged when the call is repeated after NEED_MORE_MEMORY
+        int call(service& target,
+            uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t sz_in,
+            const char* data_in,
+            size_t sz_out,
+            char* data_out,
+            size_t* data_out_sz,
+            void** retry_token);
+
+        // the near side, runs the two phase protocol through call with the predictor for the direction of travel
+        int send(const rpc::shared_ptr<service>& target,
+            reply_size_predictor& reply_sizes,
+            uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_);
+    };
+
+    // this is an equivelent to an enclave looking at its host
+    class simulated_boundary_parent_proxy : public service_proxy
+    {
+        rpc::weak_ptr<service> parent_service_;
+        std::shared_ptr<simulated_boundary> boundary_;
+
+        simulated_boundary_parent_proxy(const char* name,
+            destination_zone parent_zone_id,
+            const rpc::shared_ptr<child_service>& child_svc,
+            const rpc::shared_ptr<service>& parent_svc,
+            std::shared_ptr<simulated_boundary> boundary);
+        simulated_boundary_parent_proxy(const simulated_boundary_parent_proxy& other) = default;
+
+        rpc::shared_ptr<service_proxy> clone() override;
+
+        int send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override;
+        int try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override;
+        uint64_t add_ref(uint64_t protocol_version,
+            destination_channel_zone destination_channel_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            add_ref_options build_out_param_channel) override;
+        uint64_t release(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_zone caller_zone_id) override;
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override;
+
+        friend rpc::child_service;
+
+    public:
+        static rpc::shared_ptr<simulated_boundary_parent_proxy> create(const char* name,
+            destination_zone parent_zone_id,
+            const rpc::shared_ptr<child_service>& child_svc,
+            const rpc::shared_ptr<service>& parent_svc,
+            std::shared_ptr<simulated_boundary> boundary);
+
+        virtual ~simulated_boundary_parent_proxy() = default;
+    };
+
+    // this is an equivelent to an host looking at its enclave, the child zone is built in process with fn
+    template<class CHILD_PTR_TYPE, class PARENT_PTR_TYPE> class simulated_boundary_service_proxy : public service_proxy
+    {
+        rpc::shared_ptr<child_service> child_service_;
+        std::shared_ptr<simulated_boundary> boundary_;
+
+        typedef std::function<int(
+            const rpc::shared_ptr<PARENT_PTR_TYPE>&, rpc::shared_ptr<CHILD_PTR_TYPE>&, const rpc::shared_ptr<child_service>&)>
+            connect_fn;
+        connect_fn fn_;
+
+        friend rpc::service;
+
+        simulated_boundary_service_proxy(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& parent_svc,
+            connect_fn fn,
+            std::shared_ptr<simulated_boundary> boundary)
+            : service_proxy(name, destination_zone_id, parent_svc)
+            , boundary_(boundary ? std::move(boundary) : std::make_shared<simulated_boundary>())
+            , fn_(fn)
+        {
+        }
+        simulated_boundary_service_proxy(const simulated_boundary_service_proxy& other) = default;
+
+        rpc::shared_ptr<service_proxy> clone() override
+        {
+            return rpc::shared_ptr<service_proxy>(new simulated_boundary_service_proxy(*this));
+        }
+
+        static rpc::shared_ptr<simulated_boundary_service_proxy> create(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& svc,
+            connect_fn fn,
+            std::shared_ptr<simulated_boundary> boundary = nullptr)
+        {
+            return rpc::shared_ptr<simulated_boundary_service_proxy>(
+                new simulated_boundary_service_proxy(name, destination_zone_id, svc, fn, std::move(boundary)));
+        }
+
+        int connect(rpc::interface_descriptor input_descr, rpc::interface_descriptor& output_descr) override
+        {
+            // the initialisation is an ecall of its own
+            boundary_->cross();
+            return rpc::child_service::create_child_zone<rpc::simulated_boundary_parent_proxy>(get_name().c_str(),
+                get_destination_zone_id().as_zone(),
+                get_zone_id().as_destination(),
+                input_descr,
+                output_descr,
+                fn_,
+                child_service_,
+                get_operating_zone_service(),
+                boundary_);
+        }
+
+        int send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override
+        {
+            if (destination_zone_id != get_destination_zone_id())
+                return rpc::error::ZONE_NOT_SUPPORTED();
+            return boundary_->send(child_service_,
+                boundary_->get_child_reply_sizes(),
+                protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+        }
+        int try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override
+        {
+            boundary_->cross();
+            return child_service_->try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+        }
+        uint64_t add_ref(uint64_t protocol_version,
+            destination_channel_zone destination_channel_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            add_ref_options build_out_param_channel) override
+        {
+            boundary_->cross();
+            return child_service_->add_ref(protocol_version,
+                destination_channel_zone_id,
+                destination_zone_id,
+                object_id,
+                caller_channel_zone_id,
+                caller_zone_id,
+                build_out_param_channel);
+        }
+        uint64_t release(
+            uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id) override
+        {
+            boundary_->cross();
+            return child_service_->release(protocol_version, destination_zone_id, object_id, caller_zone_id);
+        }
+        // the whole batch is one ecall
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override
+        {
+            boundary_->cross();
+            return child_service_->release_batch(protocol_version, destination_zone_id, caller_zone_id, releases);
+        }
+
+    public:
+        virtual ~simulated_boundary_service_proxy() = default;
+
+        simulated_boundary& get_boundary() const { return *boundary_; }
+    };
+}
@@ -2,12 +2,13 @@
 
 #include <string>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 #include <mutex>
 #include <rpc/assert.h>
 #include <atomic>
 
 #include <rpc/types.h>
+#include <rpc/executor.h>
 #include <rpc/marshaller.h>
 #include <rpc/remote_pointer.h>
 #include <rpc/casting_interface.h>
@@ -27,14 +28,22 @@ namespace rpc
     class object_stub
     {
         object id_ = {0};
-        // stubs have stong pointers
+        // stubs have stong pointers, an object only exposes a handful of interfaces so a flat list beats a hash map
+        using interface_list = std::vector<std::pair<interface_ordinal, shared_ptr<i_interface_stub>>>;
+        // the current list is immutable once published so that call can scan it without locking, adding an interface
+        // publishes a copy.  Superseded lists are kept until the object stub dies as a reader may still be scanning them
+        std::atomic<const interface_list*> stub_map = nullptr;
+        std::vector<std::unique_ptr<const interface_list>> stub_map_versions;
+        // serialises writers only
         mutable std::mutex map_control;
-        std::unordered_map<interface_ordinal, shared_ptr<i_interface_stub>> stub_map;
         shared_ptr<object_stub> p_this;
         std::atomic<uint64_t> reference_count = 0;
         service& zone_;
+        // set once before the stub is registered and never changed, so every call to the object runs on it or none does
+        std::unique_ptr<strand> strand_;
 
         void add_interface(const shared_ptr<i_interface_stub>& iface);
+        const shared_ptr<i_interface_stub>* find_interface(interface_ordinal interface_id) const;
         friend service; // so that it can call add_interface
 
     public:
@@ -46,8 +55,11 @@ namespace rpc
 
         // this is called once the lifetime management needs to be activated
         void on_added_to_zone(shared_ptr<object_stub> stub) { p_this = stub; }
+        // only called by service while the stub is being created
+        void set_strand(std::unique_ptr<strand> object_strand) { strand_ = std::move(object_strand); }
 
         service& get_zone() const { return zone_; }
+        strand* get_strand() const { return strand_.get(); }
 
         int call(uint64_t protocol_version,
             rpc::encoding enc,
@@ -58,11 +70,24 @@ namespace rpc
             size_t in_size_,
             const char* in_buf_,
             std::vector<char>& out_buf_);
+#ifdef BUILD_COROUTINE
+        task<int> async_call(uint64_t protocol_version,
+            rpc::encoding enc,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_);
+#endif
         int try_cast(interface_ordinal interface_id);
 
         shared_ptr<i_interface_stub> get_interface(interface_ordinal interface_id);
 
         uint64_t add_ref();
+        // takes a reference unless the count has already reached zero, once it has the stub is leaving the zone
+        bool try_add_ref();
         uint64_t release();
         void release_from_service();
     };
@@ -93,7 +118,24 @@ namespace rpc
             const char* in_buf_,
             std::vector<char>& out_buf_)
             = 0;
+#ifdef BUILD_COROUTINE
+        // stubs generated with coroutine support override this to await the implementation
+        virtual task<int> async_call(uint64_t protocol_version,
+            rpc::encoding enc,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_)
+        {
+            co_return call(
+                protocol_version, enc, caller_channel_zone_id, caller_zone_id, method_id, in_size_, in_buf_, out_buf_);
+        }
+#endif
         virtual int cast(interface_ordinal interface_id, shared_ptr<i_interface_stub>& new_stub) = 0;
+        // true for interfaces marked [strand] in the idl, calls to their object are then run one at a time
+        virtual bool requires_strand() const { return false; }
         virtual weak_ptr<object_stub> get_object_stub() const = 0;
         virtual void* get_pointer() const = 0;
         virtual shared_ptr<casting_interface> get_castable_interface() const = 0;
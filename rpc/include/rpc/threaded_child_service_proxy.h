@@ -0,0 +1,238 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// a child zone in this process that owns its own threads, every inbound call is posted to the zones mailbox and the
+// caller blocks until one of the zones threads has run it.  With one thread the zone behaves as an actor so its state
+// needs no locks, with more the zone can be spread over several cores that may be pinned
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <rpc/basic_service_proxies.h>
+#include <rpc/executor.h>
+#include <rpc/proxy.h>
+#include <rpc/service.h>
+
+namespace rpc
+{
+    template<class CHILD_PTR_TYPE, class PARENT_PTR_TYPE> class threaded_child_service_proxy : public service_proxy
+    {
+        rpc::shared_ptr<child_service> child_service_;
+        std::shared_ptr<thread_pool_executor> executor_;
+
+        typedef std::function<int(
+            const rpc::shared_ptr<PARENT_PTR_TYPE>&, rpc::shared_ptr<CHILD_PTR_TYPE>&, const rpc::shared_ptr<child_service>&)>
+            connect_fn;
+        connect_fn fn_;
+
+        friend rpc::service;
+
+        threaded_child_service_proxy(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& parent_svc,
+            connect_fn fn,
+            const thread_pool_config& config)
+            : service_proxy(name, destination_zone_id, parent_svc)
+            , executor_(std::make_shared<thread_pool_executor>(config))
+            , fn_(fn)
+        {
+            // both zones share this address space and the caller waits for the call so nothing needs serialising
+            set_shares_address_space();
+            set_encoding(encoding::direct);
+        }
+        threaded_child_service_proxy(const threaded_child_service_proxy& other) = default;
+
+        rpc::shared_ptr<service_proxy> clone() override
+        {
+            return rpc::shared_ptr<service_proxy>(new threaded_child_service_proxy(*this));
+        }
+
+        static rpc::shared_ptr<threaded_child_service_proxy> create(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& svc,
+            connect_fn fn,
+            const thread_pool_config& config = {})
+        {
+            return rpc::shared_ptr<threaded_child_service_proxy>(
+                new threaded_child_service_proxy(name, destination_zone_id, svc, fn, config));
+        }
+
+        int connect(rpc::interface_descriptor input_descr, rpc::interface_descriptor& output_descr) override
+        {
+            // the zone is built on its own thread so that everything it creates starts life there
+            return run_on(*executor_,
+                [&]()
+                {
+                    return rpc::child_service::create_child_zone<rpc::local_service_proxy>(get_name().c_str(),
+                        get_destination_zone_id().as_zone(),
+                        get_zone_id().as_destination(),
+                        input_descr,
+                        output_descr,
+                        fn_,
+                        child_service_,
+                        get_operating_zone_service());
+                });
+        }
+
+        int send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override
+        {
+            return run_on(*executor_,
+                [&]()
+                {
+                    return child_service_->send(protocol_version,
+                        encoding,
+                        tag,
+                        caller_channel_zone_id,
+                        caller_zone_id,
+                        destination_zone_id,
+                        object_id,
+                        interface_id,
+                        method_id,
+                        in_size_,
+                        in_buf_,
+                        out_buf_);
+                });
+        }
+        // oneway calls are queued on the zones mailbox and the caller carries on, back to back posts are drained by
+        // the zones threads in one go
+        int post(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_) override
+        {
+            // an argument pack refers to the callers stack which will be gone by the time the call runs
+            if (encoding == encoding::direct)
+                return rpc::error::INCOMPATIBLE_SERIALISATION();
+
+            struct oneway_task : executor_task
+            {
+                rpc::shared_ptr<child_service> service;
+                uint64_t protocol_version;
+                rpc::encoding encoding;
+                uint64_t tag;
+                caller_channel_zone caller_channel_zone_id;
+                caller_zone caller_zone_id;
+                destination_zone destination_zone_id;
+                object object_id;
+                interface_ordinal interface_id;
+                method method_id;
+                std::vector<char> in_buf;
+            };
+            auto* task = new oneway_task();
+            task->service = child_service_;
+            task->protocol_version = protocol_version;
+            task->encoding = encoding;
+            task->tag = tag;
+            task->caller_channel_zone_id = caller_channel_zone_id;
+            task->caller_zone_id = caller_zone_id;
+            task->destination_zone_id = destination_zone_id;
+            task->object_id = object_id;
+            task->interface_id = interface_id;
+            task->method_id = method_id;
+            task->in_buf.assign(in_buf_, in_buf_ + in_size_);
+            task->run = [](executor_task* base)
+            {
+                std::unique_ptr<oneway_task> self(static_cast<oneway_task*>(base));
+                std::ignore = self->service->post(self->protocol_version,
+                    self->encoding,
+                    self->tag,
+                    self->caller_channel_zone_id,
+                    self->caller_zone_id,
+                    self->destination_zone_id,
+                    self->object_id,
+                    self->interface_id,
+                    self->method_id,
+                    self->in_buf.size(),
+                    self->in_buf.data());
+            };
+            executor_->post(task);
+            return rpc::error::OK();
+        }
+        int try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override
+        {
+            return run_on(*executor_,
+                [&]()
+                { return child_service_->try_cast(protocol_version, destination_zone_id, object_id, interface_id); });
+        }
+        uint64_t add_ref(uint64_t protocol_version,
+            destination_channel_zone destination_channel_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            add_ref_options build_out_param_channel) override
+        {
+            return run_on(*executor_,
+                [&]()
+                {
+                    return child_service_->add_ref(protocol_version,
+                        destination_channel_zone_id,
+                        destination_zone_id,
+                        object_id,
+                        caller_channel_zone_id,
+                        caller_zone_id,
+                        build_out_param_channel);
+                });
+        }
+        uint64_t release(
+            uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id) override
+        {
+            return run_on(*executor_,
+                [&]()
+                { return child_service_->release(protocol_version, destination_zone_id, object_id, caller_zone_id); });
+        }
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override
+        {
+            return run_on(*executor_,
+                [&]()
+                {
+                    return child_service_->release_batch(
+                        protocol_version, destination_zone_id, caller_zone_id, releases);
+                });
+        }
+
+    public:
+        virtual ~threaded_child_service_proxy()
+        {
+            // a proxy let go by a call running in the zone cannot join the zones threads from one of them, they are told
+            // to leave once their queue is empty and the parent zone joins them when it goes
+            if (executor_ && executor_->is_current())
+            {
+                if (executor_.use_count() == 1)
+                    executor_->stop();
+                if (auto svc = get_operating_zone_service())
+                    svc->retire_executor(std::move(executor_));
+                RPC_ASSERT(!executor_);
+            }
+        }
+
+        thread_pool_executor& get_executor() const { return *executor_; }
+    };
+}
@@ -0,0 +1,463 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// the transport independent half of a connection to a zone in another process, a concrete transport only has to move
+// whole messages in each direction
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <rpc/proxy.h>
+#include <rpc/service.h>
+
+namespace rpc
+{
+    enum class transport_message_type : uint32_t
+    {
+        connect = 1,
+        send,
+        try_cast,
+        add_ref,
+        release,
+        reply,
+        // the payload is a packed release batch
+        release_batch,
+        // a send to a [oneway] method, the receiver runs it and sends no reply
+        post
+    };
+
+    // the fixed size header that precedes every message, payload_size bytes of payload follow it and replies carry
+    // the call id of their request
+    struct transport_message
+    {
+        uint32_t payload_size = 0;
+        transport_message_type type = transport_message_type::reply;
+        uint64_t call_id = 0;
+        uint64_t protocol_version = 0;
+        uint64_t encoding = 0;
+        uint64_t tag = 0;
+        uint64_t caller_channel_zone_id = 0;
+        uint64_t caller_zone_id = 0;
+        uint64_t destination_channel_zone_id = 0;
+        uint64_t destination_zone_id = 0;
+        uint64_t object_id = 0;
+        uint64_t interface_id = 0;
+        uint64_t method_id = 0;
+        uint64_t options = 0;
+        // an int error code for send, try_cast and connect or the reference count for add_ref and release
+        uint64_t result = 0;
+    };
+
+    // outgoing calls are tagged with a call id and the caller parks until the receiver hands over the reply with the
+    // same id, so any number of threads can have calls in flight on one connection.  Incoming requests are run by a
+    // pool of workers that grows whenever every worker is busy up to a limit, past that they queue.  A worker that is
+    // itself waiting on a reply runs the queued requests meanwhile, so a call that calls back into this process never
+    // starves even when the pool is full
+    class transport_channel : public std::enable_shared_from_this<transport_channel>
+    {
+    public:
+        using connect_handler = std::function<int(const transport_message& request, uint64_t& output_object_id)>;
+        using close_handler = std::function<void()>;
+
+    private:
+        struct pending_call
+        {
+            std::atomic<uint32_t> done = 0;
+            // set when the channel closed before a reply arrived
+            bool failed = false;
+            transport_message reply;
+            std::vector<char>* payload = nullptr;
+            // made by one of this channels workers, which is woken to help when requests queue
+            bool from_worker = false;
+#ifdef BUILD_COROUTINE
+            // an awaiting caller, resumed on a worker once the reply arrives rather than woken
+            std::coroutine_handle<> awaiter;
+#endif
+        };
+
+        struct request
+        {
+            transport_message header;
+            std::vector<char> payload;
+#ifdef BUILD_COROUTINE
+            // set instead of the header when a worker is to resume a caller whose reply has arrived
+            std::coroutine_handle<> resume;
+#endif
+        };
+
+#ifdef BUILD_COROUTINE
+        // registers the call and sends it on suspending, the caller is parked on the pending call until it completes
+        struct reply_awaiter
+        {
+            transport_channel& channel;
+            transport_message& request;
+            const char* payload;
+            pending_call& pending;
+            int err_code = 0;
+
+            bool await_ready() noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> awaiting);
+            int await_resume() noexcept { return err_code; }
+        };
+#endif
+
+        std::atomic<uint32_t> reply_spin_limit_ = 256;
+        std::atomic<uint64_t> next_call_id_ = 1;
+        std::mutex pending_control_;
+        std::unordered_map<uint64_t, pending_call*> pending_calls_;
+
+        mutable std::mutex work_control_;
+        std::condition_variable work_available_;
+        std::condition_variable stopped_;
+        std::deque<request> work_;
+        size_t idle_workers_ = 0;
+        size_t max_workers_ = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+        std::vector<std::thread> workers_;
+        // workers that retired after a quiet spell, joined by the next dispatch or the destructor
+        std::vector<std::thread> retired_workers_;
+        bool receiver_running_ = false;
+        std::atomic<bool> stopping_ = false;
+
+        rpc::weak_ptr<service> service_;
+        connect_handler connect_handler_;
+        close_handler close_handler_;
+
+        void fail_pending_calls();
+        // marks the call done and wakes or resumes its caller, the pending call may be gone once this returns
+        void complete(pending_call* pending);
+        void dispatch(request&& req);
+        void worker_loop();
+        void retire_worker();
+        // runs one queued request on the calling thread, false if there was none
+        bool run_queued_request();
+        void wake_waiting_workers();
+        void handle_request(request& req);
+
+    protected:
+        transport_channel() = default;
+
+        // sends one whole message, blocking until the transport has accepted it
+        virtual int write_message(const transport_message& header, const char* payload) = 0;
+        // begins delivering incoming messages to on_message
+        virtual void start_receiver() = 0;
+        // lets the other side know this side has gone and unblocks the receiver
+        virtual void on_close() = 0;
+        virtual bool is_peer_closed() const { return false; }
+
+        // hands a message from the other side to its waiting caller or to a worker, payload may be consumed
+        void on_message(const transport_message& header, std::vector<char>& payload);
+        // called by the receiver once it has stopped for good, fails every call still waiting on a reply
+        void on_receiver_stopped();
+
+    public:
+        transport_channel(const transport_channel&) = delete;
+        transport_channel& operator=(const transport_channel&) = delete;
+        // joins the workers, except for one whose request let go of the last reference which leaves on its own
+        virtual ~transport_channel();
+
+        // the most requests from the other side that run at once, the rest queue until a worker is free.  The
+        // default is the number of hardware threads
+        void set_max_workers(size_t count);
+        size_t get_max_workers() const;
+
+        // requests coming from the other process are dispatched into svc
+        void attach(const rpc::shared_ptr<service>& svc);
+        void set_connect_handler(connect_handler handler);
+        // called once the receiver has stopped, whichever side closed the channel
+        void set_close_handler(close_handler handler);
+
+        // starts the receiver, the channel stays alive until either side closes it
+        void start();
+        void close();
+        // blocks until the channel is closed by either side
+        void wait_for_close();
+        bool is_closed() const { return stopping_.load() || is_peer_closed(); }
+
+        // sends the request and waits for the reply, reply_payload receives the reply data
+        int call(transport_message& request, const char* payload, transport_message& reply, std::vector<char>& reply_payload);
+        // sends a request that has no reply and returns once the transport has accepted it
+        int post(transport_message& request, const char* payload);
+#ifdef BUILD_COROUTINE
+        // as call but the caller suspends instead of blocking, it resumes on one of this channels workers when the
+        // reply arrives, or on the receiving thread if the channel closes first
+        task<int> async_call(
+            transport_message& request, const char* payload, transport_message& reply, std::vector<char>& reply_payload);
+#endif
+
+        virtual size_t get_max_payload_size() const = 0;
+    };
+
+    // reassembles messages from a stream transport where the header doubles as the length prefix of each frame, only
+    // ever touched by the thread that receives for one connection
+    class stream_message_reader
+    {
+        std::vector<char> buffer_;
+        size_t start_ = 0;
+        size_t end_ = 0;
+
+    public:
+        // returns space for at least min_size more bytes, available receives the full amount of space
+        char* prepare(size_t min_size, size_t& available);
+        // marks count bytes written into the space returned by prepare as received
+        void commit(size_t count) { end_ += count; }
+
+        // hands each whole message received so far to fn, returns false if a header claims a payload larger than
+        // max_payload_size in which case nothing more on the stream can be trusted
+        template<class FN> bool extract(size_t max_payload_size, FN&& fn)
+        {
+            constexpr size_t header_size = sizeof(transport_message);
+            std::vector<char> payload;
+            while (end_ - start_ >= header_size)
+            {
+                transport_message header;
+                memcpy(&header, buffer_.data() + start_, header_size);
+                if (header.payload_size > max_payload_size)
+                    return false;
+                if (end_ - start_ < header_size + header.payload_size)
+                    break;
+                auto* begin = buffer_.data() + start_ + header_size;
+                payload.assign(begin, begin + header.payload_size);
+                start_ += header_size + header.payload_size;
+                fn(header, payload);
+            }
+            return true;
+        }
+
+        // for transports that receive into their own buffers
+        template<class FN> bool append(const char* data, size_t size, size_t max_payload_size, FN&& fn)
+        {
+            size_t available = 0;
+            memcpy(prepare(size, available), data, size);
+            commit(size);
+            return extract(max_payload_size, std::forward<FN>(fn));
+        }
+    };
+
+    // owns the child zones of the connections accepted by a listener, each zone is dropped when its connection closes
+    class transport_listener : public std::enable_shared_from_this<transport_listener>
+    {
+        std::mutex zones_control_;
+        std::unordered_map<const transport_channel*, rpc::shared_ptr<rpc::child_service>> zones_;
+
+        void add_zone(const transport_channel* channel, const rpc::shared_ptr<rpc::child_service>& child_service);
+        void remove_zone(const transport_channel* channel);
+
+    protected:
+        // called by the concrete listener with every connection it accepts
+        std::function<void(const std::shared_ptr<transport_channel>&)> on_accept_;
+
+        transport_listener() = default;
+
+        // every accepted connection gets a child zone built by fn once the client sends its connect request
+        template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+        void set_child_zone_factory(const char* name,
+            std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+                rpc::shared_ptr<CHILD_INTERFACE>&,
+                const rpc::shared_ptr<rpc::child_service>&)> fn);
+
+    public:
+        transport_listener(const transport_listener&) = delete;
+        transport_listener& operator=(const transport_listener&) = delete;
+        virtual ~transport_listener() = default;
+
+        // stops accepting, connections that are already open carry on until their client goes away
+        virtual void close() = 0;
+    };
+
+    // a service proxy to a zone in another process over any transport_channel, the same class is used by the parent
+    // to reach the child and by the child to reach its parent
+    class transport_service_proxy : public service_proxy
+    {
+        // closes the channel when the last clone of the proxy goes away
+        struct channel_owner
+        {
+            std::shared_ptr<transport_channel> channel_;
+            channel_owner(std::shared_ptr<transport_channel> channel)
+                : channel_(std::move(channel))
+            {
+            }
+            ~channel_owner();
+        };
+
+        transport_service_proxy(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& svc,
+            std::shared_ptr<channel_owner> channel_owner);
+
+        transport_service_proxy(const transport_service_proxy& other) = default;
+
+        // fills in a send request, fails if the call cannot go over this channel
+        int make_send_request(transport_message& request,
+            uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_);
+
+        rpc::shared_ptr<service_proxy> clone() override;
+
+        int connect(rpc::interface_descriptor input_descr, rpc::interface_descriptor& output_descr) override;
+
+        int send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override;
+#ifdef BUILD_COROUTINE
+        // suspends until the reply arrives rather than holding the calling thread
+        task<int> async_send(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_,
+            std::vector<char>& out_buf_) override;
+#endif
+        // the call is on its way once the transport has accepted it, the other side sends nothing back
+        int post(uint64_t protocol_version,
+            encoding encoding,
+            uint64_t tag,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id,
+            method method_id,
+            size_t in_size_,
+            const char* in_buf_) override;
+        int try_cast(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            interface_ordinal interface_id) override;
+        uint64_t add_ref(uint64_t protocol_version,
+            destination_channel_zone destination_channel_zone_id,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_channel_zone caller_channel_zone_id,
+            caller_zone caller_zone_id,
+            add_ref_options build_out_param_channel) override;
+        uint64_t release(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            object object_id,
+            caller_zone caller_zone_id) override;
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override;
+
+        std::shared_ptr<channel_owner> channel_owner_;
+        transport_channel* channel_ = nullptr;
+
+        friend rpc::service;
+        friend rpc::child_service;
+
+    public:
+        virtual ~transport_service_proxy() = default;
+
+        // used by the parent through service::connect_to_zone and by the child through child_service::create_child_zone
+        static rpc::shared_ptr<transport_service_proxy> create(const char* name,
+            destination_zone destination_zone_id,
+            const rpc::shared_ptr<service>& svc,
+            std::shared_ptr<transport_channel> channel);
+    };
+
+    // builds a connect handler that answers the parent's connect request by creating a child zone with fn, the new
+    // zone is handed to on_zone_created which is responsible for keeping it alive
+    template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+    transport_channel::connect_handler make_child_zone_handler(std::string name,
+        std::weak_ptr<transport_channel> channel,
+        std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+            rpc::shared_ptr<CHILD_INTERFACE>&,
+            const rpc::shared_ptr<rpc::child_service>&)> fn,
+        std::function<void(const rpc::shared_ptr<rpc::child_service>&)> on_zone_created)
+    {
+        return [name, channel, fn, on_zone_created](const transport_message& request, uint64_t& output_object_id) -> int
+        {
+            // the handler lives inside the channel so it must not keep it alive
+            auto locked_channel = channel.lock();
+            if (!locked_channel)
+                return rpc::error::TRANSPORT_ERROR();
+
+            rpc::interface_descriptor input_descr{};
+            rpc::interface_descriptor output_descr{};
+            if (request.object_id)
+                input_descr = {{request.object_id}, {request.caller_zone_id}};
+
+            rpc::shared_ptr<rpc::child_service> child_service;
+            auto err_code
+                = rpc::child_service::create_child_zone<transport_service_proxy, PARENT_INTERFACE, CHILD_INTERFACE>(
+                    name.c_str(),
+                    rpc::zone{request.destination_zone_id},
+                    rpc::destination_zone{request.caller_zone_id},
+                    input_descr,
+                    output_descr,
+                    fn,
+                    child_service,
+                    locked_channel);
+            if (err_code != rpc::error::OK())
+                return err_code;
+            on_zone_created(child_service);
+            output_object_id = output_descr.object_id.get_val();
+            return err_code;
+        };
+    }
+
+    template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+    void transport_listener::set_child_zone_factory(const char* name,
+        std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+            rpc::shared_ptr<CHILD_INTERFACE>&,
+            const rpc::shared_ptr<rpc::child_service>&)> fn)
+    {
+        std::weak_ptr<transport_listener> weak_listener = shared_from_this();
+        std::string zone_name = name;
+        on_accept_ = [weak_listener, zone_name, fn](const std::shared_ptr<transport_channel>& channel)
+        {
+            const transport_channel* key = channel.get();
+            channel->set_connect_handler(make_child_zone_handler<PARENT_INTERFACE, CHILD_INTERFACE>(zone_name,
+                channel,
+                fn,
+                [weak_listener, key](const rpc::shared_ptr<rpc::child_service>& child_service)
+                {
+                    if (auto listener = weak_listener.lock())
+                        listener->add_zone(key, child_service);
+                }));
+            channel->set_close_handler(
+                [weak_listener, key]()
+                {
+                    if (auto listener = weak_listener.lock())
+                        listener->remove_zone(key);
+                });
+            channel->start();
+        };
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// a transport between zones in different processes over a unix domain stream socket, every socket in the process is
+// watched by one epoll reactor thread that reads whole messages and hands them to the owning channel
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <rpc/transport_channel.h>
+
+namespace rpc
+{
+    class uds_reactor;
+
+    // opens a stream socket bound to path and listening, a socket file left behind by a dead process is replaced,
+    // returns -1 on failure
+    int listen_unix_socket(const std::string& path, bool non_blocking);
+    // returns a stream socket connected to path or -1
+    int connect_unix_socket(const std::string& path, bool non_blocking);
+
+    // one end of a socket connection, messages go out as the fixed size header followed by payload_size bytes so the
+    // header doubles as the length prefix of the frame
+    class uds_channel : public transport_channel
+    {
+        int fd_ = -1;
+        // writers take turns so that frames from different threads are never interleaved
+        std::mutex write_control_;
+        // only touched by the reactor thread
+        stream_message_reader reader_;
+
+        explicit uds_channel(int fd);
+
+        // drains the socket, returns false once the connection has finished
+        bool on_readable();
+
+        friend uds_reactor;
+        friend class uds_listener;
+
+    protected:
+        int write_message(const transport_message& header, const char* payload) override;
+        void start_receiver() override;
+        void on_close() override;
+
+    public:
+        ~uds_channel() override;
+
+        // connects to a uds_listener bound to path
+        static std::shared_ptr<uds_channel> connect(const std::string& path);
+
+        size_t get_max_payload_size() const override;
+    };
+
+    // accepts connections on a socket path, every connection that sends a connect request gets its own child zone
+    // which is dropped when that connection closes
+    class uds_listener : public transport_listener
+    {
+        int fd_ = -1;
+        std::string path_;
+        std::atomic<bool> closed_ = false;
+
+        uds_listener() = default;
+
+        static std::shared_ptr<uds_listener> bind(const std::string& path);
+        void start();
+        bool on_readable();
+
+        friend uds_reactor;
+
+    public:
+        ~uds_listener() override;
+
+        // binds path and builds a child zone with fn for every client that connects
+        template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+        static std::shared_ptr<uds_listener> listen(const char* name,
+            const std::string& path,
+            std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+                rpc::shared_ptr<CHILD_INTERFACE>&,
+                const rpc::shared_ptr<rpc::child_service>&)> fn)
+        {
+            auto listener = bind(path);
+            if (!listener)
+                return nullptr;
+            listener->template set_child_zone_factory<PARENT_INTERFACE, CHILD_INTERFACE>(name, fn);
+            listener->start();
+            return listener;
+        }
+
+        void close() override;
+    };
+
+    // the client passes a connected uds_channel to service::connect_to_zone
+    using uds_service_proxy = transport_service_proxy;
+}
@@ -0,0 +1,108 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#pragma once
+
+// a unix domain socket transport driven by io_uring for servers with many connections, one reactor thread per process
+// owns the ring.  Each socket keeps a multishot receive armed that lands in a registered ring of provided buffers, and
+// every send, receive and accept produced by a pass of the reactor goes to the kernel in one submission.  The wire
+// format is the same as uds_channel so either end of a connection may use either transport
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rpc/transport_channel.h>
+#include <rpc/uds_service_proxy.h>
+
+namespace rpc
+{
+    class uring_reactor;
+
+    // one end of a socket connection, writers append whole frames to a send queue which the reactor hands to the
+    // kernel as a single send, so concurrent callers share one system call
+    class uring_channel : public transport_channel
+    {
+        int fd_ = -1;
+
+        // frames waiting to go out, filled by any thread
+        std::mutex send_control_;
+        std::vector<char> send_queue_;
+        // set while the reactor is responsible for draining send_queue_
+        bool send_scheduled_ = false;
+
+        // only touched by the reactor thread
+        stream_message_reader reader_;
+        std::vector<char> in_flight_;
+        size_t in_flight_sent_ = 0;
+        bool send_in_flight_ = false;
+        bool receive_armed_ = false;
+        // keeps the channel alive while the kernel holds operations that refer to it
+        std::shared_ptr<uring_channel> self_;
+
+        explicit uring_channel(int fd);
+
+        friend uring_reactor;
+        friend class uring_listener;
+
+    protected:
+        // queues the frame, the reactor sends it, failures surface as the connection closing
+        int write_message(const transport_message& header, const char* payload) override;
+        void start_receiver() override;
+        void on_close() override;
+
+    public:
+        ~uring_channel() override;
+
+        // connects to a uring_listener or a uds_listener bound to path, fails if io_uring is unavailable
+        static std::shared_ptr<uring_channel> connect(const std::string& path);
+
+        size_t get_max_payload_size() const override;
+    };
+
+    // accepts connections on a socket path with a multishot accept, every connection that sends a connect request gets
+    // its own child zone which is dropped when that connection closes
+    class uring_listener : public transport_listener
+    {
+        int fd_ = -1;
+        std::string path_;
+        std::atomic<bool> closed_ = false;
+        // only touched by the reactor thread
+        std::shared_ptr<uring_listener> self_;
+
+        uring_listener() = default;
+
+        static std::shared_ptr<uring_listener> bind(const std::string& path);
+        bool start();
+
+        friend uring_reactor;
+
+    public:
+        ~uring_listener() override;
+
+        // binds path and builds a child zone with fn for every client that connects, fails if io_uring is unavailable
+        template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+        static std::shared_ptr<uring_listener> listen(const char* name,
+            const std::string& path,
+            std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+                rpc::shared_ptr<CHILD_INTERFACE>&,
+                const rpc::shared_ptr<rpc::child_service>&)> fn)
+        {
+            auto listener = bind(path);
+            if (!listener)
+                return nullptr;
+            listener->template set_child_zone_factory<PARENT_INTERFACE, CHILD_INTERFACE>(name, fn);
+            if (!listener->start())
+                return nullptr;
+            return listener;
+        }
+
+        void close() override;
+    };
+
+    // the client passes a connected uring_channel to service::connect_to_zone
+    using uring_service_proxy = transport_service_proxy;
+}
@@ -0,0 +1,123 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <mutex>
+
+#include <rpc/assert.h>
+#include <rpc/buffer_pool.h>
+
+namespace rpc
+{
+    namespace
+    {
+        std::mutex default_config_control;
+        buffer_pool_config default_config;
+    }
+
+    buffer_pool::buffer_pool()
+        : config_(get_default_config())
+    {
+    }
+
+    buffer_pool& buffer_pool::get()
+    {
+        thread_local buffer_pool pool;
+        return pool;
+    }
+
+    void buffer_pool::set_default_config(const buffer_pool_config& config)
+    {
+        RPC_ASSERT(config.min_class_size && config.class_count <= buffer_pool_config::max_class_count);
+        std::lock_guard g(default_config_control);
+        default_config = config;
+    }
+
+    buffer_pool_config buffer_pool::get_default_config()
+    {
+        std::lock_guard g(default_config_control);
+        return default_config;
+    }
+
+    void buffer_pool::configure(const buffer_pool_config& config)
+    {
+        RPC_ASSERT(config.min_class_size && config.class_count <= buffer_pool_config::max_class_count);
+        trim();
+        config_ = config;
+    }
+
+    // returns class_count if the capacity does not fit into any class
+    size_t buffer_pool::class_index_for_capacity(size_t capacity) const
+    {
+        if (capacity < config_.min_class_size)
+            return config_.class_count;
+        size_t index = 0;
+        while (index + 1 < config_.class_count && (config_.min_class_size << (index + 1)) <= capacity)
+            index++;
+        if (index + 1 == config_.class_count && (config_.min_class_size << config_.class_count) <= capacity)
+            return config_.class_count;
+        return index;
+    }
+
+    // the smallest class whose every buffer can hold size bytes
+    size_t buffer_pool::class_index_for_request(size_t size) const
+    {
+        size_t index = 0;
+        while (index < config_.class_count && (config_.min_class_size << index) < size)
+            index++;
+        return index;
+    }
+
+    std::vector<char> buffer_pool::acquire(size_t size)
+    {
+        auto index = class_index_for_request(size);
+        for (auto i = index; i < config_.class_count; i++)
+        {
+            auto& bin = classes_[i];
+            if (bin.empty())
+                continue;
+            std::vector<char> buf = std::move(bin.back());
+            bin.pop_back();
+            pooled_bytes_ -= buf.capacity();
+            buf.resize(size);
+            return buf;
+        }
+
+        std::vector<char> buf;
+        if (index < config_.class_count)
+            buf.reserve(config_.min_class_size << index);
+        buf.resize(size);
+        return buf;
+    }
+
+    void buffer_pool::release(std::vector<char>&& buf)
+    {
+        auto capacity = buf.capacity();
+        auto index = class_index_for_capacity(capacity);
+        if (index == config_.class_count)
+            return;
+        auto& bin = classes_[index];
+        if (bin.size() >= config_.max_buffers_per_class || pooled_bytes_ + capacity > config_.high_water_bytes)
+            return;
+        pooled_bytes_ += capacity;
+        bin.push_back(std::move(buf));
+    }
+
+    void buffer_pool::trim()
+    {
+        for (auto& bin : classes_)
+        {
+            bin.clear();
+            bin.shrink_to_fit();
+        }
+        pooled_bytes_ = 0;
+    }
+
+    size_t buffer_pool::get_pooled_count() const
+    {
+        size_t count = 0;
+        for (auto& bin : classes_)
+            count += bin.size();
+        return count;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <yas/mem_streams.hpp>
+#include <yas/std_types.hpp>
+
+#include <rpc/call_batch.h>
+
+namespace rpc
+{
+    size_t call_batch::add(int err,
+        const rpc::shared_ptr<object_proxy>& op,
+        const std::function<interface_ordinal(uint64_t)>& id_getter,
+        method method_id,
+        uint64_t tag,
+        const std::vector<char>& in)
+    {
+        auto slot = results_.size();
+        results_.push_back(err);
+        replies_.emplace_back();
+        if (err != rpc::error::OK())
+            return slot;
+
+        if (!is_batch_encoding(enc_))
+        {
+            results_[slot] = rpc::error::INCOMPATIBLE_SERIALISATION();
+            return slot;
+        }
+        if (!op)
+        {
+            results_[slot] = rpc::error::INVALID_DATA();
+            return slot;
+        }
+        auto sp = op->get_service_proxy();
+        if (!service_proxy_)
+            service_proxy_ = sp;
+        else if (sp->get_destination_zone_id() != service_proxy_->get_destination_zone_id())
+        {
+            results_[slot] = rpc::error::ZONE_NOT_FOUND();
+            return slot;
+        }
+
+        auto version = service_proxy_->get_remote_rpc_version();
+        calls_.push_back(batched_call{tag, op->get_object_id(), id_getter(version), method_id, in});
+        slots_.push_back(slot);
+        return slot;
+    }
+
+    int call_batch::flush()
+    {
+        if (!is_batch_encoding(enc_))
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        if (calls_.empty())
+            return rpc::error::OK();
+
+        auto in = rpc::serialise<std::vector<batched_call>, std::vector<char>>(calls_, enc_);
+        std::vector<char> out;
+        auto ret = service_proxy_->send_from_this_zone(service_proxy_->get_remote_rpc_version(),
+            enc_,
+            0,
+            object{},
+            interface_ordinal{},
+            method{},
+            in.size(),
+            in.data(),
+            out);
+
+        std::vector<batched_reply> replies;
+        if (ret == rpc::error::OK())
+        {
+            std::string error;
+            if (enc_ == encoding::yas_json)
+                error = rpc::from_yas_json(out, replies);
+            else if (enc_ == encoding::yas_compressed_binary)
+                error = rpc::from_yas_compressed_binary(out, replies);
+            else
+                error = rpc::from_yas_binary(out, replies);
+            if (!error.empty() || replies.size() != calls_.size())
+                ret = rpc::error::PROXY_DESERIALISATION_ERROR();
+        }
+
+        for (size_t i = 0; i < slots_.size(); i++)
+        {
+            if (ret != rpc::error::OK())
+            {
+                results_[slots_[i]] = ret;
+                continue;
+            }
+            results_[slots_[i]] = replies[i].result;
+            replies_[slots_[i]] = std::move(replies[i].out);
+        }
+        calls_.clear();
+        slots_.clear();
+        return ret;
+    }
+}
@@ -0,0 +1,464 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <rpc/assert.h>
+#include <rpc/executor.h>
+
+namespace rpc
+{
+    namespace
+    {
+#ifndef _IN_ENCLAVE
+        thread_local threaded_executor* current_executor = nullptr;
+        // the deque of a work_stealing_executor thread
+        thread_local size_t current_worker = 0;
+
+        void pin_thread(size_t index, const thread_pool_config& config)
+        {
+#ifdef __linux__
+            if (!config.cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(config.cpus[index % config.cpus.size()], &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+#else
+            (void)index;
+            (void)config;
+#endif
+        }
+#endif
+
+        // the strands being drained by this thread, innermost first
+        struct strand_frame
+        {
+            const strand* owner;
+            strand_frame* previous;
+        };
+        thread_local strand_frame* current_strands = nullptr;
+
+        thread_local size_t worker_scopes = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // worker_scope
+
+    worker_scope::worker_scope()
+    {
+        worker_scopes++;
+    }
+
+    worker_scope::~worker_scope()
+    {
+        worker_scopes--;
+    }
+
+    bool worker_scope::is_worker()
+    {
+#ifndef _IN_ENCLAVE
+        if (current_executor)
+            return true;
+#endif
+        return worker_scopes != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // mpsc_mailbox
+
+    mpsc_mailbox::mpsc_mailbox()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    void mpsc_mailbox::push(executor_task* task)
+    {
+        task->next.store(nullptr, std::memory_order_relaxed);
+        auto* prev = head_.exchange(task, std::memory_order_acq_rel);
+        prev->next.store(task, std::memory_order_release);
+    }
+
+    executor_task* mpsc_mailbox::pop()
+    {
+        auto* tail = tail_;
+        auto* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (!next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        // a producer has swapped the head but not linked its task yet
+        if (tail != head_.load(std::memory_order_acquire))
+            return nullptr;
+        // tail is the last task, the stub goes behind it so that tail can be handed out
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+#ifndef _IN_ENCLAVE
+    ////////////////////////////////////////////////////////////////////////////
+    // threaded_executor
+
+    threaded_executor* threaded_executor::current()
+    {
+        return current_executor;
+    }
+
+    bool threaded_executor::is_current() const
+    {
+        return current_executor == this;
+    }
+
+    void threaded_executor::enter()
+    {
+        current_executor = this;
+    }
+
+    void threaded_executor::leave()
+    {
+        current_executor = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // thread_pool_executor
+
+    thread_pool_executor::thread_pool_executor(const thread_pool_config& config)
+    {
+        auto count = config.thread_count ? config.thread_count : 1;
+        threads_.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            threads_.emplace_back([this, i, config]() { run(i, config); });
+    }
+
+    thread_pool_executor::~thread_pool_executor()
+    {
+        stop();
+        RPC_ASSERT(!is_current());
+        for (auto& thread : threads_)
+            thread.join();
+    }
+
+    void thread_pool_executor::stop()
+    {
+        std::lock_guard g(sleep_control_);
+        stopping_ = true;
+        wake_.notify_all();
+    }
+
+    void thread_pool_executor::post(executor_task* task)
+    {
+        pending_.fetch_add(1);
+        mailbox_.push(task);
+        if (sleepers_.load())
+        {
+            std::lock_guard g(sleep_control_);
+            wake_.notify_one();
+        }
+    }
+
+    void thread_pool_executor::wake_all()
+    {
+        std::lock_guard g(sleep_control_);
+        wake_.notify_all();
+    }
+
+    bool thread_pool_executor::run_one()
+    {
+        executor_task* task = nullptr;
+        {
+            std::lock_guard g(pop_control_);
+            task = mailbox_.pop();
+        }
+        if (!task)
+            return false;
+        pending_.fetch_sub(1);
+        task->run(task);
+        return true;
+    }
+
+    void thread_pool_executor::run(size_t index, const thread_pool_config& config)
+    {
+        pin_thread(index, config);
+        enter();
+        while (true)
+        {
+            if (run_one())
+                continue;
+            // a task is counted before it is linked in, it will be there shortly
+            if (pending_.load())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock lock(sleep_control_);
+            sleepers_++;
+            wake_.wait(lock, [this]() { return pending_.load() || stopping_.load(); });
+            sleepers_--;
+            if (stopping_ && !pending_.load())
+                break;
+        }
+        leave();
+    }
+
+    void thread_pool_executor::wait_for(const std::atomic<bool>& done)
+    {
+        while (!done.load(std::memory_order_acquire))
+        {
+            if (run_one())
+                continue;
+            std::unique_lock lock(sleep_control_);
+            sleepers_++;
+            wake_.wait(lock, [&]() { return done.load() || pending_.load() || stopping_.load(); });
+            sleepers_--;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // work_stealing_executor
+
+    work_stealing_executor::work_stealing_executor(const thread_pool_config& config)
+    {
+        auto count = config.thread_count ? config.thread_count : 1;
+        workers_.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            workers_.push_back(std::make_unique<worker>());
+        threads_.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            threads_.emplace_back([this, i, config]() { run(i, config); });
+    }
+
+    work_stealing_executor::~work_stealing_executor()
+    {
+        {
+            std::lock_guard g(sleep_control_);
+            stopping_ = true;
+            wake_.notify_all();
+        }
+        RPC_ASSERT(!is_current());
+        for (auto& thread : threads_)
+            thread.join();
+    }
+
+    void work_stealing_executor::post(executor_task* task)
+    {
+        // nested work stays with the thread that made it, outside work is dealt out
+        auto index = is_current() ? current_worker
+                                  : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        pending_.fetch_add(1);
+        posted_.fetch_add(1, std::memory_order_relaxed);
+        {
+            auto& w = *workers_[index];
+            std::lock_guard g(w.control);
+            w.tasks.push_back(task);
+        }
+        if (sleepers_.load())
+        {
+            std::lock_guard g(sleep_control_);
+            wake_.notify_one();
+        }
+    }
+
+    void work_stealing_executor::wake_all()
+    {
+        std::lock_guard g(sleep_control_);
+        wake_.notify_all();
+    }
+
+    bool work_stealing_executor::run_one(size_t index)
+    {
+        auto& own = *workers_[index];
+        executor_task* task = nullptr;
+        {
+            std::lock_guard g(own.control);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+            }
+        }
+        for (size_t i = 1; !task && i < workers_.size(); i++)
+        {
+            auto& victim = *workers_[(index + i) % workers_.size()];
+            std::lock_guard g(victim.control);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                own.steals.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!task)
+            return false;
+        pending_.fetch_sub(1);
+        task->run(task);
+        own.executed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void work_stealing_executor::run(size_t index, const thread_pool_config& config)
+    {
+        pin_thread(index, config);
+        enter();
+        current_worker = index;
+        while (true)
+        {
+            if (run_one(index))
+                continue;
+            // a task is counted before it is pushed, it will be there shortly
+            if (pending_.load())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock lock(sleep_control_);
+            sleepers_++;
+            wake_.wait(lock, [this]() { return pending_.load() || stopping_.load(); });
+            sleepers_--;
+            if (stopping_ && !pending_.load())
+                break;
+        }
+        leave();
+    }
+
+    void work_stealing_executor::wait_for(const std::atomic<bool>& done)
+    {
+        while (!done.load(std::memory_order_acquire))
+        {
+            if (run_one(current_worker))
+                continue;
+            std::unique_lock lock(sleep_control_);
+            sleepers_++;
+            wake_.wait(lock, [&]() { return done.load() || pending_.load() || stopping_.load(); });
+            sleepers_--;
+        }
+    }
+
+    work_stealing_stats work_stealing_executor::get_stats() const
+    {
+        work_stealing_stats stats;
+        stats.posted = posted_.load(std::memory_order_relaxed);
+        stats.queue_depths.reserve(workers_.size());
+        for (auto& w : workers_)
+        {
+            stats.executed += w->executed.load(std::memory_order_relaxed);
+            stats.steals += w->steals.load(std::memory_order_relaxed);
+            std::lock_guard g(w->control);
+            stats.queue_depths.push_back(w->tasks.size());
+        }
+        return stats;
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////
+    // strand
+
+    strand::strand(std::shared_ptr<executor> ex)
+        : executor_(std::move(ex))
+    {
+        drain_task_.owner = this;
+        drain_task_.run = [](executor_task* task) { static_cast<drain_task*>(task)->owner->drain(); };
+    }
+
+    void strand::post(executor_task* task)
+    {
+        // linked in before it is counted so that the drainer mostly finds what it was told about
+        mailbox_.push(task);
+        if (pending_.fetch_add(1, std::memory_order_acq_rel) != 0)
+            return;
+        if (executor_)
+            executor_->post(&drain_task_);
+        else
+            drain();
+    }
+
+    bool strand::is_current() const
+    {
+        for (auto* frame = current_strands; frame; frame = frame->previous)
+        {
+            if (frame->owner == this)
+                return true;
+        }
+        return false;
+    }
+
+    void strand::drain()
+    {
+        strand_frame frame{this, current_strands};
+        current_strands = &frame;
+        size_t batch = 0;
+        while (true)
+        {
+            executor_task* task = nullptr;
+            // an earlier post may still be linking in its task
+            while (!(task = mailbox_.pop()))
+            {
+#ifndef _IN_ENCLAVE
+                std::this_thread::yield();
+#endif
+            }
+            task->run(task);
+            // the strand may be gone once its last task is done so nothing is touched after that
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                break;
+            if (executor_ && ++batch == max_batch)
+            {
+                executor_->post(&drain_task_);
+                break;
+            }
+        }
+        current_strands = frame.previous;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // completion
+
+    void completion::set()
+    {
+        // the waiter may destroy this as soon as done_ is seen so nothing is touched after it is set
+#ifndef _IN_ENCLAVE
+        if (auto* waiter = waiter_executor_)
+        {
+            done_.store(true, std::memory_order_release);
+            waiter->wake_all();
+            return;
+        }
+#endif
+        std::lock_guard g(control_);
+        done_.store(true, std::memory_order_release);
+        cv_.notify_one();
+    }
+
+    void completion::wait()
+    {
+#ifndef _IN_ENCLAVE
+        if (waiter_executor_)
+        {
+            waiter_executor_->wait_for(done_);
+            return;
+        }
+#endif
+        std::unique_lock lock(control_);
+        cv_.wait(lock, [this]() { return done_.load(std::memory_order_acquire); });
+    }
+}
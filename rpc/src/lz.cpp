@@ -0,0 +1,266 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <rpc/lz.h>
+
+namespace rpc
+{
+    namespace lz
+    {
+        namespace
+        {
+            std::atomic<size_t> threshold_ = 1024;
+
+            constexpr size_t min_match = 4;
+            constexpr size_t hash_bits = 12;
+            constexpr size_t max_offset = 65535;
+            // a block always ends in literals so a match is never extended up to the end of the input, and no match
+            // starts this close to the end
+            constexpr size_t end_literals = 5;
+            constexpr size_t match_limit = 12;
+            // the most a block can expand to, used to refuse a frame claiming more than its block could hold
+            constexpr size_t max_ratio = 255;
+
+            uint32_t read32(const char* p)
+            {
+                uint32_t v;
+                memcpy(&v, p, sizeof(v));
+                return v;
+            }
+
+            uint32_t hash(uint32_t v)
+            {
+                return (v * 2654435761u) >> (32 - hash_bits);
+            }
+
+            // the part of a length that did not fit in its token nibble, as a run of 255s and a remainder
+            void put_length(std::vector<char>& out, size_t length)
+            {
+                while (length >= 255)
+                {
+                    out.push_back((char)255);
+                    length -= 255;
+                }
+                out.push_back((char)length);
+            }
+
+            bool get_length(const uint8_t*& in, const uint8_t* end, size_t& length)
+            {
+                while (true)
+                {
+                    if (in == end)
+                        return false;
+                    auto b = *in++;
+                    length += b;
+                    if (b != 255)
+                        return true;
+                }
+            }
+
+            void put_literals(std::vector<char>& out, uint8_t match_token, const char* literals, size_t count)
+            {
+                out.push_back((char)((std::min<size_t>(count, 15) << 4) | match_token));
+                if (count >= 15)
+                    put_length(out, count - 15);
+                out.insert(out.end(), literals, literals + count);
+            }
+
+            void put_varint(std::vector<char>& out, uint64_t value)
+            {
+                while (value >= 0x80)
+                {
+                    out.push_back((char)(value | 0x80));
+                    value >>= 7;
+                }
+                out.push_back((char)value);
+            }
+
+            bool get_varint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+            {
+                value = 0;
+                for (int shift = 0; shift < 64; shift += 7)
+                {
+                    if (in == end)
+                        return false;
+                    auto b = *in++;
+                    value |= uint64_t(b & 0x7f) << shift;
+                    if (!(b & 0x80))
+                        return true;
+                }
+                return false;
+            }
+        }
+
+        void set_threshold(size_t threshold)
+        {
+            threshold_.store(threshold, std::memory_order_relaxed);
+        }
+
+        size_t get_threshold()
+        {
+            return threshold_.load(std::memory_order_relaxed);
+        }
+
+        void compress(const char* data, size_t size, std::vector<char>& out)
+        {
+            // positions are only hints, every candidate is compared before it is used
+            uint32_t table[1 << hash_bits] = {};
+            size_t anchor = 0;
+            size_t pos = 0;
+            if (size >= match_limit)
+            {
+                auto last = size - match_limit;
+                while (pos <= last)
+                {
+                    auto v = read32(data + pos);
+                    auto h = hash(v);
+                    size_t candidate = table[h];
+                    table[h] = (uint32_t)pos;
+                    if (candidate >= pos || pos - candidate > max_offset || read32(data + candidate) != v)
+                    {
+                        // the longer the run without a match the further ahead the next look, so data that does not
+                        // compress is passed over quickly
+                        pos += 1 + ((pos - anchor) >> 6);
+                        continue;
+                    }
+
+                    auto length = min_match;
+                    auto longest = size - end_literals - pos;
+                    while (length < longest && data[candidate + length] == data[pos + length])
+                        length++;
+
+                    auto extra = length - min_match;
+                    put_literals(out, (uint8_t)std::min<size_t>(extra, 15), data + anchor, pos - anchor);
+                    auto offset = pos - candidate;
+                    out.push_back((char)(offset & 0xff));
+                    out.push_back((char)(offset >> 8));
+                    if (extra >= 15)
+                        put_length(out, extra - 15);
+
+                    pos += length;
+                    anchor = pos;
+                }
+            }
+            put_literals(out, 0, data + anchor, size - anchor);
+        }
+
+        bool decompress(const char* block, size_t block_size, char* out, size_t size)
+        {
+            // an empty payload is a lone token with no literals and out may be null
+            if (size == 0)
+                return block_size == 1 && block[0] == 0;
+
+            auto* in = (const uint8_t*)block;
+            auto* end = in + block_size;
+            auto* op = out;
+            auto* op_end = out + size;
+            while (true)
+            {
+                if (in == end)
+                    return false;
+                auto token = *in++;
+                size_t literals = token >> 4;
+                if (literals == 15 && !get_length(in, end, literals))
+                    return false;
+                if (literals > size_t(end - in) || literals > size_t(op_end - op))
+                    return false;
+                memcpy(op, in, literals);
+                in += literals;
+                op += literals;
+                // only the last sequence has no match after its literals
+                if (in == end)
+                    return op == op_end;
+
+                if (end - in < 2)
+                    return false;
+                size_t offset = in[0] | (size_t(in[1]) << 8);
+                in += 2;
+                if (offset == 0 || offset > size_t(op - out))
+                    return false;
+                size_t length = token & 15;
+                if (length == 15 && !get_length(in, end, length))
+                    return false;
+                length += min_match;
+                if (length > size_t(op_end - op))
+                    return false;
+                auto* from = op - offset;
+                if (offset >= length)
+                    memcpy(op, from, length);
+                else
+                {
+                    // the match overlaps what it is writing, which is how runs are encoded
+                    for (size_t i = 0; i < length; i++)
+                        op[i] = from[i];
+                }
+                op += length;
+            }
+        }
+
+        void pack(std::vector<char>& buffer)
+        {
+            auto size = buffer.size();
+            if (size >= get_threshold())
+            {
+                std::vector<char> packed;
+                packed.reserve(size / 2 + 16);
+                packed.push_back((char)frame::compressed);
+                put_varint(packed, size);
+                compress(buffer.data(), size, packed);
+                if (packed.size() < size + 1)
+                {
+                    buffer.swap(packed);
+                    return;
+                }
+            }
+            // small or incompressible payloads are stored behind the header byte
+            buffer.insert(buffer.begin(), (char)frame::stored);
+        }
+
+        size_t unpacked_size(const char* frame_data, size_t frame_size)
+        {
+            if (frame_size == 0 || (frame)frame_data[0] != frame::compressed)
+                return 0;
+            auto* in = (const uint8_t*)frame_data + 1;
+            auto* end = (const uint8_t*)frame_data + frame_size;
+            uint64_t raw_size = 0;
+            if (!get_varint(in, end, raw_size) || raw_size > uint64_t(end - in) * max_ratio)
+                return 0;
+            return (size_t)raw_size;
+        }
+
+        bool unpack(
+            const char* frame_data, size_t frame_size, std::vector<char>& scratch, const char*& data, size_t& size)
+        {
+            if (frame_size == 0)
+                return false;
+            auto* in = (const uint8_t*)frame_data;
+            auto* end = in + frame_size;
+            auto header = (frame)*in++;
+            if (header == frame::stored)
+            {
+                data = frame_data + 1;
+                size = frame_size - 1;
+                return true;
+            }
+            if (header != frame::compressed)
+                return false;
+            uint64_t raw_size = 0;
+            if (!get_varint(in, end, raw_size))
+                return false;
+            auto block_size = size_t(end - in);
+            if (raw_size > uint64_t(block_size) * max_ratio)
+                return false;
+            scratch.resize(raw_size);
+            if (!decompress((const char*)in, block_size, scratch.data(), raw_size))
+                return false;
+            data = scratch.data();
+            size = raw_size;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <rpc/object_slot_table.h>
+#include <rpc/assert.h>
+
+namespace rpc
+{
+    object_slot_table::~object_slot_table()
+    {
+        for (auto& seg : segments_)
+            delete seg.load(std::memory_order_relaxed);
+    }
+
+    object_slot_table::slot* object_slot_table::get_slot(uint32_t index) const
+    {
+        auto segment_index = index / segment_size;
+        if (segment_index >= max_segments)
+            return nullptr;
+        auto* seg = segments_[segment_index].load(std::memory_order_acquire);
+        if (!seg)
+            return nullptr;
+        return &seg->slots[index % segment_size];
+    }
+
+    object object_slot_table::reserve()
+    {
+        uint32_t index = 0;
+        {
+            std::lock_guard g(allocation_control);
+            if (!free_slots_.empty())
+            {
+                index = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            else
+            {
+                if (next_slot_ == segment_size * max_segments)
+                    return {0};
+                index = next_slot_;
+                auto segment_index = index / segment_size;
+                if (!segments_[segment_index].load(std::memory_order_relaxed))
+                    segments_[segment_index].store(new segment(), std::memory_order_release);
+                next_slot_++;
+            }
+        }
+
+        auto* s = get_slot(index);
+        s->lock();
+        RPC_ASSERT(!s->occupied);
+        s->occupied = true;
+        auto generation = s->generation.load(std::memory_order_relaxed);
+        s->unlock();
+        return {((uint64_t)generation << 32) | index};
+    }
+
+    void object_slot_table::publish(object id, const rpc::weak_ptr<object_stub>& stub)
+    {
+        auto* s = get_slot((uint32_t)id.id);
+        RPC_ASSERT(s);
+        if (!s)
+            return;
+        s->lock();
+        RPC_ASSERT(s->occupied && s->generation.load(std::memory_order_relaxed) == (uint32_t)(id.id >> 32));
+        s->stub = stub;
+        s->unlock();
+    }
+
+    rpc::weak_ptr<object_stub> object_slot_table::find(object id) const
+    {
+        auto* s = get_slot((uint32_t)id.id);
+        auto generation = (uint32_t)(id.id >> 32);
+        // the unlocked check rejects stale ids without touching the slot lock
+        if (!s || s->generation.load(std::memory_order_acquire) != generation)
+            return {};
+        s->lock();
+        rpc::weak_ptr<object_stub> stub;
+        if (s->occupied && s->generation.load(std::memory_order_relaxed) == generation)
+            stub = s->stub;
+        s->unlock();
+        return stub;
+    }
+
+    bool object_slot_table::free(object id)
+    {
+        auto index = (uint32_t)id.id;
+        auto* s = get_slot(index);
+        if (!s)
+            return false;
+        s->lock();
+        if (!s->occupied || s->generation.load(std::memory_order_relaxed) != (uint32_t)(id.id >> 32))
+        {
+            s->unlock();
+            return false;
+        }
+        s->occupied = false;
+        s->stub.reset();
+        auto generation = s->generation.load(std::memory_order_relaxed) + 1;
+        // generation zero would make the id of slot zero indistinguishable from an unset object id
+        if (!generation)
+            generation = 1;
+        s->generation.store(generation, std::memory_order_release);
+        s->unlock();
+
+        std::lock_guard g(allocation_control);
+        free_slots_.push_back(index);
+        return true;
+    }
+}
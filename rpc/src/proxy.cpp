@@ -23,7 +23,7 @@ namespace rpc
         }
 #endif
 
-        service_proxy_->on_object_proxy_released(object_id_);
+        service_proxy_->on_object_proxy_released(object_id_, reference_credit_.load());
         service_proxy_ = nullptr;
     }
 
@@ -51,11 +51,120 @@ namespace rpc
             encoding::enc_default, tag, object_id_, id_getter, method_id, in_size_, in_buf_, out_buf_);
     }
 
+    int object_proxy::send(rpc::encoding encoding,
+        uint64_t tag,
+        std::function<interface_ordinal(uint64_t)> id_getter,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        return service_proxy_->send_from_this_zone(
+            encoding, tag, object_id_, id_getter, method_id, in_size_, in_buf_, out_buf_);
+    }
+
+    int object_proxy::post(rpc::encoding encoding,
+        uint64_t tag,
+        std::function<interface_ordinal(uint64_t)> id_getter,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_)
+    {
+        return service_proxy_->post_from_this_zone(encoding, tag, object_id_, id_getter, method_id, in_size_, in_buf_);
+    }
+
+#ifdef BUILD_COROUTINE
+    task<int> object_proxy::async_send(rpc::encoding encoding,
+        uint64_t tag,
+        std::function<interface_ordinal(uint64_t)> id_getter,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        co_return co_await service_proxy_->async_send_from_this_zone(
+            encoding, tag, object_id_, id_getter, method_id, in_size_, in_buf_, out_buf_);
+    }
+#endif
+
     int object_proxy::try_cast(std::function<interface_ordinal(uint64_t)> id_getter)
     {
         return service_proxy_->sp_try_cast(service_proxy_->get_destination_zone_id(), object_id_, id_getter);
     }
 
+    rpc::shared_ptr<proxy_base> object_proxy::find_cached_proxy(interface_ordinal interface_id) const
+    {
+        for (auto& slot : interface_slots_)
+        {
+            auto id = slot.interface_id.load(std::memory_order_acquire);
+            if (!id)
+                break; // slots are claimed in order so there is nothing beyond an empty one
+            if (id != interface_id.get_val())
+                continue;
+            slot.lock();
+            auto proxy = slot.proxy.lock();
+            slot.unlock();
+            return proxy;
+        }
+        return nullptr;
+    }
+
+    bool object_proxy::lookup_proxy(interface_ordinal interface_id, rpc::shared_ptr<proxy_base>& proxy)
+    {
+        for (auto& slot : interface_slots_)
+        {
+            auto id = slot.interface_id.load(std::memory_order_relaxed);
+            if (!id)
+                break;
+            if (id != interface_id.get_val())
+                continue;
+            slot.lock();
+            proxy = slot.proxy.lock();
+            slot.unlock();
+            return true;
+        }
+        auto item = proxy_map.find(interface_id);
+        if (item == proxy_map.end())
+            return false;
+        proxy = item->second.lock();
+        return true;
+    }
+
+    void object_proxy::store_proxy(interface_ordinal interface_id, const rpc::shared_ptr<proxy_base>& proxy)
+    {
+        for (auto& slot : interface_slots_)
+        {
+            auto id = slot.interface_id.load(std::memory_order_relaxed);
+            if (id && id != interface_id.get_val())
+                continue;
+            slot.lock();
+            slot.proxy = proxy;
+            slot.unlock();
+            // publish the id after the proxy so that readers never see a claimed slot without it
+            if (!id)
+                slot.interface_id.store(interface_id.get_val(), std::memory_order_release);
+            return;
+        }
+        proxy_map[interface_id] = proxy;
+    }
+
+    bool object_proxy::is_refused_interface(interface_ordinal interface_id) const
+    {
+        for (auto& refused : refused_interfaces_)
+        {
+            if (refused.load(std::memory_order_relaxed) == interface_id.get_val())
+                return true;
+        }
+        return false;
+    }
+
+    void object_proxy::add_refused_interface(interface_ordinal interface_id)
+    {
+        // a small ring, the oldest refusal is forgotten first
+        auto index = next_refused_interface_.fetch_add(1, std::memory_order_relaxed) % refused_interface_count;
+        refused_interfaces_[index].store(interface_id.get_val(), std::memory_order_relaxed);
+    }
+
     destination_zone object_proxy::get_destination_zone_id() const
     {
         return service_proxy_->get_destination_zone_id();
@@ -0,0 +1,101 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <thread>
+
+#include <rpc/rcu_map.h>
+
+namespace rpc
+{
+    // the slot a thread claimed, given back when the thread exits.  depth lets nested reads share the outermost
+    // section as that already holds back any writer that started after it
+    struct rcu_domain::thread_reader
+    {
+        reader_slot* slot = nullptr;
+        size_t depth = 0;
+
+        ~thread_reader()
+        {
+            if (slot)
+                slot->owned.store(false);
+            slot = nullptr;
+        }
+    };
+
+    rcu_domain& rcu_domain::get()
+    {
+        static rcu_domain* domain = new rcu_domain();
+        return *domain;
+    }
+
+    rcu_domain::thread_reader& rcu_domain::this_reader()
+    {
+        thread_local thread_reader reader;
+        return reader;
+    }
+
+    rcu_domain::read_section::read_section()
+    {
+        auto& domain = get();
+        auto& reader = this_reader();
+        if (reader.depth++)
+            return;
+
+        if (!reader.slot)
+        {
+            for (auto& slot : domain.slots_)
+            {
+                bool expected = false;
+                if (!slot.owned.load(std::memory_order_relaxed) && slot.owned.compare_exchange_strong(expected, true))
+                {
+                    reader.slot = &slot;
+                    break;
+                }
+            }
+        }
+
+        if (reader.slot)
+        {
+            slot_ = reader.slot;
+            slot_->epoch.store(domain.epoch_.load());
+        }
+        else
+        {
+            overflow_ = &domain.overflow_readers_[domain.epoch_.load() & 1];
+            overflow_->count.fetch_add(1);
+        }
+    }
+
+    rcu_domain::read_section::~read_section()
+    {
+        if (--this_reader().depth)
+            return;
+        if (slot_)
+            slot_->epoch.store(idle);
+        else if (overflow_)
+            overflow_->count.fetch_sub(1);
+    }
+
+    void rcu_domain::synchronize()
+    {
+        std::lock_guard g(writer_control_);
+
+        // a slot reader that loaded the old snapshot published an epoch older than target before it did so
+        auto target = epoch_.fetch_add(1) + 1;
+        for (auto& slot : slots_)
+        {
+            while (slot.epoch.load() < target)
+                std::this_thread::yield();
+        }
+
+        // the overflow counters need the epoch flipped twice and the old parity drained each time, that covers a
+        // reader that read the epoch just before the first flip
+        for (int i = 0; i < 2; i++)
+        {
+            auto& old_readers = overflow_readers_[epoch_.fetch_add(1) & 1];
+            while (old_readers.count.load() != 0)
+                std::this_thread::yield();
+        }
+    }
+}
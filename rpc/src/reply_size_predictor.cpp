@@ -0,0 +1,63 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <algorithm>
+
+#include <rpc/reply_size_predictor.h>
+
+namespace rpc
+{
+    size_t reply_size_predictor::predict(interface_ordinal interface_id, method method_id) const
+    {
+        if (!enabled_.load(std::memory_order_relaxed))
+            return 0;
+        size_t largest = 0;
+        {
+            std::lock_guard g(control_);
+            auto it = histories_.find({interface_id, method_id});
+            if (it == histories_.end())
+                return 0;
+            largest = std::max(it->second.window_max, it->second.previous_window_max);
+        }
+        // headroom for replies that vary a little, such as strings, so they do not retry every time they grow
+        return largest + largest / 8;
+    }
+
+    void reply_size_predictor::record(interface_ordinal interface_id, method method_id, size_t reply_size, bool retried)
+    {
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        if (retried)
+            retries_.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard g(control_);
+        auto& h = histories_[{interface_id, method_id}];
+        h.totals.calls++;
+        if (retried)
+            h.totals.retries++;
+        h.window_max = std::max(h.window_max, reply_size);
+        if (++h.window_calls == window_size)
+        {
+            h.previous_window_max = h.window_max;
+            h.window_max = 0;
+            h.window_calls = 0;
+        }
+    }
+
+    reply_size_predictor::stats reply_size_predictor::get_stats(interface_ordinal interface_id, method method_id) const
+    {
+        std::lock_guard g(control_);
+        auto it = histories_.find({interface_id, method_id});
+        if (it == histories_.end())
+            return {};
+        return it->second.totals;
+    }
+
+    void reply_size_predictor::reset()
+    {
+        std::lock_guard g(control_);
+        histories_.clear();
+        calls_ = 0;
+        retries_ = 0;
+    }
+}
@@ -8,6 +8,7 @@
 #include <yas/std_types.hpp>
 
 #include "rpc/service.h"
+#include "rpc/call_batch.h"
 #include "rpc/stub.h"
 #include "rpc/proxy.h"
 #include "rpc/version.h"
@@ -56,10 +57,85 @@ namespace rpc
 
     object service::generate_new_object_id() const
     {
+        if (object_slots_)
+            return object_slots_->reserve();
         auto count = ++object_id_generator;
         return {count};
     }
 
+    void service::enable_dense_object_ids()
+    {
+        RPC_ASSERT(wrapped_object_to_stub.empty());
+        if (!object_slots_)
+            object_slots_ = std::make_unique<object_slot_table>();
+    }
+
+    void service::configure_strands(bool all_objects, std::shared_ptr<executor> ex)
+    {
+        RPC_ASSERT(wrapped_object_to_stub.empty());
+        strand_all_objects_ = all_objects;
+        strand_executor_ = std::move(ex);
+    }
+
+    void service::register_stub(object object_id, const rpc::weak_ptr<object_stub>& stub)
+    {
+        if (object_slots_)
+            object_slots_->publish(object_id, stub);
+        else
+            stubs.insert_or_assign(object_id, stub);
+    }
+
+    void service::deregister_stub(object object_id)
+    {
+        if (object_slots_)
+            object_slots_->free(object_id);
+        else
+            stubs.erase(object_id);
+    }
+
+    rpc::shared_ptr<service_proxy> service::find_route(destination_zone destination_zone_id, caller_zone caller_zone_id) const
+    {
+        rpc::weak_ptr<service_proxy> route;
+        if (!other_zones.find({destination_zone_id, caller_zone_id}, route))
+            return nullptr;
+        return route.lock();
+    }
+
+    rpc::shared_ptr<service_proxy> service::find_any_route(destination_zone destination_zone_id) const
+    {
+        auto route = other_zones.read(
+            [&](const auto& zones)
+            {
+                auto found = zones.lower_bound({destination_zone_id, {0}});
+                if (found != zones.end() && found->first.dest == destination_zone_id)
+                    return found->second;
+                return rpc::weak_ptr<service_proxy>();
+            });
+        return route.lock();
+    }
+
+    bool service::take_reference_credit(const rpc::shared_ptr<object_proxy>& object_proxy) const
+    {
+        if (!indirect_reference_counting_)
+            return false;
+        // only over a direct channel to the owner, otherwise the zones in between would miss the add_ref that builds
+        // their routes
+        if (object_proxy->get_service_proxy()->get_destination_channel_zone_id().is_set())
+            return false;
+        return object_proxy->try_take_reference_credit();
+    }
+
+    bool service::find_stub(object object_id, rpc::weak_ptr<object_stub>& stub) const
+    {
+        if (object_slots_)
+        {
+            // a stale id fails the generation check and comes back empty
+            stub = object_slots_->find(object_id);
+            return !stub.expired();
+        }
+        return stubs.find(object_id, stub);
+    }
+
     service::service(const char* name, zone zone_id)
         : zone_id_(zone_id)
         , name_(name)
@@ -83,12 +159,27 @@ namespace rpc
         (void)is_empty;
         RPC_ASSERT(is_empty);
 
-        {
-            std::lock_guard l(stub_control);
-            stubs.clear();
-            wrapped_object_to_stub.clear();
-        }
+        stubs.clear();
+        object_slots_.reset();
+        wrapped_object_to_stub.clear();
         other_zones.clear();
+
+        // joins the threads of the executors handed over by their last owner
+        for (auto& ex : retired_executors_)
+            RPC_ASSERT(!ex->is_current());
+        retired_executors_.clear();
+    }
+
+    void service::retire_executor(std::shared_ptr<executor> ex)
+    {
+        std::lock_guard g(retired_executors_control_);
+        retired_executors_.push_back(std::move(ex));
+    }
+
+    size_t service::get_retired_executor_count() const
+    {
+        std::lock_guard g(retired_executors_control_);
+        return retired_executors_.size();
     }
 
     object service::get_object_id(shared_ptr<casting_interface> ptr) const
@@ -98,11 +189,10 @@ namespace rpc
         auto* addr = ptr->get_address();
         if (addr)
         {
-            std::lock_guard g(stub_control);
-            auto item = wrapped_object_to_stub.find(addr);
-            if (item != wrapped_object_to_stub.end())
+            rpc::weak_ptr<object_stub> weak_stub;
+            if (wrapped_object_to_stub.find(addr, weak_stub))
             {
-                auto obj = item->second.lock();
+                auto obj = weak_stub.lock();
                 if (obj)
                     return obj->get_id();
             }
@@ -116,58 +206,65 @@ namespace rpc
 
     bool service::check_is_empty() const
     {
-        std::lock_guard l(stub_control);
         bool success = true;
-        for (const auto& item : stubs)
+        auto check_stub = [&](const object& object_id, const rpc::weak_ptr<object_stub>& weak_stub)
         {
-            auto stub = item.second.lock();
+            (void)object_id;
+            auto stub = weak_stub.lock();
             if (!stub)
             {
 #ifdef USE_RPC_LOGGING
-                auto message = std::string("stub zone_id ") + std::to_string(zone_id_) + std::string(", object stub ")
-                               + std::to_string(item.first)
-                               + std::string(
-                                   " has been released but not deregistered in the service suspected unclean shutdown");
+                auto message = std::string("stub zone_id ") + std::to_string(zone_id_)
+                               + std::string(", object stub ") + std::to_string(object_id)
+                               + std::string(" has been released but not deregistered in the service suspected "
+                                             "unclean shutdown");
                 LOG_STR(message.c_str(), message.size());
 #endif
             }
             else
             {
 #ifdef USE_RPC_LOGGING
-                auto message = std::string("stub zone_id ") + std::to_string(zone_id_) + std::string(", object stub ")
-                               + std::to_string(item.first)
-                               + std::string(" has not been released, there is a strong pointer maintaining a positive "
-                                             "reference count suspected unclean shutdown");
+                auto message = std::string("stub zone_id ") + std::to_string(zone_id_)
+                               + std::string(", object stub ") + std::to_string(object_id)
+                               + std::string(" has not been released, there is a strong pointer maintaining a "
+                                             "positive reference count suspected unclean shutdown");
                 LOG_STR(message.c_str(), message.size());
 #endif
             }
             success = false;
-        }
-        for (auto item : wrapped_object_to_stub)
-        {
-            auto stub = item.second.lock();
-            if (!stub)
+        };
+        stubs.for_each(check_stub);
+        if (object_slots_)
+            object_slots_->for_each(check_stub);
+        wrapped_object_to_stub.for_each(
+            [&](void* pointer, const rpc::weak_ptr<object_stub>& weak_stub)
             {
+                (void)pointer;
+                auto stub = weak_stub.lock();
+                if (!stub)
+                {
 #ifdef USE_RPC_LOGGING
-                auto message = std::string("wrapped stub zone_id ") + std::to_string(zone_id_)
-                               + std::string(", wrapped_object has been released but not deregistered in the service "
-                                             "suspected unclean shutdown");
-                LOG_STR(message.c_str(), message.size());
+                    auto message = std::string("wrapped stub zone_id ") + std::to_string(zone_id_)
+                                   + std::string(", wrapped_object has been released but not deregistered in the "
+                                                 "service suspected unclean shutdown");
+                    LOG_STR(message.c_str(), message.size());
 #endif
-            }
-            else
-            {
+                }
+                else
+                {
 #ifdef USE_RPC_LOGGING
-                auto message = std::string("wrapped stub zone_id ") + std::to_string(zone_id_)
-                               + std::string(", wrapped_object ") + std::to_string(stub->get_id())
-                               + std::string(" has not been deregisted in the service suspected unclean shutdown");
-                LOG_STR(message.c_str(), message.size());
+                    auto message = std::string("wrapped stub zone_id ") + std::to_string(zone_id_)
+                                   + std::string(", wrapped_object ") + std::to_string(stub->get_id())
+                                   + std::string(" has not been deregisted in the service suspected unclean shutdown");
+                    LOG_STR(message.c_str(), message.size());
 #endif
-            }
-            success = false;
-        }
+                }
+                success = false;
+            });
 
-        for (auto item : other_zones)
+        // take a copy of the routes so that no service proxy is released while inside a read of the routing table
+        auto zones = other_zones.read([](const auto& zones) { return zones; });
+        for (auto item : zones)
         {
             auto svcproxy = item.second.lock();
             if (!svcproxy)
@@ -235,20 +332,15 @@ namespace rpc
 
         if (destination_zone_id != zone_id_.as_destination())
         {
-            rpc::shared_ptr<service_proxy> other_zone;
-            {
-                std::lock_guard g(zone_control);
-                auto found = other_zones.find({destination_zone_id, caller_zone_id});
-                if (found != other_zones.end())
-                {
-                    other_zone = found->second.lock();
-                }
-            }
+            auto other_zone = find_route(destination_zone_id, caller_zone_id);
             if (!other_zone)
             {
                 RPC_ASSERT(false);
                 return rpc::error::ZONE_NOT_FOUND();
             }
+            // an argument pack cannot be forwarded out of this address space, the caller will serialise instead
+            if (encoding == encoding::direct && other_zone->get_encoding() != encoding::direct)
+                return rpc::error::INCOMPATIBLE_SERIALISATION();
             return other_zone->send(protocol_version,
                 encoding,
                 tag,
@@ -272,6 +364,31 @@ namespace rpc
             {
                 return rpc::error::INCOMPATIBLE_SERVICE();
             }
+            // handed to the dispatcher and sent again from there, which sets up the trackers on its thread.  A call made
+            // on a worker, for instance one coming back into this zone while the dispatched call that caused it is
+            // blocked, runs inline as every dispatcher thread may be waiting on it
+            if (dispatcher_ && !dispatcher_->is_current() && !worker_scope::is_worker())
+            {
+                return run_on(*dispatcher_,
+                    [&]()
+                    {
+                        return send(protocol_version,
+                            encoding,
+                            tag,
+                            caller_channel_zone_id,
+                            caller_zone_id,
+                            destination_zone_id,
+                            object_id,
+                            interface_id,
+                            method_id,
+                            in_size_,
+                            in_buf_,
+                            out_buf_);
+                    });
+            }
+            if (is_batch_call(object_id, interface_id, method_id))
+                return send_batch(
+                    protocol_version, encoding, caller_channel_zone_id, caller_zone_id, in_size_, in_buf_, out_buf_);
             rpc::weak_ptr<object_stub> weak_stub = get_object(object_id);
             auto stub = weak_stub.lock();
             if (stub == nullptr)
@@ -285,25 +402,283 @@ namespace rpc
                         caller_zone_id, object_id, interface_id, method_id, in_size_, in_buf_ ? in_buf_ : "");
                 });
 
-            auto ret = stub->call(protocol_version,
+            auto call = [&]()
+            {
+                return stub->call(protocol_version,
+                    encoding,
+                    caller_channel_zone_id,
+                    caller_zone_id,
+                    interface_id,
+                    method_id,
+                    in_size_,
+                    in_buf_,
+                    out_buf_);
+            };
+            int ret = 0;
+            if (auto* strand = stub->get_strand())
+            {
+                ret = run_on(*strand,
+                    [&]()
+                    {
+                        // a queued call may be run by another callers thread
+                        current_service_tracker strand_tracker(this);
+                        current_caller_manager strand_cc(caller_zone_id);
+                        return call();
+                    });
+            }
+            else
+                ret = call();
+
+            std::for_each(service_loggers.begin(),
+                service_loggers.end(),
+                [&](const std::shared_ptr<service_logger>& logger)
+                { logger->after_send(caller_zone_id, object_id, interface_id, method_id, ret, out_buf_); });
+
+            return ret;
+        }
+    }
+
+    int service::send_batch(uint64_t protocol_version,
+        encoding encoding,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        if (!is_batch_encoding(encoding))
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        std::vector<batched_call> calls;
+        std::string error;
+        rpc::span in(in_buf_, in_buf_ + in_size_);
+        if (encoding == encoding::yas_json)
+            error = rpc::from_yas_json(in, calls);
+        else if (encoding == encoding::yas_binary || encoding == encoding::enc_default)
+            error = rpc::from_yas_binary(in, calls);
+        else
+            error = rpc::from_yas_compressed_binary(in, calls);
+        if (!error.empty())
+        {
+#ifdef USE_RPC_LOGGING
+            LOG_STR(error.data(), error.size());
+#endif
+            return rpc::error::STUB_DESERIALISATION_ERROR();
+        }
+
+        // each call takes the same path as if it had been sent on its own
+        std::vector<batched_reply> replies(calls.size());
+        for (size_t i = 0; i < calls.size(); i++)
+        {
+            auto& call = calls[i];
+            if (is_batch_call(call.object_id, call.interface_id, call.method_id))
+            {
+                replies[i].result = rpc::error::INVALID_DATA();
+                continue;
+            }
+            replies[i].result = send(protocol_version,
                 encoding,
+                call.tag,
                 caller_channel_zone_id,
                 caller_zone_id,
+                zone_id_.as_destination(),
+                call.object_id,
+                call.interface_id,
+                call.method_id,
+                call.in.size(),
+                call.in.data(),
+                replies[i].out);
+        }
+        out_buf_ = rpc::serialise<std::vector<batched_reply>, std::vector<char>>(replies, encoding);
+        return rpc::error::OK();
+    }
+
+    int service::post(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_)
+    {
+        if (destination_zone_id == zone_id_.as_destination())
+        {
+            return i_marshaller::post(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_);
+        }
+
+        current_service_tracker tracker(this);
+        current_caller_manager cc(caller_zone_id);
+        auto other_zone = find_route(destination_zone_id, caller_zone_id);
+        if (!other_zone)
+        {
+            RPC_ASSERT(false);
+            return rpc::error::ZONE_NOT_FOUND();
+        }
+        if (encoding == encoding::direct && other_zone->get_encoding() != encoding::direct)
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        return other_zone->post(protocol_version,
+            encoding,
+            tag,
+            zone_id_.as_caller_channel(),
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            in_size_,
+            in_buf_);
+    }
+
+#ifdef BUILD_COROUTINE
+    // the routing mirrors send, but forwarding awaits the next hop so that a transport that suspends does not park this
+    // thread.  The service and caller trackers are thread local so a stub that suspends must resume on the same thread
+    task<int> service::async_send(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        if (destination_zone_id != zone_id_.as_destination())
+        {
+            auto other_zone = find_route(destination_zone_id, caller_zone_id);
+            if (!other_zone)
+            {
+                RPC_ASSERT(false);
+                co_return rpc::error::ZONE_NOT_FOUND();
+            }
+            if (encoding == encoding::direct && other_zone->get_encoding() != encoding::direct)
+                co_return rpc::error::INCOMPATIBLE_SERIALISATION();
+            co_return co_await other_zone->async_send(protocol_version,
+                encoding,
+                tag,
+                zone_id_.as_caller_channel(),
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
                 interface_id,
                 method_id,
                 in_size_,
                 in_buf_,
                 out_buf_);
+        }
 
-            std::for_each(service_loggers.begin(),
-                service_loggers.end(),
-                [&](const std::shared_ptr<service_logger>& logger)
-                { logger->after_send(caller_zone_id, object_id, interface_id, method_id, ret, out_buf_); });
+#ifdef RPC_V2
+        if (protocol_version == rpc::VERSION_2)
+            ;
+        else
+#endif
+        {
+            co_return rpc::error::INCOMPATIBLE_SERVICE();
+        }
+        if (dispatcher_ && !dispatcher_->is_current() && !worker_scope::is_worker())
+        {
+            co_return send(protocol_version,
+                encoding,
+                tag,
+                caller_channel_zone_id,
+                caller_zone_id,
+                destination_zone_id,
+                object_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
+        }
+        if (is_batch_call(object_id, interface_id, method_id))
+            co_return send_batch(
+                protocol_version, encoding, caller_channel_zone_id, caller_zone_id, in_size_, in_buf_, out_buf_);
+        auto stub = get_object(object_id).lock();
+        if (stub == nullptr)
+        {
+            co_return rpc::error::INVALID_DATA();
+        }
 
-            return ret;
+        current_service_tracker tracker(this);
+        current_caller_manager cc(caller_zone_id);
+        std::for_each(service_loggers.begin(),
+            service_loggers.end(),
+            [&](const std::shared_ptr<service_logger>& logger)
+            { logger->before_send(caller_zone_id, object_id, interface_id, method_id, in_size_, in_buf_ ? in_buf_ : ""); });
+
+        int ret = 0;
+        if (auto* strand = stub->get_strand())
+        {
+            // a strand serialises whole calls, so an object with one is called synchronously rather than being left
+            // suspended while holding its strand
+            ret = run_on(*strand,
+                [&]()
+                {
+                    current_service_tracker strand_tracker(this);
+                    current_caller_manager strand_cc(caller_zone_id);
+                    return stub->call(protocol_version,
+                        encoding,
+                        caller_channel_zone_id,
+                        caller_zone_id,
+                        interface_id,
+                        method_id,
+                        in_size_,
+                        in_buf_,
+                        out_buf_);
+                });
+        }
+        else
+        {
+            ret = co_await stub->async_call(protocol_version,
+                encoding,
+                caller_channel_zone_id,
+                caller_zone_id,
+                interface_id,
+                method_id,
+                in_size_,
+                in_buf_,
+                out_buf_);
         }
+
+        std::for_each(service_loggers.begin(),
+            service_loggers.end(),
+            [&](const std::shared_ptr<service_logger>& logger)
+            { logger->after_send(caller_zone_id, object_id, interface_id, method_id, ret, out_buf_); });
+        co_return ret;
     }
 
+    task<int> service::async_try_cast(
+        uint64_t protocol_version, destination_zone destination_zone_id, object object_id, interface_ordinal interface_id)
+    {
+        if (destination_zone_id != zone_id_.as_destination())
+        {
+            auto other_zone = find_any_route(destination_zone_id);
+            if (!other_zone)
+            {
+                RPC_ASSERT(false);
+                co_return rpc::error::ZONE_NOT_FOUND();
+            }
+            co_return co_await other_zone->async_try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+        }
+        co_return try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+    }
+#endif
+
     void service::clean_up_on_failed_connection(
         const rpc::shared_ptr<service_proxy>& destination_zone, rpc::shared_ptr<rpc::casting_interface> input_interface)
     {
@@ -343,19 +718,23 @@ namespace rpc
         destination_zone = object_service_proxy;
         {
             std::lock_guard g(zone_control);
-            auto found = other_zones.find({destination_zone_id, caller_zone_id}); // we dont need to get caller id for this
-            if (found != other_zones.end())
+            rpc::weak_ptr<service_proxy> found;
+            if (other_zones.find({destination_zone_id, caller_zone_id}, found)) // we dont need to get caller id for this
             {
-                destination_zone = found->second.lock();
+                destination_zone = found.lock();
             }
             else
             {
                 destination_zone = object_service_proxy->clone_for_zone(destination_zone_id, caller_zone_id);
-                other_zones[{destination_zone_id, caller_zone_id}] = destination_zone;
+                other_zones.insert_or_assign({destination_zone_id, caller_zone_id}, destination_zone);
             }
             destination_zone->add_external_ref();
         }
 
+        // lend out a reference we already hold rather than going back to the owner
+        if (take_reference_credit(object_proxy))
+            return {object_id, destination_zone_id};
+
 #ifdef USE_RPC_TELEMETRY
         if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
         {
@@ -435,11 +814,11 @@ namespace rpc
             {
                 std::lock_guard g(zone_control);
                 {
-                    auto found = other_zones.find(
-                        {destination_zone_id, caller_zone_id}); // we dont need to get caller id for this
-                    if (found != other_zones.end())
+                    rpc::weak_ptr<service_proxy> found;
+                    if (other_zones.find(
+                            {destination_zone_id, caller_zone_id}, found)) // we dont need to get caller id for this
                     {
-                        destination_zone = found->second.lock();
+                        destination_zone = found.lock();
                         destination_zone->add_external_ref();
                     }
                     else
@@ -450,55 +829,61 @@ namespace rpc
                 }
                 // and the caller with destination info
                 {
-                    auto found = other_zones.find(
-                        {{object_channel}, zone_id_.as_caller()}); // we dont need to get caller id for this
-                    if (found == other_zones.end())
+                    rpc::weak_ptr<service_proxy> found;
+                    if (!other_zones.find(
+                            {{object_channel}, zone_id_.as_caller()}, found)) // we dont need to get caller id for this
                     {
                         // this is working on the premise that the caller_channel_zone_id is not known but
                         // object_channel is
                         RPC_ASSERT(object_channel == caller_channel_zone_id.get_val()
                                    && object_channel != caller_zone_id.get_val());
 
-                        auto alternative = other_zones.lower_bound({caller_zone_id.as_destination(), {0}});
-                        if (alternative == other_zones.end() || alternative->first.dest != caller_zone_id.as_destination())
+                        auto alternative_caller_service_proxy = find_any_route(caller_zone_id.as_destination());
+                        if (!alternative_caller_service_proxy)
                         {
                             RPC_ASSERT(!!"alternative route to caller zone is not found");
                             return {};
                         }
 
-                        auto alternative_caller_service_proxy = alternative->second.lock();
-                        RPC_ASSERT(alternative_caller_service_proxy != nullptr || !!"alternative caller proxy not found");
-
                         // now make a copy of the original as we need it back
                         caller = alternative_caller_service_proxy->clone_for_zone(
                             {caller_channel_zone_id.get_val()}, zone_id_.as_caller());
-                        other_zones[{{caller_channel_zone_id.get_val()}, zone_id_.as_caller()}] = caller;
+                        other_zones.insert_or_assign({{caller_channel_zone_id.get_val()}, zone_id_.as_caller()}, caller);
                     }
                     else
                     {
-                        caller = found->second.lock();
+                        caller = found.lock();
                     }
                 }
                 RPC_ASSERT(caller);
             }
 
-#ifdef USE_RPC_TELEMETRY
-            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            // lend out a reference we already hold rather than going back to the owner, the caller route still
+            // needs building
+            if (!take_reference_credit(object_proxy))
             {
-                telemetry_service->on_service_proxy_add_ref(
-                    zone_id_, destination_zone_id, {0}, caller_zone_id, object_id, rpc::add_ref_options::build_destination_route);
-            }
+#ifdef USE_RPC_TELEMETRY
+                if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                {
+                    telemetry_service->on_service_proxy_add_ref(zone_id_,
+                        destination_zone_id,
+                        {0},
+                        caller_zone_id,
+                        object_id,
+                        rpc::add_ref_options::build_destination_route);
+                }
 #endif
 
-            // the fork is here so we need to add ref the destination normally with caller info
-            // note the caller_channel_zone_id is is this zones id as the caller came from a route via this node
-            destination_zone->add_ref(protocol_version,
-                {0},
-                destination_zone_id,
-                object_id,
-                zone_id_.as_caller_channel(),
-                caller_zone_id,
-                rpc::add_ref_options::build_destination_route);
+                // the fork is here so we need to add ref the destination normally with caller info
+                // note the caller_channel_zone_id is is this zones id as the caller came from a route via this node
+                destination_zone->add_ref(protocol_version,
+                    {0},
+                    destination_zone_id,
+                    object_id,
+                    zone_id_.as_caller_channel(),
+                    caller_zone_id,
+                    rpc::add_ref_options::build_destination_route);
+            }
 
 #ifdef USE_RPC_TELEMETRY
             if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
@@ -554,40 +939,58 @@ namespace rpc
 
         auto* pointer = iface->get_address();
         {
-            // find the stub by its address
+            // find the stub by its address, a stub that is already there only needs a shared lock on its shard
+            rpc::weak_ptr<object_stub> weak_stub;
+            if (wrapped_object_to_stub.find(pointer, weak_stub))
             {
-                std::lock_guard g(stub_control);
-                auto item = wrapped_object_to_stub.find(pointer);
-                if (item != wrapped_object_to_stub.end())
-                {
-                    stub = item->second.lock();
-                    stub->add_ref();
-                }
-                else
-                {
-                    // else create a stub
-                    auto id = generate_new_object_id();
-                    stub = rpc::make_shared<object_stub>(id, *this, pointer);
-                    rpc::shared_ptr<i_interface_stub> interface_stub = fn(stub);
-                    stub->add_interface(interface_stub);
-                    wrapped_object_to_stub[pointer] = stub;
-                    stubs[id] = stub;
-                    stub->on_added_to_zone(stub);
-                    stub->add_ref();
-                }
+                stub = weak_stub.lock();
+                if (stub && !stub->try_add_ref())
+                    stub = nullptr;
+            }
+            if (!stub)
+            {
+                // the shard lock makes the create atomic for this pointer, another thread may have got here first
+                wrapped_object_to_stub.with_exclusive(pointer,
+                    [&](std::unordered_map<void*, rpc::weak_ptr<object_stub>>& wrapped_stubs)
+                    {
+                        auto item = wrapped_stubs.find(pointer);
+                        if (item != wrapped_stubs.end())
+                        {
+                            stub = item->second.lock();
+                            if (stub && stub->try_add_ref())
+                                return;
+                        }
+                        // a stub whose count has reached zero is on its way out and is replaced rather than revived
+                        auto id = generate_new_object_id();
+                        // the dense slot table hands out an unset id when it is full
+                        if (!id.is_set())
+                        {
+                            stub = nullptr;
+                            return;
+                        }
+                        stub = rpc::make_shared<object_stub>(id, *this, pointer);
+                        rpc::shared_ptr<i_interface_stub> interface_stub = fn(stub);
+                        stub->add_interface(interface_stub);
+                        if (needs_strand(iface, interface_stub))
+                            stub->set_strand(std::make_unique<strand>(strand_executor_));
+                        wrapped_stubs[pointer] = stub;
+                        register_stub(id, stub);
+                        stub->on_added_to_zone(stub);
+                        stub->add_ref();
+                    });
             }
+            if (!stub)
+                return {{0}, {0}};
 
             if (outcall)
             {
-                std::lock_guard g(zone_control);
                 uint64_t object_channel = caller_channel_zone_id.is_set() ? caller_channel_zone_id.id : caller_zone_id.id;
                 RPC_ASSERT(object_channel);
                 // and the caller with destination info
-                auto found = other_zones.find(
-                    {{object_channel}, zone_id_.as_caller()}); // we dont need to get caller id for this
-                if (found != other_zones.end())
+                rpc::weak_ptr<service_proxy> found;
+                if (other_zones.find({{object_channel}, zone_id_.as_caller()}, found)) // we dont need to get caller id for this
                 {
-                    caller = found->second.lock();
+                    caller = found.lock();
                 }
                 else
                 {
@@ -625,16 +1028,15 @@ namespace rpc
 
     rpc::weak_ptr<object_stub> service::get_object(object object_id) const
     {
-        std::lock_guard l(stub_control);
-        auto item = stubs.find(object_id);
-        if (item == stubs.end())
+        rpc::weak_ptr<object_stub> weak_stub;
+        if (!find_stub(object_id, weak_stub))
         {
             // we need a test if we get here
             RPC_ASSERT(false);
             return rpc::weak_ptr<object_stub>();
         }
 
-        return item->second;
+        return weak_stub;
     }
     int service::try_cast(
         uint64_t protocol_version, destination_zone destination_zone_id, object object_id, interface_ordinal interface_id)
@@ -642,15 +1044,7 @@ namespace rpc
         current_service_tracker tracker(this);
         if (destination_zone_id != zone_id_.as_destination())
         {
-            rpc::shared_ptr<service_proxy> other_zone;
-            {
-                std::lock_guard g(zone_control);
-                auto found = other_zones.lower_bound({destination_zone_id, {0}});
-                if (found != other_zones.end() && found->first.dest == destination_zone_id)
-                {
-                    other_zone = found->second.lock();
-                }
-            }
+            auto other_zone = find_any_route(destination_zone_id);
             if (!other_zone)
             {
                 RPC_ASSERT(false);
@@ -722,24 +1116,20 @@ namespace rpc
                 rpc::shared_ptr<rpc::service_proxy> destination;
                 do
                 {
-                    std::lock_guard g(zone_control);
-                    auto found = other_zones.find({destination_zone_id, caller_zone_id});
-                    if (found != other_zones.end())
+                    rpc::weak_ptr<service_proxy> found;
+                    if (other_zones.find({destination_zone_id, caller_zone_id}, found))
                     {
                         // untested section
                         RPC_ASSERT(false);
-                        // destination = found->second.lock();
+                        // destination = found.lock();
                         // destination->add_external_ref();//update the local ref count the object refcount is done
                         // further down the stack
                         break;
                     }
 
-                    found = other_zones.lower_bound({{dest_channel}, {0}});
-                    if (found != other_zones.end() && found->first.dest.get_val() == dest_channel)
-                    {
-                        destination = found->second.lock();
+                    destination = find_any_route({dest_channel});
+                    if (destination)
                         break;
-                    }
 
                     RPC_ASSERT(get_parent() != nullptr);
                     destination = get_parent();
@@ -766,18 +1156,16 @@ namespace rpc
                     {
                         std::lock_guard g(zone_control);
 
-                        auto found = other_zones.find({destination_zone_id, caller_zone_id});
-                        if (found != other_zones.end())
+                        rpc::weak_ptr<service_proxy> found;
+                        if (other_zones.find({destination_zone_id, caller_zone_id}, found))
                         {
-                            destination = found->second.lock();
+                            destination = found.lock();
                             destination->add_external_ref();
                         }
                         else
                         {
-                            found = other_zones.lower_bound({{dest_channel}, {0}});
-                            if (found != other_zones.end() && found->first.dest.get_val() == dest_channel)
+                            if (auto tmp = find_any_route({dest_channel}); tmp)
                             {
-                                auto tmp = found->second.lock();
                                 destination = tmp->clone_for_zone(destination_zone_id, caller_zone_id);
                             }
                             else
@@ -795,12 +1183,8 @@ namespace rpc
 
                         if (!!(build_out_param_channel & add_ref_options::build_caller_route))
                         {
-                            found = other_zones.lower_bound({{caller_channel}, {0}});
-                            if (found != other_zones.end() && found->first.dest.get_val() == caller_channel)
-                            {
-                                caller = found->second.lock();
-                            }
-                            else
+                            caller = find_any_route({caller_channel});
+                            if (!caller)
                             {
                                 // UNTESTED PATH!!!
                                 // It has been worked out that this happens when a reference to an zone is passed to a
@@ -920,19 +1304,17 @@ namespace rpc
                 rpc::shared_ptr<service_proxy> other_zone;
                 { // brackets here as we are using a lock guard
                     std::lock_guard g(zone_control);
-                    auto found = other_zones.find({destination_zone_id, caller_zone_id});
-                    if (found != other_zones.end())
+                    rpc::weak_ptr<service_proxy> found;
+                    if (other_zones.find({destination_zone_id, caller_zone_id}, found))
                     {
-                        other_zone = found->second.lock();
+                        other_zone = found.lock();
                         other_zone->add_external_ref();
                     }
 
                     if (!other_zone)
                     {
-                        auto found = other_zones.lower_bound({destination_zone_id, {0}});
-                        if (found != other_zones.end() && found->first.dest == destination_zone_id)
+                        if (auto tmp = find_any_route(destination_zone_id); tmp)
                         {
-                            auto tmp = found->second.lock();
                             other_zone = tmp->clone_for_zone(destination_zone_id, caller_zone_id);
                             inner_add_zone_proxy(other_zone);
                         }
@@ -980,13 +1362,12 @@ namespace rpc
             {
                 rpc::shared_ptr<service_proxy> caller;
                 {
-                    std::lock_guard g(zone_control);
                     // we swap the parameter types as this is from perspective of the caller and not the proxy that
                     // called this function
-                    auto found = other_zones.find({caller_zone_id.as_destination(), destination_zone_id.as_caller()});
-                    if (found != other_zones.end())
+                    rpc::weak_ptr<service_proxy> found;
+                    if (other_zones.find({caller_zone_id.as_destination(), destination_zone_id.as_caller()}, found))
                     {
-                        caller = found->second.lock();
+                        caller = found.lock();
                     }
                     else
                     {
@@ -1024,31 +1405,30 @@ namespace rpc
 
     uint64_t service::release_local_stub(const rpc::shared_ptr<rpc::object_stub>& stub)
     {
-        std::lock_guard l(stub_control);
         uint64_t count = stub->release();
         if (!count)
-        {
-            {
-                stubs.erase(stub->get_id());
-            }
-            {
-                auto* pointer = stub->get_castable_interface()->get_address();
-                auto it = wrapped_object_to_stub.find(pointer);
-                if (it != wrapped_object_to_stub.end())
-                {
-                    wrapped_object_to_stub.erase(it);
-                }
-                else
-                {
-                    // if you get here make sure that get_address is defined in the most derived class
-                    RPC_ASSERT(false);
-                }
-            }
-            stub->reset();
-        }
+            retire_stub(stub);
         return count;
     }
 
+    void service::retire_stub(const rpc::shared_ptr<rpc::object_stub>& stub)
+    {
+        // the count is already zero so get_proxy_stub_descriptor will not revive it, only the entries go under the
+        // shard lock.  The stub lets go of the object after the lock is dropped as that can run user destructors that
+        // call back into this service
+        auto* pointer = stub->get_castable_interface()->get_address();
+        wrapped_object_to_stub.with_exclusive(pointer,
+            [&](std::unordered_map<void*, rpc::weak_ptr<object_stub>>& wrapped_stubs)
+            {
+                deregister_stub(stub->get_id());
+                // the entry may belong to a newer stub for the same object, or have gone with it already
+                auto it = wrapped_stubs.find(pointer);
+                if (it != wrapped_stubs.end() && it->second.lock() == stub)
+                    wrapped_stubs.erase(it);
+            });
+        stub->reset();
+    }
+
     uint64_t service::release(
         uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id)
     {
@@ -1057,15 +1437,7 @@ namespace rpc
 
         if (destination_zone_id != zone_id_.as_destination())
         {
-            rpc::shared_ptr<service_proxy> other_zone;
-            {
-                std::lock_guard g(zone_control);
-                auto found = other_zones.find({destination_zone_id, caller_zone_id});
-                if (found != other_zones.end())
-                {
-                    other_zone = found->second.lock();
-                }
-            }
+            auto other_zone = find_route(destination_zone_id, caller_zone_id);
             if (!other_zone)
             {
                 RPC_ASSERT(false);
@@ -1076,6 +1448,23 @@ namespace rpc
                 telemetry_service->on_service_release(
                     zone_id_, other_zone->get_destination_channel_zone_id(), destination_zone_id, object_id, caller_zone_id);
 #endif
+            if (indirect_reference_counting_ && caller_zone_id != zone_id_.as_caller())
+            {
+                // if this zone still holds its own proxy to the object keep the reference as credit on it instead of
+                // passing the release on, the owner gets it back when that proxy dies
+                auto own_route = find_route(destination_zone_id, zone_id_.as_caller());
+                if (own_route && !own_route->get_destination_channel_zone_id().is_set())
+                {
+                    if (auto object_proxy = own_route->find_object_proxy(object_id))
+                    {
+                        // the owner still counts the reference of this proxy and every one absorbed into it, so that
+                        // is the count reported rather than the owners which this zone cannot see
+                        auto count = 1 + object_proxy->add_reference_credit();
+                        other_zone->release_external_ref();
+                        return count;
+                    }
+                }
+            }
             auto ret = other_zone->sp_release(object_id);
             if (ret != std::numeric_limits<uint64_t>::max())
             {
@@ -1099,64 +1488,103 @@ namespace rpc
                 return std::numeric_limits<uint64_t>::max();
             }
 
-            bool reset_stub = false;
-            rpc::shared_ptr<rpc::object_stub> stub;
-            uint64_t count = 0;
-            // these scope brackets are needed as otherwise there will be a recursive lock on a mutex in rare cases when
-            // the stub is reset
+            return release_object(object_id);
+        }
+    }
+
+    uint64_t service::release_object(object object_id)
+    {
+        rpc::shared_ptr<rpc::object_stub> stub;
+        {
+            rpc::weak_ptr<object_stub> weak_stub;
+            if (!find_stub(object_id, weak_stub))
             {
-                {
-                    // a scoped lock
-                    std::lock_guard l(stub_control);
-                    auto item = stubs.find(object_id);
-                    if (item == stubs.end())
-                    {
-                        RPC_ASSERT(false);
-                        return std::numeric_limits<uint64_t>::max();
-                    }
+                RPC_ASSERT(false);
+                return std::numeric_limits<uint64_t>::max();
+            }
+            stub = weak_stub.lock();
+        }
 
-                    stub = item->second.lock();
-                }
+        if (!stub)
+        {
+            RPC_ASSERT(false);
+            return std::numeric_limits<uint64_t>::max();
+        }
+        // this guy needs to live outside of the mutex or deadlocks may happen
+        uint64_t count = stub->release();
+        if (!count)
+            retire_stub(stub);
+        return count;
+    }
 
-                if (!stub)
-                {
-                    RPC_ASSERT(false);
-                    return std::numeric_limits<uint64_t>::max();
-                }
-                // this guy needs to live outside of the mutex or deadlocks may happen
-                count = stub->release();
-                if (!count)
-                {
-                    {
-                        // a scoped lock
-                        std::lock_guard l(stub_control);
-                        {
-                            stubs.erase(object_id);
-                        }
-                        {
-                            auto* pointer = stub->get_castable_interface()->get_address();
-                            auto it = wrapped_object_to_stub.find(pointer);
-                            if (it != wrapped_object_to_stub.end())
-                            {
-                                wrapped_object_to_stub.erase(it);
-                            }
-                            else
-                            {
-                                RPC_ASSERT(false);
-                                return std::numeric_limits<uint64_t>::max();
-                            }
-                        }
-                    }
-                    stub->reset();
-                    reset_stub = true;
-                }
+    uint64_t service::release_batch(uint64_t protocol_version,
+        destination_zone destination_zone_id,
+        caller_zone caller_zone_id,
+        const std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        if (destination_zone_id != zone_id_.as_destination())
+        {
+            // credit is taken object by object so those releases are passed on one at a time
+            if (indirect_reference_counting_ && caller_zone_id != zone_id_.as_caller())
+                return i_marshaller::release_batch(protocol_version, destination_zone_id, caller_zone_id, releases);
+
+            current_service_tracker tracker(this);
+            current_caller_manager cc(caller_zone_id);
+            auto other_zone = find_route(destination_zone_id, caller_zone_id);
+            if (!other_zone)
+            {
+                RPC_ASSERT(false);
+                return std::numeric_limits<uint64_t>::max();
+            }
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                for (auto& item : releases)
+                    telemetry_service->on_service_release(zone_id_,
+                        other_zone->get_destination_channel_zone_id(),
+                        destination_zone_id,
+                        item.first,
+                        caller_zone_id);
             }
+#endif
+            auto ret = other_zone->sp_release_batch(releases);
+            if (ret != std::numeric_limits<uint64_t>::max())
+            {
+                // the route holds an external ref for every reference that passes through it
+                for (auto& item : releases)
+                    for (uint64_t i = 0; i < item.second; i++)
+                        other_zone->release_external_ref();
+            }
+            return ret;
+        }
 
-            if (reset_stub)
-                stub->reset();
+#ifdef RPC_V2
+        if (protocol_version == rpc::VERSION_2)
+            ;
+        else
+#endif
+        {
+            return std::numeric_limits<uint64_t>::max();
+        }
 
-            return count;
+        current_service_tracker tracker(this);
+        current_caller_manager cc(caller_zone_id);
+        uint64_t remaining = 0;
+        for (auto& item : releases)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                telemetry_service->on_service_release(zone_id_, {0}, destination_zone_id, item.first, caller_zone_id);
+#endif
+            // the batch has been accepted so an object that cannot be found is not reported back as a version
+            // mismatch, release_object asserts on it instead and it adds nothing to the sum
+            uint64_t count = 0;
+            for (uint64_t i = 0; i < item.second; i++)
+                count = release_object(item.first);
+            if (count != std::numeric_limits<uint64_t>::max())
+                remaining += count;
         }
+        return remaining;
     }
 
     void service::inner_add_zone_proxy(const rpc::shared_ptr<service_proxy>& service_proxy)
@@ -1166,8 +1594,12 @@ namespace rpc
         auto destination_zone_id = service_proxy->get_destination_zone_id();
         auto caller_zone_id = service_proxy->get_caller_zone_id();
         RPC_ASSERT(destination_zone_id != zone_id_.as_destination());
-        RPC_ASSERT(other_zones.find({destination_zone_id, caller_zone_id}) == other_zones.end());
-        other_zones[{destination_zone_id, caller_zone_id}] = service_proxy;
+        other_zones.update(
+            [&](auto& zones)
+            {
+                RPC_ASSERT(zones.find({destination_zone_id, caller_zone_id}) == zones.end());
+                zones[{destination_zone_id, caller_zone_id}] = service_proxy;
+            });
     }
 
     void service::add_zone_proxy(const rpc::shared_ptr<service_proxy>& service_proxy)
@@ -1187,44 +1619,53 @@ namespace rpc
         std::lock_guard g(zone_control);
 
         // find if we have one
-        auto item = other_zones.find({destination_zone_id, new_caller_zone_id});
-        if (item != other_zones.end())
-            return item->second.lock();
+        rpc::weak_ptr<service_proxy> found;
+        if (other_zones.find({destination_zone_id, new_caller_zone_id}, found))
+            return found.lock();
 
-        item = other_zones.lower_bound({destination_zone_id, {0}});
+        bool route_found = false;
+        auto calling_route = other_zones.read(
+            [&](const auto& zones)
+            {
+                auto item = zones.lower_bound({destination_zone_id, {0}});
 
-        if (item != other_zones.end() && item->first.dest != destination_zone_id)
-            item = other_zones.end();
+                if (item != zones.end() && item->first.dest != destination_zone_id)
+                    item = zones.end();
 
-        // if not we can make one from the proxy of the calling channel zone
-        // this zone knows nothing about the destination zone however the caller channel zone will know how to connect
-        // to it
-        if (item == other_zones.end() && caller_channel_zone_id.is_set())
-        {
-            item = other_zones.lower_bound({caller_channel_zone_id.as_destination(), {0}});
-            if (item == other_zones.end() || item->first.dest != caller_channel_zone_id.as_destination())
-            {
-                RPC_ASSERT(false); // something is wrong the caller channel should always be valid if specified
-                return nullptr;
-            }
-        }
-        // or if not we can make one from the proxy of the calling  zone
-        if (item == other_zones.end() && caller_zone_id.is_set())
-        {
-            item = other_zones.lower_bound({caller_zone_id.as_destination(), {0}});
-            if (item == other_zones.end() || item->first.dest != caller_zone_id.as_destination())
-            {
-                RPC_ASSERT(false); // something is wrong the caller should always be valid if specified
-                return nullptr;
-            }
-        }
-        if (item == other_zones.end())
-        {
-            RPC_ASSERT(false); // something is wrong we should not get here
+                // if not we can make one from the proxy of the calling channel zone
+                // this zone knows nothing about the destination zone however the caller channel zone will know how to
+                // connect to it
+                if (item == zones.end() && caller_channel_zone_id.is_set())
+                {
+                    item = zones.lower_bound({caller_channel_zone_id.as_destination(), {0}});
+                    if (item == zones.end() || item->first.dest != caller_channel_zone_id.as_destination())
+                    {
+                        RPC_ASSERT(false); // something is wrong the caller channel should always be valid if specified
+                        return rpc::weak_ptr<service_proxy>();
+                    }
+                }
+                // or if not we can make one from the proxy of the calling  zone
+                if (item == zones.end() && caller_zone_id.is_set())
+                {
+                    item = zones.lower_bound({caller_zone_id.as_destination(), {0}});
+                    if (item == zones.end() || item->first.dest != caller_zone_id.as_destination())
+                    {
+                        RPC_ASSERT(false); // something is wrong the caller should always be valid if specified
+                        return rpc::weak_ptr<service_proxy>();
+                    }
+                }
+                if (item == zones.end())
+                {
+                    RPC_ASSERT(false); // something is wrong we should not get here
+                    return rpc::weak_ptr<service_proxy>();
+                }
+                route_found = true;
+                return item->second;
+            });
+        if (!route_found)
             return nullptr;
-        }
 
-        auto calling_proxy = item->second.lock();
+        auto calling_proxy = calling_route.lock();
         if (!calling_proxy)
         {
             RPC_ASSERT(!"Race condition"); // we have a race condition
@@ -1241,15 +1682,10 @@ namespace rpc
     {
         {
             std::lock_guard g(zone_control);
-            auto item = other_zones.find({destination_zone_id, caller_zone_id});
-            if (item == other_zones.end())
+            if (!other_zones.erase({destination_zone_id, caller_zone_id}))
             {
                 RPC_ASSERT(false);
             }
-            else
-            {
-                other_zones.erase(item);
-            }
         }
     }
 
@@ -1257,17 +1693,17 @@ namespace rpc
     {
         {
             std::lock_guard g(zone_control);
-            auto item = other_zones.find({destination_zone_id, caller_zone_id});
-            if (item == other_zones.end())
+            rpc::weak_ptr<service_proxy> found;
+            if (!other_zones.find({destination_zone_id, caller_zone_id}, found))
             {
                 RPC_ASSERT(false);
             }
             else
             {
-                auto sp = item->second.lock();
+                auto sp = found.lock();
                 if (!sp || sp->is_unused())
                 {
-                    other_zones.erase(item);
+                    other_zones.erase({destination_zone_id, caller_zone_id});
                 }
             }
         }
@@ -1310,7 +1746,8 @@ namespace rpc
 
     // note this function is not thread safe!  Use it before using the service class for normal operation
     void service::add_interface_stub_factory(std::function<interface_ordinal(uint8_t)> id_getter,
-        std::shared_ptr<std::function<rpc::shared_ptr<rpc::i_interface_stub>(const rpc::shared_ptr<rpc::i_interface_stub>&)>> factory)
+        std::shared_ptr<std::function<rpc::shared_ptr<rpc::i_interface_stub>(const rpc::shared_ptr<rpc::i_interface_stub>&)>> factory,
+        bool requires_strand)
     {
 #ifdef RPC_V2
         auto interface_id = id_getter(rpc::VERSION_2);
@@ -1320,9 +1757,25 @@ namespace rpc
             rpc::error::INVALID_DATA();
         }
         stub_factories[{interface_id}] = factory;
+        if (requires_strand)
+            strand_interfaces_.push_back({interface_id});
 #endif
     }
 
+    bool service::needs_strand(rpc::casting_interface* iface, const rpc::shared_ptr<rpc::i_interface_stub>& first) const
+    {
+        if (strand_all_objects_ || first->requires_strand())
+            return true;
+        // a strand cannot be added once calls are running, so every [strand] interface the object could later be cast
+        // to is asked about now
+        for (auto& interface_id : strand_interfaces_)
+        {
+            if (iface->query_interface(interface_id))
+                return true;
+        }
+        return false;
+    }
+
     rpc::shared_ptr<casting_interface> service::get_castable_interface(object object_id, interface_ordinal interface_id)
     {
         auto ob = get_object(object_id).lock();
@@ -0,0 +1,251 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rpc/shm_service_proxy.h"
+#include "rpc/futex.h"
+
+namespace rpc
+{
+    namespace
+    {
+        constexpr uint64_t shm_magic = 0x72706373686d3031ull; // "rpcshm01"
+        constexpr uint64_t shm_version = 1;
+        constexpr uint64_t min_ring_capacity = 0x1000;
+        constexpr uint64_t max_ring_capacity = 1ull << 30;
+        constexpr size_t ring_data_offset = (sizeof(shm_region_header) + 63) & ~size_t(63);
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+        static_assert(sizeof(transport_message) % 8 == 0, "frames are kept 8 byte aligned");
+
+        uint64_t frame_size(uint32_t payload_size)
+        {
+            return (sizeof(transport_message) + payload_size + 7) & ~uint64_t(7);
+        }
+
+        void copy_to_ring(char* data, uint64_t capacity, uint64_t pos, const void* src, size_t size)
+        {
+            auto offset = pos & (capacity - 1);
+            auto first = std::min<uint64_t>(size, capacity - offset);
+            memcpy(data + offset, src, first);
+            if (first < size)
+                memcpy(data, (const char*)src + first, size - first);
+        }
+
+        void copy_from_ring(const char* data, uint64_t capacity, uint64_t pos, void* dest, size_t size)
+        {
+            auto offset = pos & (capacity - 1);
+            auto first = std::min<uint64_t>(size, capacity - offset);
+            memcpy(dest, data + offset, first);
+            if (first < size)
+                memcpy((char*)dest + first, data, size - first);
+        }
+    }
+
+    shm_channel::~shm_channel()
+    {
+        if (mapping_ && mapping_ != MAP_FAILED)
+            munmap(mapping_, mapping_size_);
+        if (fd_ != -1)
+            ::close(fd_);
+        if (is_owner_)
+            shm_unlink(name_.c_str());
+    }
+
+    std::shared_ptr<shm_channel> shm_channel::create(const std::string& name, size_t ring_capacity)
+    {
+        auto channel = std::shared_ptr<shm_channel>(new shm_channel());
+        if (!channel->map_region(name, true, ring_capacity))
+            return nullptr;
+        return channel;
+    }
+
+    std::shared_ptr<shm_channel> shm_channel::open(const std::string& name)
+    {
+        auto channel = std::shared_ptr<shm_channel>(new shm_channel());
+        if (!channel->map_region(name, false, 0))
+            return nullptr;
+        return channel;
+    }
+
+    bool shm_channel::map_region(const std::string& name, bool create, size_t ring_capacity)
+    {
+        name_ = name;
+        fd_ = shm_open(name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+        if (fd_ == -1)
+            return false;
+        is_owner_ = create;
+
+        uint64_t capacity = min_ring_capacity;
+        if (create)
+        {
+            while (capacity < ring_capacity && capacity < max_ring_capacity)
+                capacity <<= 1;
+            mapping_size_ = ring_data_offset + 2 * capacity;
+            if (ftruncate(fd_, mapping_size_) == -1)
+                return false;
+        }
+        else
+        {
+            struct stat st = {};
+            if (fstat(fd_, &st) == -1 || (size_t)st.st_size < ring_data_offset)
+                return false;
+            mapping_size_ = st.st_size;
+        }
+
+        mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapping_ == MAP_FAILED)
+            return false;
+        region_ = static_cast<shm_region_header*>(mapping_);
+
+        if (create)
+        {
+            // the new region is zero filled so the rings start out empty, publishing the magic makes it usable
+            region_->version = shm_version;
+            region_->ring_capacity = capacity;
+            region_->magic.store(shm_magic, std::memory_order_release);
+        }
+        else
+        {
+            if (region_->magic.load(std::memory_order_acquire) != shm_magic || region_->version != shm_version)
+                return false;
+            capacity = region_->ring_capacity;
+            if (capacity < min_ring_capacity || capacity > max_ring_capacity || (capacity & (capacity - 1))
+                || mapping_size_ < ring_data_offset + 2 * capacity)
+                return false;
+        }
+        capacity_ = capacity;
+
+        auto* data = static_cast<char*>(mapping_) + ring_data_offset;
+        auto outbound_index = create ? 0 : 1;
+        outbound_ = &region_->rings[outbound_index];
+        outbound_data_ = data + outbound_index * capacity;
+        inbound_ = &region_->rings[1 - outbound_index];
+        inbound_data_ = data + (1 - outbound_index) * capacity;
+        return true;
+    }
+
+    bool shm_channel::is_peer_closed() const
+    {
+        return region_->closed.load(std::memory_order_acquire) != 0;
+    }
+
+    size_t shm_channel::get_max_payload_size() const
+    {
+        return std::min<uint64_t>(capacity_ - sizeof(transport_message), std::numeric_limits<uint32_t>::max());
+    }
+
+    void shm_channel::start_receiver()
+    {
+        auto self = std::static_pointer_cast<shm_channel>(shared_from_this());
+        std::thread([self]() { self->receive_loop(); }).detach();
+    }
+
+    void shm_channel::on_close()
+    {
+        region_->closed.store(1, std::memory_order_release);
+        // wake anything parked on either ring in either process so it notices the closed flag
+        for (auto& ring : region_->rings)
+        {
+            ring.data_signal.fetch_add(1);
+            futex_wake(&ring.data_signal, true);
+            ring.space_signal.fetch_add(1);
+            futex_wake(&ring.space_signal, true);
+        }
+    }
+
+    int shm_channel::write_message(const transport_message& header, const char* payload)
+    {
+        auto size = frame_size(header.payload_size);
+        if (size > capacity_)
+            return rpc::error::TRANSPORT_ERROR();
+
+        std::lock_guard g(write_control_);
+        auto write_pos = outbound_->write_pos.load(std::memory_order_relaxed);
+        auto has_space = [&]()
+        { return capacity_ - (write_pos - outbound_->read_pos.load(std::memory_order_acquire)) >= size; };
+        while (!has_space())
+        {
+            if (is_closed())
+                return rpc::error::TRANSPORT_ERROR();
+            if (adaptive_spin(write_spin_limit_, has_space))
+                break;
+            outbound_->producer_waiting.store(1);
+            auto signal = outbound_->space_signal.load();
+            if (!has_space() && !is_closed())
+                futex_wait(&outbound_->space_signal, signal, true);
+            outbound_->producer_waiting.store(0);
+        }
+
+        copy_to_ring(outbound_data_, capacity_, write_pos, &header, sizeof(header));
+        if (header.payload_size)
+            copy_to_ring(outbound_data_, capacity_, write_pos + sizeof(header), payload, header.payload_size);
+        outbound_->write_pos.store(write_pos + size, std::memory_order_release);
+
+        outbound_->data_signal.fetch_add(1);
+        if (outbound_->consumer_waiting.load())
+            futex_wake(&outbound_->data_signal, true);
+        return rpc::error::OK();
+    }
+
+    bool shm_channel::read_message(transport_message& header, std::vector<char>& payload)
+    {
+        auto read_pos = inbound_->read_pos.load(std::memory_order_relaxed);
+        auto has_data = [&]() { return inbound_->write_pos.load(std::memory_order_acquire) != read_pos; };
+        while (!has_data())
+        {
+            if (is_closed())
+                return false;
+            if (adaptive_spin(read_spin_limit_, has_data))
+                break;
+            inbound_->consumer_waiting.store(1);
+            auto signal = inbound_->data_signal.load();
+            if (!has_data() && !is_closed())
+                futex_wait(&inbound_->data_signal, signal, true);
+            inbound_->consumer_waiting.store(0);
+        }
+
+        copy_from_ring(inbound_data_, capacity_, read_pos, &header, sizeof(header));
+        auto size = frame_size(header.payload_size);
+        if (size > capacity_ || size > inbound_->write_pos.load(std::memory_order_acquire) - read_pos)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                telemetry_service->message(rpc::i_telemetry_service::err, "shm_channel received a corrupt frame");
+            }
+#endif
+            // the other process wrote garbage, nothing after this point can be trusted
+            close();
+            return false;
+        }
+        payload.resize(header.payload_size);
+        if (header.payload_size)
+            copy_from_ring(inbound_data_, capacity_, read_pos + sizeof(header), payload.data(), header.payload_size);
+        inbound_->read_pos.store(read_pos + size, std::memory_order_release);
+
+        inbound_->space_signal.fetch_add(1);
+        if (inbound_->producer_waiting.load())
+            futex_wake(&inbound_->space_signal, true);
+        return true;
+    }
+
+    void shm_channel::receive_loop()
+    {
+        transport_message header;
+        std::vector<char> payload;
+        while (read_message(header, payload))
+            on_message(header, payload);
+        on_receiver_stopped();
+    }
+}
@@ -0,0 +1,296 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <cstring>
+#include <limits>
+
+#include <rpc/buffer_pool.h>
+#include <rpc/simulated_boundary_service_proxy.h>
+
+namespace rpc
+{
+    ////////////////////////////////////////////////////////////////////////////
+    // simulated_boundary
+
+    simulated_boundary::simulated_boundary(const simulated_boundary_config& config)
+        : config_(config)
+    {
+        child_reply_sizes_.set_enabled(config.predict_reply_sizes);
+        parent_reply_sizes_.set_enabled(config.predict_reply_sizes);
+    }
+
+    simulated_boundary_stats simulated_boundary::get_stats() const
+    {
+        simulated_boundary_stats stats;
+        stats.crossings = crossings_.load(std::memory_order_relaxed);
+        stats.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+        stats.bytes_out = bytes_out_.load(std::memory_order_relaxed);
+        std::lock_guard g(parked_control_);
+        stats.parked_replies = parked_.size();
+        return stats;
+    }
+
+    void simulated_boundary::cross()
+    {
+        crossings_.fetch_add(1, std::memory_order_relaxed);
+        if (config_.crossing_latency.count() <= 0)
+            return;
+        // spun rather than slept as a transition keeps the core busy and sleeps are far coarser than a microsecond
+        auto until = std::chrono::steady_clock::now() + config_.crossing_latency;
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    }
+
+    int simulated_boundary::call(service& target,
+        uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t sz_in,
+        const char* data_in,
+        size_t sz_out,
+        char* data_out,
+        size_t* data_out_sz,
+        void** retry_token)
+    {
+        cross();
+
+        if (protocol_version > rpc::get_version())
+            return rpc::error::INVALID_VERSION();
+        // data_in would be dereferenced as pointers into the callers address space
+        if (encoding == encoding::direct)
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        if (!retry_token || !data_out_sz)
+            return rpc::error::INVALID_DATA();
+
+        if (*retry_token)
+        {
+            std::unique_ptr<retry_buffer> parked;
+            {
+                std::lock_guard g(parked_control_);
+                auto it = parked_.find(static_cast<const retry_buffer*>(*retry_token));
+                if (it == parked_.end())
+                    return rpc::error::SECURITY_ERROR();
+
+                *data_out_sz = it->second->data.size();
+                if (*data_out_sz > sz_out)
+                    return rpc::error::NEED_MORE_MEMORY();
+                parked = std::move(it->second);
+                parked_.erase(it);
+            }
+            memcpy(data_out, parked->data.data(), parked->data.size());
+            bytes_out_.fetch_add(parked->data.size(), std::memory_order_relaxed);
+            *retry_token = nullptr;
+            return parked->return_value;
+        }
+
+        // the [in] buffer is copied to the far side before the call is dispatched
+        pooled_buffer pooled_in(sz_in);
+        auto& in = pooled_in.get();
+        if (sz_in)
+            memcpy(in.data(), data_in, sz_in);
+        bytes_in_.fetch_add(sz_in, std::memory_order_relaxed);
+
+        pooled_buffer pooled_tmp(sz_out);
+        auto& tmp = pooled_tmp.get();
+        int ret = target.send(protocol_version,
+            encoding,
+            tag,
+            caller_channel_zone_id,
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            sz_in,
+            in.data(),
+            tmp);
+        if (ret >= rpc::error::MIN() && ret <= rpc::error::MAX())
+            return ret;
+
+        // and the [out] buffer copied back, but only if the reply fits the size the caller declared
+        *data_out_sz = tmp.size();
+        if (*data_out_sz <= sz_out)
+        {
+            memcpy(data_out, tmp.data(), *data_out_sz);
+            bytes_out_.fetch_add(*data_out_sz, std::memory_order_relaxed);
+            return ret;
+        }
+
+        auto parked = std::make_unique<retry_buffer>(retry_buffer{std::move(tmp), ret});
+        *retry_token = parked.get();
+        std::lock_guard g(parked_control_);
+        parked_.emplace(parked.get(), std::move(parked));
+        return rpc::error::NEED_MORE_MEMORY();
+    }
+
+    int simulated_boundary::send(const rpc::shared_ptr<service>& target,
+        reply_size_predictor& reply_sizes,
+        uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        if (!target)
+            return rpc::error::TRANSPORT_ERROR();
+
+        void* retry_token = nullptr;
+        auto ret = reply_sizes.send(interface_id,
+            method_id,
+            out_buf_,
+            [&](std::vector<char>& out_buf, size_t& data_out_sz) -> int
+            {
+                return call(*target,
+                    protocol_version,
+                    encoding,
+                    tag,
+                    caller_channel_zone_id,
+                    caller_zone_id,
+                    destination_zone_id,
+                    object_id,
+                    interface_id,
+                    method_id,
+                    in_size_,
+                    in_buf_,
+                    out_buf.size(),
+                    out_buf.data(),
+                    &data_out_sz,
+                    &retry_token);
+            });
+
+        // a reply that was never collected would otherwise stay parked for the life of the boundary
+        if (retry_token)
+        {
+            std::lock_guard g(parked_control_);
+            parked_.erase(static_cast<const retry_buffer*>(retry_token));
+        }
+        return ret;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // simulated_boundary_parent_proxy
+
+    simulated_boundary_parent_proxy::simulated_boundary_parent_proxy(const char* name,
+        destination_zone parent_zone_id,
+        const rpc::shared_ptr<child_service>& child_svc,
+        const rpc::shared_ptr<service>& parent_svc,
+        std::shared_ptr<simulated_boundary> boundary)
+        : service_proxy(name, parent_zone_id, child_svc)
+        , parent_service_(parent_svc)
+        , boundary_(std::move(boundary))
+    {
+    }
+
+    rpc::shared_ptr<simulated_boundary_parent_proxy> simulated_boundary_parent_proxy::create(const char* name,
+        destination_zone parent_zone_id,
+        const rpc::shared_ptr<child_service>& child_svc,
+        const rpc::shared_ptr<service>& parent_svc,
+        std::shared_ptr<simulated_boundary> boundary)
+    {
+        RPC_ASSERT(boundary);
+        return rpc::shared_ptr<simulated_boundary_parent_proxy>(
+            new simulated_boundary_parent_proxy(name, parent_zone_id, child_svc, parent_svc, std::move(boundary)));
+    }
+
+    rpc::shared_ptr<service_proxy> simulated_boundary_parent_proxy::clone()
+    {
+        return rpc::shared_ptr<service_proxy>(new simulated_boundary_parent_proxy(*this));
+    }
+
+    int simulated_boundary_parent_proxy::send(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        return boundary_->send(parent_service_.lock(),
+            boundary_->get_parent_reply_sizes(),
+            protocol_version,
+            encoding,
+            tag,
+            caller_channel_zone_id,
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            in_size_,
+            in_buf_,
+            out_buf_);
+    }
+
+    int simulated_boundary_parent_proxy::try_cast(
+        uint64_t protocol_version, destination_zone destination_zone_id, object object_id, interface_ordinal interface_id)
+    {
+        auto parent = parent_service_.lock();
+        if (!parent)
+            return rpc::error::TRANSPORT_ERROR();
+        boundary_->cross();
+        return parent->try_cast(protocol_version, destination_zone_id, object_id, interface_id);
+    }
+
+    uint64_t simulated_boundary_parent_proxy::add_ref(uint64_t protocol_version,
+        destination_channel_zone destination_channel_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        add_ref_options build_out_param_channel)
+    {
+        auto parent = parent_service_.lock();
+        if (!parent)
+            return std::numeric_limits<uint64_t>::max();
+        boundary_->cross();
+        return parent->add_ref(protocol_version,
+            destination_channel_zone_id,
+            destination_zone_id,
+            object_id,
+            caller_channel_zone_id,
+            caller_zone_id,
+            build_out_param_channel);
+    }
+
+    uint64_t simulated_boundary_parent_proxy::release(
+        uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id)
+    {
+        auto parent = parent_service_.lock();
+        if (!parent)
+            return std::numeric_limits<uint64_t>::max();
+        boundary_->cross();
+        return parent->release(protocol_version, destination_zone_id, object_id, caller_zone_id);
+    }
+
+    uint64_t simulated_boundary_parent_proxy::release_batch(uint64_t protocol_version,
+        destination_zone destination_zone_id,
+        caller_zone caller_zone_id,
+        const std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        auto parent = parent_service_.lock();
+        if (!parent)
+            return std::numeric_limits<uint64_t>::max();
+        boundary_->cross();
+        return parent->release_batch(protocol_version, destination_zone_id, caller_zone_id, releases);
+    }
+}
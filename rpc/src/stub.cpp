@@ -28,28 +28,43 @@ namespace rpc
 
     rpc::shared_ptr<rpc::casting_interface> object_stub::get_castable_interface() const
     {
-        std::lock_guard g(map_control);
-        RPC_ASSERT(!stub_map.empty());
-        auto& iface = stub_map.begin()->second;
-        return iface->get_castable_interface();
+        auto* interfaces = stub_map.load(std::memory_order_acquire);
+        RPC_ASSERT(interfaces && !interfaces->empty());
+        return interfaces->front().second->get_castable_interface();
     }
 
     // this method is not thread safe as it is only used when the object is constructed by service
-    // or by an internal call by this class
+    // or by an internal call by this class with map_control held
     void object_stub::add_interface(const rpc::shared_ptr<i_interface_stub>& iface)
     {
 #ifdef RPC_V2
-        stub_map[iface->get_interface_id(rpc::VERSION_2)] = iface;
+        auto* current = stub_map.load(std::memory_order_relaxed);
+        auto interfaces = current ? std::make_unique<interface_list>(*current) : std::make_unique<interface_list>();
+        interfaces->emplace_back(iface->get_interface_id(rpc::VERSION_2), iface);
+        stub_map.store(interfaces.get(), std::memory_order_release);
+        stub_map_versions.push_back(std::move(interfaces));
 #endif
     }
 
+    const rpc::shared_ptr<i_interface_stub>* object_stub::find_interface(interface_ordinal interface_id) const
+    {
+        auto* interfaces = stub_map.load(std::memory_order_acquire);
+        if (!interfaces)
+            return nullptr;
+        for (auto& item : *interfaces)
+        {
+            if (item.first == interface_id)
+                return &item.second;
+        }
+        return nullptr;
+    }
+
     rpc::shared_ptr<i_interface_stub> object_stub::get_interface(interface_ordinal interface_id)
     {
-        std::lock_guard g(map_control);
-        auto res = stub_map.find(interface_id);
-        if (res == stub_map.end())
+        auto* stub = find_interface(interface_id);
+        if (!stub)
             return nullptr;
-        return res->second;
+        return *stub;
     }
 
     int object_stub::call(uint64_t protocol_version,
@@ -62,32 +77,47 @@ namespace rpc
         const char* in_buf_,
         std::vector<char>& out_buf_)
     {
-        rpc::shared_ptr<i_interface_stub> stub;
-        {
-            std::lock_guard g(map_control);
-            auto item = stub_map.find(interface_id);
-            if (item != stub_map.end())
-            {
-                stub = item->second;
-            }
-        }
+        // the entry lives as long as this object stub so there is no need to take a reference to it
+        auto* stub = find_interface(interface_id);
         if (stub)
         {
-            return stub->call(
+            return (*stub)->call(
                 protocol_version, enc, caller_channel_zone_id, caller_zone_id, method_id, in_size_, in_buf_, out_buf_);
         }
         return rpc::error::INVALID_INTERFACE_ID();
     }
 
+#ifdef BUILD_COROUTINE
+    task<int> object_stub::async_call(uint64_t protocol_version,
+        rpc::encoding enc,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        auto stub = get_interface(interface_id);
+        if (!stub)
+            co_return rpc::error::INVALID_INTERFACE_ID();
+        co_return co_await stub->async_call(
+            protocol_version, enc, caller_channel_zone_id, caller_zone_id, method_id, in_size_, in_buf_, out_buf_);
+    }
+#endif
+
     int object_stub::try_cast(interface_ordinal interface_id)
     {
+        if (find_interface(interface_id))
+            return rpc::error::OK();
+
         std::lock_guard g(map_control);
         int ret = rpc::error::OK();
-        auto item = stub_map.find(interface_id);
-        if (item == stub_map.end())
+        // check again as another thread may have added it while we were waiting
+        if (!find_interface(interface_id))
         {
             rpc::shared_ptr<i_interface_stub> new_stub;
-            rpc::shared_ptr<i_interface_stub> stub = stub_map.begin()->second;
+            rpc::shared_ptr<i_interface_stub> stub = stub_map.load(std::memory_order_relaxed)->front().second;
             ret = stub->cast(interface_id, new_stub);
             if (ret == rpc::error::OK() && new_stub)
             {
@@ -109,6 +139,21 @@ namespace rpc
         return ret;
     }
 
+    bool object_stub::try_add_ref()
+    {
+        uint64_t count = reference_count.load(std::memory_order_relaxed);
+        do
+        {
+            if (!count)
+                return false;
+        } while (!reference_count.compare_exchange_weak(count, count + 1));
+#ifdef USE_RPC_TELEMETRY
+        if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            telemetry_service->on_stub_add_ref(zone_.get_zone_id(), id_, {}, count + 1, {});
+#endif
+        return true;
+    }
+
     uint64_t object_stub::release()
     {
         uint64_t count = --reference_count;
@@ -0,0 +1,921 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#include "rpc/transport_channel.h"
+#include "rpc/buffer_pool.h"
+#include "rpc/futex.h"
+#include "rpc/version.h"
+
+namespace rpc
+{
+    namespace
+    {
+        bool is_reference_count_call(transport_message_type type)
+        {
+            return type == transport_message_type::add_ref || type == transport_message_type::release
+                || type == transport_message_type::release_batch;
+        }
+
+        uint64_t to_result(int err_code)
+        {
+            return (uint64_t)(int64_t)err_code;
+        }
+
+        int from_result(uint64_t result)
+        {
+            return (int)(int64_t)result;
+        }
+
+        // a large message leaves a large buffer behind, it is dropped once it is idle
+        constexpr size_t max_idle_stream_buffer = 0x100000;
+
+        // surplus workers retire after this long without work
+        constexpr auto worker_idle_timeout = std::chrono::seconds(10);
+
+        // the channel whose worker loop runs on this thread, cleared if the channel is destroyed on it
+        thread_local transport_channel* current_worker_channel = nullptr;
+
+        void report_transport_error([[maybe_unused]] const char* message)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                telemetry_service->message(rpc::i_telemetry_service::err, message);
+            }
+#endif
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // transport_channel
+
+    transport_channel::~transport_channel()
+    {
+        std::vector<std::thread> workers;
+        {
+            std::lock_guard g(work_control_);
+            stopping_ = true;
+            work_available_.notify_all();
+            workers.swap(workers_);
+            for (auto& worker : retired_workers_)
+                workers.push_back(std::move(worker));
+            retired_workers_.clear();
+        }
+        for (auto& worker : workers)
+        {
+            if (worker.get_id() == std::this_thread::get_id())
+            {
+                // the request that this worker ran let go of the last reference, it leaves its loop once this returns
+                current_worker_channel = nullptr;
+                worker.detach();
+            }
+            else
+            {
+                worker.join();
+            }
+        }
+    }
+
+    void transport_channel::set_max_workers(size_t count)
+    {
+        std::lock_guard g(work_control_);
+        max_workers_ = std::max<size_t>(count, 1);
+    }
+
+    size_t transport_channel::get_max_workers() const
+    {
+        std::lock_guard g(work_control_);
+        return max_workers_;
+    }
+
+    void transport_channel::attach(const rpc::shared_ptr<service>& svc)
+    {
+        service_ = svc;
+    }
+
+    void transport_channel::set_connect_handler(connect_handler handler)
+    {
+        connect_handler_ = std::move(handler);
+    }
+
+    void transport_channel::set_close_handler(close_handler handler)
+    {
+        std::lock_guard g(work_control_);
+        close_handler_ = std::move(handler);
+    }
+
+    void transport_channel::start()
+    {
+        {
+            std::lock_guard g(work_control_);
+            if (receiver_running_ || stopping_)
+                return;
+            receiver_running_ = true;
+        }
+        start_receiver();
+    }
+
+    void transport_channel::close()
+    {
+        if (stopping_.exchange(true))
+            return;
+        on_close();
+        std::lock_guard g(work_control_);
+        work_available_.notify_all();
+    }
+
+    void transport_channel::wait_for_close()
+    {
+        std::unique_lock lock(work_control_);
+        stopped_.wait(lock, [&]() { return !receiver_running_; });
+    }
+
+    int transport_channel::call(
+        transport_message& request, const char* payload, transport_message& reply, std::vector<char>& reply_payload)
+    {
+        if (is_closed())
+            return rpc::error::TRANSPORT_ERROR();
+
+        pending_call pending;
+        pending.payload = &reply_payload;
+        pending.from_worker = current_worker_channel == this;
+        request.call_id = next_call_id_++;
+        {
+            std::lock_guard g(pending_control_);
+            pending_calls_[request.call_id] = &pending;
+        }
+
+        // if the call is no longer pending the receiver has claimed it and is about to complete it
+        auto abandon = [&]()
+        {
+            std::lock_guard g(pending_control_);
+            return pending_calls_.erase(request.call_id) != 0;
+        };
+
+        auto err_code = write_message(request, payload);
+        if (err_code != rpc::error::OK() && abandon())
+            return err_code;
+
+        auto is_done = [&]() { return pending.done.load(std::memory_order_acquire) != 0; };
+        if (!adaptive_spin(reply_spin_limit_, is_done))
+        {
+            while (!is_done())
+            {
+                // the other side may be waiting on a request queued behind this worker
+                if (pending.from_worker && run_queued_request())
+                    continue;
+                futex_wait(&pending.done, 0, false);
+                if (!is_done() && is_closed() && abandon())
+                    return rpc::error::TRANSPORT_ERROR();
+            }
+        }
+        if (pending.failed)
+            return rpc::error::TRANSPORT_ERROR();
+        reply = pending.reply;
+        return rpc::error::OK();
+    }
+
+    int transport_channel::post(transport_message& request, const char* payload)
+    {
+        if (is_closed())
+            return rpc::error::TRANSPORT_ERROR();
+        request.call_id = 0;
+        return write_message(request, payload);
+    }
+
+#ifdef BUILD_COROUTINE
+    bool transport_channel::reply_awaiter::await_suspend(std::coroutine_handle<> awaiting)
+    {
+        pending.awaiter = awaiting;
+        auto call_id = request.call_id;
+        {
+            std::lock_guard g(channel.pending_control_);
+            channel.pending_calls_[call_id] = &pending;
+        }
+        // once the request is written the reply may resume the caller on a worker, nothing here may be touched
+        auto& owner = channel;
+        auto write_err = owner.write_message(request, payload);
+        if (write_err == rpc::error::OK())
+            return true;
+        std::lock_guard g(owner.pending_control_);
+        // the receiver has claimed the call and will resume the caller
+        if (owner.pending_calls_.erase(call_id) == 0)
+            return true;
+        err_code = write_err;
+        return false;
+    }
+
+    task<int> transport_channel::async_call(
+        transport_message& request, const char* payload, transport_message& reply, std::vector<char>& reply_payload)
+    {
+        if (is_closed())
+            co_return rpc::error::TRANSPORT_ERROR();
+
+        pending_call pending;
+        pending.payload = &reply_payload;
+        request.call_id = next_call_id_++;
+        auto err_code = co_await reply_awaiter{*this, request, payload, pending};
+        if (err_code != rpc::error::OK())
+            co_return err_code;
+        if (pending.failed)
+            co_return rpc::error::TRANSPORT_ERROR();
+        reply = pending.reply;
+        co_return rpc::error::OK();
+    }
+#endif
+
+    void transport_channel::complete(pending_call* pending)
+    {
+#ifdef BUILD_COROUTINE
+        if (auto awaiter = pending->awaiter)
+        {
+            pending->done.store(1, std::memory_order_release);
+            // the workers stop once the channel is closing so a failed caller is resumed here
+            if (pending->failed)
+            {
+                awaiter.resume();
+                return;
+            }
+            request req;
+            req.resume = awaiter;
+            dispatch(std::move(req));
+            return;
+        }
+#endif
+        pending->done.store(1, std::memory_order_release);
+        futex_wake(&pending->done, false);
+    }
+
+    void transport_channel::fail_pending_calls()
+    {
+        // callers may be resumed here, which must happen outside the lock as they can make further calls
+        std::unordered_map<uint64_t, pending_call*> pending_calls;
+        {
+            std::lock_guard g(pending_control_);
+            pending_calls.swap(pending_calls_);
+        }
+        for (auto& item : pending_calls)
+        {
+            item.second->failed = true;
+            complete(item.second);
+        }
+    }
+
+    void transport_channel::on_message(const transport_message& header, std::vector<char>& payload)
+    {
+        if (header.type != transport_message_type::reply)
+        {
+            dispatch({header, std::move(payload)});
+            payload = {};
+            return;
+        }
+
+        pending_call* pending = nullptr;
+        {
+            std::lock_guard g(pending_control_);
+            auto it = pending_calls_.find(header.call_id);
+            if (it != pending_calls_.end())
+            {
+                pending = it->second;
+                pending_calls_.erase(it);
+            }
+        }
+        // the caller gave up on this call when the channel closed
+        if (!pending)
+            return;
+        pending->reply = header;
+        pending->payload->swap(payload);
+        complete(pending);
+    }
+
+    void transport_channel::on_receiver_stopped()
+    {
+        stopping_ = true;
+        fail_pending_calls();
+#ifdef BUILD_COROUTINE
+        // replies that arrived as the workers stopped still have callers to resume
+        std::vector<std::coroutine_handle<>> resumes;
+        {
+            std::lock_guard g(work_control_);
+            for (auto it = work_.begin(); it != work_.end();)
+            {
+                if (it->resume)
+                {
+                    resumes.push_back(it->resume);
+                    it = work_.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+        for (auto& resume : resumes)
+            resume.resume();
+#endif
+        close_handler handler;
+        {
+            std::lock_guard g(work_control_);
+            receiver_running_ = false;
+            handler = std::move(close_handler_);
+            work_available_.notify_all();
+            stopped_.notify_all();
+        }
+        if (handler)
+            handler();
+    }
+
+    void transport_channel::dispatch(request&& req)
+    {
+        std::vector<std::thread> retired;
+        bool queued = false;
+        {
+            std::lock_guard g(work_control_);
+            work_.push_back(std::move(req));
+            retired.swap(retired_workers_);
+            if (work_.size() <= idle_workers_)
+                work_available_.notify_one();
+            else if (workers_.size() < max_workers_)
+                workers_.emplace_back([this]() { worker_loop(); });
+            else
+                queued = true;
+        }
+        // every worker is busy, any of them that is waiting on the other side can run the request meanwhile
+        if (queued)
+            wake_waiting_workers();
+        for (auto& worker : retired)
+            worker.join();
+    }
+
+    void transport_channel::wake_waiting_workers()
+    {
+        std::lock_guard g(pending_control_);
+        for (auto& item : pending_calls_)
+        {
+            if (item.second->from_worker)
+                futex_wake(&item.second->done, false);
+        }
+    }
+
+    bool transport_channel::run_queued_request()
+    {
+        request req;
+        {
+            std::lock_guard g(work_control_);
+            if (work_.empty())
+                return false;
+            req = std::move(work_.front());
+            work_.pop_front();
+        }
+        handle_request(req);
+        return true;
+    }
+
+    void transport_channel::retire_worker()
+    {
+        auto id = std::this_thread::get_id();
+        auto it = std::find_if(
+            workers_.begin(), workers_.end(), [&](const std::thread& worker) { return worker.get_id() == id; });
+        RPC_ASSERT(it != workers_.end());
+        retired_workers_.push_back(std::move(*it));
+        workers_.erase(it);
+    }
+
+    void transport_channel::worker_loop()
+    {
+        current_worker_channel = this;
+        // requests already run on this pool so a zone's dispatcher does not take them on another thread
+        worker_scope worker;
+        std::unique_lock lock(work_control_);
+        while (true)
+        {
+            idle_workers_++;
+            auto has_work = work_available_.wait_for(
+                lock, worker_idle_timeout, [&]() { return !work_.empty() || stopping_; });
+            idle_workers_--;
+            // the destructor joins the workers that have stopped
+            if (stopping_)
+                return;
+            if (!has_work)
+            {
+                retire_worker();
+                return;
+            }
+            auto req = std::move(work_.front());
+            work_.pop_front();
+            lock.unlock();
+            {
+                // the channel is only held while a request runs so that an idle pool never keeps it alive
+                auto self = weak_from_this().lock();
+                if (!self)
+                    return;
+                handle_request(req);
+            }
+            if (current_worker_channel != this)
+                return;
+            lock.lock();
+        }
+    }
+
+    void transport_channel::handle_request(request& req)
+    {
+#ifdef BUILD_COROUTINE
+        if (req.resume)
+        {
+            req.resume.resume();
+            return;
+        }
+#endif
+        const auto& in = req.header;
+        transport_message reply;
+        reply.type = transport_message_type::reply;
+        reply.call_id = in.call_id;
+
+        rpc::pooled_buffer pooled_out;
+        auto& out_buf = pooled_out.get();
+        out_buf.clear();
+
+        auto fail = [&](int err_code)
+        {
+            reply.result
+                = is_reference_count_call(in.type) ? std::numeric_limits<uint64_t>::max() : to_result(err_code);
+        };
+
+        auto svc = service_.lock();
+        if (in.type == transport_message_type::connect)
+        {
+            uint64_t output_object_id = 0;
+            auto err_code = connect_handler_ ? connect_handler_(in, output_object_id) : rpc::error::ZONE_NOT_SUPPORTED();
+            reply.object_id = output_object_id;
+            reply.result = to_result(err_code);
+        }
+        else if (in.protocol_version > rpc::get_version())
+        {
+            fail(rpc::error::INVALID_VERSION());
+        }
+        else if (!svc)
+        {
+            fail(rpc::error::ZONE_NOT_INITIALISED());
+        }
+        else
+        {
+            switch (in.type)
+            {
+            case transport_message_type::send:
+                // the payload is a copy in this address space, pointers from the other process mean nothing here
+                if (rpc::encoding(in.encoding) == rpc::encoding::direct)
+                {
+                    fail(rpc::error::INCOMPATIBLE_SERIALISATION());
+                    break;
+                }
+                reply.result = to_result(svc->send(in.protocol_version,
+                    rpc::encoding(in.encoding),
+                    in.tag,
+                    {in.caller_channel_zone_id},
+                    {in.caller_zone_id},
+                    {in.destination_zone_id},
+                    {in.object_id},
+                    {in.interface_id},
+                    {in.method_id},
+                    req.payload.size(),
+                    req.payload.data(),
+                    out_buf));
+                if (out_buf.size() > get_max_payload_size())
+                {
+                    report_transport_error("transport_channel reply is larger than the transport allows");
+                    out_buf.clear();
+                    fail(rpc::error::TRANSPORT_ERROR());
+                }
+                break;
+            case transport_message_type::post:
+                if (rpc::encoding(in.encoding) == rpc::encoding::direct)
+                {
+                    report_transport_error("transport_channel oneway call with the direct encoding dropped");
+                    break;
+                }
+                // the caller is not waiting so a failure has nowhere to go
+                std::ignore = svc->post(in.protocol_version,
+                    rpc::encoding(in.encoding),
+                    in.tag,
+                    {in.caller_channel_zone_id},
+                    {in.caller_zone_id},
+                    {in.destination_zone_id},
+                    {in.object_id},
+                    {in.interface_id},
+                    {in.method_id},
+                    req.payload.size(),
+                    req.payload.data());
+                break;
+            case transport_message_type::try_cast:
+                reply.result = to_result(
+                    svc->try_cast(in.protocol_version, {in.destination_zone_id}, {in.object_id}, {in.interface_id}));
+                break;
+            case transport_message_type::add_ref:
+                reply.result = svc->add_ref(in.protocol_version,
+                    {in.destination_channel_zone_id},
+                    {in.destination_zone_id},
+                    {in.object_id},
+                    {in.caller_channel_zone_id},
+                    {in.caller_zone_id},
+                    static_cast<rpc::add_ref_options>(in.options));
+                break;
+            case transport_message_type::release:
+                reply.result
+                    = svc->release(in.protocol_version, {in.destination_zone_id}, {in.object_id}, {in.caller_zone_id});
+                break;
+            case transport_message_type::release_batch:
+            {
+                std::vector<std::pair<rpc::object, uint64_t>> releases;
+                if (!rpc::unpack_release_batch(req.payload.data(), req.payload.size(), releases))
+                {
+                    fail(rpc::error::INVALID_DATA());
+                    break;
+                }
+                reply.result = svc->release_batch(
+                    in.protocol_version, {in.destination_zone_id}, {in.caller_zone_id}, releases);
+                break;
+            }
+            default:
+                fail(rpc::error::INVALID_DATA());
+                break;
+            }
+        }
+
+        if (in.type == transport_message_type::post)
+            return;
+        reply.payload_size = (uint32_t)out_buf.size();
+        write_message(reply, out_buf.data());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // stream_message_reader
+
+    char* stream_message_reader::prepare(size_t min_size, size_t& available)
+    {
+        if (start_ == end_)
+        {
+            start_ = end_ = 0;
+            if (buffer_.size() > max_idle_stream_buffer && min_size <= max_idle_stream_buffer)
+                buffer_ = std::vector<char>();
+        }
+        if (buffer_.size() - end_ < min_size)
+        {
+            if (start_)
+            {
+                memmove(buffer_.data(), buffer_.data() + start_, end_ - start_);
+                end_ -= start_;
+                start_ = 0;
+            }
+            if (buffer_.size() - end_ < min_size)
+                buffer_.resize(end_ + min_size);
+        }
+        available = buffer_.size() - end_;
+        return buffer_.data() + end_;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // transport_listener
+
+    void transport_listener::add_zone(
+        const transport_channel* channel, const rpc::shared_ptr<rpc::child_service>& child_service)
+    {
+        std::lock_guard g(zones_control_);
+        zones_[channel] = child_service;
+    }
+
+    void transport_listener::remove_zone(const transport_channel* channel)
+    {
+        // the zone is torn down outside the lock as that can call back into the listener
+        rpc::shared_ptr<rpc::child_service> child_service;
+        std::lock_guard g(zones_control_);
+        auto it = zones_.find(channel);
+        if (it == zones_.end())
+            return;
+        child_service = std::move(it->second);
+        zones_.erase(it);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // transport_service_proxy
+
+    transport_service_proxy::channel_owner::~channel_owner()
+    {
+        channel_->close();
+    }
+
+    transport_service_proxy::transport_service_proxy(const char* name,
+        destination_zone destination_zone_id,
+        const rpc::shared_ptr<service>& svc,
+        std::shared_ptr<channel_owner> channel_owner)
+        : service_proxy(name, destination_zone_id, svc)
+        , channel_owner_(std::move(channel_owner))
+        , channel_(channel_owner_->channel_.get())
+    {
+    }
+
+    rpc::shared_ptr<service_proxy> transport_service_proxy::clone()
+    {
+        return rpc::shared_ptr<service_proxy>(new transport_service_proxy(*this));
+    }
+
+    rpc::shared_ptr<transport_service_proxy> transport_service_proxy::create(const char* name,
+        destination_zone destination_zone_id,
+        const rpc::shared_ptr<service>& svc,
+        std::shared_ptr<transport_channel> channel)
+    {
+        RPC_ASSERT(svc);
+        RPC_ASSERT(channel);
+        if (!channel)
+            return nullptr;
+        channel->attach(svc);
+        channel->start();
+        return rpc::shared_ptr<transport_service_proxy>(new transport_service_proxy(
+            name, destination_zone_id, svc, std::make_shared<channel_owner>(std::move(channel))));
+    }
+
+    int transport_service_proxy::connect(rpc::interface_descriptor input_descr, rpc::interface_descriptor& output_descr)
+    {
+        transport_message request;
+        request.type = transport_message_type::connect;
+        request.protocol_version = rpc::get_version();
+        request.caller_zone_id = get_zone_id().get_val();
+        request.destination_zone_id = get_destination_zone_id().get_val();
+        request.object_id = input_descr.object_id.get_val();
+
+        transport_message reply;
+        std::vector<char> reply_payload;
+        if (channel_->call(request, nullptr, reply, reply_payload) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy connect failed");
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        auto err_code = from_result(reply.result);
+        if (err_code != rpc::error::OK())
+            return err_code;
+
+        output_descr = {{reply.object_id}, get_destination_zone_id()};
+        return err_code;
+    }
+
+    int transport_service_proxy::send(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        transport_message request;
+        auto err_code = make_send_request(request,
+            protocol_version,
+            encoding,
+            tag,
+            caller_channel_zone_id,
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            in_size_);
+        if (err_code != rpc::error::OK())
+            return err_code;
+
+        transport_message reply;
+        if (channel_->call(request, in_buf_, reply, out_buf_) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy send failed");
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        return from_result(reply.result);
+    }
+
+#ifdef BUILD_COROUTINE
+    task<int> transport_service_proxy::async_send(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_)
+    {
+        transport_message request;
+        auto err_code = make_send_request(request,
+            protocol_version,
+            encoding,
+            tag,
+            caller_channel_zone_id,
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            in_size_);
+        if (err_code != rpc::error::OK())
+            co_return err_code;
+
+        transport_message reply;
+        if (co_await channel_->async_call(request, in_buf_, reply, out_buf_) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy send failed");
+            co_return rpc::error::TRANSPORT_ERROR();
+        }
+        co_return from_result(reply.result);
+    }
+#endif
+
+    int transport_service_proxy::make_send_request(transport_message& request,
+        uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_)
+    {
+        if (destination_zone_id != get_destination_zone_id())
+            return rpc::error::ZONE_NOT_SUPPORTED();
+        if (in_size_ > channel_->get_max_payload_size())
+        {
+            report_transport_error("transport_service_proxy request is larger than the transport allows");
+            return rpc::error::TRANSPORT_ERROR();
+        }
+
+        request.type = transport_message_type::send;
+        request.payload_size = (uint32_t)in_size_;
+        request.protocol_version = protocol_version;
+        request.encoding = (uint64_t)encoding;
+        request.tag = tag;
+        request.caller_channel_zone_id = caller_channel_zone_id.get_val();
+        request.caller_zone_id = caller_zone_id.get_val();
+        request.destination_zone_id = destination_zone_id.get_val();
+        request.object_id = object_id.get_val();
+        request.interface_id = interface_id.get_val();
+        request.method_id = method_id.get_val();
+        return rpc::error::OK();
+    }
+
+    int transport_service_proxy::post(uint64_t protocol_version,
+        encoding encoding,
+        uint64_t tag,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        interface_ordinal interface_id,
+        method method_id,
+        size_t in_size_,
+        const char* in_buf_)
+    {
+        if (destination_zone_id != get_destination_zone_id())
+            return rpc::error::ZONE_NOT_SUPPORTED();
+        // the payload is copied onto the transport but the other side cannot follow pointers into this process
+        if (encoding == encoding::direct)
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        transport_message request;
+        auto err_code = make_send_request(request,
+            protocol_version,
+            encoding,
+            tag,
+            caller_channel_zone_id,
+            caller_zone_id,
+            destination_zone_id,
+            object_id,
+            interface_id,
+            method_id,
+            in_size_);
+        if (err_code != rpc::error::OK())
+            return err_code;
+        request.type = transport_message_type::post;
+
+        if (channel_->post(request, in_buf_) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy post failed");
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        return rpc::error::OK();
+    }
+
+    int transport_service_proxy::try_cast(
+        uint64_t protocol_version, destination_zone destination_zone_id, object object_id, interface_ordinal interface_id)
+    {
+        transport_message request;
+        request.type = transport_message_type::try_cast;
+        request.protocol_version = protocol_version;
+        request.destination_zone_id = destination_zone_id.get_val();
+        request.object_id = object_id.get_val();
+        request.interface_id = interface_id.get_val();
+
+        transport_message reply;
+        std::vector<char> reply_payload;
+        if (channel_->call(request, nullptr, reply, reply_payload) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy try_cast failed");
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        return from_result(reply.result);
+    }
+
+    uint64_t transport_service_proxy::add_ref(uint64_t protocol_version,
+        destination_channel_zone destination_channel_zone_id,
+        destination_zone destination_zone_id,
+        object object_id,
+        caller_channel_zone caller_channel_zone_id,
+        caller_zone caller_zone_id,
+        add_ref_options build_out_param_channel)
+    {
+#ifdef USE_RPC_TELEMETRY
+        if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+        {
+            telemetry_service->on_service_proxy_add_ref(get_zone_id(),
+                destination_zone_id,
+                destination_channel_zone_id,
+                get_caller_zone_id(),
+                object_id,
+                build_out_param_channel);
+        }
+#endif
+        transport_message request;
+        request.type = transport_message_type::add_ref;
+        request.protocol_version = protocol_version;
+        request.destination_channel_zone_id = destination_channel_zone_id.get_val();
+        request.destination_zone_id = destination_zone_id.get_val();
+        request.object_id = object_id.get_val();
+        request.caller_channel_zone_id = caller_channel_zone_id.get_val();
+        request.caller_zone_id = caller_zone_id.get_val();
+        request.options = (uint64_t)build_out_param_channel;
+
+        transport_message reply;
+        std::vector<char> reply_payload;
+        if (channel_->call(request, nullptr, reply, reply_payload) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy add_ref failed");
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return reply.result;
+    }
+
+    uint64_t transport_service_proxy::release(
+        uint64_t protocol_version, destination_zone destination_zone_id, object object_id, caller_zone caller_zone_id)
+    {
+        transport_message request;
+        request.type = transport_message_type::release;
+        request.protocol_version = protocol_version;
+        request.destination_zone_id = destination_zone_id.get_val();
+        request.object_id = object_id.get_val();
+        request.caller_zone_id = caller_zone_id.get_val();
+
+        transport_message reply;
+        std::vector<char> reply_payload;
+        if (channel_->call(request, nullptr, reply, reply_payload) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy release failed");
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return reply.result;
+    }
+
+    uint64_t transport_service_proxy::release_batch(uint64_t protocol_version,
+        destination_zone destination_zone_id,
+        caller_zone caller_zone_id,
+        const std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        std::vector<uint64_t> packed;
+        rpc::pack_release_batch(releases, packed);
+        auto payload_size = packed.size() * sizeof(uint64_t);
+        // a batch too large for one message goes as a release per reference
+        if (payload_size > channel_->get_max_payload_size())
+            return i_marshaller::release_batch(protocol_version, destination_zone_id, caller_zone_id, releases);
+
+        transport_message request;
+        request.type = transport_message_type::release_batch;
+        request.payload_size = (uint32_t)payload_size;
+        request.protocol_version = protocol_version;
+        request.destination_zone_id = destination_zone_id.get_val();
+        request.caller_zone_id = caller_zone_id.get_val();
+
+        transport_message reply;
+        std::vector<char> reply_payload;
+        if (channel_->call(request, (const char*)packed.data(), reply, reply_payload) != rpc::error::OK())
+        {
+            report_transport_error("transport_service_proxy release_batch failed");
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return reply.result;
+    }
+}
@@ -0,0 +1,376 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "rpc/uds_service_proxy.h"
+
+namespace rpc
+{
+    namespace
+    {
+        // caps what a misbehaving peer can make this side allocate for one message
+        constexpr size_t max_message_size = 1 << 28;
+        constexpr size_t read_chunk_size = 0x10000;
+        // reads per readiness event so that one busy connection cannot starve the others
+        constexpr int max_reads_per_event = 16;
+        constexpr int write_poll_timeout_ms = 50;
+
+        bool make_address(const std::string& path, sockaddr_un& addr)
+        {
+            if (path.empty() || path.size() >= sizeof(addr.sun_path))
+                return false;
+            addr = {};
+            addr.sun_family = AF_UNIX;
+            memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            return true;
+        }
+    }
+
+    int listen_unix_socket(const std::string& path, bool non_blocking)
+    {
+        sockaddr_un addr;
+        if (!make_address(path, addr))
+            return -1;
+
+        // a socket file left behind by a process that died would otherwise block the bind, anything else is kept
+        struct stat st = {};
+        if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(path.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | (non_blocking ? SOCK_NONBLOCK : 0), 0);
+        if (fd == -1)
+            return -1;
+        if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) == -1)
+        {
+            ::close(fd);
+            return -1;
+        }
+        if (::listen(fd, SOMAXCONN) == -1)
+        {
+            ::close(fd);
+            unlink(path.c_str());
+            return -1;
+        }
+        return fd;
+    }
+
+    int connect_unix_socket(const std::string& path, bool non_blocking)
+    {
+        sockaddr_un addr;
+        if (!make_address(path, addr))
+            return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return -1;
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1
+            || (non_blocking && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1))
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // one epoll thread per process that waits on every uds socket, handlers return false to be removed
+    class uds_reactor
+    {
+        int epoll_fd_ = -1;
+        int wake_fd_ = -1;
+        std::mutex control_;
+        std::unordered_map<int, std::function<bool()>> handlers_;
+        std::atomic<bool> stopping_ = false;
+        std::thread thread_;
+
+        uds_reactor()
+        {
+            epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+            wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = wake_fd_;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+            thread_ = std::thread([this]() { run(); });
+        }
+
+        ~uds_reactor()
+        {
+            stopping_ = true;
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_fd_, &one, sizeof(one));
+            thread_.join();
+            std::unordered_map<int, std::function<bool()>> handlers;
+            {
+                std::lock_guard g(control_);
+                handlers.swap(handlers_);
+            }
+            handlers.clear();
+            ::close(wake_fd_);
+            ::close(epoll_fd_);
+        }
+
+        void run()
+        {
+            std::array<epoll_event, 64> events;
+            while (!stopping_)
+            {
+                auto count = epoll_wait(epoll_fd_, events.data(), (int)events.size(), -1);
+                if (count == -1)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+                for (int i = 0; i < count; i++)
+                {
+                    auto fd = events[i].data.fd;
+                    if (fd == wake_fd_)
+                    {
+                        uint64_t value = 0;
+                        [[maybe_unused]] auto read = ::read(wake_fd_, &value, sizeof(value));
+                        continue;
+                    }
+                    // the handler is copied so that it can run without the lock and survive its own removal
+                    std::function<bool()> handler;
+                    {
+                        std::lock_guard g(control_);
+                        auto it = handlers_.find(fd);
+                        if (it == handlers_.end())
+                            continue;
+                        handler = it->second;
+                    }
+                    if (!handler())
+                        remove(fd);
+                }
+            }
+        }
+
+    public:
+        static uds_reactor& get()
+        {
+            static uds_reactor reactor;
+            return reactor;
+        }
+
+        bool add(int fd, std::function<bool()> on_readable)
+        {
+            std::lock_guard g(control_);
+            handlers_[fd] = std::move(on_readable);
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1)
+            {
+                handlers_.erase(fd);
+                return false;
+            }
+            return true;
+        }
+
+        void remove(int fd)
+        {
+            // released outside the lock as it may hold the last reference to a channel
+            std::function<bool()> handler;
+            {
+                std::lock_guard g(control_);
+                auto it = handlers_.find(fd);
+                if (it == handlers_.end())
+                    return;
+                handler = std::move(it->second);
+                handlers_.erase(it);
+                epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            }
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // uds_channel
+
+    uds_channel::uds_channel(int fd)
+        : fd_(fd)
+    {
+    }
+
+    uds_channel::~uds_channel()
+    {
+        if (fd_ != -1)
+            ::close(fd_);
+    }
+
+    std::shared_ptr<uds_channel> uds_channel::connect(const std::string& path)
+    {
+        int fd = connect_unix_socket(path, true);
+        if (fd == -1)
+            return nullptr;
+        return std::shared_ptr<uds_channel>(new uds_channel(fd));
+    }
+
+    size_t uds_channel::get_max_payload_size() const
+    {
+        return max_message_size - sizeof(transport_message);
+    }
+
+    void uds_channel::start_receiver()
+    {
+        auto self = std::static_pointer_cast<uds_channel>(shared_from_this());
+        if (!uds_reactor::get().add(fd_, [self]() { return self->on_readable(); }))
+            on_receiver_stopped();
+    }
+
+    void uds_channel::on_close()
+    {
+        // the reactor sees the hang up on both ends and retires the socket
+        shutdown(fd_, SHUT_RDWR);
+    }
+
+    int uds_channel::write_message(const transport_message& header, const char* payload)
+    {
+        constexpr size_t header_size = sizeof(transport_message);
+        size_t total = header_size + header.payload_size;
+        size_t sent = 0;
+
+        std::lock_guard g(write_control_);
+        while (sent < total)
+        {
+            iovec iov[2];
+            size_t iov_count = 0;
+            if (sent < header_size)
+            {
+                iov[iov_count++] = {(char*)&header + sent, header_size - sent};
+                if (header.payload_size)
+                    iov[iov_count++] = {(void*)payload, header.payload_size};
+            }
+            else
+            {
+                iov[iov_count++] = {(void*)(payload + sent - header_size), total - sent};
+            }
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+
+            auto count = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (count > 0)
+            {
+                sent += count;
+                continue;
+            }
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                if (is_closed())
+                    return rpc::error::TRANSPORT_ERROR();
+                pollfd pfd = {fd_, POLLOUT, 0};
+                poll(&pfd, 1, write_poll_timeout_ms);
+                continue;
+            }
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        return rpc::error::OK();
+    }
+
+    bool uds_channel::on_readable()
+    {
+        for (int reads = 0; reads < max_reads_per_event; reads++)
+        {
+            size_t available = 0;
+            auto* dest = reader_.prepare(read_chunk_size, available);
+            auto count = recv(fd_, dest, available, 0);
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;
+            // the other side hung up or the socket failed
+            if (count <= 0)
+                break;
+
+            reader_.commit(count);
+            if (!reader_.extract(get_max_payload_size(),
+                    [this](const transport_message& header, std::vector<char>& payload) { on_message(header, payload); }))
+            {
+#ifdef USE_RPC_TELEMETRY
+                if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                {
+                    telemetry_service->message(rpc::i_telemetry_service::err, "uds_channel received an oversized frame");
+                }
+#endif
+                break;
+            }
+            // level triggered epoll calls again if there is more to read
+            if (reads + 1 == max_reads_per_event)
+                return true;
+        }
+        close();
+        on_receiver_stopped();
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // uds_listener
+
+    uds_listener::~uds_listener()
+    {
+        if (fd_ == -1)
+            return;
+        ::close(fd_);
+        if (!closed_)
+            unlink(path_.c_str());
+    }
+
+    std::shared_ptr<uds_listener> uds_listener::bind(const std::string& path)
+    {
+        int fd = listen_unix_socket(path, true);
+        if (fd == -1)
+            return nullptr;
+        auto listener = std::shared_ptr<uds_listener>(new uds_listener());
+        listener->fd_ = fd;
+        listener->path_ = path;
+        return listener;
+    }
+
+    void uds_listener::start()
+    {
+        auto self = std::static_pointer_cast<uds_listener>(shared_from_this());
+        uds_reactor::get().add(fd_, [self]() { return self->on_readable(); });
+    }
+
+    void uds_listener::close()
+    {
+        if (closed_.exchange(true))
+            return;
+        // the path is given up straight away so that a new listener can bind it before this one is torn down
+        unlink(path_.c_str());
+        uds_reactor::get().remove(fd_);
+    }
+
+    bool uds_listener::on_readable()
+    {
+        while (!closed_)
+        {
+            int fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd != -1)
+            {
+                on_accept_(std::shared_ptr<uds_channel>(new uds_channel(fd)));
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            // EAGAIN once the backlog is empty, anything else is retried on the next readiness event
+            return true;
+        }
+        return false;
+    }
+}
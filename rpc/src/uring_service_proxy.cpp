@@ -0,0 +1,710 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rpc/uring_service_proxy.h"
+
+namespace rpc
+{
+    namespace
+    {
+        // caps what a misbehaving peer can make this side allocate for one message
+        constexpr size_t max_message_size = 1 << 28;
+        constexpr unsigned ring_entries = 256;
+        // the provided buffers shared by every receive in the process, the count must be a power of two
+        constexpr unsigned buffer_count = 256;
+        constexpr size_t buffer_size = 0x4000;
+        constexpr uint16_t buffer_group = 0;
+        // a single send never asks the kernel for more than this, the remainder goes out when it completes
+        constexpr size_t max_send_size = 1 << 30;
+
+        // the low bits of the user data say what completed, the rest points at the channel or listener
+        enum operation : uint64_t
+        {
+            wake_operation = 0,
+            receive_operation,
+            send_operation,
+            accept_operation,
+            cancel_operation
+        };
+        constexpr uint64_t operation_mask = 7;
+
+        uint64_t make_user_data(const void* target, operation op)
+        {
+            return (uint64_t)(uintptr_t)target | op;
+        }
+
+        // liburing is not a dependency, the three system calls are all that is needed
+        int uring_setup(unsigned entries, io_uring_params* params)
+        {
+            return (int)syscall(__NR_io_uring_setup, entries, params);
+        }
+
+        int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        int uring_register(int ring_fd, unsigned opcode, void* arg, unsigned nr_args)
+        {
+            return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+        }
+    }
+
+    // one io_uring per process driven by one thread, other threads hand it work as commands and wake it through an
+    // eventfd read that is kept armed in the ring
+    class uring_reactor
+    {
+        int ring_fd_ = -1;
+        int wake_fd_ = -1;
+        uint64_t wake_value_ = 0;
+
+        void* sq_mapping_ = MAP_FAILED;
+        size_t sq_mapping_size_ = 0;
+        void* cq_mapping_ = MAP_FAILED;
+        size_t cq_mapping_size_ = 0;
+        void* sqes_mapping_ = MAP_FAILED;
+        size_t sqes_mapping_size_ = 0;
+
+        io_uring_sqe* sqes_ = nullptr;
+        unsigned* sq_head_ = nullptr;
+        unsigned* sq_tail_ = nullptr;
+        unsigned* sq_array_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned sq_entries_ = 0;
+        // entries filled in locally and entries handed to the kernel
+        unsigned sqe_tail_ = 0;
+        unsigned submitted_tail_ = 0;
+
+        io_uring_cqe* cqes_ = nullptr;
+        unsigned* cq_head_ = nullptr;
+        unsigned* cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+
+        // registered with the kernel which picks a buffer for each received chunk and names it in the completion
+        io_uring_buf_ring* buffer_ring_ = (io_uring_buf_ring*)MAP_FAILED;
+        size_t buffer_ring_size_ = 0;
+        std::unique_ptr<char[]> buffers_;
+        uint16_t buffer_ring_tail_ = 0;
+
+        // cleared if the kernel rejects multishot receives or accepts, every operation is then rearmed by hand
+        bool multishot_ = true;
+        bool available_ = false;
+
+        std::mutex commands_control_;
+        std::vector<std::function<void()>> commands_;
+        std::atomic<bool> sleeping_ = false;
+        std::atomic<bool> stopping_ = false;
+        std::thread thread_;
+
+        uring_reactor()
+        {
+            available_ = setup();
+            if (available_)
+                thread_ = std::thread([this]() { run(); });
+        }
+
+        ~uring_reactor()
+        {
+            if (thread_.joinable())
+            {
+                stopping_ = true;
+                wake();
+                thread_.join();
+            }
+            // closing the ring cancels anything still in flight, channels it was holding are left to the process exit
+            if (sqes_mapping_ != MAP_FAILED)
+                munmap(sqes_mapping_, sqes_mapping_size_);
+            if (cq_mapping_ != MAP_FAILED && cq_mapping_ != sq_mapping_)
+                munmap(cq_mapping_, cq_mapping_size_);
+            if (sq_mapping_ != MAP_FAILED)
+                munmap(sq_mapping_, sq_mapping_size_);
+            if (ring_fd_ != -1)
+                ::close(ring_fd_);
+            if ((void*)buffer_ring_ != MAP_FAILED)
+                munmap(buffer_ring_, buffer_ring_size_);
+            if (wake_fd_ != -1)
+                ::close(wake_fd_);
+        }
+
+        bool setup()
+        {
+            io_uring_params params = {};
+            // the reactor enters the kernel on every pass so completions never need to interrupt it
+            params.flags = IORING_SETUP_COOP_TASKRUN;
+            ring_fd_ = uring_setup(ring_entries, &params);
+            if (ring_fd_ == -1 && errno == EINVAL)
+            {
+                params = {};
+                ring_fd_ = uring_setup(ring_entries, &params);
+            }
+            if (ring_fd_ == -1)
+                return false;
+
+            sq_mapping_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_mapping_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mapping)
+                sq_mapping_size_ = cq_mapping_size_ = std::max(sq_mapping_size_, cq_mapping_size_);
+            sq_mapping_ = mmap(nullptr,
+                sq_mapping_size_,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                ring_fd_,
+                IORING_OFF_SQ_RING);
+            if (sq_mapping_ == MAP_FAILED)
+                return false;
+            cq_mapping_ = single_mapping ? sq_mapping_
+                                         : mmap(nullptr,
+                                               cq_mapping_size_,
+                                               PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE,
+                                               ring_fd_,
+                                               IORING_OFF_CQ_RING);
+            if (cq_mapping_ == MAP_FAILED)
+                return false;
+            sqes_mapping_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            sqes_mapping_ = mmap(nullptr,
+                sqes_mapping_size_,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                ring_fd_,
+                IORING_OFF_SQES);
+            if (sqes_mapping_ == MAP_FAILED)
+                return false;
+
+            auto* sq = static_cast<char*>(sq_mapping_);
+            sq_head_ = (unsigned*)(sq + params.sq_off.head);
+            sq_tail_ = (unsigned*)(sq + params.sq_off.tail);
+            sq_array_ = (unsigned*)(sq + params.sq_off.array);
+            sq_mask_ = *(unsigned*)(sq + params.sq_off.ring_mask);
+            sq_entries_ = params.sq_entries;
+            sqes_ = static_cast<io_uring_sqe*>(sqes_mapping_);
+            sqe_tail_ = submitted_tail_ = *sq_tail_;
+
+            auto* cq = static_cast<char*>(cq_mapping_);
+            cq_head_ = (unsigned*)(cq + params.cq_off.head);
+            cq_tail_ = (unsigned*)(cq + params.cq_off.tail);
+            cq_mask_ = *(unsigned*)(cq + params.cq_off.ring_mask);
+            cqes_ = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+            buffer_ring_size_ = buffer_count * sizeof(io_uring_buf);
+            buffer_ring_ = (io_uring_buf_ring*)mmap(
+                nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if ((void*)buffer_ring_ == MAP_FAILED)
+                return false;
+            io_uring_buf_reg reg = {};
+            reg.ring_addr = (uint64_t)(uintptr_t)buffer_ring_;
+            reg.ring_entries = buffer_count;
+            reg.bgid = buffer_group;
+            if (uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+                return false;
+            buffers_.reset(new char[buffer_count * buffer_size]);
+            for (unsigned i = 0; i < buffer_count; i++)
+                provide_buffer((uint16_t)i);
+
+            wake_fd_ = eventfd(0, EFD_CLOEXEC);
+            return wake_fd_ != -1;
+        }
+
+        void run()
+        {
+            arm_wake();
+            while (!stopping_)
+            {
+                run_commands();
+                reap_completions();
+                bool wait = false;
+                {
+                    std::lock_guard g(commands_control_);
+                    wait = commands_.empty() && !completions_ready() && !stopping_;
+                    sleeping_ = wait;
+                }
+                // everything queued by this pass goes to the kernel in one call, which also waits when idle
+                submit(wait ? 1 : 0);
+                sleeping_ = false;
+            }
+        }
+
+        void post(std::function<void()> command)
+        {
+            bool sleeping = false;
+            {
+                std::lock_guard g(commands_control_);
+                commands_.push_back(std::move(command));
+                sleeping = sleeping_;
+            }
+            if (sleeping)
+                wake();
+        }
+
+        void wake()
+        {
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_fd_, &one, sizeof(one));
+        }
+
+        void run_commands()
+        {
+            std::vector<std::function<void()>> commands;
+            {
+                std::lock_guard g(commands_control_);
+                commands.swap(commands_);
+            }
+            for (auto& command : commands)
+                command();
+        }
+
+        ////////////////////////////////////////////////////////////////////////
+        // ring access, reactor thread only
+
+        io_uring_sqe* get_sqe()
+        {
+            if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+            {
+                submit(0);
+                if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+                    return nullptr;
+            }
+            auto index = sqe_tail_ & sq_mask_;
+            auto* sqe = &sqes_[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sq_array_[index] = index;
+            sqe_tail_++;
+            return sqe;
+        }
+
+        void submit(unsigned min_complete)
+        {
+            __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+            auto submitted = uring_enter(ring_fd_, sqe_tail_ - submitted_tail_, min_complete, IORING_ENTER_GETEVENTS);
+            if (submitted > 0)
+                submitted_tail_ += submitted;
+        }
+
+        bool completions_ready() const
+        {
+            return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        }
+
+        void reap_completions()
+        {
+            unsigned head = *cq_head_;
+            while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+            {
+                auto cqe = cqes_[head & cq_mask_];
+                __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+                on_completion(cqe);
+            }
+        }
+
+        void provide_buffer(uint16_t buffer_id)
+        {
+            // indexed by hand as the flexible array member of io_uring_buf_ring is offset when compiled as c++
+            auto& buf = reinterpret_cast<io_uring_buf*>(buffer_ring_)[buffer_ring_tail_ & (buffer_count - 1)];
+            buf.addr = (uint64_t)(uintptr_t)(buffers_.get() + buffer_id * buffer_size);
+            buf.len = buffer_size;
+            buf.bid = buffer_id;
+            buffer_ring_tail_++;
+            __atomic_store_n(&buffer_ring_->tail, buffer_ring_tail_, __ATOMIC_RELEASE);
+        }
+
+        void arm_wake()
+        {
+            auto* sqe = get_sqe();
+            if (!sqe)
+                return;
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = wake_fd_;
+            sqe->addr = (uint64_t)(uintptr_t)&wake_value_;
+            sqe->len = sizeof(wake_value_);
+            sqe->off = (uint64_t)-1;
+            sqe->user_data = make_user_data(nullptr, wake_operation);
+        }
+
+        void on_completion(const io_uring_cqe& cqe)
+        {
+            auto* target = (void*)(uintptr_t)(cqe.user_data & ~operation_mask);
+            switch (cqe.user_data & operation_mask)
+            {
+            case wake_operation:
+                if (!stopping_)
+                    arm_wake();
+                break;
+            case receive_operation:
+                on_receive(*static_cast<uring_channel*>(target), cqe);
+                break;
+            case send_operation:
+                on_send(*static_cast<uring_channel*>(target), cqe);
+                break;
+            case accept_operation:
+                on_accept(*static_cast<uring_listener*>(target), cqe);
+                break;
+            default:
+                break;
+            }
+        }
+
+        ////////////////////////////////////////////////////////////////////////
+        // channels
+
+        void arm_receive(uring_channel& channel)
+        {
+            auto* sqe = get_sqe();
+            if (!sqe)
+            {
+                channel.receive_armed_ = false;
+                channel.close();
+                finish(channel);
+                return;
+            }
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = channel.fd_;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = buffer_group;
+            if (multishot_)
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+            else
+                sqe->len = buffer_size;
+            sqe->user_data = make_user_data(&channel, receive_operation);
+            channel.receive_armed_ = true;
+        }
+
+        void on_receive(uring_channel& channel, const io_uring_cqe& cqe)
+        {
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+            if (cqe.res > 0)
+            {
+                auto buffer_id = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                bool valid = channel.reader_.append(buffers_.get() + buffer_id * buffer_size,
+                    cqe.res,
+                    channel.get_max_payload_size(),
+                    [&channel](const transport_message& header, std::vector<char>& payload)
+                    { channel.on_message(header, payload); });
+                provide_buffer(buffer_id);
+                if (!valid)
+                {
+#ifdef USE_RPC_TELEMETRY
+                    if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                    {
+                        telemetry_service->message(
+                            rpc::i_telemetry_service::err, "uring_channel received an oversized frame");
+                    }
+#endif
+                    // the receive ends with the hang up that follows
+                    channel.close();
+                }
+                if (!more)
+                    arm_receive(channel);
+                return;
+            }
+            if (cqe.res == -EINVAL && multishot_)
+            {
+                multishot_ = false;
+                arm_receive(channel);
+                return;
+            }
+            // ENOBUFS when every provided buffer was in use, they have been handed back by now
+            if (cqe.res == -ENOBUFS || cqe.res == -EINTR || cqe.res == -EAGAIN)
+            {
+                if (!more)
+                    arm_receive(channel);
+                return;
+            }
+            // the other side hung up or the socket failed
+            channel.receive_armed_ = false;
+            channel.close();
+            finish(channel);
+        }
+
+        void start_send(uring_channel& channel)
+        {
+            if (channel.send_in_flight_ || !channel.self_)
+                return;
+            {
+                std::lock_guard g(channel.send_control_);
+                if (channel.send_queue_.empty())
+                {
+                    channel.send_scheduled_ = false;
+                    return;
+                }
+                // every frame queued since the last send goes out together
+                channel.in_flight_.clear();
+                channel.in_flight_.swap(channel.send_queue_);
+            }
+            channel.in_flight_sent_ = 0;
+            channel.send_in_flight_ = true;
+            submit_send(channel);
+        }
+
+        void submit_send(uring_channel& channel)
+        {
+            auto* sqe = get_sqe();
+            if (!sqe)
+            {
+                channel.send_in_flight_ = false;
+                channel.close();
+                finish(channel);
+                return;
+            }
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = channel.fd_;
+            sqe->addr = (uint64_t)(uintptr_t)(channel.in_flight_.data() + channel.in_flight_sent_);
+            sqe->len = (uint32_t)std::min(channel.in_flight_.size() - channel.in_flight_sent_, max_send_size);
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = make_user_data(&channel, send_operation);
+        }
+
+        void on_send(uring_channel& channel, const io_uring_cqe& cqe)
+        {
+            if (cqe.res > 0)
+            {
+                channel.in_flight_sent_ += cqe.res;
+                if (channel.in_flight_sent_ < channel.in_flight_.size())
+                {
+                    submit_send(channel);
+                    return;
+                }
+                channel.send_in_flight_ = false;
+                start_send(channel);
+                return;
+            }
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+            {
+                submit_send(channel);
+                return;
+            }
+            channel.send_in_flight_ = false;
+            channel.close();
+            finish(channel);
+        }
+
+        // once the kernel has let go of the channel it is released and its callers are failed
+        void finish(uring_channel& channel)
+        {
+            if (!channel.self_ || channel.receive_armed_ || channel.send_in_flight_)
+                return;
+            // the close handler can tear down a zone whose last calls need this thread, so it runs on its own
+            std::thread([self = std::move(channel.self_)]() { self->on_receiver_stopped(); }).detach();
+        }
+
+        ////////////////////////////////////////////////////////////////////////
+        // listeners
+
+        void arm_accept(uring_listener& listener)
+        {
+            auto* sqe = get_sqe();
+            if (!sqe)
+            {
+                listener.self_.reset();
+                return;
+            }
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = listener.fd_;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            if (multishot_)
+                sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->user_data = make_user_data(&listener, accept_operation);
+        }
+
+        void on_accept(uring_listener& listener, const io_uring_cqe& cqe)
+        {
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+            if (cqe.res >= 0)
+            {
+                if (listener.closed_)
+                    ::close(cqe.res);
+                else
+                    listener.on_accept_(std::shared_ptr<uring_channel>(new uring_channel(cqe.res)));
+            }
+            else if (cqe.res == -EINVAL && multishot_ && !listener.closed_)
+            {
+                multishot_ = false;
+            }
+            else if (cqe.res != -EINTR && cqe.res != -EAGAIN && cqe.res != -ECONNABORTED)
+            {
+                // cancelled by close or the socket failed, the listener is let go once nothing refers to it
+                if (!more)
+                    listener.self_.reset();
+                return;
+            }
+            if (!more)
+            {
+                if (listener.closed_)
+                    listener.self_.reset();
+                else
+                    arm_accept(listener);
+            }
+        }
+
+    public:
+        static uring_reactor& get()
+        {
+            static uring_reactor reactor;
+            return reactor;
+        }
+
+        // false when the kernel does not offer io_uring or the features this reactor relies on
+        bool is_available() const { return available_; }
+
+        bool add_channel(std::shared_ptr<uring_channel> channel)
+        {
+            if (!available_)
+                return false;
+            post(
+                [this, channel]()
+                {
+                    channel->self_ = channel;
+                    arm_receive(*channel);
+                });
+            return true;
+        }
+
+        void schedule_send(std::shared_ptr<uring_channel> channel)
+        {
+            post([this, channel]() { start_send(*channel); });
+        }
+
+        bool add_listener(std::shared_ptr<uring_listener> listener)
+        {
+            if (!available_)
+                return false;
+            post(
+                [this, listener]()
+                {
+                    listener->self_ = listener;
+                    arm_accept(*listener);
+                });
+            return true;
+        }
+
+        void cancel_accept(std::shared_ptr<uring_listener> listener)
+        {
+            post(
+                [this, listener]()
+                {
+                    if (!listener->self_)
+                        return;
+                    auto* sqe = get_sqe();
+                    if (!sqe)
+                        return;
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd = -1;
+                    sqe->addr = make_user_data(listener.get(), accept_operation);
+                    sqe->user_data = make_user_data(nullptr, cancel_operation);
+                });
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // uring_channel
+
+    uring_channel::uring_channel(int fd)
+        : fd_(fd)
+    {
+    }
+
+    uring_channel::~uring_channel()
+    {
+        if (fd_ != -1)
+            ::close(fd_);
+    }
+
+    std::shared_ptr<uring_channel> uring_channel::connect(const std::string& path)
+    {
+        if (!uring_reactor::get().is_available())
+            return nullptr;
+        int fd = connect_unix_socket(path, false);
+        if (fd == -1)
+            return nullptr;
+        return std::shared_ptr<uring_channel>(new uring_channel(fd));
+    }
+
+    size_t uring_channel::get_max_payload_size() const
+    {
+        return max_message_size - sizeof(transport_message);
+    }
+
+    void uring_channel::start_receiver()
+    {
+        if (!uring_reactor::get().add_channel(std::static_pointer_cast<uring_channel>(shared_from_this())))
+            on_receiver_stopped();
+    }
+
+    void uring_channel::on_close()
+    {
+        // the armed receive sees the hang up and the reactor retires the socket
+        shutdown(fd_, SHUT_RDWR);
+    }
+
+    int uring_channel::write_message(const transport_message& header, const char* payload)
+    {
+        if (is_closed())
+            return rpc::error::TRANSPORT_ERROR();
+        bool schedule = false;
+        {
+            std::lock_guard g(send_control_);
+            auto* begin = reinterpret_cast<const char*>(&header);
+            send_queue_.insert(send_queue_.end(), begin, begin + sizeof(header));
+            if (header.payload_size)
+                send_queue_.insert(send_queue_.end(), payload, payload + header.payload_size);
+            // while the reactor is draining the queue it picks this frame up without being told
+            schedule = !send_scheduled_;
+            send_scheduled_ = true;
+        }
+        if (schedule)
+            uring_reactor::get().schedule_send(std::static_pointer_cast<uring_channel>(shared_from_this()));
+        return rpc::error::OK();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // uring_listener
+
+    uring_listener::~uring_listener()
+    {
+        if (fd_ == -1)
+            return;
+        ::close(fd_);
+        if (!closed_)
+            unlink(path_.c_str());
+    }
+
+    std::shared_ptr<uring_listener> uring_listener::bind(const std::string& path)
+    {
+        if (!uring_reactor::get().is_available())
+            return nullptr;
+        int fd = listen_unix_socket(path, false);
+        if (fd == -1)
+            return nullptr;
+        auto listener = std::shared_ptr<uring_listener>(new uring_listener());
+        listener->fd_ = fd;
+        listener->path_ = path;
+        return listener;
+    }
+
+    bool uring_listener::start()
+    {
+        return uring_reactor::get().add_listener(std::static_pointer_cast<uring_listener>(shared_from_this()));
+    }
+
+    void uring_listener::close()
+    {
+        if (closed_.exchange(true))
+            return;
+        // the path is given up straight away so that a new listener can bind it before this one is torn down
+        unlink(path_.c_str());
+        uring_reactor::get().cancel_accept(std::static_pointer_cast<uring_listener>(shared_from_this()));
+    }
+}
@@ -6,6 +6,7 @@
 
 #include <sgx_urts.h>
 #include <rpc/proxy.h>
+#include <rpc/reply_size_predictor.h>
 
 namespace rpc
 {
@@ -66,14 +67,22 @@ namespace rpc
             destination_zone destination_zone_id,
             object object_id,
             caller_zone caller_zone_id) override;
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override;
 
         std::shared_ptr<enclave_owner> enclave_owner_;
         uint64_t eid_ = 0;
         std::string filename_;
+        // shared with clones so that every proxy to this enclave learns from the same replies
+        std::shared_ptr<reply_size_predictor> reply_sizes_ = std::make_shared<reply_size_predictor>();
 
         friend rpc::service;
 
     public:
         virtual ~enclave_service_proxy() = default;
+
+        const reply_size_predictor& get_reply_size_predictor() const { return *reply_sizes_; }
     };
 }
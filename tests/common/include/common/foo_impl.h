@@ -65,6 +65,17 @@ namespace marshalled_tests
             out_val = inval;
             return rpc::error::OK();
         }
+        error_code numbers_test(const std::vector<uint32_t>& inval, std::vector<uint32_t>& out_val) override
+        {
+            log(std::string("baz numbers_test ") + std::to_string(inval.size()));
+            out_val = inval;
+            return rpc::error::OK();
+        }
+        error_code notify(int val) override
+        {
+            log(std::string("notify ") + std::to_string(val));
+            return rpc::error::OK();
+        }
         error_code do_something_else(int val) override
         {
             log(std::string("baz do_something_else"));
@@ -360,6 +371,16 @@ namespace marshalled_tests
             out_val = inval;
             return rpc::error::OK();
         }
+        error_code numbers_test(const std::vector<uint32_t>& inval, std::vector<uint32_t>& out_val) override
+        {
+            out_val = inval;
+            return rpc::error::OK();
+        }
+        error_code notify(int val) override
+        {
+            log(std::string("notify ") + std::to_string(val));
+            return rpc::error::OK();
+        }
     };
 
     class example : public yyy::i_example
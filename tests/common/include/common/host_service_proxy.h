@@ -5,6 +5,7 @@
 #pragma once
 
 #include <rpc/proxy.h>
+#include <rpc/reply_size_predictor.h>
 
 namespace rpc
 {
@@ -51,10 +52,19 @@ namespace rpc
             destination_zone destination_zone_id,
             object object_id,
             caller_zone caller_zone_id) override;
+        uint64_t release_batch(uint64_t protocol_version,
+            destination_zone destination_zone_id,
+            caller_zone caller_zone_id,
+            const std::vector<std::pair<object, uint64_t>>& releases) override;
+
+        // shared with clones so that every proxy to the host learns from the same replies
+        std::shared_ptr<reply_size_predictor> reply_sizes_ = std::make_shared<reply_size_predictor>();
 
         friend rpc::child_service;
 
     public:
         virtual ~host_service_proxy() = default;
+
+        const reply_size_predictor& get_reply_size_predictor() const { return *reply_sizes_; }
     };
 }
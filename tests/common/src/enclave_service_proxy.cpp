@@ -108,75 +108,44 @@ namespace rpc
         if (destination_zone_id != get_destination_zone_id())
             return rpc::error::ZONE_NOT_SUPPORTED();
 
-        int err_code = 0;
-        size_t data_out_sz = 0;
+        // the enclave keeps a reply that did not fit against tls until the second call collects it
         void* tls = nullptr;
-        sgx_status_t status = ::call_enclave(eid_,
-            &err_code,
-            protocol_version,
-            (uint64_t)encoding,
-            tag,
-            caller_channel_zone_id.get_val(),
-            caller_zone_id.get_val(),
-            destination_zone_id.get_val(),
-            object_id.get_val(),
-            interface_id.get_val(),
-            method_id.get_val(),
-            in_size_,
-            in_buf_,
-            out_buf_.size(),
-            out_buf_.data(),
-            &data_out_sz,
-            &tls);
-
-        if (status)
-        {
-#ifdef USE_RPC_TELEMETRY
-            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+        return reply_sizes_->send(interface_id,
+            method_id,
+            out_buf_,
+            [&](std::vector<char>& out_buf, size_t& data_out_sz) -> int
             {
-                auto error_message = std::string("call_enclave failed ") + std::to_string(status);
-                telemetry_service->message(rpc::i_telemetry_service::err, error_message.c_str());
-            }
-#endif
-            return rpc::error::TRANSPORT_ERROR();
-        }
-
-        if (err_code == rpc::error::NEED_MORE_MEMORY())
-        {
-            // data too small reallocate memory and try again
-            out_buf_.resize(data_out_sz);
-
-            status = ::call_enclave(eid_,
-                &err_code,
-                protocol_version,
-                (uint64_t)encoding,
-                tag,
-                caller_channel_zone_id.get_val(),
-                caller_zone_id.get_val(),
-                destination_zone_id.get_val(),
-                object_id.get_val(),
-                interface_id.get_val(),
-                method_id.get_val(),
-                in_size_,
-                in_buf_,
-                out_buf_.size(),
-                out_buf_.data(),
-                &data_out_sz,
-                &tls);
-            if (status)
-            {
-#ifdef USE_RPC_TELEMETRY
-                if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                int err_code = 0;
+                sgx_status_t status = ::call_enclave(eid_,
+                    &err_code,
+                    protocol_version,
+                    (uint64_t)encoding,
+                    tag,
+                    caller_channel_zone_id.get_val(),
+                    caller_zone_id.get_val(),
+                    destination_zone_id.get_val(),
+                    object_id.get_val(),
+                    interface_id.get_val(),
+                    method_id.get_val(),
+                    in_size_,
+                    in_buf_,
+                    out_buf.size(),
+                    out_buf.data(),
+                    &data_out_sz,
+                    &tls);
+                if (status)
                 {
-                    auto error_message = std::string("call_enclave failed ") + std::to_string(status);
-                    telemetry_service->message(rpc::i_telemetry_service::err, error_message.c_str());
-                }
+#ifdef USE_RPC_TELEMETRY
+                    if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                    {
+                        auto error_message = std::string("call_enclave failed ") + std::to_string(status);
+                        telemetry_service->message(rpc::i_telemetry_service::err, error_message.c_str());
+                    }
 #endif
-                return rpc::error::TRANSPORT_ERROR();
-            }
-        }
-
-        return err_code;
+                    return rpc::error::TRANSPORT_ERROR();
+                }
+                return err_code;
+            });
     }
 
     int enclave_service_proxy::try_cast(
@@ -304,6 +273,50 @@ namespace rpc
                 auto error_message = std::string("release_enclave failed ") + std::to_string(status);
                 telemetry_service->message(rpc::i_telemetry_service::err, error_message.c_str());
             }
+#endif
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return ret;
+    }
+
+    uint64_t enclave_service_proxy::release_batch(uint64_t protocol_version,
+        destination_zone destination_zone_id,
+        caller_zone caller_zone_id,
+        const std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        std::vector<uint64_t> packed;
+        rpc::pack_release_batch(releases, packed);
+        uint64_t ret = 0;
+        sgx_status_t status = ::release_batch_enclave(eid_,
+            &ret,
+            protocol_version,
+            destination_zone_id.get_val(),
+            caller_zone_id.get_val(),
+            packed.size() * sizeof(uint64_t),
+            (const char*)packed.data());
+        if (status == SGX_ERROR_ECALL_NOT_ALLOWED)
+        {
+            auto task = std::thread(
+                [&]()
+                {
+                    status = ::release_batch_enclave(eid_,
+                        &ret,
+                        protocol_version,
+                        destination_zone_id.get_val(),
+                        caller_zone_id.get_val(),
+                        packed.size() * sizeof(uint64_t),
+                        (const char*)packed.data());
+                });
+            task.join();
+        }
+        if (status)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                auto error_message = std::string("release_batch_enclave failed ") + std::to_string(status);
+                telemetry_service->message(rpc::i_telemetry_service::err, error_message.c_str());
+            }
 #endif
             return std::numeric_limits<uint64_t>::max();
         }
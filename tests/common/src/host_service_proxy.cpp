@@ -41,67 +41,39 @@ namespace rpc
         if (destination_zone_id != get_destination_zone_id())
             return rpc::error::ZONE_NOT_SUPPORTED();
 
-        int err_code = 0;
-        size_t data_out_sz = 0;
-        sgx_status_t status = ::call_host(&err_code,
-            protocol_version,
-            (uint64_t)encoding,
-            tag,
-            caller_channel_zone_id.get_val(),
-            caller_zone_id.get_val(),
-            destination_zone_id.get_val(),
-            object_id.get_val(),
-            interface_id.get_val(),
-            method_id.get_val(),
-            in_size_,
-            in_buf_,
-            out_buf_.size(),
-            out_buf_.data(),
-            &data_out_sz);
-
-        if (status)
-        {
-#ifdef USE_RPC_TELEMETRY
-            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+        return reply_sizes_->send(interface_id,
+            method_id,
+            out_buf_,
+            [&](std::vector<char>& out_buf, size_t& data_out_sz) -> int
             {
-                telemetry_service->message(rpc::i_telemetry_service::err, "call_host failed");
-            }
-#endif
-            return rpc::error::TRANSPORT_ERROR();
-        }
-
-        if (err_code == rpc::error::NEED_MORE_MEMORY())
-        {
-            // data too small reallocate memory and try again
-            out_buf_.resize(data_out_sz);
-
-            status = ::call_host(&err_code,
-                protocol_version,
-                (uint64_t)encoding,
-                tag,
-                caller_channel_zone_id.get_val(),
-                caller_zone_id.get_val(),
-                destination_zone_id.get_val(),
-                object_id.get_val(),
-                interface_id.get_val(),
-                method_id.get_val(),
-                in_size_,
-                in_buf_,
-                out_buf_.size(),
-                out_buf_.data(),
-                &data_out_sz);
-            if (status)
-            {
-#ifdef USE_RPC_TELEMETRY
-                if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                int err_code = 0;
+                sgx_status_t status = ::call_host(&err_code,
+                    protocol_version,
+                    (uint64_t)encoding,
+                    tag,
+                    caller_channel_zone_id.get_val(),
+                    caller_zone_id.get_val(),
+                    destination_zone_id.get_val(),
+                    object_id.get_val(),
+                    interface_id.get_val(),
+                    method_id.get_val(),
+                    in_size_,
+                    in_buf_,
+                    out_buf.size(),
+                    out_buf.data(),
+                    &data_out_sz);
+                if (status)
                 {
-                    telemetry_service->message(rpc::i_telemetry_service::err, "call_host failed");
-                }
+#ifdef USE_RPC_TELEMETRY
+                    if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+                    {
+                        telemetry_service->message(rpc::i_telemetry_service::err, "call_host failed");
+                    }
 #endif
-                return rpc::error::TRANSPORT_ERROR();
-            }
-        }
-        return err_code;
+                    return rpc::error::TRANSPORT_ERROR();
+                }
+                return err_code;
+            });
     }
 
     int host_service_proxy::try_cast(
@@ -180,6 +152,33 @@ namespace rpc
             {
                 telemetry_service->message(rpc::i_telemetry_service::err, "release_host failed");
             }
+#endif
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return ret;
+    }
+
+    uint64_t host_service_proxy::release_batch(uint64_t protocol_version,
+        destination_zone destination_zone_id,
+        caller_zone caller_zone_id,
+        const std::vector<std::pair<object, uint64_t>>& releases)
+    {
+        std::vector<uint64_t> packed;
+        rpc::pack_release_batch(releases, packed);
+        uint64_t ret = 0;
+        sgx_status_t status = ::release_batch_host(&ret,
+            protocol_version,
+            destination_zone_id.get_val(),
+            caller_zone_id.get_val(),
+            packed.size() * sizeof(uint64_t),
+            (const char*)packed.data());
+        if (status)
+        {
+#ifdef USE_RPC_TELEMETRY
+            if (auto telemetry_service = rpc::telemetry_service_manager::get(); telemetry_service)
+            {
+                telemetry_service->message(rpc::i_telemetry_service::err, "release_batch_host failed");
+            }
 #endif
             return std::numeric_limits<uint64_t>::max();
         }
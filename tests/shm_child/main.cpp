@@ -0,0 +1,56 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+
+// the child process of the shm_service_proxy test, it opens the region the test created and serves the example zone
+// until the test disconnects.  It is its own program so the multithreaded test process never has to fork
+#include <cstdio>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#include <common/foo_impl.h>
+
+#include <example/example.h>
+
+#include <rpc/shm_service_proxy.h>
+#ifdef USE_RPC_TELEMETRY
+#include <rpc/telemetry/host_telemetry_service.h>
+#endif
+
+#ifdef USE_RPC_TELEMETRY
+TELEMETRY_SERVICE_MANAGER
+#endif
+
+extern "C"
+{
+    void rpc_log(const char* str, size_t sz)
+    {
+#ifdef USE_RPC_LOGGING
+        spdlog::info(std::string(str, sz));
+#endif
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "usage: %s shm_name\n", argv[0]);
+        return 1;
+    }
+    auto err_code = rpc::shm_channel::run_child_zone<yyy::i_host, yyy::i_example>("shm child",
+        argv[1],
+        [](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new marshalled_tests::example(child_service_ptr, host));
+            return rpc::error::OK();
+        });
+    return err_code == rpc::error::OK() ? 0 : 1;
+}
@@ -11,6 +11,7 @@
 #include <trusted/enclave_marshal_test_t.h>
 
 #include <rpc/error_codes.h>
+#include <rpc/buffer_pool.h>
 
 #include <common/foo_impl.h>
 #include <common/host_service_proxy.h>
@@ -97,6 +98,11 @@ int call_enclave(uint64_t protocol_version, // version of the rpc call protocol
     {
         return rpc::error::INVALID_VERSION();
     }
+    // data_in would be dereferenced as pointers into the callers address space
+    if (rpc::encoding(encoding) == rpc::encoding::direct)
+    {
+        return rpc::error::INCOMPATIBLE_SERIALISATION();
+    }
     // a retry cache using enclave_retry_buffer as thread local storage, leaky if the client does not retry with more
     // memory
     if (!enclave_retry_buffer)
@@ -125,8 +131,8 @@ int call_enclave(uint64_t protocol_version, // version of the rpc call protocol
         return ret;
     }
 
-    std::vector<char> tmp;
-    tmp.resize(sz_out);
+    rpc::pooled_buffer pooled_tmp(sz_out);
+    auto& tmp = pooled_tmp.get();
     int ret = rpc_server->send(protocol_version, // version of the rpc call protocol
         rpc::encoding(encoding),                 // format of the serialised data
         tag,
@@ -193,6 +199,21 @@ uint64_t release_enclave(uint64_t protocol_version, uint64_t zone_id, uint64_t o
     return rpc_server->release(protocol_version, {zone_id}, {object_id}, {caller_zone_id});
 }
 
+uint64_t release_batch_enclave(
+    uint64_t protocol_version, uint64_t zone_id, uint64_t caller_zone_id, size_t sz_in, const char* data_in)
+{
+    if (protocol_version > rpc::get_version())
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    std::vector<std::pair<rpc::object, uint64_t>> releases;
+    if (!rpc::unpack_release_batch(data_in, sz_in, releases))
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return rpc_server->release_batch(protocol_version, {zone_id}, {caller_zone_id}, releases);
+}
+
 extern "C"
 {
     int _Uelf64_valid_object()
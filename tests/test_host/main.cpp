@@ -2,8 +2,11 @@
  *   Copyright (c) 2024 Edward Boggis-Rolfe
  *   All rights reserved.
  */
+#include <future>
 #include <iostream>
 #include <unordered_map>
+#include <map>
+#include <set>
 #include <string_view>
 #include <thread>
 
@@ -18,6 +21,24 @@
 #include <example/example.h>
 
 #include <rpc/basic_service_proxies.h>
+#include <rpc/buffer_pool.h>
+#include <rpc/call_batch.h>
+#include <rpc/flat.h>
+#include <rpc/json.h>
+#include <rpc/lz.h>
+#include <rpc/object_slot_table.h>
+#include <rpc/reply_size_predictor.h>
+#include <rpc/simulated_boundary_service_proxy.h>
+#include <rpc/threaded_child_service_proxy.h>
+#include <rpc/stub.h>
+#ifdef __linux__
+#include <rpc/shm_service_proxy.h>
+#include <rpc/uds_service_proxy.h>
+#include <rpc/uring_service_proxy.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 #ifdef USE_RPC_TELEMETRY
 #include <rpc/telemetry/host_telemetry_service.h>
 #endif
@@ -25,6 +46,11 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <yas/mem_streams.hpp>
+#include <yas/json_oarchive.hpp>
+#include <yas/binary_oarchive.hpp>
+#include <yas/std_types.hpp>
+
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -263,7 +289,13 @@ public:
     }
 };
 
-template<bool UseHostInChild, bool RunStandardTests, bool CreateNewZoneThenCreateSubordinatedZone> class inproc_setup
+// CHILD_PROXY is how the root service reaches the child zone, a simulated_boundary_service_proxy serialises every call
+// across the same contract as an enclave
+template<bool UseHostInChild,
+    bool RunStandardTests,
+    bool CreateNewZoneThenCreateSubordinatedZone,
+    class CHILD_PROXY = rpc::local_child_service_proxy<yyy::i_example, yyy::i_host>>
+class inproc_setup
 {
     rpc::shared_ptr<rpc::service> root_service_;
     rpc::shared_ptr<rpc::child_service> child_service_;
@@ -277,10 +309,20 @@ template<bool UseHostInChild, bool RunStandardTests, bool CreateNewZoneThenCreat
 
     std::atomic<uint64_t> zone_gen_ = 0;
 
+protected:
+    // called on the root service and on each child zone this setup makes before any stubs are registered
+    virtual void on_service_created(const rpc::shared_ptr<rpc::service>& service) { }
+    // the example that each child zone hands back
+    virtual rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr)
+    {
+        return rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, nullptr));
+    }
+
 public:
     virtual ~inproc_setup() = default;
 
     rpc::shared_ptr<rpc::service> get_root_service() const { return root_service_; }
+    rpc::shared_ptr<rpc::child_service> get_child_service() const { return child_service_; }
     bool get_has_enclave() const { return has_enclave_; }
     bool is_enclave_setup() const { return false; }
     rpc::shared_ptr<yyy::i_example> get_example() const { return i_example_ptr_; }
@@ -299,14 +341,19 @@ public:
 #endif
 
         root_service_ = rpc::make_shared<rpc::service>("host", rpc::zone{++zone_gen_});
+        on_service_created(root_service_);
         root_service_->add_service_logger(std::make_shared<test_service_logger>());
+        // needed by proxies that serialise, the local proxies pass calls through directly
+        example_import_idl_register_stubs(root_service_);
+        example_shared_idl_register_stubs(root_service_);
+        example_idl_register_stubs(root_service_);
         current_host_service = root_service_;
 
         rpc::shared_ptr<yyy::i_host> hst(new host(root_service_->get_zone_id()));
         local_host_ptr_ = hst; // assign to weak ptr
 
         auto err_code
-            = root_service_->connect_to_zone<rpc::local_child_service_proxy<yyy::i_example, yyy::i_host>>("main child",
+            = root_service_->connect_to_zone<CHILD_PROXY>("main child",
                 {++zone_gen_},
                 hst,
                 i_example_ptr_,
@@ -316,10 +363,11 @@ public:
                 {
                     i_host_ptr_ = host;
                     child_service_ = child_service_ptr;
+                    on_service_created(child_service_ptr);
                     example_import_idl_register_stubs(child_service_ptr);
                     example_shared_idl_register_stubs(child_service_ptr);
                     example_idl_register_stubs(child_service_ptr);
-                    new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, nullptr));
+                    new_example = make_example(child_service_ptr);
                     if (use_host_in_child_)
                         new_example->set_host(host);
                     return rpc::error::OK();
@@ -348,7 +396,7 @@ public:
         rpc::shared_ptr<yyy::i_example> example_relay_ptr;
 
         auto err_code
-            = root_service_->connect_to_zone<rpc::local_child_service_proxy<yyy::i_example, yyy::i_host>>("main child",
+            = root_service_->connect_to_zone<CHILD_PROXY>("main child",
                 {++zone_gen_},
                 hst,
                 example_relay_ptr,
@@ -356,10 +404,11 @@ public:
                     rpc::shared_ptr<yyy::i_example>& new_example,
                     const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
                 {
+                    on_service_created(child_service_ptr);
                     example_import_idl_register_stubs(child_service_ptr);
                     example_shared_idl_register_stubs(child_service_ptr);
                     example_idl_register_stubs(child_service_ptr);
-                    new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, nullptr));
+                    new_example = make_example(child_service_ptr);
                     if (use_host_in_child_)
                         new_example->set_host(host);
                     return rpc::error::OK();
@@ -465,6 +514,31 @@ public:
 };
 #endif
 
+// the zones of an inproc_setup hand out object ids from a dense slot table rather than a counter
+template<class CHILD_PROXY = rpc::local_child_service_proxy<yyy::i_example, yyy::i_host>>
+class dense_object_id_setup : public inproc_setup<true, true, true, CHILD_PROXY>
+{
+protected:
+    void on_service_created(const rpc::shared_ptr<rpc::service>& service) override
+    {
+        service->enable_dense_object_ids();
+    }
+};
+
+// tears the zones down and then checks that none of them was left holding a stub or a service proxy
+template<class SETUP> class checked_teardown_setup : public SETUP
+{
+public:
+    void TearDown() override
+    {
+        auto root_service = this->get_root_service();
+        rpc::weak_ptr<rpc::child_service> child_service = this->get_child_service();
+        SETUP::TearDown();
+        ASSERT_EQ(child_service.lock(), nullptr);
+        ASSERT_TRUE(root_service->check_is_empty());
+    }
+};
+
 template<class T> class type_test : public testing::Test
 {
     T lib_;
@@ -476,6 +550,9 @@ public:
     void TearDown() override { this->lib_.TearDown(); }
 };
 
+using simulated_child_proxy = rpc::simulated_boundary_service_proxy<yyy::i_example, yyy::i_host>;
+using threaded_child_proxy = rpc::threaded_child_service_proxy<yyy::i_example, yyy::i_host>;
+
 using local_implementations = ::testing::Types<in_memory_setup<false>,
     in_memory_setup<true>,
     inproc_setup<false, false, false>,
@@ -485,7 +562,13 @@ using local_implementations = ::testing::Types<in_memory_setup<false>,
     inproc_setup<true, false, false>,
     inproc_setup<true, false, true>,
     inproc_setup<true, true, false>,
-    inproc_setup<true, true, true>
+    inproc_setup<true, true, true>,
+    inproc_setup<false, false, false, simulated_child_proxy>,
+    inproc_setup<true, true, true, simulated_child_proxy>,
+    inproc_setup<false, false, false, threaded_child_proxy>,
+    inproc_setup<true, true, true, threaded_child_proxy>,
+    dense_object_id_setup<>,
+    dense_object_id_setup<simulated_child_proxy>
 
 #ifdef BUILD_ENCLAVE
     ,
@@ -566,7 +649,11 @@ typedef Types<
     inproc_setup<true, false, false>,
     inproc_setup<true, false, true>,
     inproc_setup<true, true, false>,
-    inproc_setup<true, true, true>
+    inproc_setup<true, true, true>,
+    inproc_setup<true, true, true, simulated_child_proxy>,
+    inproc_setup<true, true, true, threaded_child_proxy>,
+    dense_object_id_setup<>,
+    dense_object_id_setup<simulated_child_proxy>
 
 #ifdef BUILD_ENCLAVE
     ,
@@ -1141,7 +1228,11 @@ template<class T> class type_test_with_host : public type_test<T>
 typedef Types<inproc_setup<true, false, false>,
     inproc_setup<true, false, true>,
     inproc_setup<true, true, false>,
-    inproc_setup<true, true, true>
+    inproc_setup<true, true, true>,
+    inproc_setup<true, true, true, simulated_child_proxy>,
+    inproc_setup<true, true, true, threaded_child_proxy>,
+    dense_object_id_setup<>,
+    dense_object_id_setup<simulated_child_proxy>
 
 #ifdef BUILD_ENCLAVE
     ,
@@ -1283,6 +1374,2231 @@ TYPED_TEST(type_test_with_host, create_subordinate_zone_and_set_in_host)
     target->set_host(nullptr);
 }
 
+TEST(buffer_pool, steady_state_reuses_buffers)
+{
+    auto& pool = rpc::buffer_pool::get();
+    pool.trim();
+
+    const char* first = nullptr;
+    {
+        rpc::pooled_buffer buf(RPC_OUT_BUFFER_SIZE);
+        ASSERT_EQ(buf.get().size(), (size_t)RPC_OUT_BUFFER_SIZE);
+        first = buf.get().data();
+    }
+    ASSERT_EQ(pool.get_pooled_count(), 1u);
+    {
+        rpc::pooled_buffer buf(RPC_OUT_BUFFER_SIZE);
+        ASSERT_EQ(buf.get().data(), first);
+        ASSERT_EQ(pool.get_pooled_count(), 0u);
+    }
+
+    // buffers above the largest size class are not retained
+    {
+        auto& config = pool.get_config();
+        rpc::pooled_buffer buf((config.min_class_size << config.class_count) + 1);
+    }
+    ASSERT_EQ(pool.get_pooled_count(), 1u);
+    pool.trim();
+    ASSERT_EQ(pool.get_pooled_bytes(), 0u);
+}
+
+// the least an object stub needs, it answers no calls
+class plain_interface_stub : public rpc::i_interface_stub
+{
+    rpc::weak_ptr<rpc::object_stub> owner_;
+    rpc::shared_ptr<rpc::casting_interface> target_;
+
+public:
+    plain_interface_stub(
+        const rpc::shared_ptr<rpc::object_stub>& owner, const rpc::shared_ptr<rpc::casting_interface>& target)
+        : owner_(owner)
+        , target_(target)
+    {
+    }
+
+    rpc::interface_ordinal get_interface_id(uint64_t rpc_version) const override { return {1}; }
+    int call(uint64_t protocol_version,
+        rpc::encoding enc,
+        rpc::caller_channel_zone caller_channel_zone_id,
+        rpc::caller_zone caller_zone_id,
+        rpc::method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_) override
+    {
+        return rpc::error::INVALID_METHOD_ID();
+    }
+    int cast(rpc::interface_ordinal interface_id, rpc::shared_ptr<rpc::i_interface_stub>& new_stub) override
+    {
+        return rpc::error::INVALID_CAST();
+    }
+    rpc::weak_ptr<rpc::object_stub> get_object_stub() const override { return owner_; }
+    void* get_pointer() const override { return target_->get_address(); }
+    rpc::shared_ptr<rpc::casting_interface> get_castable_interface() const override { return target_; }
+};
+
+// a baz that runs some code as it is destroyed
+class destructor_callback_baz : public baz
+{
+public:
+    using baz::baz;
+    std::function<void()> on_destroy;
+    ~destructor_callback_baz() override
+    {
+        if (on_destroy)
+            on_destroy();
+    }
+};
+
+TEST(service, stubs_are_found_and_released_concurrently)
+{
+    auto svc = rpc::make_shared<rpc::service>("registry", rpc::zone{1});
+    auto acquire = [&](const rpc::shared_ptr<xxx::i_baz>& target)
+    {
+        rpc::shared_ptr<rpc::object_stub> stub;
+        return svc
+            ->get_proxy_stub_descriptor(rpc::get_version(),
+                {},
+                {},
+                target.get(),
+                [&](rpc::shared_ptr<rpc::object_stub> owner)
+                { return rpc::shared_ptr<rpc::i_interface_stub>(new plain_interface_stub(owner, target)); },
+                false,
+                stub)
+            .object_id;
+    };
+    auto release = [&](rpc::object object_id)
+    {
+        return svc->release(
+            rpc::get_version(), svc->get_zone_id().as_destination(), object_id, svc->get_zone_id().as_caller());
+    };
+
+    std::vector<rpc::shared_ptr<xxx::i_baz>> targets(32);
+    for (auto& target : targets)
+        target = rpc::shared_ptr<xxx::i_baz>(new baz(svc->get_zone_id()));
+
+    // the threads keep taking the stubs of a few objects down to zero while the others look them up, and drop
+    // objects whose destructors call back into the service
+    constexpr int rounds = 20000;
+    std::atomic<int> failures = 0;
+    std::atomic<int> destroyed = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < rounds; i++)
+                {
+                    auto& target = targets[(i * 7 + t) % targets.size()];
+                    auto object_id = acquire(target);
+                    auto stub = svc->get_object(object_id).lock();
+                    if (!stub || stub->get_castable_interface()->get_address() != target->get_address())
+                        failures++;
+                    stub = nullptr;
+
+                    if (i % 8 == 0)
+                    {
+                        auto* owned = new destructor_callback_baz(svc->get_zone_id());
+                        auto& other = targets[(i + t) % targets.size()];
+                        owned->on_destroy = [&]()
+                        {
+                            release(acquire(other));
+                            destroyed++;
+                        };
+                        auto owned_id = acquire(rpc::shared_ptr<xxx::i_baz>(owned));
+                        svc->get_object(owned_id).lock()->release_from_service();
+                    }
+
+                    if (release(object_id) == std::numeric_limits<uint64_t>::max())
+                        failures++;
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+    ASSERT_EQ(destroyed, 8 * rounds / 8);
+    ASSERT_TRUE(svc->check_is_empty());
+}
+
+TEST(rcu_map, a_snapshot_outlives_the_readers_that_hold_it)
+{
+    rpc::rcu_map<int, std::string> map;
+    map.insert_or_assign(1, "one");
+    auto first_version = map.get_version();
+
+    // one more reader than there are slots so that at least one of them takes the shared counter fallback
+    const size_t reader_count = rpc::rcu_domain::slot_count + 1;
+    std::atomic<size_t> entered = 0;
+    std::atomic<bool> leave = false;
+    std::atomic<int> stale = 0;
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < reader_count; i++)
+    {
+        readers.emplace_back(
+            [&]()
+            {
+                map.read(
+                    [&](const auto& snapshot)
+                    {
+                        ++entered;
+                        while (!leave)
+                            std::this_thread::yield();
+                        // the writer has replaced this snapshot by now, it must still be intact
+                        auto it = snapshot.find(1);
+                        if (snapshot.size() != 1 || it == snapshot.end() || it->second != "one")
+                            ++stale;
+                    });
+            });
+    }
+    while (entered != reader_count)
+        std::this_thread::yield();
+
+    std::atomic<bool> written = false;
+    std::thread writer(
+        [&]()
+        {
+            map.erase(1);
+            written = true;
+        });
+
+    // the new snapshot is published before the writer waits, readers that start now see it and are not held up
+    while (map.get_version() == first_version)
+        std::this_thread::yield();
+    std::string value;
+    ASSERT_FALSE(map.find(1, value));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(written);
+
+    leave = true;
+    for (auto& reader : readers)
+        reader.join();
+    writer.join();
+    ASSERT_TRUE(written);
+    ASSERT_EQ(stale, 0);
+}
+
+TEST(rcu_map, nested_reads_share_the_outer_section)
+{
+    rpc::rcu_map<int, int> map;
+    map.insert_or_assign(1, 1);
+    auto sum = map.read(
+        [&](const auto& outer) { return outer.at(1) + map.read([](const auto& inner) { return inner.at(1); }); });
+    ASSERT_EQ(sum, 2);
+
+    // a thread that has left its read must not hold back the writer
+    std::thread([&]() { map.read([](const auto&) { return 0; }); }).join();
+    map.insert_or_assign(2, 2);
+    int value = 0;
+    ASSERT_TRUE(map.find(2, value));
+    ASSERT_EQ(value, 2);
+}
+
+// a zone proxy that only exists to be routed to, it never carries a call
+class route_only_service_proxy : public rpc::service_proxy
+{
+public:
+    route_only_service_proxy(rpc::destination_zone destination_zone_id, const rpc::shared_ptr<rpc::service>& svc)
+        : rpc::service_proxy("route_only", destination_zone_id, svc)
+    {
+    }
+
+    rpc::shared_ptr<rpc::service_proxy> clone() override
+    {
+        return rpc::shared_ptr<rpc::service_proxy>(new route_only_service_proxy(*this));
+    }
+
+    int send(uint64_t,
+        rpc::encoding,
+        uint64_t,
+        rpc::caller_channel_zone,
+        rpc::caller_zone,
+        rpc::destination_zone,
+        rpc::object,
+        rpc::interface_ordinal,
+        rpc::method,
+        size_t,
+        const char*,
+        std::vector<char>&) override
+    {
+        return rpc::error::ZONE_NOT_FOUND();
+    }
+    int try_cast(uint64_t, rpc::destination_zone, rpc::object, rpc::interface_ordinal) override
+    {
+        return rpc::error::ZONE_NOT_FOUND();
+    }
+    uint64_t add_ref(uint64_t,
+        rpc::destination_channel_zone,
+        rpc::destination_zone,
+        rpc::object,
+        rpc::caller_channel_zone,
+        rpc::caller_zone,
+        rpc::add_ref_options) override
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    uint64_t release(uint64_t, rpc::destination_zone, rpc::object, rpc::caller_zone) override
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+};
+
+TEST(service, zone_proxies_fall_back_to_the_route_of_the_calling_channel)
+{
+    auto svc = rpc::make_shared<rpc::service>("router", rpc::zone{1});
+    // routes either side of zone 4 so that a lower_bound for it lands on a neighbour
+    rpc::shared_ptr<rpc::service_proxy> channel(new route_only_service_proxy({2}, svc));
+    rpc::shared_ptr<rpc::service_proxy> neighbour(new route_only_service_proxy({5}, svc));
+    svc->add_zone_proxy(channel);
+    svc->add_zone_proxy(neighbour);
+
+    // zone 4 is unknown, the route is cloned from the proxy of the channel the call came in on
+    bool added = false;
+    auto via_channel = svc->get_zone_proxy({2}, {3}, {4}, {3}, added);
+    ASSERT_TRUE(added);
+    ASSERT_NE(via_channel, nullptr);
+    ASSERT_EQ(via_channel->get_destination_zone_id(), rpc::destination_zone{4});
+    ASSERT_EQ(via_channel->get_destination_channel_zone_id(), rpc::destination_channel_zone{2});
+    ASSERT_EQ(via_channel->get_caller_zone_id(), rpc::caller_zone{3});
+
+    // the same pair is found rather than cloned again
+    ASSERT_EQ(svc->get_zone_proxy({2}, {3}, {4}, {3}, added), via_channel);
+    ASSERT_FALSE(added);
+
+    // a new caller of zone 4 clones whichever route zone 4 already has
+    auto other_caller = svc->get_zone_proxy({}, {}, {4}, {6}, added);
+    ASSERT_TRUE(added);
+    ASSERT_NE(other_caller, nullptr);
+    ASSERT_EQ(other_caller->get_destination_zone_id(), rpc::destination_zone{4});
+    ASSERT_EQ(other_caller->get_destination_channel_zone_id(), rpc::destination_channel_zone{2});
+    ASSERT_EQ(other_caller->get_caller_zone_id(), rpc::caller_zone{6});
+
+    for (auto& proxy : {via_channel, other_caller, neighbour, channel})
+        proxy->release_external_ref();
+    via_channel = nullptr;
+    other_caller = nullptr;
+    neighbour = nullptr;
+    channel = nullptr;
+}
+
+// counts the calls whose in buffer holds the address of an expected argument, which only a direct call passes
+class argument_address_logger : public rpc::service_logger
+{
+public:
+    const void* expected = nullptr;
+    std::atomic<int> calls = 0;
+    std::atomic<int> by_reference = 0;
+
+    void before_send(rpc::caller_zone caller_zone_id,
+        rpc::object object_id,
+        rpc::interface_ordinal interface_id,
+        rpc::method method_id,
+        size_t in_size_,
+        const char* in_buf_) override
+    {
+        calls++;
+        for (size_t offset = 0; offset + sizeof(void*) <= in_size_; offset += sizeof(void*))
+        {
+            const void* word = nullptr;
+            memcpy(&word, in_buf_ + offset, sizeof(word));
+            if (word == expected)
+            {
+                by_reference++;
+                return;
+            }
+        }
+    }
+
+    void after_send(rpc::caller_zone caller_zone_id,
+        rpc::object object_id,
+        rpc::interface_ordinal interface_id,
+        rpc::method method_id,
+        int ret,
+        const std::vector<char>& out_buf_) override
+    {
+    }
+};
+
+using direct_call_test = type_test<inproc_setup<false, false, false>>;
+
+TEST_F(direct_call_test, arguments_are_passed_by_reference_to_a_local_zone)
+{
+    auto logger = std::make_shared<argument_address_logger>();
+    get_lib().get_child_service()->add_service_logger(logger);
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    ASSERT_EQ(service_proxy->get_encoding(), rpc::encoding::direct);
+
+    // the out parameter is written straight back through the reference in the pack
+    int c = 0;
+    logger->expected = &c;
+    ASSERT_EQ(example_ptr->add(1, 2, c), rpc::error::OK());
+    ASSERT_EQ(c, 3);
+    ASSERT_EQ(logger->calls, 1);
+    ASSERT_EQ(logger->by_reference, 1);
+
+    // the same zone still takes serialised calls
+    service_proxy->set_encoding(rpc::encoding::yas_binary);
+    ASSERT_EQ(example_ptr->add(2, 3, c), rpc::error::OK());
+    ASSERT_EQ(c, 5);
+    ASSERT_EQ(logger->calls, 2);
+    ASSERT_EQ(logger->by_reference, 1);
+    ASSERT_EQ((int)service_proxy->set_encoding(rpc::encoding::direct), rpc::error::OK());
+}
+
+// an example whose subordinate zones sit behind a simulated enclave boundary
+class boundary_subordinate_example : public example
+{
+    rpc::weak_ptr<rpc::child_service> service_;
+    std::shared_ptr<rpc::simulated_boundary> boundary_;
+
+public:
+    boundary_subordinate_example(
+        const rpc::shared_ptr<rpc::child_service>& this_service, std::shared_ptr<rpc::simulated_boundary> boundary)
+        : example(this_service, nullptr)
+        , service_(this_service)
+        , boundary_(std::move(boundary))
+    {
+    }
+
+    error_code create_example_in_subordinate_zone(rpc::shared_ptr<yyy::i_example>& target,
+        const rpc::shared_ptr<yyy::i_host>& host_ptr,
+        uint64_t new_zone_id) override
+    {
+        return service_.lock()->connect_to_zone<simulated_child_proxy>("behind a boundary",
+            {new_zone_id},
+            host_ptr,
+            target,
+            [](const rpc::shared_ptr<yyy::i_host>& host,
+                rpc::shared_ptr<yyy::i_example>& new_example,
+                const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+            {
+                example_import_idl_register_stubs(child_service_ptr);
+                example_shared_idl_register_stubs(child_service_ptr);
+                example_idl_register_stubs(child_service_ptr);
+                new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, host));
+                return rpc::error::OK();
+            },
+            boundary_);
+    }
+};
+
+class boundary_subordinate_setup : public inproc_setup<false, false, false>
+{
+public:
+    std::shared_ptr<rpc::simulated_boundary> boundary = std::make_shared<rpc::simulated_boundary>();
+
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        return rpc::shared_ptr<yyy::i_example>(new boundary_subordinate_example(child_service_ptr, boundary));
+    }
+};
+
+using direct_fallback_test = type_test<boundary_subordinate_setup>;
+
+TEST_F(direct_fallback_test, a_route_that_leaves_the_process_is_serialised)
+{
+    rpc::shared_ptr<yyy::i_example> far_example;
+    ASSERT_EQ(get_lib().get_example()->create_example_in_subordinate_zone(far_example, nullptr, ++(*zone_gen)),
+        rpc::error::OK());
+    // the first hop is in process so the proxy starts out passing a pack
+    ASSERT_EQ(far_example->query_proxy_base()->get_object_proxy()->get_service_proxy()->get_encoding(),
+        rpc::encoding::direct);
+
+    // the pack is refused before it reaches the boundary and the call crosses it once serialised
+    auto crossings = get_lib().boundary->get_stats().crossings;
+    int c = 0;
+    ASSERT_EQ(far_example->add(1, 2, c), rpc::error::OK());
+    ASSERT_EQ(c, 3);
+    ASSERT_EQ(get_lib().boundary->get_stats().crossings, crossings + 1);
+    far_example = nullptr;
+}
+
+#ifdef BUILD_COROUTINE
+// an example that counts the calls that reached it through the awaitable stub path
+class async_counting_example : public example
+{
+public:
+    using example::example;
+    std::atomic<int> async_calls = 0;
+
+    rpc::task<error_code> add_async(int a, int b, int& c) override
+    {
+        async_calls++;
+        co_return example::add(a, b, c);
+    }
+};
+
+class async_counting_setup : public inproc_setup<false, false, false>
+{
+public:
+    async_counting_example* impl = nullptr;
+
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        impl = new async_counting_example(child_service_ptr, nullptr);
+        return rpc::shared_ptr<yyy::i_example>(impl);
+    }
+};
+
+using coroutine_proxy_test = type_test<async_counting_setup>;
+
+TEST_F(coroutine_proxy_test, a_generated_proxy_is_awaited_end_to_end)
+{
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    for (auto enc : {rpc::encoding::direct, rpc::encoding::yas_binary})
+    {
+        service_proxy->set_encoding(enc);
+        int c = 0;
+        auto call = [&]() -> rpc::task<int> { co_return co_await example_ptr->add_async(1, 2, c); };
+        ASSERT_EQ(rpc::sync_wait(call()), rpc::error::OK());
+        ASSERT_EQ(c, 3);
+    }
+    // both calls went through the stubs async_call into add_async rather than the blocking add
+    ASSERT_EQ(get_lib().impl->async_calls, 2);
+}
+#endif
+
+// an interface stub that answers to any ordinal up to a limit, a call succeeds only if its method matches the ordinal
+// that it was dispatched to
+class numbered_interface_stub : public rpc::i_interface_stub
+{
+    rpc::interface_ordinal id_;
+    rpc::weak_ptr<rpc::object_stub> owner_;
+    rpc::shared_ptr<rpc::casting_interface> target_;
+    uint64_t limit_;
+    std::atomic<int>& created_;
+
+public:
+    numbered_interface_stub(rpc::interface_ordinal id,
+        const rpc::shared_ptr<rpc::object_stub>& owner,
+        const rpc::shared_ptr<rpc::casting_interface>& target,
+        uint64_t limit,
+        std::atomic<int>& created)
+        : id_(id)
+        , owner_(owner)
+        , target_(target)
+        , limit_(limit)
+        , created_(created)
+    {
+        created_++;
+    }
+
+    rpc::interface_ordinal get_interface_id(uint64_t rpc_version) const override { return id_; }
+    int call(uint64_t protocol_version,
+        rpc::encoding enc,
+        rpc::caller_channel_zone caller_channel_zone_id,
+        rpc::caller_zone caller_zone_id,
+        rpc::method method_id,
+        size_t in_size_,
+        const char* in_buf_,
+        std::vector<char>& out_buf_) override
+    {
+        return method_id.get_val() == id_.get_val() ? rpc::error::OK() : rpc::error::INVALID_DATA();
+    }
+    int cast(rpc::interface_ordinal interface_id, rpc::shared_ptr<rpc::i_interface_stub>& new_stub) override
+    {
+        if (interface_id.get_val() == 0 || interface_id.get_val() > limit_)
+            return rpc::error::INVALID_CAST();
+        new_stub = rpc::shared_ptr<rpc::i_interface_stub>(
+            new numbered_interface_stub(interface_id, owner_.lock(), target_, limit_, created_));
+        return rpc::error::OK();
+    }
+    rpc::weak_ptr<rpc::object_stub> get_object_stub() const override { return owner_; }
+    void* get_pointer() const override { return target_->get_address(); }
+    rpc::shared_ptr<rpc::casting_interface> get_castable_interface() const override { return target_; }
+};
+
+TEST(object_stub, interfaces_are_added_while_other_threads_call_and_cast)
+{
+    constexpr uint64_t interface_count = 64;
+    auto svc = rpc::make_shared<rpc::service>("snapshots", rpc::zone{1});
+    auto target = rpc::shared_ptr<xxx::i_baz>(new baz(svc->get_zone_id()));
+    std::atomic<int> created = 0;
+
+    rpc::shared_ptr<rpc::object_stub> stub;
+    svc->get_proxy_stub_descriptor(rpc::get_version(),
+        {},
+        {},
+        target.get(),
+        [&](rpc::shared_ptr<rpc::object_stub> owner)
+        {
+            return rpc::shared_ptr<rpc::i_interface_stub>(
+                new numbered_interface_stub({1}, owner, target, interface_count, created));
+        },
+        false,
+        stub);
+    ASSERT_NE(stub, nullptr);
+
+    // each thread casts to every interface in a different order while the others call through the list
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 8; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int round = 0; round < 50; round++)
+                {
+                    for (uint64_t i = 0; i < interface_count; i++)
+                    {
+                        rpc::interface_ordinal id{(i + t * 7) % interface_count + 1};
+                        rpc::method method_id{id.get_val()};
+                        std::vector<char> out;
+                        auto ret = stub->try_cast(id);
+                        // once cast an interface is always found and it is the one that was asked for
+                        if (ret == rpc::error::OK())
+                            ret = stub->call(
+                                rpc::get_version(), rpc::encoding::yas_binary, {}, {}, id, method_id, 0, nullptr, out);
+                        if (ret != rpc::error::OK())
+                            failures++;
+                    }
+                    if (stub->try_cast({interface_count + 1}) != rpc::error::INVALID_CAST())
+                        failures++;
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+
+    // no interface was added twice
+    ASSERT_EQ(created, (int)interface_count);
+    for (uint64_t i = 1; i <= interface_count; i++)
+        ASSERT_NE(stub->get_interface({i}), nullptr);
+
+    stub->release_from_service();
+    stub = nullptr;
+}
+
+using interface_cache_test = type_test<inproc_setup<false, false, false, simulated_child_proxy>>;
+
+TEST_F(interface_cache_test, casts_are_answered_by_the_object_proxy_once_known)
+{
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    auto service_proxy = baz->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto& boundary = static_cast<simulated_child_proxy*>(service_proxy.get())->get_boundary();
+    // every try_cast that reaches the object crosses the boundary once
+    auto crossings = [&]() { return boundary.get_stats().crossings; };
+
+    // the first cast asks the object, after that the proxy comes from the inline slots
+    auto before = crossings();
+    auto bar = rpc::dynamic_pointer_cast<xxx::i_bar>(baz);
+    ASSERT_NE(bar, nullptr);
+    ASSERT_EQ(crossings(), before + 1);
+    ASSERT_EQ(rpc::dynamic_pointer_cast<xxx::i_bar>(baz), bar);
+    ASSERT_EQ(crossings(), before + 1);
+    // an expired proxy is made again without asking the object
+    bar = nullptr;
+    ASSERT_NE(rpc::dynamic_pointer_cast<xxx::i_bar>(baz), nullptr);
+    ASSERT_EQ(crossings(), before + 1);
+
+    // a refusal is remembered
+    before = crossings();
+    ASSERT_EQ(rpc::dynamic_pointer_cast<xxx::i_foo>(baz), nullptr);
+    ASSERT_EQ(rpc::dynamic_pointer_cast<xxx::i_foo>(baz), nullptr);
+    ASSERT_EQ(crossings(), before + 1);
+
+    // the ring keeps the latest refusals and forgets the oldest first, i_foo is already in it
+    std::vector<std::function<bool()>> refusals = {
+        [&]() { return rpc::dynamic_pointer_cast<xxx::i_foo>(baz) == nullptr; },
+        [&]() { return rpc::dynamic_pointer_cast<yyy::i_example>(baz) == nullptr; },
+        [&]() { return rpc::dynamic_pointer_cast<yyy::i_host>(baz) == nullptr; },
+        [&]() { return rpc::dynamic_pointer_cast<zzz::i_zzz>(baz) == nullptr; },
+        [&]() { return rpc::dynamic_pointer_cast<xxx::i_interface_with_templates>(baz) == nullptr; }};
+    constexpr auto capacity = rpc::object_proxy::refused_interface_count;
+    ASSERT_GT(refusals.size(), capacity);
+    for (size_t i = 1; i < capacity; i++)
+        ASSERT_TRUE(refusals[i]());
+    ASSERT_EQ(crossings(), before + capacity);
+    for (size_t i = 0; i < capacity; i++)
+        ASSERT_TRUE(refusals[i]());
+    ASSERT_EQ(crossings(), before + capacity);
+    // one more refusal pushes i_foo out
+    ASSERT_TRUE(refusals[capacity]());
+    ASSERT_EQ(crossings(), before + capacity + 1);
+    ASSERT_TRUE(refusals[capacity]());
+    ASSERT_EQ(crossings(), before + capacity + 1);
+    ASSERT_TRUE(refusals[0]());
+    ASSERT_EQ(crossings(), before + capacity + 2);
+
+    // the object still answers to what it does implement
+    ASSERT_NE(rpc::dynamic_pointer_cast<xxx::i_bar>(baz), nullptr);
+    ASSERT_EQ(crossings(), before + capacity + 2);
+    baz = nullptr;
+}
+
+TEST(reply_size_predictor, sizes_the_out_buffer_after_the_first_retry)
+{
+    rpc::reply_size_predictor predictor;
+    rpc::interface_ordinal interface_id{1};
+    rpc::method method_id{2};
+    std::vector<char> reply(RPC_OUT_BUFFER_SIZE * 3, 'x');
+
+    // a two phase boundary that only copies the reply out if the buffer is large enough
+    int crossings = 0;
+    auto boundary = [&](std::vector<char>& out_buf, size_t& data_out_sz) -> int
+    {
+        crossings++;
+        data_out_sz = reply.size();
+        if (out_buf.size() < reply.size())
+            return rpc::error::NEED_MORE_MEMORY();
+        memcpy(out_buf.data(), reply.data(), reply.size());
+        return rpc::error::OK();
+    };
+
+    for (int i = 0; i < 10; i++)
+    {
+        rpc::pooled_buffer out(RPC_OUT_BUFFER_SIZE);
+        ASSERT_EQ(predictor.send(interface_id, method_id, out.get(), boundary), rpc::error::OK());
+        ASSERT_EQ(out.get(), reply);
+    }
+    ASSERT_EQ(crossings, 11);
+    ASSERT_EQ(predictor.get_stats().retries, 1u);
+    ASSERT_EQ(predictor.get_stats(interface_id, method_id).calls, 10u);
+    ASSERT_DOUBLE_EQ(predictor.get_retry_rate(), 0.1);
+}
+
+using simulated_boundary_test = type_test<inproc_setup<false, false, false, simulated_child_proxy>>;
+
+TEST_F(simulated_boundary_test, parks_large_replies_until_the_caller_retries)
+{
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto& boundary = static_cast<simulated_child_proxy*>(service_proxy.get())->get_boundary();
+
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(example_ptr->create_baz(baz), rpc::error::OK());
+
+    // the first reply does not fit RPC_OUT_BUFFER_SIZE and is collected on a second crossing, after that the buffer
+    // is sized up front
+    std::vector<uint8_t> in_val(RPC_OUT_BUFFER_SIZE * 4, 42);
+    auto& reply_sizes = boundary.get_child_reply_sizes();
+    auto retries = reply_sizes.get_stats().retries;
+    for (int i = 0; i < 3; i++)
+    {
+        std::vector<uint8_t> out_val;
+        ASSERT_EQ(baz->blob_test(in_val, out_val), rpc::error::OK());
+        ASSERT_EQ(out_val, in_val);
+    }
+    ASSERT_EQ(reply_sizes.get_stats().retries, retries + 1);
+    ASSERT_EQ(boundary.get_stats().parked_replies, 0u);
+
+    // a token that the boundary did not hand out is refused, as sgx_is_within_enclave would
+    void* forged_token = &in_val;
+    char out[16];
+    size_t data_out_sz = 0;
+    ASSERT_EQ(boundary.call(*get_lib().get_root_service(),
+                  rpc::get_version(),
+                  rpc::encoding::enc_default,
+                  0,
+                  {},
+                  {},
+                  {1},
+                  {1},
+                  {},
+                  {},
+                  0,
+                  nullptr,
+                  sizeof(out),
+                  out,
+                  &data_out_sz,
+                  &forged_token),
+        rpc::error::SECURITY_ERROR());
+    baz = nullptr;
+}
+
+TEST_F(simulated_boundary_test, refuses_encodings_it_cannot_carry)
+{
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto enc = service_proxy->get_encoding();
+
+    // argument packs cannot cross the boundary and an unknown encoding cannot be sent anywhere
+    ASSERT_EQ((int)service_proxy->set_encoding(rpc::encoding::direct), rpc::error::INCOMPATIBLE_SERIALISATION());
+    ASSERT_EQ((int)service_proxy->set_encoding(rpc::encoding(4)), rpc::error::INCOMPATIBLE_SERIALISATION());
+    ASSERT_EQ(service_proxy->get_encoding(), enc);
+
+    ASSERT_EQ((int)service_proxy->set_encoding(rpc::encoding::yas_json), rpc::error::OK());
+    int c = 0;
+    ASSERT_EQ(example_ptr->add(1, 2, c), rpc::error::OK());
+    ASSERT_EQ(c, 3);
+}
+
+// notes the thread that the threaded child zone was built on
+class zone_thread_setup : public inproc_setup<false, false, false, threaded_child_proxy>
+{
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        zone_thread = std::this_thread::get_id();
+        return inproc_setup::make_example(child_service_ptr);
+    }
+
+public:
+    std::thread::id zone_thread;
+};
+
+using threaded_child_test = type_test<zone_thread_setup>;
+
+TEST_F(threaded_child_test, runs_the_zone_on_its_own_thread)
+{
+    auto example_ptr = get_lib().get_example();
+    ASSERT_NE(get_lib().zone_thread, std::thread::id());
+    ASSERT_NE(get_lib().zone_thread, std::this_thread::get_id());
+
+    // callers on several threads queue up on the one zone thread
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < 1000; i++)
+                {
+                    int c = 0;
+                    if (example_ptr->add(t, i, c) != rpc::error::OK() || c != t + i)
+                        failures++;
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+}
+
+// holds notifications back until the test opens it, or a timeout passes
+struct notify_gate
+{
+    std::mutex control;
+    std::condition_variable cv;
+    bool open = false;
+    int finished = 0;
+};
+
+// a baz whose notification waits for the gate and then has the host unload an app
+class unloading_baz : public baz
+{
+    rpc::shared_ptr<yyy::i_host> host_;
+    std::shared_ptr<notify_gate> gate_;
+
+public:
+    unloading_baz(rpc::zone zone_id, rpc::shared_ptr<yyy::i_host> host, std::shared_ptr<notify_gate> gate)
+        : baz(zone_id)
+        , host_(host)
+        , gate_(gate)
+    {
+    }
+    error_code notify(int val) override
+    {
+        {
+            std::unique_lock lock(gate_->control);
+            gate_->cv.wait_for(lock, std::chrono::seconds(10), [&]() { return gate_->open; });
+        }
+        auto ret = host_->unload_app("zone");
+        std::lock_guard lock(gate_->control);
+        gate_->finished++;
+        gate_->cv.notify_all();
+        return ret;
+    }
+};
+
+class unloading_baz_example : public example
+{
+    rpc::shared_ptr<yyy::i_host> host_;
+    std::shared_ptr<notify_gate> gate_;
+    rpc::zone zone_id_;
+
+public:
+    unloading_baz_example(rpc::shared_ptr<rpc::child_service> this_service,
+        rpc::shared_ptr<yyy::i_host> host,
+        std::shared_ptr<notify_gate> gate)
+        : example(this_service, host)
+        , host_(host)
+        , gate_(gate)
+        , zone_id_(this_service->get_zone_id())
+    {
+    }
+    error_code create_baz(rpc::shared_ptr<xxx::i_baz>& target) override
+    {
+        target = rpc::shared_ptr<xxx::i_baz>(new unloading_baz(zone_id_, host_, gate_));
+        return rpc::error::OK();
+    }
+};
+
+TEST(threaded_child_service_proxy, hands_its_threads_to_the_parent_when_let_go_on_one_of_them)
+{
+    auto gate = std::make_shared<notify_gate>();
+    auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{1});
+    auto host_ptr = rpc::shared_ptr<yyy::i_host>(new host(root_service->get_zone_id()));
+
+    rpc::shared_ptr<yyy::i_example> example_ptr;
+    auto err_code = root_service->connect_to_zone<threaded_child_proxy>("threaded",
+        {2},
+        host_ptr,
+        example_ptr,
+        [&](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new unloading_baz_example(child_service_ptr, host, gate));
+            return rpc::error::OK();
+        },
+        rpc::thread_pool_config{2, {}});
+    ASSERT_EQ(err_code, rpc::error::OK());
+
+    // the zone is queued a notification that will make the host drop the last reference into the zone, by then the
+    // host's app registry holds the only one
+    rpc::shared_ptr<xxx::i_baz> baz_ptr;
+    ASSERT_EQ(example_ptr->create_baz(baz_ptr), rpc::error::OK());
+    ASSERT_EQ(host_ptr->set_app("zone", example_ptr), rpc::error::OK());
+    ASSERT_EQ(baz_ptr->notify(1), rpc::error::OK());
+    baz_ptr = nullptr;
+    example_ptr = nullptr;
+    ASSERT_EQ(root_service->get_retired_executor_count(), 0u);
+
+    {
+        std::unique_lock lock(gate->control);
+        gate->open = true;
+        gate->cv.notify_all();
+        ASSERT_TRUE(gate->cv.wait_for(lock, std::chrono::seconds(10), [&]() { return gate->finished == 1; }));
+    }
+    // the proxy died on a zone thread so it handed the zone's threads to the root rather than joining them there
+    for (int i = 0; i < 1000 && root_service->get_retired_executor_count() == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(root_service->get_retired_executor_count(), 1u);
+
+    // the root joins them as it goes
+    host_ptr = nullptr;
+    root_service = nullptr;
+}
+
+// an example whose add notices when another call is already inside it
+class overlap_detecting_example : public example
+{
+public:
+    using example::example;
+    std::atomic<int> in_call = 0;
+    std::atomic<int> overlaps = 0;
+
+    error_code add(int a, int b, int& c) override
+    {
+        if (in_call.fetch_add(1) != 0)
+            overlaps++;
+        std::this_thread::yield();
+        auto ret = example::add(a, b, c);
+        in_call.fetch_sub(1);
+        return ret;
+    }
+};
+
+// every object in the child zone has a strand
+class strand_setup : public inproc_setup<false, false, false>
+{
+protected:
+    void on_service_created(const rpc::shared_ptr<rpc::service>& service) override
+    {
+        service->configure_strands(true);
+    }
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        impl = new overlap_detecting_example(child_service_ptr, nullptr);
+        return rpc::shared_ptr<yyy::i_example>(impl);
+    }
+
+public:
+    overlap_detecting_example* impl = nullptr;
+};
+
+using strand_test = type_test<strand_setup>;
+
+TEST_F(strand_test, calls_to_an_object_run_one_at_a_time)
+{
+    auto example_ptr = get_lib().get_example();
+
+    // the local child zone runs each call on its callers thread so without a strand these would overlap
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < 1000; i++)
+                {
+                    int c = 0;
+                    if (example_ptr->add(t, i, c) != rpc::error::OK() || c != t + i)
+                        failures++;
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+    ASSERT_EQ(get_lib().impl->overlaps, 0);
+}
+
+// a baz that also keeps a running total through the [strand] i_tally interface, the total is not guarded so calls
+// that overlap would lose updates
+class tally_baz : public baz, public xxx::i_tally
+{
+    int total_ = 0;
+    std::atomic<int>& overlaps_;
+    std::atomic<int> in_call_ = 0;
+
+    void* get_address() const override { return (void*)this; }
+    const rpc::casting_interface* query_interface(rpc::interface_ordinal interface_id) const override
+    {
+        if (rpc::match<xxx::i_baz>(interface_id))
+            return static_cast<const xxx::i_baz*>(this);
+        if (rpc::match<xxx::i_bar>(interface_id))
+            return static_cast<const xxx::i_bar*>(this);
+        if (rpc::match<xxx::i_tally>(interface_id))
+            return static_cast<const xxx::i_tally*>(this);
+        return nullptr;
+    }
+
+public:
+    tally_baz(rpc::zone zone_id, std::atomic<int>& overlaps)
+        : baz(zone_id)
+        , overlaps_(overlaps)
+    {
+    }
+    error_code add_to_total(int val, int& total) override
+    {
+        if (in_call_.fetch_add(1) != 0)
+            overlaps_++;
+        auto current = total_;
+        std::this_thread::yield();
+        total_ = total = current + val;
+        in_call_.fetch_sub(1);
+        return rpc::error::OK();
+    }
+};
+
+class tally_baz_example : public example
+{
+    std::shared_ptr<std::atomic<int>> overlaps_;
+    rpc::zone zone_id_;
+
+public:
+    tally_baz_example(rpc::shared_ptr<rpc::child_service> this_service, std::shared_ptr<std::atomic<int>> overlaps)
+        : example(this_service, nullptr)
+        , overlaps_(overlaps)
+        , zone_id_(this_service->get_zone_id())
+    {
+    }
+    error_code create_baz(rpc::shared_ptr<xxx::i_baz>& target) override
+    {
+        target = rpc::shared_ptr<xxx::i_baz>(new tally_baz(zone_id_, *overlaps_));
+        return rpc::error::OK();
+    }
+};
+
+// the child zone hands out tally bazes and does not give every object a strand
+class tally_setup : public inproc_setup<false, false, false>
+{
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        return rpc::shared_ptr<yyy::i_example>(new tally_baz_example(child_service_ptr, overlaps));
+    }
+
+public:
+    std::shared_ptr<std::atomic<int>> overlaps = std::make_shared<std::atomic<int>>(0);
+};
+
+using strand_interface_test = type_test<tally_setup>;
+
+TEST_F(strand_interface_test, an_object_bound_through_another_interface_still_gets_its_strand)
+{
+    // the object is bound as an i_baz, which has no strand, and only cast to i_tally afterwards
+    rpc::shared_ptr<xxx::i_baz> baz_ptr;
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz_ptr), rpc::error::OK());
+    auto tally = rpc::dynamic_pointer_cast<xxx::i_tally>(baz_ptr);
+    ASSERT_NE(tally, nullptr);
+
+    constexpr int calls = 1000;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(
+            [&]()
+            {
+                for (int i = 0; i < calls; i++)
+                {
+                    int total = 0;
+                    if (tally->add_to_total(1, total) != rpc::error::OK())
+                        failures++;
+                }
+            });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+    ASSERT_EQ(*get_lib().overlaps, 0);
+    int total = 0;
+    ASSERT_EQ(tally->add_to_total(0, total), rpc::error::OK());
+    ASSERT_EQ(total, 4 * calls);
+}
+
+// an executor that only runs what was posted to it when the test says so
+class manual_executor : public rpc::executor
+{
+public:
+    std::vector<rpc::executor_task*> posted;
+
+    void post(rpc::executor_task* task) override { posted.push_back(task); }
+    bool is_current() const override { return false; }
+
+    // runs what was posted before the call, returns false if there was nothing
+    bool run_posted()
+    {
+        if (posted.empty())
+            return false;
+        auto tasks = std::move(posted);
+        posted.clear();
+        for (auto* task : tasks)
+            task->run(task);
+        return true;
+    }
+};
+
+TEST(strand, yields_its_executor_after_a_batch_and_picks_up_where_it_left_off)
+{
+    auto ex = std::make_shared<manual_executor>();
+    rpc::strand object_strand(ex);
+
+    struct counted_task : rpc::executor_task
+    {
+        int index = 0;
+        std::vector<int>* order = nullptr;
+        bool on_strand = false;
+        const rpc::strand* owner = nullptr;
+    };
+    std::vector<int> order;
+    std::vector<counted_task> tasks(rpc::strand::max_batch * 2 + 1);
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        tasks[i].index = (int)i;
+        tasks[i].order = &order;
+        tasks[i].owner = &object_strand;
+        tasks[i].run = [](rpc::executor_task* task)
+        {
+            auto* self = static_cast<counted_task*>(task);
+            self->on_strand = self->owner->is_current();
+            self->order->push_back(self->index);
+        };
+        object_strand.post(&tasks[i]);
+    }
+
+    // only the first post hands the strand to the executor, nothing runs on the posting thread
+    ASSERT_EQ(ex->posted.size(), 1u);
+    ASSERT_TRUE(order.empty());
+    ASSERT_EQ(object_strand.get_pending(), tasks.size());
+
+    // each turn on the executor runs one batch and posts the strand again while there is more to do
+    ASSERT_TRUE(ex->run_posted());
+    ASSERT_EQ(order.size(), rpc::strand::max_batch);
+    ASSERT_EQ(ex->posted.size(), 1u);
+    ASSERT_TRUE(ex->run_posted());
+    ASSERT_EQ(order.size(), rpc::strand::max_batch * 2);
+    ASSERT_EQ(ex->posted.size(), 1u);
+    ASSERT_TRUE(ex->run_posted());
+    ASSERT_EQ(order.size(), tasks.size());
+    ASSERT_FALSE(ex->run_posted());
+    ASSERT_EQ(object_strand.get_pending(), 0u);
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        ASSERT_EQ(order[i], (int)i);
+        ASSERT_TRUE(tasks[i].on_strand);
+    }
+    ASSERT_FALSE(object_strand.is_current());
+}
+
+// a baz that counts its callbacks and notifications, handed out by an example
+class counting_baz : public baz
+{
+    std::atomic<int>& count_;
+
+public:
+    counting_baz(rpc::zone zone_id, std::atomic<int>& count)
+        : baz(zone_id)
+        , count_(count)
+    {
+    }
+    int callback(int val) override
+    {
+        count_++;
+        return baz::callback(val);
+    }
+    error_code notify(int val) override
+    {
+        count_++;
+        return baz::notify(val);
+    }
+};
+
+class counting_baz_example : public example
+{
+    std::shared_ptr<std::atomic<int>> count_;
+    rpc::zone zone_id_;
+
+public:
+    counting_baz_example(rpc::shared_ptr<rpc::child_service> this_service, std::shared_ptr<std::atomic<int>> count)
+        : example(this_service, nullptr)
+        , count_(count)
+        , zone_id_(this_service->get_zone_id())
+    {
+    }
+    error_code create_baz(rpc::shared_ptr<xxx::i_baz>& target) override
+    {
+        target = rpc::shared_ptr<xxx::i_baz>(new counting_baz(zone_id_, *count_));
+        return rpc::error::OK();
+    }
+};
+
+// the child zone hands out counting bazes
+template<class CHILD_PROXY> class counting_baz_setup : public inproc_setup<false, false, false, CHILD_PROXY>
+{
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        return rpc::shared_ptr<yyy::i_example>(new counting_baz_example(child_service_ptr, count));
+    }
+
+public:
+    std::shared_ptr<std::atomic<int>> count = std::make_shared<std::atomic<int>>(0);
+};
+
+using oneway_test = type_test<counting_baz_setup<threaded_child_proxy>>;
+
+TEST_F(oneway_test, notifications_are_queued_without_waiting_for_a_reply)
+{
+    auto example_ptr = get_lib().get_example();
+    rpc::shared_ptr<xxx::i_baz> baz_ptr;
+    ASSERT_EQ(example_ptr->create_baz(baz_ptr), rpc::error::OK());
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(baz_ptr->notify(i), rpc::error::OK());
+
+    // the zone has one thread so a blocking call runs after every notification queued before it
+    int c = 0;
+    ASSERT_EQ(example_ptr->add(1, 2, c), rpc::error::OK());
+    ASSERT_EQ(*get_lib().count, 100);
+    baz_ptr = nullptr;
+}
+
+using call_batch_test = type_test<counting_baz_setup<simulated_child_proxy>>;
+
+TEST_F(call_batch_test, sends_many_calls_in_one_crossing)
+{
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto& boundary = static_cast<simulated_child_proxy*>(service_proxy.get())->get_boundary();
+
+    rpc::shared_ptr<xxx::i_baz> baz_ptr;
+    ASSERT_EQ(example_ptr->create_baz(baz_ptr), rpc::error::OK());
+
+    rpc::call_batch batch;
+    auto target = batch.on(baz_ptr);
+    for (int i = 0; i < 10; i++)
+        ASSERT_EQ(target.callback(i), static_cast<size_t>(i));
+    // a call without an object is refused up front and does not spoil the rest of the batch
+    auto missing = batch.on(rpc::shared_ptr<xxx::i_baz>()).callback(0);
+
+    auto crossings = boundary.get_stats().crossings;
+    ASSERT_EQ(batch.flush(), rpc::error::OK());
+    ASSERT_EQ(boundary.get_stats().crossings, crossings + 1);
+    ASSERT_EQ(*get_lib().count, 10);
+    for (int i = 0; i < 10; i++)
+        ASSERT_EQ(batch.get_result(i), rpc::error::OK());
+    ASSERT_EQ(batch.get_result(missing), rpc::error::INVALID_DATA());
+
+    // a batch is only ever serialised with yas, any other encoding is refused without sending anything
+    for (auto enc : {rpc::encoding::flat, rpc::encoding::json, rpc::encoding::yas_lz, rpc::encoding::direct})
+    {
+        rpc::call_batch refused(enc);
+        auto index = refused.on(baz_ptr).callback(0);
+        ASSERT_EQ(refused.get_result(index), rpc::error::INCOMPATIBLE_SERIALISATION());
+        crossings = boundary.get_stats().crossings;
+        ASSERT_EQ(refused.flush(), rpc::error::INCOMPATIBLE_SERIALISATION());
+        ASSERT_EQ(boundary.get_stats().crossings, crossings);
+    }
+    ASSERT_EQ(*get_lib().count, 10);
+    baz_ptr = nullptr;
+}
+
+TEST(reserve_yas, sizes_a_buffer_once_for_what_is_saved)
+{
+    constexpr auto flags = ::yas::mem | ::yas::binary | ::yas::no_header;
+
+    // a fixed size parameter set is sized at compile time
+    int val1 = 1;
+    uint64_t val2 = 2;
+    auto fixed_mapping = YAS_OBJECT_NVP("in", ("val1", val1), ("val2", val2));
+    static_assert(rpc::yas_fixed_size<decltype(val1), decltype(val2)>::known);
+    std::vector<char> buffer;
+    rpc::reserve_yas<flags, decltype(val1), decltype(val2)>(buffer, fixed_mapping);
+    auto capacity = buffer.capacity();
+    ::yas::save<flags>(::yas::vector_ostream(buffer), fixed_mapping);
+    ASSERT_EQ(buffer.size(), capacity);
+
+    // anything else is counted first
+    xxx::something_more_complicated val;
+    val.vector_val = {{1, std::string(1000, 'a')}, {2, "two"}};
+    val.map_val["a"] = {3, "three"};
+    auto mapping = YAS_OBJECT_NVP("in", ("val", val));
+    for (auto json : {false, true})
+    {
+        std::vector<char> buffer;
+        if (json)
+        {
+            rpc::reserve_yas<::yas::mem | ::yas::json | ::yas::no_header, decltype(val)>(buffer, mapping);
+            capacity = buffer.capacity();
+            ::yas::save<::yas::mem | ::yas::json | ::yas::no_header>(::yas::vector_ostream(buffer), mapping);
+        }
+        else
+        {
+            rpc::reserve_yas<flags, decltype(val)>(buffer, mapping);
+            capacity = buffer.capacity();
+            ::yas::save<flags>(::yas::vector_ostream(buffer), mapping);
+        }
+        ASSERT_EQ(buffer.size(), capacity);
+    }
+}
+
+TEST(flat_encoding, values_are_read_in_place)
+{
+    xxx::something_more_complicated val;
+    val.vector_val = {{1, "one"}, {2, "two"}};
+    val.map_val["a"] = {3, "three"};
+    auto buffer = rpc::to_flat(val);
+
+    // the view points into the buffer and nothing is copied out of it
+    rpc::flat::view_t<xxx::something_more_complicated> view;
+    ASSERT_TRUE(rpc::flat::get_view<xxx::something_more_complicated>(buffer, view));
+    ASSERT_EQ(view.vector_val.size(), 2u);
+    ASSERT_EQ(view.vector_val[1].string_val, "two");
+    ASSERT_EQ(view.map_val.value(view.map_val.find(std::string_view("a"))).int_val, 3);
+    ASSERT_GE(view.vector_val[1].string_val.data(), buffer.data());
+    ASSERT_LT(view.vector_val[1].string_val.data(), buffer.data() + buffer.size());
+
+    // a buffer whose references run off its end is refused
+    buffer.resize(buffer.size() - 1);
+    ASSERT_FALSE(rpc::flat::get_view<xxx::something_more_complicated>(buffer, view));
+}
+
+TEST(pod_block, blobs_are_saved_as_one_block)
+{
+    // the block encodings carry bytes as base64 in json and as a raw block in compacted binary
+    const std::vector<uint8_t> blob{0, 1, 2, 250, 251, 252, 253};
+    std::vector<char> buffer;
+    auto saved = rpc::make_pod_block(blob, rpc::encoding::yas_json_blocks);
+    ::yas::save<::yas::mem | ::yas::json | ::yas::no_header>(
+        ::yas::vector_ostream(buffer), YAS_OBJECT_NVP("in", ("blob", saved)));
+    ASSERT_NE(std::string(buffer.begin(), buffer.end()).find("\"AAEC+vv8/Q==\""), std::string::npos);
+    std::vector<uint8_t> loaded;
+    auto load_block = rpc::make_pod_block(loaded, rpc::encoding::yas_json_blocks);
+    ::yas::load<::yas::mem | ::yas::json | ::yas::no_header>(
+        ::yas::intrusive_buffer(buffer.data(), buffer.size()), YAS_OBJECT_NVP("in", ("blob", load_block)));
+    ASSERT_EQ(loaded, blob);
+
+    const std::vector<uint8_t> big(100000, 200);
+    buffer.clear();
+    auto compacted = rpc::make_pod_block(big, rpc::encoding::yas_compressed_blocks);
+    ::yas::save<::yas::mem | ::yas::binary | ::yas::compacted | ::yas::no_header>(
+        ::yas::vector_ostream(buffer), YAS_OBJECT_NVP("in", ("blob", compacted)));
+    ASSERT_LT(buffer.size(), big.size() + 16);
+    std::vector<uint8_t> unpacked;
+    auto load_compacted = rpc::make_pod_block(unpacked, rpc::encoding::yas_compressed_blocks);
+    ::yas::load<::yas::mem | ::yas::binary | ::yas::compacted | ::yas::no_header>(
+        ::yas::intrusive_buffer(buffer.data(), buffer.size()), YAS_OBJECT_NVP("in", ("blob", load_compacted)));
+    ASSERT_EQ(unpacked, big);
+
+    // the existing encodings keep the layout yas gives the container so older peers can still read them
+    for (auto enc : {rpc::encoding::yas_compressed_binary, rpc::encoding::yas_json})
+    {
+        std::vector<char> by_block;
+        std::vector<char> by_yas;
+        auto unchanged = rpc::make_pod_block(blob, enc);
+        if (enc == rpc::encoding::yas_json)
+        {
+            ::yas::save<::yas::mem | ::yas::json | ::yas::no_header>(
+                ::yas::vector_ostream(by_block), YAS_OBJECT_NVP("in", ("blob", unchanged)));
+            ::yas::save<::yas::mem | ::yas::json | ::yas::no_header>(
+                ::yas::vector_ostream(by_yas), YAS_OBJECT_NVP("in", ("blob", blob)));
+        }
+        else
+        {
+            ::yas::save<::yas::mem | ::yas::binary | ::yas::compacted | ::yas::no_header>(
+                ::yas::vector_ostream(by_block), YAS_OBJECT_NVP("in", ("blob", unchanged)));
+            ::yas::save<::yas::mem | ::yas::binary | ::yas::compacted | ::yas::no_header>(
+                ::yas::vector_ostream(by_yas), YAS_OBJECT_NVP("in", ("blob", blob)));
+        }
+        ASSERT_EQ(by_block, by_yas);
+    }
+}
+
+TEST(json_encoding, reads_and_writes_yas_json_text)
+{
+    xxx::something_more_complicated val;
+    val.vector_val = {{1, "one \"quoted\""}, {-2, "two\n\ttabbed"}};
+    val.map_val["a"] = {3, "three"};
+
+    // text written by the codec is read by yas json and the other way round
+    auto text = rpc::to_json(val);
+    xxx::something_more_complicated from_codec;
+    ASSERT_EQ(rpc::from_yas_json(text, from_codec), "");
+    ASSERT_EQ(from_codec, val);
+    auto yas_text = rpc::to_yas_json<xxx::something_more_complicated, std::vector<char>>(val);
+    xxx::something_more_complicated from_yas;
+    ASSERT_EQ(rpc::from_json(yas_text, from_yas), "");
+    ASSERT_EQ(from_yas, val);
+
+    text.pop_back();
+    ASSERT_NE(rpc::from_json(text, from_codec), "");
+}
+
+TEST(lz_encoding, large_frames_are_compressed_and_small_ones_are_not)
+{
+    xxx::something_more_complicated val;
+    for (int i = 0; i < 500; i++)
+        val.map_val[std::to_string(i)] = {i % 7, "something complicated"};
+    auto payload = rpc::to_yas_binary<xxx::something_more_complicated, std::vector<char>>(val);
+
+    auto frame = payload;
+    rpc::lz::pack(frame);
+    ASSERT_LT(frame.size(), payload.size() / 2);
+    std::vector<char> scratch;
+    const char* data = nullptr;
+    size_t size = 0;
+    ASSERT_TRUE(rpc::lz::unpack(frame.data(), frame.size(), scratch, data, size));
+    ASSERT_EQ(std::vector<char>(data, data + size), payload);
+    ASSERT_EQ(rpc::lz::unpacked_size(frame.data(), frame.size()), payload.size());
+
+    // under the threshold the frame costs a byte and nothing is copied to read it
+    std::vector<char> small(payload.begin(), payload.begin() + 100);
+    rpc::lz::pack(small);
+    ASSERT_EQ(small.size(), 101u);
+    ASSERT_TRUE(rpc::lz::unpack(small.data(), small.size(), scratch, data, size));
+    ASSERT_EQ(data, small.data() + 1);
+
+    frame.resize(frame.size() / 2);
+    ASSERT_FALSE(rpc::lz::unpack(frame.data(), frame.size(), scratch, data, size));
+
+    // an empty payload compressed with no threshold unpacks to nothing and needs no scratch
+    std::vector<char> empty_frame = {(char)rpc::lz::frame::compressed, 0, 0};
+    ASSERT_EQ(rpc::lz::unpacked_size(empty_frame.data(), empty_frame.size()), 0u);
+    std::vector<char> no_scratch;
+    ASSERT_TRUE(rpc::lz::unpack(empty_frame.data(), empty_frame.size(), no_scratch, data, size));
+    ASSERT_EQ(size, 0u);
+    auto old_threshold = rpc::lz::get_threshold();
+    rpc::lz::set_threshold(0);
+    std::vector<char> nothing;
+    rpc::lz::pack(nothing);
+    rpc::lz::set_threshold(old_threshold);
+    ASSERT_TRUE(rpc::lz::unpack(nothing.data(), nothing.size(), scratch, data, size));
+    ASSERT_EQ(size, 0u);
+}
+
+// the simulated boundary setup with each encoding its service proxy can be set to
+class boundary_encoding_test : public simulated_boundary_test, public testing::WithParamInterface<rpc::encoding>
+{
+};
+
+TEST_P(boundary_encoding_test, calls_are_carried_across_a_boundary)
+{
+    auto example_ptr = get_lib().get_example();
+    auto service_proxy = example_ptr->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto& boundary = static_cast<simulated_child_proxy*>(service_proxy.get())->get_boundary();
+    ASSERT_EQ((int)service_proxy->set_encoding(GetParam()), rpc::error::OK());
+
+    // text that json has to escape and enough entries for yas_lz to compress
+    xxx::something_more_complicated val;
+    val.vector_val = {{1, "one \"quoted\""}, {-2, "two\n\ttabbed"}};
+    for (int i = 0; i < 500; i++)
+        val.map_val[std::to_string(i)] = {i % 7, "something complicated"};
+    rpc::shared_ptr<xxx::i_foo> foo;
+    ASSERT_EQ(example_ptr->create_foo(foo), rpc::error::OK());
+    ASSERT_EQ(foo->receive_something_more_complicated_in_out_ref(val), rpc::error::OK());
+    ASSERT_EQ(val.map_val["22"].string_val, "23");
+    ASSERT_EQ(val.map_val["499"].string_val, "something complicated");
+    ASSERT_EQ(val.vector_val.size(), 2u);
+    ASSERT_EQ(val.vector_val[0].string_val, "one \"quoted\"");
+
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(example_ptr->create_baz(baz), rpc::error::OK());
+    std::vector<uint8_t> blob(100000);
+    for (size_t i = 0; i < blob.size(); i++)
+        blob[i] = (uint8_t)(i * 7);
+    auto bytes_in = boundary.get_stats().bytes_in;
+    std::vector<uint8_t> blob_out;
+    ASSERT_EQ(baz->blob_test(blob, blob_out), rpc::error::OK());
+    ASSERT_EQ(blob_out, blob);
+    auto blob_bytes = boundary.get_stats().bytes_in - bytes_in;
+
+    // large enough that compacted binary gives each one a length byte
+    std::vector<uint32_t> numbers(10000);
+    for (size_t i = 0; i < numbers.size(); i++)
+        numbers[i] = 0x80000000u + (uint32_t)i * 7;
+    bytes_in = boundary.get_stats().bytes_in;
+    std::vector<uint32_t> numbers_out;
+    ASSERT_EQ(baz->numbers_test(numbers, numbers_out), rpc::error::OK());
+    ASSERT_EQ(numbers_out, numbers);
+    auto number_bytes = boundary.get_stats().bytes_in - bytes_in;
+
+    // the encodings that change how the parameters are laid out must show it on the wire
+    switch (GetParam())
+    {
+    case rpc::encoding::yas_lz:
+        // the blob repeats every 256 bytes so its frame is a fraction of it
+        ASSERT_LT(blob_bytes, blob.size() / 4);
+        break;
+    case rpc::encoding::yas_json_blocks:
+        // base64 takes four characters for every three bytes, value by value takes at least two a byte
+        ASSERT_LT(blob_bytes, blob.size() * 4 / 3 + 256);
+        break;
+    case rpc::encoding::yas_compressed_blocks:
+    case rpc::encoding::flat:
+        // the numbers go as one raw block rather than as compacted values
+        ASSERT_LT(number_bytes, numbers.size() * sizeof(uint32_t) + 64);
+        break;
+    default:
+        break;
+    }
+
+    baz = nullptr;
+    foo = nullptr;
+}
+
+INSTANTIATE_TEST_SUITE_P(encodings,
+    boundary_encoding_test,
+    testing::Values(rpc::encoding::yas_binary,
+        rpc::encoding::yas_compressed_binary,
+        rpc::encoding::yas_json,
+        rpc::encoding::flat,
+        rpc::encoding::yas_compressed_blocks,
+        rpc::encoding::yas_json_blocks,
+        rpc::encoding::json,
+        rpc::encoding::yas_lz));
+
+// an example that notes where each add was dispatched to
+class dispatch_recording_example : public example
+{
+public:
+    using example::example;
+    std::mutex control;
+    std::set<std::thread::id> threads;
+    std::atomic<int> wrong_context = 0;
+    rpc::service* expected_service = nullptr;
+
+    error_code add(int a, int b, int& c) override
+    {
+        if (rpc::service::get_current_service() != expected_service
+            || rpc::service::get_current_caller() != rpc::caller_zone{1})
+            wrong_context++;
+        {
+            std::lock_guard g(control);
+            threads.insert(std::this_thread::get_id());
+        }
+        return example::add(a, b, c);
+    }
+};
+
+// the child zone dispatches its inbound calls to a work stealing executor
+class work_stealing_setup : public inproc_setup<false, false, false>
+{
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        child_service_ptr->set_dispatcher(dispatcher);
+        impl = new dispatch_recording_example(child_service_ptr, nullptr);
+        impl->expected_service = child_service_ptr.get();
+        return rpc::shared_ptr<yyy::i_example>(impl);
+    }
+
+public:
+    std::shared_ptr<rpc::work_stealing_executor> dispatcher
+        = std::make_shared<rpc::work_stealing_executor>(rpc::thread_pool_config{4, {}});
+    dispatch_recording_example* impl = nullptr;
+};
+
+using work_stealing_test = type_test<work_stealing_setup>;
+
+TEST_F(work_stealing_test, dispatches_inbound_calls_to_idle_threads)
+{
+    auto example_ptr = get_lib().get_example();
+    auto& dispatcher = get_lib().dispatcher;
+    auto* impl = get_lib().impl;
+    auto posted = dispatcher->get_stats().posted;
+
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < 1000; i++)
+                {
+                    int c = 0;
+                    if (example_ptr->add(t, i, c) != rpc::error::OK() || c != t + i)
+                        failures++;
+                }
+            });
+    }
+    std::vector<std::thread::id> caller_threads;
+    for (auto& thread : threads)
+    {
+        caller_threads.push_back(thread.get_id());
+        thread.join();
+    }
+    ASSERT_EQ(failures, 0);
+    // the stubs ran on the dispatchers threads but still saw the zone and caller of the call
+    ASSERT_EQ(impl->wrong_context, 0);
+    for (auto& id : caller_threads)
+        ASSERT_EQ(impl->threads.count(id), 0);
+
+    ASSERT_GE(dispatcher->get_stats().posted, posted + 4000);
+    ASSERT_EQ(dispatcher->get_pending(), 0);
+}
+
+// an example whose negative adds are finished by another pool that calls back into this zone while the dispatcher
+// thread waits without serving its queue
+class reentrant_dispatch_example : public example
+{
+public:
+    using example::example;
+    rpc::shared_ptr<yyy::i_example> outer;
+    rpc::thread_pool_executor helper{rpc::thread_pool_config{1, {}}};
+
+    error_code add(int a, int b, int& c) override
+    {
+        if (a >= 0)
+            return example::add(a, b, c);
+
+        struct callback_task : rpc::executor_task
+        {
+            reentrant_dispatch_example* self;
+            int a;
+            int b;
+            std::promise<int> result;
+        } task;
+        task.self = this;
+        task.a = -a;
+        task.b = b;
+        task.run = [](rpc::executor_task* base)
+        {
+            auto* t = static_cast<callback_task*>(base);
+            int c = 0;
+            auto err = t->self->outer->add(t->a, t->b, c);
+            t->result.set_value(err == rpc::error::OK() ? c : -1);
+        };
+        auto result = task.result.get_future();
+        helper.post(&task);
+        c = result.get();
+        return rpc::error::OK();
+    }
+};
+
+// the child zone dispatches its inbound calls to a single dispatcher thread
+class reentrant_dispatch_setup : public inproc_setup<false, false, false>
+{
+protected:
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        child_service_ptr->set_dispatcher(dispatcher);
+        impl = new reentrant_dispatch_example(child_service_ptr, nullptr);
+        return rpc::shared_ptr<yyy::i_example>(impl);
+    }
+
+public:
+    std::shared_ptr<rpc::work_stealing_executor> dispatcher
+        = std::make_shared<rpc::work_stealing_executor>(rpc::thread_pool_config{1, {}});
+    reentrant_dispatch_example* impl = nullptr;
+};
+
+using reentrant_dispatch_test = type_test<reentrant_dispatch_setup>;
+
+TEST_F(reentrant_dispatch_test, calls_made_on_another_pools_worker_run_inline)
+{
+    auto example_ptr = get_lib().get_example();
+    auto* impl = get_lib().impl;
+    impl->outer = example_ptr;
+
+    // the callback comes back in while the only dispatcher thread is blocked on it, queued it would never run
+    int c = 0;
+    ASSERT_EQ(example_ptr->add(-2, 3, c), rpc::error::OK());
+    ASSERT_EQ(c, 5);
+
+    impl->outer = nullptr;
+}
+
+TEST(object_slot_table, stale_ids_are_rejected)
+{
+    auto svc = rpc::make_shared<rpc::service>("slots", rpc::zone{1});
+    rpc::object_slot_table slots;
+
+    auto id = slots.reserve();
+    ASSERT_TRUE(id.is_set());
+    auto stub = rpc::make_shared<rpc::object_stub>(id, *svc, nullptr);
+    slots.publish(id, stub);
+    ASSERT_EQ(slots.find(id).lock(), stub);
+
+    ASSERT_TRUE(slots.free(id));
+    ASSERT_FALSE(slots.free(id));
+    ASSERT_EQ(slots.find(id).lock(), nullptr);
+
+    // the slot is recycled under a new generation so the old id stays dead
+    auto new_id = slots.reserve();
+    ASSERT_EQ((uint32_t)new_id.id, (uint32_t)id.id);
+    ASSERT_NE(new_id, id);
+    slots.publish(new_id, stub);
+    ASSERT_EQ(slots.find(id).lock(), nullptr);
+    ASSERT_EQ(slots.find(new_id).lock(), stub);
+    slots.free(new_id);
+}
+
+TEST(release_batch, falls_back_to_a_release_per_reference)
+{
+    struct counting_marshaller : rpc::i_marshaller
+    {
+        std::map<uint64_t, uint64_t> released;
+        int send(uint64_t,
+            rpc::encoding,
+            uint64_t,
+            rpc::caller_channel_zone,
+            rpc::caller_zone,
+            rpc::destination_zone,
+            rpc::object,
+            rpc::interface_ordinal,
+            rpc::method,
+            size_t,
+            const char*,
+            std::vector<char>&) override
+        {
+            return rpc::error::OK();
+        }
+        int try_cast(uint64_t, rpc::destination_zone, rpc::object, rpc::interface_ordinal) override
+        {
+            return rpc::error::OK();
+        }
+        uint64_t add_ref(uint64_t,
+            rpc::destination_channel_zone,
+            rpc::destination_zone,
+            rpc::object,
+            rpc::caller_channel_zone,
+            rpc::caller_zone,
+            rpc::add_ref_options) override
+        {
+            return 1;
+        }
+        uint64_t release(
+            uint64_t protocol_version, rpc::destination_zone, rpc::object object_id, rpc::caller_zone) override
+        {
+            if (protocol_version != rpc::VERSION_2)
+                return std::numeric_limits<uint64_t>::max();
+            return ++released[object_id.get_val()];
+        }
+    } marshaller;
+
+    std::vector<std::pair<rpc::object, uint64_t>> releases = {{{1}, 3}, {{2}, 1}};
+    // an unsupported version must not release anything so that the caller can retry with an older one
+    ASSERT_EQ(marshaller.release_batch(rpc::VERSION_2 + 1, {1}, {2}, releases), std::numeric_limits<uint64_t>::max());
+    ASSERT_TRUE(marshaller.released.empty());
+    // the counts the objects were left with are summed, this marshaller counts up rather than down
+    ASSERT_EQ(marshaller.release_batch(rpc::VERSION_2, {1}, {2}, releases), 3u + 1u);
+    ASSERT_EQ(marshaller.released[1], 3u);
+    ASSERT_EQ(marshaller.released[2], 1u);
+}
+
+using release_batch_test = type_test<checked_teardown_setup<inproc_setup<false, false, false, simulated_child_proxy>>>;
+
+TEST_F(release_batch_test, dropped_proxies_cross_the_boundary_once)
+{
+    auto example = get_lib().get_example();
+    auto service_proxy = example->query_proxy_base()->get_object_proxy()->get_service_proxy();
+    auto& boundary = static_cast<simulated_child_proxy*>(service_proxy.get())->get_boundary();
+    auto child_service = get_lib().get_child_service();
+
+    auto create_bazes = [&](size_t count)
+    {
+        std::vector<rpc::shared_ptr<xxx::i_baz>> bazes(count);
+        for (auto& baz : bazes)
+            EXPECT_EQ(example->create_baz(baz), rpc::error::OK());
+        return bazes;
+    };
+    auto object_ids = [](const std::vector<rpc::shared_ptr<xxx::i_baz>>& bazes)
+    {
+        std::vector<rpc::object> ids;
+        for (auto& baz : bazes)
+            ids.push_back(baz->query_proxy_base()->get_object_proxy()->get_object_id());
+        return ids;
+    };
+
+    // releases are held until flushed, the example keeps the channel open so nothing forces them out early
+    service_proxy->set_release_batch_size(16);
+    auto bazes = create_bazes(4);
+    auto ids = object_ids(bazes);
+    auto crossings = boundary.get_stats().crossings;
+    bazes.clear();
+    ASSERT_EQ(boundary.get_stats().crossings, crossings);
+    for (auto id : ids)
+        ASSERT_NE(child_service->get_object(id).lock(), nullptr);
+    service_proxy->flush_pending_releases();
+    ASSERT_EQ(boundary.get_stats().crossings, crossings + 1);
+    for (auto id : ids)
+        ASSERT_EQ(child_service->get_object(id).lock(), nullptr);
+
+    // a full batch is sent as soon as it fills
+    service_proxy->set_release_batch_size(3);
+    bazes = create_bazes(3);
+    ids = object_ids(bazes);
+    crossings = boundary.get_stats().crossings;
+    bazes.pop_back();
+    bazes.pop_back();
+    ASSERT_EQ(boundary.get_stats().crossings, crossings);
+    bazes.pop_back();
+    ASSERT_EQ(boundary.get_stats().crossings, crossings + 1);
+    for (auto id : ids)
+        ASSERT_EQ(child_service->get_object(id).lock(), nullptr);
+
+    // anything still held when the example goes is flushed with it at teardown
+    bazes = create_bazes(2);
+    bazes.clear();
+}
+
+// an example that keeps a baz made in a zone of its own and hands out that same baz, so that the zone in the middle
+// holds its own proxy to an object that it forwards
+class baz_relay_example : public example
+{
+    rpc::weak_ptr<rpc::child_service> service_;
+    rpc::shared_ptr<yyy::i_example> leaf_;
+    rpc::weak_ptr<rpc::child_service> leaf_service_;
+    rpc::shared_ptr<xxx::i_baz> kept_;
+
+public:
+    baz_relay_example(const rpc::shared_ptr<rpc::child_service>& this_service)
+        : example(this_service, nullptr)
+        , service_(this_service)
+    {
+    }
+
+    rpc::shared_ptr<rpc::child_service> get_leaf_service() const { return leaf_service_.lock(); }
+    rpc::shared_ptr<xxx::i_baz> get_kept() const { return kept_; }
+
+    error_code create_baz(rpc::shared_ptr<xxx::i_baz>& target) override
+    {
+        if (!leaf_)
+        {
+            auto err_code
+                = service_.lock()->connect_to_zone<rpc::local_child_service_proxy<yyy::i_example, yyy::i_host>>("leaf",
+                    {++(*zone_gen)},
+                    rpc::shared_ptr<yyy::i_host>(),
+                    leaf_,
+                    [this](const rpc::shared_ptr<yyy::i_host>& host,
+                        rpc::shared_ptr<yyy::i_example>& new_example,
+                        const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+                    {
+                        leaf_service_ = child_service_ptr;
+                        child_service_ptr->enable_indirect_reference_counting();
+                        example_import_idl_register_stubs(child_service_ptr);
+                        example_shared_idl_register_stubs(child_service_ptr);
+                        example_idl_register_stubs(child_service_ptr);
+                        new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, host));
+                        return rpc::error::OK();
+                    });
+            if (err_code != rpc::error::OK())
+                return err_code;
+        }
+        if (!kept_)
+        {
+            auto err_code = leaf_->create_baz(kept_);
+            if (err_code != rpc::error::OK())
+                return err_code;
+        }
+        target = kept_;
+        return rpc::error::OK();
+    }
+
+    // a null baz lets go of the one that is kept
+    error_code give_interface(const rpc::shared_ptr<xxx::i_baz> val) override
+    {
+        kept_ = val;
+        return rpc::error::OK();
+    }
+};
+
+// root -> relay -> leaf with every zone absorbing releases as reference credit
+class baz_relay_setup : public inproc_setup<false, false, false>
+{
+public:
+    // the example of the relay zone, valid until TearDown
+    baz_relay_example* relay = nullptr;
+
+    void TearDown() override
+    {
+        rpc::weak_ptr<rpc::child_service> leaf_service = relay->get_leaf_service();
+        relay = nullptr;
+        inproc_setup::TearDown();
+        ASSERT_EQ(leaf_service.lock(), nullptr);
+    }
+
+protected:
+    void on_service_created(const rpc::shared_ptr<rpc::service>& service) override
+    {
+        service->enable_indirect_reference_counting();
+    }
+    rpc::shared_ptr<yyy::i_example> make_example(const rpc::shared_ptr<rpc::child_service>& child_service_ptr) override
+    {
+        relay = new baz_relay_example(child_service_ptr);
+        return rpc::shared_ptr<yyy::i_example>(relay);
+    }
+};
+
+using indirect_reference_test = type_test<checked_teardown_setup<baz_relay_setup>>;
+
+TEST_F(indirect_reference_test, the_root_releases_before_the_relay)
+{
+    auto& relay = *get_lib().relay;
+    auto credit = [&]() { return relay.get_kept()->query_proxy_base()->get_object_proxy()->get_reference_credit(); };
+
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    auto leaf_service = relay.get_leaf_service();
+    auto object_id = relay.get_kept()->query_proxy_base()->get_object_proxy()->get_object_id();
+    ASSERT_EQ(credit(), 0u);
+
+    // the relay keeps the roots release rather than passing it on to the leaf
+    baz = nullptr;
+    ASSERT_EQ(credit(), 1u);
+    ASSERT_NE(leaf_service->get_object(object_id).lock(), nullptr);
+
+    // and lends it out again when it forwards the baz
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    ASSERT_EQ(credit(), 0u);
+    baz = nullptr;
+    ASSERT_EQ(credit(), 1u);
+
+    // the credit goes back to the leaf with the relays own reference
+    ASSERT_EQ(get_lib().get_example()->give_interface(nullptr), rpc::error::OK());
+    ASSERT_EQ(leaf_service->get_object(object_id).lock(), nullptr);
+    leaf_service = nullptr;
+}
+
+TEST_F(indirect_reference_test, the_relay_releases_before_the_root)
+{
+    auto& relay = *get_lib().relay;
+
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    auto leaf_service = relay.get_leaf_service();
+    auto object_id = relay.get_kept()->query_proxy_base()->get_object_proxy()->get_object_id();
+
+    // with no proxy of its own left the relay has nowhere to keep credit
+    ASSERT_EQ(get_lib().get_example()->give_interface(nullptr), rpc::error::OK());
+    ASSERT_NE(leaf_service->get_object(object_id).lock(), nullptr);
+    baz = nullptr;
+    ASSERT_EQ(leaf_service->get_object(object_id).lock(), nullptr);
+    leaf_service = nullptr;
+}
+
+TEST_F(indirect_reference_test, credit_still_held_at_teardown_is_returned)
+{
+    auto& relay = *get_lib().relay;
+
+    rpc::shared_ptr<xxx::i_baz> baz;
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    // the root already has a proxy to the baz so it hands the second reference straight back, which the relay keeps
+    ASSERT_EQ(get_lib().get_example()->create_baz(baz), rpc::error::OK());
+    ASSERT_EQ(relay.get_kept()->query_proxy_base()->get_object_proxy()->get_reference_credit(), 1u);
+    baz = nullptr;
+    ASSERT_EQ(relay.get_kept()->query_proxy_base()->get_object_proxy()->get_reference_credit(), 2u);
+    // the relay and leaf zones go with the credit outstanding, the checked teardown finds nothing left behind
+}
+
+#ifdef __linux__
+#ifdef RPC_SHM_CHILD_PATH
+TEST(shm_service_proxy, calls_a_zone_in_a_child_process)
+{
+    auto shm_name = "/rpc_test_" + std::to_string(getpid());
+    auto channel = rpc::shm_channel::create(shm_name);
+    ASSERT_NE(channel, nullptr);
+
+    // the child is a separate program, forking this process with its worker threads running is not safe
+    std::string child_path = RPC_SHM_CHILD_PATH;
+    char* child_argv[] = {child_path.data(), shm_name.data(), nullptr};
+    pid_t pid = 0;
+    ASSERT_EQ(posix_spawn(&pid, child_path.c_str(), nullptr, nullptr, child_argv, environ), 0);
+
+    {
+        auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{1});
+        rpc::shared_ptr<yyy::i_example> example_ptr;
+        auto err_code = root_service->connect_to_zone<rpc::shm_service_proxy>(
+            "shm child", {2}, rpc::shared_ptr<yyy::i_host>(), example_ptr, channel);
+        EXPECT_EQ(err_code, rpc::error::OK());
+        if (example_ptr)
+        {
+            int c = 0;
+            EXPECT_EQ(example_ptr->add(1, 2, c), rpc::error::OK());
+            EXPECT_EQ(c, 3);
+        }
+    }
+    // the channel closed when the last proxy to the child went away, so the child winds its zone down and exits
+    channel = nullptr;
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+#endif
+
+TEST(uds_service_proxy, shares_one_connection_between_threads)
+{
+    auto path = "/tmp/rpc_test_" + std::to_string(getpid()) + ".sock";
+    auto listener = rpc::uds_listener::listen<yyy::i_host, yyy::i_example>("uds server",
+        path,
+        [](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, host));
+            return rpc::error::OK();
+        });
+    ASSERT_NE(listener, nullptr);
+
+    {
+        auto channel = rpc::uds_channel::connect(path);
+        ASSERT_NE(channel, nullptr);
+        auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{1});
+        rpc::shared_ptr<yyy::i_example> example_ptr;
+        ASSERT_EQ(root_service->connect_to_zone<rpc::uds_service_proxy>(
+                      "uds client", {2}, rpc::shared_ptr<yyy::i_host>(), example_ptr, channel),
+            rpc::error::OK());
+
+        std::vector<std::thread> threads;
+        std::atomic<int> failures = 0;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back(
+                [&, t]()
+                {
+                    for (int i = 0; i < 100; i++)
+                    {
+                        int c = 0;
+                        if (example_ptr->add(t, i, c) != rpc::error::OK() || c != t + i)
+                            failures++;
+                    }
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        EXPECT_EQ(failures, 0);
+    }
+    listener->close();
+}
+
+// notifications to a gated baz do not finish until the test opens the gate, or a timeout passes
+class gated_baz : public baz
+{
+    std::shared_ptr<notify_gate> gate_;
+
+public:
+    gated_baz(rpc::zone zone_id, std::shared_ptr<notify_gate> gate)
+        : baz(zone_id)
+        , gate_(gate)
+    {
+    }
+    error_code notify(int val) override
+    {
+        std::unique_lock lock(gate_->control);
+        gate_->cv.wait_for(lock, std::chrono::seconds(10), [&]() { return gate_->open; });
+        gate_->finished++;
+        gate_->cv.notify_all();
+        return baz::notify(val);
+    }
+};
+
+class gated_baz_example : public example
+{
+    std::shared_ptr<notify_gate> gate_;
+    rpc::zone zone_id_;
+
+public:
+    gated_baz_example(rpc::shared_ptr<rpc::child_service> this_service, std::shared_ptr<notify_gate> gate)
+        : example(this_service, nullptr)
+        , gate_(gate)
+        , zone_id_(this_service->get_zone_id())
+    {
+    }
+    error_code create_baz(rpc::shared_ptr<xxx::i_baz>& target) override
+    {
+        target = rpc::shared_ptr<xxx::i_baz>(new gated_baz(zone_id_, gate_));
+        return rpc::error::OK();
+    }
+};
+
+TEST(uds_service_proxy, oneway_calls_return_before_the_callee_finishes)
+{
+    auto gate = std::make_shared<notify_gate>();
+    auto path = "/tmp/rpc_test_oneway_" + std::to_string(getpid()) + ".sock";
+    auto listener = rpc::uds_listener::listen<yyy::i_host, yyy::i_example>("uds server",
+        path,
+        [gate](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new gated_baz_example(child_service_ptr, gate));
+            return rpc::error::OK();
+        });
+    ASSERT_NE(listener, nullptr);
+
+    {
+        auto channel = rpc::uds_channel::connect(path);
+        ASSERT_NE(channel, nullptr);
+        auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{1});
+        rpc::shared_ptr<yyy::i_example> example_ptr;
+        ASSERT_EQ(root_service->connect_to_zone<rpc::uds_service_proxy>(
+                      "uds client", {2}, rpc::shared_ptr<yyy::i_host>(), example_ptr, channel),
+            rpc::error::OK());
+        rpc::shared_ptr<xxx::i_baz> baz_ptr;
+        ASSERT_EQ(example_ptr->create_baz(baz_ptr), rpc::error::OK());
+
+        // the callee cannot finish until the gate opens, which only happens once notify has returned here
+        ASSERT_EQ(baz_ptr->notify(1), rpc::error::OK());
+        {
+            std::unique_lock lock(gate->control);
+            ASSERT_EQ(gate->finished, 0);
+            gate->open = true;
+            gate->cv.notify_all();
+            ASSERT_TRUE(gate->cv.wait_for(lock, std::chrono::seconds(10), [&]() { return gate->finished == 1; }));
+        }
+        // the connection still carries normal calls and no stray reply was left behind
+        int c = 0;
+        ASSERT_EQ(example_ptr->add(1, 2, c), rpc::error::OK());
+        ASSERT_EQ(c, 3);
+    }
+    listener->close();
+}
+
+#ifdef BUILD_COROUTINE
+TEST(uds_service_proxy, an_awaited_call_lets_go_of_its_thread_until_the_reply_arrives)
+{
+    auto path = "/tmp/rpc_test_async_" + std::to_string(getpid()) + ".sock";
+    auto listener = rpc::uds_listener::listen<yyy::i_host, yyy::i_example>("uds server",
+        path,
+        [](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, host));
+            return rpc::error::OK();
+        });
+    ASSERT_NE(listener, nullptr);
+
+    {
+        auto channel = rpc::uds_channel::connect(path);
+        ASSERT_NE(channel, nullptr);
+        auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{1});
+        rpc::shared_ptr<yyy::i_example> example_ptr;
+        ASSERT_EQ(root_service->connect_to_zone<rpc::uds_service_proxy>(
+                      "uds client", {2}, rpc::shared_ptr<yyy::i_host>(), example_ptr, channel),
+            rpc::error::OK());
+
+        // a blocking fallback would carry on on the thread that started the call, a suspended call is picked up by
+        // the channel worker that the reply is handed to
+        auto caller = std::this_thread::get_id();
+        std::thread::id resumed_on;
+        int c = 0;
+        auto call = [&]() -> rpc::task<int>
+        {
+            auto err = co_await example_ptr->add_async(1, 2, c);
+            resumed_on = std::this_thread::get_id();
+            co_return err;
+        };
+        ASSERT_EQ(rpc::sync_wait(call()), rpc::error::OK());
+        ASSERT_EQ(c, 3);
+        ASSERT_NE(resumed_on, caller);
+    }
+    listener->close();
+}
+#endif
+
+TEST(uring_service_proxy, serves_uring_and_uds_clients)
+{
+    auto path = "/tmp/rpc_test_uring_" + std::to_string(getpid()) + ".sock";
+    auto listener = rpc::uring_listener::listen<yyy::i_host, yyy::i_example>("uring server",
+        path,
+        [](const rpc::shared_ptr<yyy::i_host>& host,
+            rpc::shared_ptr<yyy::i_example>& new_example,
+            const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+        {
+            example_import_idl_register_stubs(child_service_ptr);
+            example_shared_idl_register_stubs(child_service_ptr);
+            example_idl_register_stubs(child_service_ptr);
+            new_example = rpc::shared_ptr<yyy::i_example>(new example(child_service_ptr, host));
+            return rpc::error::OK();
+        });
+    if (!listener)
+        GTEST_SKIP() << "io_uring is not available";
+
+    // both transports share a wire format so a client may use either
+    std::vector<std::shared_ptr<rpc::transport_channel>> channels
+        = {rpc::uring_channel::connect(path), rpc::uds_channel::connect(path)};
+    uint64_t zone_id = 1;
+    for (auto& channel : channels)
+    {
+        ASSERT_NE(channel, nullptr);
+        auto root_service = rpc::make_shared<rpc::service>("host", rpc::zone{zone_id});
+        rpc::shared_ptr<yyy::i_example> example_ptr;
+        ASSERT_EQ(root_service->connect_to_zone<rpc::uring_service_proxy>(
+                      "uring client", {zone_id + 1}, rpc::shared_ptr<yyy::i_host>(), example_ptr, channel),
+            rpc::error::OK());
+        zone_id += 2;
+
+        std::vector<std::thread> threads;
+        std::atomic<int> failures = 0;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back(
+                [&, t]()
+                {
+                    for (int i = 0; i < 100; i++)
+                    {
+                        int c = 0;
+                        if (example_ptr->add(t, i, c) != rpc::error::OK() || c != t + i)
+                            failures++;
+                    }
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        EXPECT_EQ(failures, 0);
+    }
+    channels.clear();
+    listener->close();
+}
+#endif
+
 static_assert(rpc::id<std::string>::get(rpc::VERSION_2) == rpc::STD_STRING_ID);
 
 static_assert(rpc::id<xxx::test_template<std::string>>::get(rpc::VERSION_2) == 0xAFFFFFEB79FBFBFB);
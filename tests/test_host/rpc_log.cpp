@@ -5,6 +5,7 @@
 #include <spdlog/spdlog.h>
 
 #include <rpc/service.h>
+#include <rpc/buffer_pool.h>
 #ifdef USE_RPC_TELEMETRY
 #include <rpc/telemetry/host_telemetry_service.h>
 #include <rpc/telemetry/telemetry_handler.h>
@@ -34,6 +35,12 @@ extern "C"
     {
         thread_local rpc::retry_buffer retry_buf;
 
+        // data_in would be dereferenced as pointers into the enclaves address space
+        if (rpc::encoding(encoding) == rpc::encoding::direct)
+        {
+            return rpc::error::INCOMPATIBLE_SERIALISATION();
+        }
+
         auto root_service = current_host_service.lock();
         if (!root_service)
         {
@@ -42,7 +49,7 @@ extern "C"
         }
         if (retry_buf.data.empty())
         {
-            std::vector<char> out_data(sz_out);
+            rpc::pooled_buffer out_data(sz_out);
             retry_buf.return_value = root_service->send(protocol_version,
                 rpc::encoding(encoding),
                 tag,
@@ -54,12 +61,21 @@ extern "C"
                 {method_id},
                 sz_int,
                 data_in,
-                out_data);
+                out_data.get());
             if (retry_buf.return_value >= rpc::error::MIN() && retry_buf.return_value <= rpc::error::MAX())
             {
                 return retry_buf.return_value;
             }
-            retry_buf.data.swap(out_data);
+            // a reply that fits goes straight out and the pooled buffer goes back, only one that does not is copied
+            // and parked for the retry
+            *data_out_sz = out_data.get().size();
+            if (*data_out_sz <= sz_out)
+            {
+                memcpy(data_out, out_data.get().data(), *data_out_sz);
+                return retry_buf.return_value;
+            }
+            retry_buf.data.assign(out_data.get().begin(), out_data.get().end());
+            return rpc::error::NEED_MORE_MEMORY();
         }
         *data_out_sz = retry_buf.data.size();
         if (*data_out_sz > sz_out)
@@ -114,6 +130,24 @@ extern "C"
         }
         return root_service->release(protocol_version, {zone_id}, {object_id}, {caller_zone_id});
     }
+    uint64_t release_batch_host(uint64_t protocol_version, // version of the rpc call protocol
+        uint64_t zone_id,
+        uint64_t caller_zone_id,
+        size_t sz_in,
+        const char* data_in)
+    {
+        auto root_service = current_host_service.lock();
+        if (!root_service)
+        {
+            return rpc::error::TRANSPORT_ERROR();
+        }
+        std::vector<std::pair<rpc::object, uint64_t>> releases;
+        if (!rpc::unpack_release_batch(data_in, sz_in, releases))
+        {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return root_service->release_batch(protocol_version, {zone_id}, {caller_zone_id}, releases);
+    }
 
     void rpc_log(const char* str, size_t sz)
     {
@@ -0,0 +1,370 @@
+/*
+ *   Copyright (c) 2024 Edward Boggis-Rolfe
+ *   All rights reserved.
+ */
+
+// compares the socket transports over loopback, each one serves the same example zone and every client thread makes
+// round trips through i_example::add.  The blocking transport below is the baseline, one thread per connection blocked
+// in recv and callers blocked in send
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include <common/foo_impl.h>
+
+#include <example/example.h>
+
+#include <rpc/transport_channel.h>
+#include <rpc/uds_service_proxy.h>
+#include <rpc/uring_service_proxy.h>
+#ifdef USE_RPC_TELEMETRY
+#include <rpc/telemetry/host_telemetry_service.h>
+#endif
+
+#ifdef USE_RPC_TELEMETRY
+TELEMETRY_SERVICE_MANAGER
+#endif
+
+extern "C"
+{
+    void rpc_log(const char* str, size_t sz)
+    {
+#ifdef USE_RPC_LOGGING
+        spdlog::info(std::string(str, sz));
+#endif
+    }
+}
+
+namespace
+{
+    constexpr size_t max_message_size = 1 << 28;
+
+    class blocking_socket_channel : public rpc::transport_channel
+    {
+        int fd_ = -1;
+        std::mutex write_control_;
+        rpc::stream_message_reader reader_;
+
+        explicit blocking_socket_channel(int fd)
+            : fd_(fd)
+        {
+        }
+
+        void receive_loop()
+        {
+            while (true)
+            {
+                size_t available = 0;
+                auto* dest = reader_.prepare(0x10000, available);
+                auto count = recv(fd_, dest, available, 0);
+                if (count == -1 && errno == EINTR)
+                    continue;
+                if (count <= 0)
+                    break;
+                reader_.commit(count);
+                if (!reader_.extract(get_max_payload_size(),
+                        [this](const rpc::transport_message& header, std::vector<char>& payload)
+                        { on_message(header, payload); }))
+                    break;
+            }
+            close();
+            on_receiver_stopped();
+        }
+
+    protected:
+        int write_message(const rpc::transport_message& header, const char* payload) override
+        {
+            constexpr size_t header_size = sizeof(rpc::transport_message);
+            size_t total = header_size + header.payload_size;
+            size_t sent = 0;
+
+            std::lock_guard g(write_control_);
+            while (sent < total)
+            {
+                iovec iov[2];
+                size_t iov_count = 0;
+                if (sent < header_size)
+                {
+                    iov[iov_count++] = {(char*)&header + sent, header_size - sent};
+                    if (header.payload_size)
+                        iov[iov_count++] = {(void*)payload, header.payload_size};
+                }
+                else
+                {
+                    iov[iov_count++] = {(void*)(payload + sent - header_size), total - sent};
+                }
+                msghdr msg = {};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = iov_count;
+
+                auto count = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+                if (count > 0)
+                {
+                    sent += count;
+                    continue;
+                }
+                if (count == -1 && errno == EINTR)
+                    continue;
+                return rpc::error::TRANSPORT_ERROR();
+            }
+            return rpc::error::OK();
+        }
+
+        void start_receiver() override
+        {
+            auto self = std::static_pointer_cast<blocking_socket_channel>(shared_from_this());
+            std::thread([self]() { self->receive_loop(); }).detach();
+        }
+
+        void on_close() override { shutdown(fd_, SHUT_RDWR); }
+
+    public:
+        ~blocking_socket_channel() override { ::close(fd_); }
+
+        static std::shared_ptr<blocking_socket_channel> connect(const std::string& path)
+        {
+            int fd = rpc::connect_unix_socket(path, false);
+            if (fd == -1)
+                return nullptr;
+            return std::shared_ptr<blocking_socket_channel>(new blocking_socket_channel(fd));
+        }
+
+        static std::shared_ptr<blocking_socket_channel> accept(int listener_fd)
+        {
+            int fd = ::accept4(listener_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd == -1)
+                return nullptr;
+            return std::shared_ptr<blocking_socket_channel>(new blocking_socket_channel(fd));
+        }
+
+        size_t get_max_payload_size() const override { return max_message_size - sizeof(rpc::transport_message); }
+    };
+
+    class blocking_socket_listener : public rpc::transport_listener
+    {
+        int fd_ = -1;
+        std::string path_;
+        std::atomic<bool> closed_ = false;
+        std::thread thread_;
+
+        blocking_socket_listener() = default;
+
+    public:
+        ~blocking_socket_listener() override
+        {
+            close();
+            if (thread_.joinable())
+                thread_.join();
+            ::close(fd_);
+        }
+
+        template<class PARENT_INTERFACE, class CHILD_INTERFACE>
+        static std::shared_ptr<blocking_socket_listener> listen(const char* name,
+            const std::string& path,
+            std::function<int(const rpc::shared_ptr<PARENT_INTERFACE>&,
+                rpc::shared_ptr<CHILD_INTERFACE>&,
+                const rpc::shared_ptr<rpc::child_service>&)> fn)
+        {
+            int fd = rpc::listen_unix_socket(path, false);
+            if (fd == -1)
+                return nullptr;
+            auto listener = std::shared_ptr<blocking_socket_listener>(new blocking_socket_listener());
+            listener->fd_ = fd;
+            listener->path_ = path;
+            listener->template set_child_zone_factory<PARENT_INTERFACE, CHILD_INTERFACE>(name, fn);
+            auto* raw = listener.get();
+            listener->thread_ = std::thread(
+                [raw]()
+                {
+                    while (!raw->closed_)
+                    {
+                        if (auto channel = blocking_socket_channel::accept(raw->fd_))
+                            raw->on_accept_(channel);
+                        else if (errno != EINTR && errno != ECONNABORTED)
+                            break;
+                    }
+                });
+            return listener;
+        }
+
+        void close() override
+        {
+            if (closed_.exchange(true))
+                return;
+            unlink(path_.c_str());
+            // wakes the accepting thread
+            shutdown(fd_, SHUT_RDWR);
+        }
+    };
+
+    using example_factory = std::function<int(const rpc::shared_ptr<yyy::i_host>&,
+        rpc::shared_ptr<yyy::i_example>&,
+        const rpc::shared_ptr<rpc::child_service>&)>;
+
+    struct transport
+    {
+        const char* name;
+        std::function<std::shared_ptr<rpc::transport_listener>(const std::string&, example_factory)> listen;
+        std::function<std::shared_ptr<rpc::transport_channel>(const std::string&)> connect;
+    };
+
+    struct options
+    {
+        int connections = 8;
+        int threads = 4;
+        int calls = 20000;
+    };
+
+    void run(const transport& transport, const options& opts)
+    {
+        auto path = "/tmp/rpc_transport_benchmark_" + std::to_string(getpid()) + ".sock";
+        auto listener = transport.listen(path,
+            [](const rpc::shared_ptr<yyy::i_host>& host,
+                rpc::shared_ptr<yyy::i_example>& new_example,
+                const rpc::shared_ptr<rpc::child_service>& child_service_ptr) -> int
+            {
+                example_import_idl_register_stubs(child_service_ptr);
+                example_shared_idl_register_stubs(child_service_ptr);
+                example_idl_register_stubs(child_service_ptr);
+                new_example = rpc::shared_ptr<yyy::i_example>(
+                    new marshalled_tests::example(child_service_ptr, host));
+                return rpc::error::OK();
+            });
+        if (!listener)
+        {
+            std::printf("%-10s unavailable\n", transport.name);
+            return;
+        }
+
+        struct client
+        {
+            rpc::shared_ptr<rpc::service> service;
+            rpc::shared_ptr<yyy::i_example> example;
+        };
+        std::vector<client> clients(opts.connections);
+        for (int i = 0; i < opts.connections; i++)
+        {
+            auto channel = transport.connect(path);
+            if (!channel)
+            {
+                std::printf("%-10s failed to connect\n", transport.name);
+                listener->close();
+                return;
+            }
+            uint64_t zone_id = 2 * i + 1;
+            clients[i].service = rpc::make_shared<rpc::service>("benchmark client", rpc::zone{zone_id});
+            auto err_code = clients[i].service->connect_to_zone<rpc::transport_service_proxy>("benchmark server",
+                {zone_id + 1},
+                rpc::shared_ptr<yyy::i_host>(),
+                clients[i].example,
+                channel);
+            if (err_code != rpc::error::OK())
+            {
+                std::printf("%-10s failed to connect to the zone %d\n", transport.name, err_code);
+                listener->close();
+                return;
+            }
+            // warms up the worker pools on both sides
+            for (int call = 0; call < 100; call++)
+            {
+                int c = 0;
+                clients[i].example->add(call, 1, c);
+            }
+        }
+
+        std::atomic<int> failures = 0;
+        std::atomic<bool> go = false;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < opts.connections; i++)
+        {
+            for (int t = 0; t < opts.threads; t++)
+            {
+                threads.emplace_back(
+                    [&, i]()
+                    {
+                        while (!go)
+                            std::this_thread::yield();
+                        auto& example = clients[i].example;
+                        for (int call = 0; call < opts.calls; call++)
+                        {
+                            int c = 0;
+                            if (example->add(call, 1, c) != rpc::error::OK() || c != call + 1)
+                                failures++;
+                        }
+                    });
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        go = true;
+        for (auto& thread : threads)
+            thread.join();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double total = double(opts.connections) * opts.threads * opts.calls;
+        std::printf("%-10s %14.0f %14.2f %10d\n",
+            transport.name,
+            total / elapsed.count(),
+            elapsed.count() * 1e6 * opts.connections * opts.threads / total,
+            failures.load());
+
+        clients.clear();
+        listener->close();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    options opts;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!std::strcmp(argv[i], "--connections"))
+            opts.connections = std::max(1, std::atoi(argv[i + 1]));
+        else if (!std::strcmp(argv[i], "--threads"))
+            opts.threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (!std::strcmp(argv[i], "--calls"))
+            opts.calls = std::max(1, std::atoi(argv[i + 1]));
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--connections n] [--threads n] [--calls n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<transport> transports = {
+        {"blocking",
+            [](const std::string& path, example_factory fn) -> std::shared_ptr<rpc::transport_listener>
+            { return blocking_socket_listener::listen<yyy::i_host, yyy::i_example>("benchmark server", path, fn); },
+            [](const std::string& path) -> std::shared_ptr<rpc::transport_channel>
+            { return blocking_socket_channel::connect(path); }},
+        {"epoll",
+            [](const std::string& path, example_factory fn) -> std::shared_ptr<rpc::transport_listener>
+            { return rpc::uds_listener::listen<yyy::i_host, yyy::i_example>("benchmark server", path, fn); },
+            [](const std::string& path) -> std::shared_ptr<rpc::transport_channel>
+            { return rpc::uds_channel::connect(path); }},
+        {"io_uring",
+            [](const std::string& path, example_factory fn) -> std::shared_ptr<rpc::transport_listener>
+            { return rpc::uring_listener::listen<yyy::i_host, yyy::i_example>("benchmark server", path, fn); },
+            [](const std::string& path) -> std::shared_ptr<rpc::transport_channel>
+            { return rpc::uring_channel::connect(path); }},
+    };
+
+    std::printf("%d connections, %d threads per connection, %d calls per thread\n",
+        opts.connections,
+        opts.threads,
+        opts.calls);
+    std::printf("%-10s %14s %14s %10s\n", "transport", "calls/s", "us/call", "failures");
+    for (auto& transport : transports)
+        run(transport, opts);
+    return 0;
+}